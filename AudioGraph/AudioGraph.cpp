@@ -26,12 +26,28 @@
 
 #include "AudioGraph.h"
 #include "CAudioGraphFactory.h"
+#include "CAudioGraphCompiler.h"
 
 HRESULT AudioGraphCreateFactory (
 	IAudioGraphCallback* pAudioGraphCallback,
 	IAudioGraphFactory** ppAudioGraphFactory
 ) {
-	if (pAudioGraphCallback == nullptr || ppAudioGraphFactory == nullptr) {
+	AUDIO_GRAPH_FACTORY_DESC Desc;
+	ZeroMemory(&Desc, sizeof(Desc));
+
+	return AudioGraphCreateFactoryEx (
+		&Desc,
+		pAudioGraphCallback,
+		ppAudioGraphFactory
+	);
+}
+
+HRESULT AudioGraphCreateFactoryEx (
+	const AUDIO_GRAPH_FACTORY_DESC* pDesc,
+	IAudioGraphCallback* pAudioGraphCallback,
+	IAudioGraphFactory** ppAudioGraphFactory
+) {
+	if (pDesc == nullptr || pAudioGraphCallback == nullptr || ppAudioGraphFactory == nullptr) {
 		return E_POINTER;
 	}
 
@@ -39,7 +55,7 @@ HRESULT AudioGraphCreateFactory (
 
 	CComPtr<CAudioGraphFactory> Factory = new CAudioGraphFactory();
 
-	hr = Factory->Initialize(pAudioGraphCallback);
+	hr = Factory->Initialize(pDesc, pAudioGraphCallback);
 
 	if (FAILED(hr)) {
 		*ppAudioGraphFactory = nullptr;
@@ -49,4 +65,26 @@ HRESULT AudioGraphCreateFactory (
 	*ppAudioGraphFactory = Factory;
 
 	return S_OK;
+}
+
+HRESULT AudioGraphCompileFile (
+	LPCWSTR XmlFilename,
+	LPCWSTR ImageFilename
+) {
+	if (XmlFilename == nullptr || ImageFilename == nullptr) {
+		return E_POINTER;
+	}
+
+	HRESULT hr = S_OK;
+
+	CAudioGraphCompiler Compiler;
+	std::vector<BYTE> Image;
+
+	hr = Compiler.CompileFile(XmlFilename, Image);
+
+	if (FAILED(hr)) {
+		return hr;
+	}
+
+	return CAudioGraphCompiler::WriteImage(ImageFilename, Image);
 }
\ No newline at end of file
@@ -31,6 +31,20 @@ struct IAudioGraphFile;
 struct IAudioGraph;
 struct IAudioGraphFactory;
 
+/* A trigger handle is a trigger string resolved ahead of time with IAudioGraph::ResolveTrigger(), so that choosing
+** a transition doesn't involve any strings.  Handles are shared by every graph in the same file. */
+typedef UINT AUDIO_GRAPH_TRIGGER;
+
+/* The handle of a trigger that no edge in the file uses.  Transitioning on it replays the current node. */
+static const AUDIO_GRAPH_TRIGGER AUDIO_GRAPH_TRIGGER_NONE = 0xFFFFFFFF;
+
+/* The shape of the gain ramps used when an edge crossfades from one node to the next. */
+enum AUDIO_GRAPH_CURVE {
+	AUDIO_GRAPH_CURVE_EQUAL_POWER = 0, //curve = "equalpower", or no curve attribute - the combined power stays constant, which suits unrelated material
+	AUDIO_GRAPH_CURVE_LINEAR, //curve = "linear" - the combined amplitude stays constant, which suits material that is in phase
+	AUDIO_GRAPH_CURVE_COUNT
+};
+
 /* IAudioGraphCallback is an interface that acts as a callback boundary between the application and the
 ** library. */
 struct __declspec(uuid("b7fa0e54-41d7-4161-81d6-3036900cfc80")) IAudioGraphCallback : public IUnknown {
@@ -45,8 +59,24 @@ struct __declspec(uuid("b7fa0e54-41d7-4161-81d6-3036900cfc80")) IAudioGraphCallb
 	virtual LPCSTR STDMETHODCALLTYPE OnTransition(IAudioGraph* pAudioGraph, IAudioGraphNode* pNode) PURE;
 };
 
+/* IAudioGraphCallback2 is an optional extension of IAudioGraphCallback.  If the callback passed to the factory
+** implements it, OnTransitionTrigger() is called in place of OnTransition(), so the application never has to
+** build a string on the audio thread. */
+struct __declspec(uuid("12427771-6c17-4d96-b12e-5d47c485bb4f")) IAudioGraphCallback2 : public IAudioGraphCallback {
+	/* OnTransitionTrigger() is called when a node is about to finish playing, unless a trigger has already been
+	** posted with IAudioGraph::PostTrigger().  It should return the handle of the desired trigger, as given by
+	** IAudioGraph::ResolveTrigger().  This is called on the audio thread, so it should return quickly. */
+	virtual AUDIO_GRAPH_TRIGGER STDMETHODCALLTYPE OnTransitionTrigger(IAudioGraph* pAudioGraph, IAudioGraphNode* pNode) PURE;
+};
+
 /* IAudioGraphEdge represents a directed edge in the audio graph. Associated with it is a trigger, 
-** which is used to identify which particular edge is the path to take when a node is finished playing. */
+** which is used to identify which particular edge is the path to take when a node is finished playing.
+** By default, the destination node starts the moment the source node ends.  An edge with a crossfade
+** attribute instead keeps playing the audio that follows the source node in its file for that many
+** milliseconds, fading it out while the destination fades in.  A crossfade longer than the destination
+** node is shortened to fit it, so it's always over before the next transition.  A preroll attribute starts
+** the destination that many milliseconds ahead of its offset, so a pickup before the offset plays during
+** the overlap. */
 struct __declspec(uuid("2a4bee1e-2d02-4f9c-bed9-eaedfb95331d")) IAudioGraphEdge : public IUnknown {
 	/* Returns the ID of this particular edge. */
 	virtual LPCSTR STDMETHODCALLTYPE GetID() PURE;
@@ -68,6 +98,15 @@ struct __declspec(uuid("2a4bee1e-2d02-4f9c-bed9-eaedfb95331d")) IAudioGraphEdge
 
 	/* Retrieves the audio graph file that this edge is associated with, if there is one. */
 	virtual VOID STDMETHODCALLTYPE GetAudioGraphFile(IAudioGraphFile** ppAudioGraphFile) PURE;
+
+	/* Returns the length of the crossfade in milliseconds, or 0 if the edge cuts straight to the destination. */
+	virtual UINT STDMETHODCALLTYPE GetCrossfadeTime() PURE;
+
+	/* Returns the curve of the crossfade. */
+	virtual AUDIO_GRAPH_CURVE STDMETHODCALLTYPE GetCrossfadeCurve() PURE;
+
+	/* Returns how many milliseconds before its offset the destination node starts playing. */
+	virtual UINT STDMETHODCALLTYPE GetPrerollTime() PURE;
 };
 
 /* IAudioGraphNode represents a node in an audio graph.  It can only be a member of a single audio graph -
@@ -79,14 +118,19 @@ struct __declspec(uuid("b8fd4cc2-4360-4701-bb1c-8715fd77d38e")) IAudioGraphNode
 	/* Returns this node's formatted style string, which was used to create it. */
 	virtual LPCSTR STDMETHODCALLTYPE GetStyleString() PURE;
 
-	/* Returns the name of the audio file that this node is streamed from. */
+	/* Returns the name of the audio file that this node is streamed from.  PCM and floating-point WAV files that
+	** already match the stream's sample rate and channel count are mapped into memory and read directly, with exact
+	** seeks.  A background thread reads them from the disk ahead of the audio thread, which would otherwise wait
+	** on the disk the first time it reached each part of the file.  Every other file is decoded by Media Foundation. */
 	virtual LPCSTR STDMETHODCALLTYPE GetAudioFilename() PURE;
 
 	/* Returns the offset this node has from the start of the PCM audio data in the
-	** associated file, in samples. */
+	** associated file, in samples at the file's own sample rate.  An offset too large for a UINT is
+	** returned as UINT_MAX - IAudioGraphNode2::GetSampleOffset64() returns the whole of it. */
 	virtual UINT STDMETHODCALLTYPE GetSampleOffset() PURE;
 
-	/* Returns the duration this node will play for, in samples. */
+	/* Returns the duration this node will play for, in samples at the file's own sample rate.  A duration
+	** too large for a UINT is returned as UINT_MAX - IAudioGraphNode2::GetSampleDuration64() returns the whole of it. */
 	virtual UINT STDMETHODCALLTYPE GetSampleDuration() PURE;
 
 	/* Returns the offset this node has from the start of the PCM audio data in the
@@ -113,6 +157,21 @@ struct __declspec(uuid("b8fd4cc2-4360-4701-bb1c-8715fd77d38e")) IAudioGraphNode
 
 	/* Retrieves the audio graph file that this node is associated with, if there is one. */
 	virtual VOID STDMETHODCALLTYPE GetAudioGraphFile(IAudioGraphFile** ppAudioGraphFile) PURE;
+
+	/* Retrieves the edge given by the node's default attribute, which is taken when transitions are asynchronous
+	** and no trigger has been posted.  Set to nullptr if the node has no default edge. */
+	virtual VOID STDMETHODCALLTYPE GetDefaultEdge(IAudioGraphEdge** ppEdge) PURE;
+};
+
+/* IAudioGraphNode2 extends IAudioGraphNode with the node's offset and duration as 64-bit sample counts, for
+** files too long for a UINT.  Every node implements it, and it's retrieved with QueryInterface(). */
+struct __declspec(uuid("b1972a2d-5006-40fc-b2a2-303535d46eb9")) IAudioGraphNode2 : public IAudioGraphNode {
+	/* Returns the offset this node has from the start of the PCM audio data in the
+	** associated file, in samples at the file's own sample rate. */
+	virtual UINT64 STDMETHODCALLTYPE GetSampleOffset64() PURE;
+
+	/* Returns the duration this node will play for, in samples at the file's own sample rate. */
+	virtual UINT64 STDMETHODCALLTYPE GetSampleDuration64() PURE;
 };
 
 /* IAudioGraph represents a single audio graph, which is composed of nodes and directed edges. */
@@ -149,6 +208,16 @@ struct __declspec(uuid("b1f2bb1c-f1da-4f0a-ba3a-b7dbe2a7c824")) IAudioGraph : pu
 
 	/* Retrieves the audio graph file that this graph is associated with, if there is one. */
 	virtual VOID STDMETHODCALLTYPE GetAudioGraphFile(IAudioGraphFile** ppAudioGraphFile) PURE;
+
+	/* Returns the handle of a trigger string, or AUDIO_GRAPH_TRIGGER_NONE if no edge uses it.  Handles should be
+	** resolved once, up front - they stay valid for as long as the file is loaded, in every graph of the file. */
+	virtual AUDIO_GRAPH_TRIGGER STDMETHODCALLTYPE ResolveTrigger(LPCSTR Trigger) PURE;
+
+	/* Sets the trigger to take when the current node finishes playing.  This may be called from any thread, at any
+	** time before the node ends, and never blocks.  The trigger is used once, in place of asking the callback, so the
+	** audio thread doesn't have to wait on the application at the transition.  Posting again before the node ends
+	** replaces the trigger.  With AUDIO_GRAPH_FACTORY_DESC::AsyncTransitions, this is the only way to choose one. */
+	virtual VOID STDMETHODCALLTYPE PostTrigger(AUDIO_GRAPH_TRIGGER Trigger) PURE;
 };
 
 /* IAudioGraphFile represents an XML file's state.  It can be loaded and parsed via IAudioGraphFactory::ParseAudioGraphFile().
@@ -167,14 +236,116 @@ struct __declspec(uuid("91a4fdda-c694-4c6c-b33e-78a04545eeaa")) IAudioGraphFile
 	virtual VOID STDMETHODCALLTYPE GetGraphByID(LPCSTR ID, IAudioGraph** ppAudioGraph) PURE;
 };
 
+/* AUDIO_GRAPH_PLAYBACK_STATS reports how playback has been going since the factory was created.
+** It is filled by IAudioGraphFactory::GetPlaybackStats(). */
+struct AUDIO_GRAPH_PLAYBACK_STATS {
+	UINT64 Callbacks; //Number of times the audio thread has asked for samples
+	UINT64 Xruns; //Callbacks that took longer to produce their samples than those samples last
+	UINT64 Transitions; //Node transitions, including nodes that replay themselves
+	UINT64 ColdTransitions; //Transitions that had to seek a source reader on the audio thread, play silence until a prefetch in progress was done, or start on part of a WAV file that hadn't been read into memory
+	UINT64 Prefetches; //Transition targets warmed ahead of time on a background thread
+	UINT64 Crossfades; //Transitions that crossfaded from one node to the next
+	UINT64 RealtimeAllocations; //Heap allocations and frees made by the audio thread while producing samples - debug builds only, and always 0 otherwise
+	UINT64 DecodeUnderruns; //Times a streamed node's decode ring ran dry, and the node played silence until it caught up
+	UINT64 RealtimeBlockingCalls; //Calls made by the audio thread while producing samples that can block or enter the kernel, such as signalling the loader or reading a source reader - debug builds only, and always 0 otherwise
+	UINT64 RenderFailures; //Failures on the audio thread.  They are passed to IAudioGraphCallback::OnObjectFailure() later, from a thread that queues graphs, reads these stats or renders offline - only the first since the last one was passed on is kept, so this can be more than the callback saw
+};
+
+/* AUDIO_GRAPH_BUS_STATS reports how a mixer bus has been doing since the factory was created.
+** It is filled by IAudioGraphFactory::GetBusStats(). */
+struct AUDIO_GRAPH_BUS_STATS {
+	UINT Voices; //Graphs playing on the bus right now
+	UINT PeakVoices; //The most graphs that have played on the bus at once
+	UINT64 DroppedVoices; //Graphs that weren't played because AUDIO_GRAPH_FACTORY_DESC::MaxVoices were already playing
+	LONGLONG ProcessTime; //Time spent rendering the bus's graphs, added up over every thread that rendered them, in 100-nanosecond units
+	LONGLONG MaxProcessTime; //The most time spent on the bus in a single callback, in 100-nanosecond units
+	DOUBLE CpuUsage; //ProcessTime divided by the duration of the audio played - at 1.0, the bus alone would take up a whole core
+};
+
+/* AUDIO_GRAPH_FACTORY_DESC is used by AudioGraphCreateFactoryEx() to determine how a factory plays its graphs. */
+struct AUDIO_GRAPH_FACTORY_DESC {
+	UINT SampleRate; //Sample rate graphs are rendered at, or 0 for the device's mix rate (44100 when offline) - files at this rate are never resampled
+	UINT Channels; //Number of channels graphs are rendered with, up to 32, or 0 for stereo - every file is mixed to this many channels
+	BOOL Offline; //If TRUE, nothing is played on a device - instead, IAudioGraphFactory::Render() renders the playback queue as fast as possible
+	LPCWSTR OfflineFilename; //Offline only - the WAV file to render to, or NULL to render to memory
+	UINT64 OfflineFrames; //Offline only - the number of frames to render, or 0 to render until the playback queue is empty
+	const LPCSTR* TransitionScript; //If not NULL, the transition strings to use in order, in place of IAudioGraphCallback::OnTransition()
+	UINT TransitionScriptLength; //The number of strings in TransitionScript - once they run out, the empty string is used
+	BOOL AsyncTransitions; //If TRUE, the callback is never asked for transitions - the audio thread takes the trigger last posted with IAudioGraph::PostTrigger(), or the node's default edge if none was posted or it has no edge from the node
+	UINT Buses; //Number of mixer buses, up to 32, or 0 for none - see IAudioGraphFactory::PlayAudioGraph()
+	UINT MaxVoices; //The most graphs that can play on the mixer buses at once, up to 256, or 0 for 256
+	UINT RenderThreads; //Threads that render the mixer's graphs alongside the audio thread, up to 32, or 0 to render them all on the audio thread - only used with AsyncTransitions and without a TransitionScript
+};
+
 /* IAudioGraphFactory provides several APIs to create audio graphs.  It also provides the connection
 ** between the application and the Windows audio service.  There should be one of these per application. */
 struct __declspec(uuid("b824c4eb-5a50-4706-8c14-bcc2f207d6ee")) IAudioGraphFactory : public IUnknown {
 	/* Parses an XML file defining a set of audio graphs. */
 	virtual VOID STDMETHODCALLTYPE ParseAudioGraphFile(LPCWSTR Filename, IAudioGraphFile** ppAudioGraphFile) PURE;
 
-	/* Places an audio graph in the playback queue. */
+	/* Places an audio graph in the playback queue.  The graph's files are opened by this call, rather than
+	** by the audio thread when the graph starts playing. */
 	virtual VOID STDMETHODCALLTYPE QueueAudioGraph(IAudioGraph* pAudioGraph) PURE;
+
+	/* Stops the graph that is currently playing and removes every graph from the playback queue. */
+	virtual VOID STDMETHODCALLTYPE ClearQueue() PURE;
+
+	/* Stops the graph that is currently playing and moves on to the next graph in the playback queue. */
+	virtual VOID STDMETHODCALLTYPE SkipAudioGraph() PURE;
+
+	/* Sets the memory budget, in bytes, for decoded PCM node caches.  When a graph is set up for playback,
+	** each node's segment is decoded in the background and then played straight from memory, so seeking
+	** and looping no longer decode on the audio thread.  Nodes that don't fit in the budget are streamed
+	** as usual, as are nodes with cache = "false".  The default budget is 0, which disables caching. */
+	virtual VOID STDMETHODCALLTYPE SetCacheBudget(UINT64 Bytes) PURE;
+
+	/* Sets how long before the end of a node, in milliseconds, the nodes it can transition to are prepared
+	** on the loader thread.  This keeps transitions to uncached nodes from blocking on I/O on the audio thread.
+	** The default is 0, which disables prefetching.  Takes effect the next time a graph is set up for playback. */
+	virtual VOID STDMETHODCALLTYPE SetPrefetchTime(UINT Milliseconds) PURE;
+
+	/* Retrieves the playback statistics gathered so far.  May be called from any thread. */
+	virtual VOID STDMETHODCALLTYPE GetPlaybackStats(AUDIO_GRAPH_PLAYBACK_STATS* pStats) PURE;
+
+	/* Offline factories only.  Renders the playback queue as fast as possible, and blocks until the render
+	** has finished.  [pRealTimeFactor], if not nullptr, receives the duration of the audio rendered divided by
+	** the time it took to render it.  A factory can only render once. */
+	virtual VOID STDMETHODCALLTYPE Render(DOUBLE* pRealTimeFactor) PURE;
+
+	/* Offline factories that render to memory only.  Retrieves the interleaved frames produced by Render().
+	** The buffer is valid until the factory is released. */
+	virtual VOID STDMETHODCALLTYPE GetRenderBuffer(const FLOAT** ppBuffer, UINT64* pFrames) PURE;
+
+	/* Loads a binary image compiled ahead of time by AudioGraphCompileFile().  The image is memory-mapped
+	** rather than read, and the graphs are built from it without any parsing, so loading takes a fraction of
+	** the time ParseAudioGraphFile() does.  The file is kept open until the IAudioGraphFile is released. */
+	virtual VOID STDMETHODCALLTYPE LoadAudioGraphImage(LPCWSTR Filename, IAudioGraphFile** ppAudioGraphFile) PURE;
+
+	/* Starts playing a graph on a mixer bus, alongside the playback queue and every other graph on the buses.
+	** This is how music, ambience and stingers play at the same time.  Like QueueAudioGraph(), the graph's files
+	** are opened by this call.  The graph plays until it reaches a terminal node or the bus is stopped.  A graph
+	** can't play on a bus while it's in the playback queue or playing on a bus already.  If MaxVoices graphs
+	** are already playing, the graph is dropped, which is counted in the bus's statistics. */
+	virtual VOID STDMETHODCALLTYPE PlayAudioGraph(UINT Bus, IAudioGraph* pAudioGraph) PURE;
+
+	/* Stops every graph playing on a mixer bus. */
+	virtual VOID STDMETHODCALLTYPE StopBus(UINT Bus) PURE;
+
+	/* Sets the linear gain a mixer bus is mixed at.  Buses start out at 1.0.  The change is ramped over a few
+	** milliseconds, so it doesn't click. */
+	virtual VOID STDMETHODCALLTYPE SetBusGain(UINT Bus, FLOAT Gain) PURE;
+
+	/* Retrieves the statistics of a mixer bus gathered so far.  May be called from any thread. */
+	virtual VOID STDMETHODCALLTYPE GetBusStats(UINT Bus, AUDIO_GRAPH_BUS_STATS* pStats) PURE;
+
+	/* Sets how much decoded audio, in milliseconds, each streamed node keeps ready ahead of the audio thread.
+	** Nodes are then decoded into a ring on a background streaming thread, and the audio thread only copies
+	** frames out of it, so it never reads a source reader or waits on I/O - not even to loop or transition.
+	** If the ring runs dry, the node plays silence, which is counted as a decode underrun.  The default is 0,
+	** which streams nodes on the audio thread.  Takes effect the next time a graph is set up for playback.
+	** Offline factories ignore this, and always stream nodes on the render thread: the render runs faster than
+	** real time, so the streaming thread could fall behind it and leave dropouts that differ from run to run. */
+	virtual VOID STDMETHODCALLTYPE SetReadAhead(UINT Milliseconds) PURE;
 };
 
 #ifndef _AUDIO_GRAPH_EXPORT_TAG
@@ -191,4 +362,21 @@ struct __declspec(uuid("b824c4eb-5a50-4706-8c14-bcc2f207d6ee")) IAudioGraphFacto
 extern "C" HRESULT _AUDIO_GRAPH_EXPORT_TAG AudioGraphCreateFactory (
 	IAudioGraphCallback* pAudioGraphCallback,
 	IAudioGraphFactory** ppAudioGraphFactory
+);
+
+/* AudioGraphCreateFactoryEx() is the same as AudioGraphCreateFactory(), but takes a description
+** of how the factory should play its graphs, such as rendering offline. */
+extern "C" HRESULT _AUDIO_GRAPH_EXPORT_TAG AudioGraphCreateFactoryEx (
+	const AUDIO_GRAPH_FACTORY_DESC* pDesc,
+	IAudioGraphCallback* pAudioGraphCallback,
+	IAudioGraphFactory** ppAudioGraphFactory
+);
+
+/* AudioGraphCompileFile() compiles an XML file defining a set of audio graphs into a binary image, which
+** can be loaded with IAudioGraphFactory::LoadAudioGraphImage().  This is meant to be run at build time, so
+** it doesn't need a factory or an audio device.  Graphs, nodes and edges that ParseAudioGraphFile() would
+** leave out are left out of the image too.  Returns E_INVALIDARG if the XML is malformed. */
+extern "C" HRESULT _AUDIO_GRAPH_EXPORT_TAG AudioGraphCompileFile (
+	LPCWSTR XmlFilename,
+	LPCWSTR ImageFilename
 );
\ No newline at end of file
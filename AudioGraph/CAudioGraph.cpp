@@ -23,137 +23,247 @@
 #include "CAudioGraph.h"
 #include "CAudioGraphFile.h"
 
+#include "MixKernels.h"
+
 #include <algorithm>
+#include <math.h>
 
 #define FILENAME L"CAudioGraph.cpp"
 
+//Frames mixed per gain ramp during a crossfade.  The curve is exact at the ends of each segment, and linear in between.
+static const UINT AUDIO_GRAPH_FADE_SEGMENT = 64;
+
+//Gains of the incoming and outgoing nodes at [Progress] through a crossfade, from 0 to 1
+static VOID GetFadeGains(AUDIO_GRAPH_CURVE Curve, DOUBLE Progress, FLOAT& In, FLOAT& Out) {
+	if (Curve == AUDIO_GRAPH_CURVE_LINEAR) {
+		In = FLOAT(Progress);
+		Out = FLOAT(1.0 - Progress);
+	} else {
+		In = FLOAT(sin(Progress * 1.57079632679489661923));
+		Out = FLOAT(cos(Progress * 1.57079632679489661923));
+	}
+}
+
 CAudioGraph::CAudioGraph() : 
-	m_RefCount(1),
-	m_Playing(false)
+	m_File(nullptr),
+	m_CurrentNode(nullptr),
+	m_InitialNode(nullptr),
+	m_Script(nullptr),
+	m_Playing(false),
+	m_Primed(false),
+	m_QueueCount(0),
+	m_Voice(false),
+	m_PrefetchFrames(0),
+	m_PrefetchPosted(false),
+	m_Channels(2),
+	m_PostedTrigger(LONG(AUDIO_GRAPH_TRIGGER_NONE)),
+	m_AsyncTransitions(false),
+	m_SampleRate(44100),
+	m_FadeNode(nullptr),
+	m_FadePosition(0),
+	m_FadeFrames(0),
+	m_FadeCurve(AUDIO_GRAPH_CURVE_EQUAL_POWER),
+	m_FadeFromCache(false),
+	m_Image(nullptr),
+	m_Record(nullptr),
+	m_ID(""),
+	m_Type(""),
+	m_StyleString(""),
+	m_Nodes(nullptr),
+	m_NumNodes(0),
+	m_Edges(nullptr),
+	m_NumEdges(0)
 { }
 
-CAudioGraph::~CAudioGraph() { }
+CAudioGraph::~CAudioGraph() {
+	delete[] m_Edges;
+	delete[] m_Nodes;
+}
+
+ULONG STDMETHODCALLTYPE CAudioGraph::AddRef() {
+	return m_File->AddRef();
+}
+
+ULONG STDMETHODCALLTYPE CAudioGraph::Release() {
+	return m_File->Release();
+}
 
-HRESULT CAudioGraph::Initialize (
+VOID CAudioGraph::Initialize (
 	IAudioGraphCallback* pAudioGraphCallback,
 	CAudioGraphFile* pAudioGraphFile,
-	std::string& Style
+	const CAudioGraphImage& Image,
+	UINT Graph
 ) {
-	HRESULT hr = S_OK;
-
 	m_Callback = pAudioGraphCallback;
 	m_File = pAudioGraphFile;
-	m_StyleString = Style;
-
-	// Parse style string
-
-	static const auto attribute = [&Style](LPCSTR attribute) {
-		size_t off = Style.find(attribute, 0);
-		size_t start = off + 4 + strlen(attribute);
-		size_t end = Style.find("\"", start);
-		size_t length = end - start;
-		return Style.substr(start, length);
-	};
+	m_Image = &Image;
 
-	m_ID = attribute("id");
-	m_Type = attribute("type");
-	m_Initial = attribute("initial");
-
-	// id and initial must be defined, but type is optional.
-	if (m_ID == "" || m_Initial == "") {
-		return E_INVALIDARG;
-	}
-
-	return S_OK;
-}
-
-VOID CAudioGraph::CreateNode(std::string& Style) {
-	HRESULT hr = S_OK;
-
-	CComPtr<CAudioGraphNode> Node = new CAudioGraphNode();
-
-	hr = Node->Initialize (
-		m_Callback,
-		m_File,
-		this,
-		Style
+	// IAudioGraphCallback2 is optional, so failing to find it isn't an error
+	m_Callback->QueryInterface (
+		IID_PPV_ARGS(&m_Callback2)
 	);
 
-	if (SUCCEEDED(hr)) {
-		m_NodeEnum.push_back(Node);
-		m_NodeMap[Node->GetID()] = Node;
+	m_Record = &Image.GetGraph(Graph);
+
+	m_ID = Image.GetString(m_Record->ID);
+	m_Type = Image.GetString(m_Record->Type);
+	m_StyleString = Image.GetString(m_Record->Style);
+	m_NumNodes = m_Record->NumNodes;
+	m_NumEdges = m_Record->NumEdges;
+
+	// The compiler only emits graphs with an initial node, so there's at least one
+	m_Nodes = new CAudioGraphNode[m_NumNodes];
+	m_Edges = new CAudioGraphEdge[m_NumEdges];
+
+	for (UINT i = 0; i < m_NumNodes; i++) {
+		m_Nodes[i].Initialize (
+			m_Callback,
+			m_File,
+			this,
+			Image,
+			Image.GetNode(*m_Record, i),
+			m_Edges
+		);
 	}
-}
-
-VOID CAudioGraph::CreateEdge(std::string& Style) {
-	HRESULT hr = S_OK;
 
-	CComPtr<CAudioGraphEdge> Edge = new CAudioGraphEdge();
-
-	hr = Edge->Initialize (
-		m_Callback,
-		m_File,
-		this,
-		Style
-	);
-
-	if (SUCCEEDED(hr)) {
-		m_EdgeEnum.push_back(Edge);
-		m_EdgeMap[Edge->GetID()] = Edge;
+	for (UINT i = 0; i < m_NumEdges; i++) {
+		m_Edges[i].Initialize (
+			m_Callback,
+			m_File,
+			this,
+			Image,
+			Image.GetEdge(*m_Record, i),
+			m_Nodes
+		);
 	}
-}
 
-VOID CAudioGraph::GetNodeByID(std::string& ID, CAudioGraphNode** ppNode) {
-	try {
-		*ppNode = m_NodeMap.at(ID);
-	} catch (...) {
-		*ppNode = nullptr;
+	// A node has to be able to start as early, and play on as long, as any edge into or out of it asks for
+	for (UINT i = 0; i < m_NumEdges; i++) {
+		m_Edges[i].GetFromNode()->ReserveTail(m_Edges[i].GetCrossfadeTime());
+		m_Edges[i].GetToNode()->ReserveLead(m_Edges[i].GetPrerollTime());
 	}
+
+	m_InitialNode = &m_Nodes[m_Record->Initial];
 }
 
-VOID CAudioGraph::Setup(IMFMediaType* pMediaType) {
-	for (auto Node : m_NodeEnum) {
-		Node->Setup(pMediaType);
+VOID CAudioGraph::Setup(IMFMediaType* pMediaType, CAudioGraphLoader* pLoader, AUDIO_GRAPH_TRANSITION_SCRIPT* pScript, bool AsyncTransitions) {
+	for (UINT i = 0; i < m_NumNodes; i++) {
+		m_Nodes[i].Setup(pMediaType, pLoader);
 	}
 
-	m_CurrentNode = m_NodeMap[m_Initial];
-	m_CurrentNode->Seek();
+	m_Loader = pLoader;
+	m_Script = pScript;
+	m_AsyncTransitions = AsyncTransitions;
+	m_Channels = MFGetAttributeUINT32(pMediaType, MF_MT_AUDIO_NUM_CHANNELS, 2);
+	m_SampleRate = MFGetAttributeUINT32(pMediaType, MF_MT_AUDIO_SAMPLES_PER_SECOND, 44100);
+	m_PrefetchFrames = GetFramesFromTime(m_Loader->GetPrefetchTime());
+	m_PrefetchPosted = false;
+	m_FadeBuffer.resize(AUDIO_GRAPH_FADE_SEGMENT * m_Channels);
+	EndFade();
+
+	// Position the initial node now, so that starting playback doesn't have to
+	m_InitialNode->WarmDecoder();
+	m_InitialNode->Seek(0);
+	m_Primed = true;
 }
 
 VOID CAudioGraph::Flush() {
-	for (auto Node : m_NodeEnum) {
-		Node->Flush();
+	for (UINT i = 0; i < m_NumNodes; i++) {
+		m_Nodes[i].Flush();
 	}
 
-	m_CurrentNode.Release();
 	m_CurrentNode = nullptr;
+	m_Primed = false;
+	EndFade();
 }
 
-UINT CAudioGraph::Process(FLOAT* OutputBuffer, UINT BufferFrames) {
+VOID CAudioGraph::Start(AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters) {
+	m_CurrentNode = m_InitialNode;
+	m_PrefetchPosted = false;
+	EndFade();
+
+	if (!m_Primed && m_CurrentNode->Seek(0)) {
+		InterlockedIncrement64(&Counters.ColdTransitions);
+	}
+
+	m_Primed = false;
+}
+
+UINT CAudioGraph::Process(FLOAT* OutputBuffer, UINT BufferFrames, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters) {
 	UINT Written = 0;
 	UINT TotalWritten = 0;
+	UINT Idle = 0; // Transitions since a node last produced anything
 	bool done = false;
 
 	while (BufferFrames > 0 && !done) {
-		Written = m_CurrentNode->Process(OutputBuffer, BufferFrames);
+		// Close to the end of the node, warm every node it can transition to so that
+		// whichever one is chosen can start without blocking on I/O
+		if (!m_PrefetchPosted && m_PrefetchFrames > 0 && m_CurrentNode->GetFramesRemaining() <= m_PrefetchFrames) {
+			CAudioGraphNode* Busy = m_FadeFromCache ? nullptr : m_FadeNode;
+
+			InterlockedExchangeAdd64(&Counters.Prefetches, m_CurrentNode->PrefetchTargets(Busy));
+			m_PrefetchPosted = true;
+		}
+
+		Written = m_CurrentNode->Process(OutputBuffer, BufferFrames, Counters);
+		ApplyFade(OutputBuffer, Written, Counters);
 		BufferFrames -= Written;
-		OutputBuffer += Written * 2;
+		OutputBuffer += Written * m_Channels;
 		TotalWritten += Written;
 
+		if (Written > 0) {
+			Idle = 0;
+		}
+
 		// Node has finished playing
 		if (BufferFrames > 0) {
+			// Every node the graph moved through came up empty, for instance because its segment lies past the end
+			// of its file.  Walking the same nodes again wouldn't change that, so the rest of the buffer is silent,
+			// and the next callback tries again in case a trigger has since changed where the graph goes.
+			if (Idle > m_NumNodes) {
+				EndFade();
+				ZeroMemory(OutputBuffer, BufferFrames * sizeof(FLOAT) * m_Channels);
+				TotalWritten += BufferFrames;
+				break;
+			}
+
 			if (m_CurrentNode->IsTerminal() == FALSE) { // Move to the next node
-				std::string TransitionString = m_Callback->OnTransition(this, m_CurrentNode);
-				CComPtr<CAudioGraphEdge> TransitionEdge;
-				m_CurrentNode->GetTransitionEdge(TransitionString, &TransitionEdge);
+				CAudioGraphEdge* TransitionEdge = GetNextEdge();
+				UINT64 Preroll = 0;
+
+				// A crossfade is over by the time the node it faded into ends, unless the file ran out
+				// before the node did, in which case what's left of it is dropped
+				EndFade();
 
+				// If there's no edge, just replay the same node
 				if (TransitionEdge != nullptr) {
-					m_CurrentNode.Release();
-					TransitionEdge->GetTo((IAudioGraphNode**)(&m_CurrentNode));
-				} else { // just replay the same node
-					m_CurrentNode->Seek();
+					if (BeginFade(TransitionEdge)) {
+						InterlockedIncrement64(&Counters.Crossfades);
+					}
+
+					Preroll = GetFramesFromTime(TransitionEdge->GetPrerollTime());
+					m_CurrentNode = TransitionEdge->GetToNode();
+				}
+
+				if (m_CurrentNode->Seek(Preroll)) {
+					InterlockedIncrement64(&Counters.ColdTransitions);
 				}
+
+				// A crossfade longer than the node it fades into is shortened to fit, so that the next
+				// transition never has to cut it off halfway
+				if (m_FadeNode != nullptr) {
+					m_FadeFrames = std::min(m_FadeFrames, m_CurrentNode->GetFramesRemaining());
+
+					if (m_FadeFrames == 0) {
+						EndFade();
+					}
+				}
+
+				InterlockedIncrement64(&Counters.Transitions);
+				m_PrefetchPosted = false;
+				Idle++;
 			} else { // Node is a terminal, stop playing this graph.
+				EndFade();
 				done = true;
 			}
 		}
@@ -162,19 +272,104 @@ UINT CAudioGraph::Process(FLOAT* OutputBuffer, UINT BufferFrames) {
 	return TotalWritten;
 }
 
+bool CAudioGraph::BeginFade(CAudioGraphEdge* pEdge) {
+	CAudioGraphNode* Outgoing = m_CurrentNode;
+	UINT64 Frames = std::min(GetFramesFromTime(pEdge->GetCrossfadeTime()), Outgoing->GetTailFrames());
+
+	if (Frames == 0) {
+		return false;
+	}
+
+	// A streamed node plays its tail from its own source reader, which a self-loop needs to start over
+	if (!Outgoing->IsCached() && pEdge->GetToNode() == Outgoing) {
+		return false;
+	}
+
+	m_FadeNode = Outgoing;
+	m_FadePosition = 0;
+	m_FadeFrames = Frames;
+	m_FadeCurve = pEdge->GetCrossfadeCurve();
+	m_FadeFromCache = Outgoing->IsCached();
+
+	return true;
+}
+
+VOID CAudioGraph::ApplyFade(FLOAT* Buffer, UINT Frames, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters) {
+	while (m_FadeNode != nullptr && Frames > 0) {
+		UINT Segment = UINT(std::min(UINT64(std::min(Frames, AUDIO_GRAPH_FADE_SEGMENT)), m_FadeFrames - m_FadePosition));
+		FLOAT InStart, OutStart, InEnd, OutEnd;
+
+		m_FadeNode->ReadTail (
+			m_FadePosition,
+			m_FadeBuffer.data(),
+			Segment,
+			m_FadeFromCache,
+			Counters
+		);
+
+		GetFadeGains(m_FadeCurve, DOUBLE(m_FadePosition) / DOUBLE(m_FadeFrames), InStart, OutStart);
+		GetFadeGains(m_FadeCurve, DOUBLE(m_FadePosition + Segment) / DOUBLE(m_FadeFrames), InEnd, OutEnd);
+
+		ScaleRamp(Buffer, Segment, m_Channels, InStart, (InEnd - InStart) / FLOAT(Segment));
+		MixRamp(Buffer, m_FadeBuffer.data(), Segment, m_Channels, OutStart, (OutEnd - OutStart) / FLOAT(Segment));
+
+		Buffer += Segment * m_Channels;
+		Frames -= Segment;
+		m_FadePosition += Segment;
+
+		if (m_FadePosition == m_FadeFrames) {
+			EndFade();
+		}
+	}
+}
+
+CAudioGraphEdge* CAudioGraph::GetNextEdge() {
+	// A script keeps renders deterministic, so it overrides everything else
+	if (m_Script != nullptr) {
+		LPCSTR Trigger = "";
+
+		if (m_Script->Position < m_Script->Transitions.size()) {
+			Trigger = m_Script->Transitions[m_Script->Position++].c_str();
+		}
+
+		return GetTransitionEdge(m_CurrentNode, ResolveTrigger(Trigger));
+	}
+
+	// A trigger posted ahead of time means the application doesn't have to be asked
+	AUDIO_GRAPH_TRIGGER Posted = AUDIO_GRAPH_TRIGGER(InterlockedExchange(&m_PostedTrigger, LONG(AUDIO_GRAPH_TRIGGER_NONE)));
+
+	if (m_AsyncTransitions) {
+		CAudioGraphEdge* Edge = GetTransitionEdge(m_CurrentNode, Posted);
+
+		// The posted trigger may have been meant for another node, in which case the default still applies
+		return Edge != nullptr ? Edge : m_CurrentNode->GetDefaultEdge();
+	}
+
+	if (Posted != AUDIO_GRAPH_TRIGGER_NONE) {
+		return GetTransitionEdge(m_CurrentNode, Posted);
+	}
+
+	if (m_Callback2 != nullptr) {
+		return GetTransitionEdge(m_CurrentNode, m_Callback2->OnTransitionTrigger(this, m_CurrentNode));
+	}
+
+	// The string is interned as it is, since copying it could allocate
+	return GetTransitionEdge(m_CurrentNode, ResolveTrigger(m_Callback->OnTransition(this, m_CurrentNode)));
+}
+
 VOID CAudioGraph::EnumNode(UINT NodeNum, IAudioGraphNode** ppNode) {
 	if (ppNode == nullptr) {
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
 		return;
 	}
 
-	try {
-		*ppNode = m_NodeEnum.at(NodeNum);
-	} catch (...) {
+	if (NodeNum >= m_NumNodes) {
 		*ppNode = nullptr;
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
 		return;
 	}
+
+	*ppNode = &m_Nodes[NodeNum];
 }
 
 VOID CAudioGraph::GetNodeByID(LPCSTR ID, IAudioGraphNode** ppNode) {
@@ -183,15 +378,15 @@ VOID CAudioGraph::GetNodeByID(LPCSTR ID, IAudioGraphNode** ppNode) {
 		return;
 	}
 
-	std::string stringID = ID;
+	UINT Node = ID != nullptr ? m_Image->FindNode(*m_Record, ID) : AUDIO_GRAPH_IMAGE_NONE;
 
-	try {
-		*ppNode = m_NodeMap.at(stringID);
-	} catch (...) {
+	if (Node == AUDIO_GRAPH_IMAGE_NONE) {
 		*ppNode = nullptr;
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
 		return;
 	}
+
+	*ppNode = &m_Nodes[Node];
 }
 
 VOID CAudioGraph::EnumEdge(UINT EdgeNum, IAudioGraphEdge** ppEdge) {
@@ -200,13 +395,13 @@ VOID CAudioGraph::EnumEdge(UINT EdgeNum, IAudioGraphEdge** ppEdge) {
 		return;
 	}
 
-	try {
-		*ppEdge = m_EdgeEnum.at(EdgeNum);
-	} catch (...) {
+	if (EdgeNum >= m_NumEdges) {
 		*ppEdge = nullptr;
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
 		return;
 	}
+
+	*ppEdge = &m_Edges[EdgeNum];
 }
 
 VOID CAudioGraph::GetEdgeByID(LPCSTR ID, IAudioGraphEdge** ppEdge) {
@@ -215,15 +410,15 @@ VOID CAudioGraph::GetEdgeByID(LPCSTR ID, IAudioGraphEdge** ppEdge) {
 		return;
 	}
 
-	std::string stringID = ID;
+	UINT Edge = ID != nullptr ? m_Image->FindEdge(*m_Record, ID) : AUDIO_GRAPH_IMAGE_NONE;
 
-	try {
-		*ppEdge = m_EdgeMap.at(stringID);
-	} catch (...) {
+	if (Edge == AUDIO_GRAPH_IMAGE_NONE) {
 		*ppEdge = nullptr;
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
 		return;
 	}
+
+	*ppEdge = &m_Edges[Edge];
 }
 
 VOID CAudioGraph::GetCurrentNode(IAudioGraphNode** ppAudioGraphNode) {
@@ -235,6 +430,18 @@ VOID CAudioGraph::GetCurrentNode(IAudioGraphNode** ppAudioGraphNode) {
 	*ppAudioGraphNode = m_CurrentNode;
 }
 
+AUDIO_GRAPH_TRIGGER CAudioGraph::ResolveTrigger(LPCSTR Trigger) {
+	if (Trigger == nullptr) {
+		Trigger = "";
+	}
+
+	return m_Image->FindTrigger(Trigger);
+}
+
+VOID CAudioGraph::PostTrigger(AUDIO_GRAPH_TRIGGER Trigger) {
+	InterlockedExchange(&m_PostedTrigger, LONG(Trigger));
+}
+
 VOID CAudioGraph::GetAudioGraphFile(IAudioGraphFile** ppAudioGraphFile) {
 	if (ppAudioGraphFile == nullptr) {
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
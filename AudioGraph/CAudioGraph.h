@@ -27,15 +27,36 @@
 #include <Windows.h>
 #include <string>
 #include <vector>
-#include <map>
 
 #include "AudioGraph.h"
 #include "QueryInterface.h"
 #include "CAudioGraphNode.h"
 #include "CAudioGraphEdge.h"
+#include "CAudioGraphImage.h"
+#include "Realtime.h"
 
 class CAudioGraphFile;
 
+/* Playback counters shared between CDXAudioWriteCallback and the graphs it plays.  They are
+** only written by the render thread, but may be read from any thread. */
+struct AUDIO_GRAPH_PLAYBACK_COUNTERS {
+	volatile LONG64 Callbacks; //Number of render callbacks
+	volatile LONG64 Xruns; //Render callbacks that took longer than the audio they produced
+	volatile LONG64 Transitions; //Node transitions, including a node replaying itself
+	volatile LONG64 ColdTransitions; //Transitions that had to read a source reader on the render thread, play silence while the loader finished a prefetch, or start on part of a mapped file that wasn't in memory
+	volatile LONG64 Prefetches; //Prefetches, and reads of mapped files, posted to the loader ahead of a transition
+	volatile LONG64 Crossfades; //Transitions that overlapped the outgoing node with the incoming one
+	AUDIO_GRAPH_REALTIME_COUNTERS Realtime; //What the render thread and its workers did that they shouldn't have
+	volatile LONG64 DecodeUnderruns; //Reads that found a decode ring with too few frames
+};
+
+/* A fixed sequence of transition strings, used in place of IAudioGraphCallback::OnTransition() so that
+** renders are deterministic.  Once the script runs out, the empty string is used. */
+struct AUDIO_GRAPH_TRANSITION_SCRIPT {
+	std::vector<std::string> Transitions;
+	UINT Position; //Index of the next transition string
+};
+
 class CAudioGraph : public IAudioGraph {
 public:
 	CAudioGraph();
@@ -44,41 +65,32 @@ public:
 
 	//IUnknown methods
 
-	ULONG STDMETHODCALLTYPE AddRef() {
-		return ++m_RefCount;
-	}
-
-	ULONG STDMETHODCALLTYPE Release() {
-		m_RefCount--;
+	//Graphs are stored in an array owned by their file, so they share its reference count
 
-		if (m_RefCount <= 0) {
-			delete this;
-			return 0;
-		}
+	ULONG STDMETHODCALLTYPE AddRef();
 
-		return m_RefCount;
-	}
+	ULONG STDMETHODCALLTYPE Release();
 
 	//IAudioGraph methods
 
 	/* Returns the ID of this particular graph. */
 	LPCSTR STDMETHODCALLTYPE GetID() final {
-		return m_ID.c_str();
+		return m_ID;
 	}
 
 	/* Returns an arbitrary type string describing this graph. */
 	LPCSTR STDMETHODCALLTYPE GetType() final {
-		return m_Type.c_str();
+		return m_Type;
 	}
 
 	/* Returns the style string of this graph. */
 	LPCSTR STDMETHODCALLTYPE GetStyleString() final {
-		return m_StyleString.c_str();
+		return m_StyleString;
 	}
 
 	/* Returns the number of nodes associated with this particular graph. */
 	UINT STDMETHODCALLTYPE GetNumNodes() final {
-		return m_NodeEnum.size();
+		return m_NumNodes;
 	}
 
 	/* Retrieves an node associted with this graph by array index. */
@@ -89,7 +101,7 @@ public:
 
 	/* Returns the number of edges associated with this particular graph. */
 	UINT STDMETHODCALLTYPE GetNumEdges() final {
-		return m_EdgeEnum.size();
+		return m_NumEdges;
 	}
 
 	/* Retrieves an edge associted with this graph by array index. */
@@ -104,22 +116,29 @@ public:
 	/* Retrieves the audio graph file that this graph is associated with, if there is one. */
 	VOID STDMETHODCALLTYPE GetAudioGraphFile(IAudioGraphFile** ppAudioGraphFile) final;
 
+	/* Returns the handle of a trigger string.  This is a binary search over strings already in the image,
+	** so it doesn't allocate. */
+	AUDIO_GRAPH_TRIGGER STDMETHODCALLTYPE ResolveTrigger(LPCSTR Trigger) final;
+
+	/* Sets the trigger to take when the current node finishes playing.  May be called from any thread. */
+	VOID STDMETHODCALLTYPE PostTrigger(AUDIO_GRAPH_TRIGGER Trigger) final;
+
 	//New methods
 
-	HRESULT Initialize (
+	/* Creates the graph's nodes and edges from graph number [Graph] of [Image], which must outlive the graph. */
+	VOID Initialize (
 		IAudioGraphCallback* pAudioGraphCallback,
 		CAudioGraphFile* pAudioGraphFile,
-		std::string& Style
+		const CAudioGraphImage& Image,
+		UINT Graph
 	);
 
-	/* To be used by CAudioGraphFile when parsing. */
-	VOID CreateNode(std::string& Style);
-
-	/* To be used by CAudioGraphFile when parsing. */
-	VOID CreateEdge(std::string& Style);
-
-	/* To be used by CAudioGraphEdge. */
-	VOID GetNodeByID(std::string& ID, CAudioGraphNode** ppNode);
+	/* Returns the edge leaving [pNode] on the trigger with handle [Trigger], or nullptr if there is none.
+	** This is a hash table lookup that never compares strings, so it's cheap enough for the render thread. */
+	CAudioGraphEdge* GetTransitionEdge(CAudioGraphNode* pNode, UINT Trigger) {
+		UINT Edge = m_Image->FindTransition(*m_Record, UINT(pNode - m_Nodes), Trigger);
+		return Edge != AUDIO_GRAPH_IMAGE_NONE ? &m_Edges[Edge] : nullptr;
+	}
 
 	/* Used by CDXAudioWriteCallback. */
 	bool IsPlaying() {
@@ -131,34 +150,113 @@ public:
 		m_Playing = Playing;
 	}
 
-	/* Prepares the graph for playback by creating stream readers. */
-	VOID Setup(IMFMediaType* pMediaType);
+	/* Used by CDXAudioWriteCallback on the application thread when the graph is queued.  Returns
+	** true if the graph wasn't queued already, in which case it needs to be set up. */
+	bool AddQueueReference() {
+		return m_QueueCount++ == 0;
+	}
+
+	/* Used by CDXAudioWriteCallback on the application thread once the render thread is done with
+	** the graph.  Returns true if the graph isn't queued anymore, in which case it can be flushed. */
+	bool ReleaseQueueReference() {
+		return --m_QueueCount == 0;
+	}
+
+	/* Used by CDXAudioWriteCallback on the application thread. */
+	bool IsQueued() {
+		return m_QueueCount > 0;
+	}
+
+	/* Used by CDXAudioWriteCallback on the application thread.  A graph playing on a mixer bus can't be
+	** queued or played on another bus until the render thread has handed it back. */
+	bool IsVoice() {
+		return m_Voice;
+	}
 
-	/* Closes all streams. */
+	/* Used by CDXAudioWriteCallback on the application thread. */
+	VOID SetVoice(bool Voice) {
+		m_Voice = Voice;
+	}
+
+	/* Prepares the graph for playback by creating stream readers and seeking to the initial
+	** node.  [pLoader] is used to decode node caches in the background.  If [pScript] isn't
+	** nullptr, transitions are taken from it instead of from the callback.  If [AsyncTransitions]
+	** is true, the callback is never asked, and transitions only come from posted triggers and
+	** default edges.  This blocks on file I/O, so it must never be called on the render thread. */
+	VOID Setup(IMFMediaType* pMediaType, CAudioGraphLoader* pLoader, AUDIO_GRAPH_TRANSITION_SCRIPT* pScript, bool AsyncTransitions);
+
+	/* Closes all streams.  Like Setup(), this must never be called on the render thread. */
 	VOID Flush();
 
+	/* Starts playing from the initial node.  This is called on the render thread.  The first
+	** playback after Setup() is already positioned; a graph that was queued again while it
+	** played has to seek, which is recorded in [Counters] as a cold transition. */
+	VOID Start(AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters);
+
 	/* Fetches a set of samples.  Returns the number of samples written.
 	** If any value less than BufferFrames is returned, the graph has finished
-	** playing. */
-	UINT Process(FLOAT* OutputBuffer, UINT BufferFrames);
+	** playing.  Transitions, prefetches and crossfades are recorded in [Counters]. */
+	UINT Process(FLOAT* OutputBuffer, UINT BufferFrames, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters);
 
 private:
-	long m_RefCount;
-
 	CComPtr<IAudioGraphCallback> m_Callback;
-	CComPtr<CAudioGraphFile> m_File;
-	CComPtr<CAudioGraphNode> m_CurrentNode;
-
-	std::string m_ID;
-	std::string m_Type;
-	std::string m_Initial;
-	std::string m_StyleString;
+	CComPtr<IAudioGraphCallback2> m_Callback2; //nullptr if the application's callback doesn't implement it
+	CAudioGraphFile* m_File; //The file owns the graph
+	CAudioGraphNode* m_CurrentNode; //Points into m_Nodes, so the render thread never touches a reference count
+	CAudioGraphNode* m_InitialNode; //Points into m_Nodes
+	CComPtr<CAudioGraphLoader> m_Loader;
+	AUDIO_GRAPH_TRANSITION_SCRIPT* m_Script; //Owned by CDXAudioWriteCallback
+
+	const CAudioGraphImage* m_Image; //Owned by m_File
+	const AUDIO_GRAPH_IMAGE_GRAPH* m_Record; //Points into m_Image
+
+	LPCSTR m_ID; //Points into m_Image, like the other strings
+	LPCSTR m_Type;
+	LPCSTR m_StyleString;
 	bool m_Playing;
+	bool m_Primed; //Whether Setup() has positioned the initial node for the next Start()
+	UINT m_QueueCount; //Times the graph is queued, including the playing one - application thread only
+	bool m_Voice; //Whether the graph was sent to a mixer bus, and hasn't been handed back yet - application thread only
+	UINT64 m_PrefetchFrames; //How many frames before the end of a node its targets are prefetched
+	bool m_PrefetchPosted; //Whether the current node's targets have been prefetched yet
+	UINT m_Channels; //Interleaved channels in the output buffer
+	volatile LONG m_PostedTrigger; //Set by PostTrigger() on any thread, and taken by the render thread at the next transition
+	bool m_AsyncTransitions; //Whether the callback is never asked for a transition
+	UINT m_SampleRate; //Sample rate of the output buffer
+
+	CAudioGraphNode* m_FadeNode; //The node being crossfaded out of, or nullptr
+	UINT64 m_FadePosition; //Frames of the crossfade played so far
+	UINT64 m_FadeFrames; //Length of the crossfade
+	AUDIO_GRAPH_CURVE m_FadeCurve;
+	bool m_FadeFromCache; //Whether m_FadeNode's tail comes from its cache rather than its source reader
+	std::vector<FLOAT> m_FadeBuffer; //m_FadeNode's tail, one segment at a time - sized by Setup(), so the render thread never allocates
+
+	CAudioGraphNode* m_Nodes; //One allocation for all of the graph's nodes, in the order of the image
+	UINT m_NumNodes;
+	CAudioGraphEdge* m_Edges; //One allocation for all of the graph's edges, in the order of the image
+	UINT m_NumEdges;
+
+	/* Chooses the edge to take as the current node ends, or nullptr to replay it.  This is called on the render thread. */
+	CAudioGraphEdge* GetNextEdge();
+
+	/* Converts milliseconds to frames of the output buffer. */
+	UINT64 GetFramesFromTime(UINT Time) {
+		return UINT64(Time) * m_SampleRate / 1000;
+	}
 
-	std::vector<CComPtr<CAudioGraphNode>> m_NodeEnum;
-	std::map<std::string, CComPtr<CAudioGraphNode>> m_NodeMap;
-	std::vector<CComPtr<CAudioGraphEdge>> m_EdgeEnum;
-	std::map<std::string, CComPtr<CAudioGraphEdge>> m_EdgeMap;
+	/* Starts crossfading out of the current node as [pEdge] is taken, if the edge has a crossfade.
+	** Returns false if the transition is a hard cut.  Process() shortens the crossfade to the node it
+	** fades into once that node has been positioned. */
+	bool BeginFade(CAudioGraphEdge* pEdge);
+
+	/* Mixes the tail of the node being crossfaded out of into [Frames] frames just written to [Buffer]
+	** by the current node, ramping one down and the other up. */
+	VOID ApplyFade(FLOAT* Buffer, UINT Frames, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters);
+
+	/* Drops whatever is left of the crossfade in progress. */
+	VOID EndFade() {
+		m_FadeNode = nullptr;
+	}
 
 	//IUnknown methods
 
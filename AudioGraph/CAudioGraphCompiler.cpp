@@ -0,0 +1,490 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#include "CAudioGraphCompiler.h"
+
+#include <stdio.h>
+
+using namespace rapidxml;
+
+/* Returns an attribute of [Element], or the empty string if it's missing or empty.  The attribute is also
+** appended to [Style], in the style string format of name = "value" pairs separated by spaces. */
+static std::string Attribute(xml_node<>* Element, LPCSTR Name, std::string& Style) {
+	std::string Value;
+
+	// Optional attributes may be missing entirely, in which case they are left empty
+	xml_attribute<>* Attribute = Element->first_attribute(Name);
+
+	if (Attribute != nullptr) {
+		Value = Attribute->value();
+	}
+
+	if (!Style.empty()) {
+		Style += " ";
+	}
+
+	Style += Name;
+	Style += " = \"";
+	Style += Value;
+	Style += "\"";
+
+	return Value;
+}
+
+CAudioGraphCompiler::CAudioGraphCompiler() {
+	Reset();
+}
+
+VOID CAudioGraphCompiler::Reset() {
+	m_Graphs.clear();
+	m_Nodes.clear();
+	m_Edges.clear();
+	m_Transitions.clear();
+	m_Indices.clear();
+	m_Strings.clear();
+	m_StringMap.clear();
+	m_TriggerMap.clear();
+
+	// Missing attributes all share the string at offset 0
+	AddString("");
+}
+
+HRESULT CAudioGraphCompiler::CompileFile(LPCWSTR Filename, std::vector<BYTE>& Image) {
+	FILE* f = nullptr;
+
+	if (_wfopen_s(&f, Filename, L"rb") != 0) {
+		return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+	}
+
+	fseek(f, 0, SEEK_END);
+	long fsize = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	std::vector<char> Text(fsize + 1, 0);
+
+	if (fsize > 0 && fread(Text.data(), fsize, 1, f) != 1) {
+		fclose(f);
+		return HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+	}
+
+	fclose(f);
+
+	return Compile(Text.data(), Image);
+}
+
+HRESULT CAudioGraphCompiler::Compile(char* Text, std::vector<BYTE>& Image) {
+	xml_document<> Document;
+	std::map<std::string, UINT> GraphMap;
+
+	Reset();
+
+	try {
+		Document.parse<0>(Text);
+	} catch (...) {
+		return E_INVALIDARG;
+	}
+
+	xml_node<>* Root = Document.first_node("AudioGraph");
+
+	if (Root == nullptr) {
+		return E_INVALIDARG;
+	}
+
+	for (xml_node<>* Element = Root->first_node("Graph"); Element != nullptr; Element = Element->next_sibling("Graph")) {
+		std::string ID;
+
+		// Later definitions of an ID replace earlier ones when looking it up
+		if (CompileGraph(Element, ID)) {
+			GraphMap[ID] = UINT(m_Graphs.size() - 1);
+		}
+	}
+
+	UINT GraphIndex = AddIndex(GraphMap);
+	UINT TriggerIndex = InternTriggers();
+
+	for (auto& Graph : m_Graphs) {
+		BuildTransitions(Graph);
+	}
+
+	return Link(GraphIndex, TriggerIndex, Image);
+}
+
+bool CAudioGraphCompiler::CompileGraph(xml_node<>* Element, std::string& ID) {
+	AUDIO_GRAPH_IMAGE_GRAPH Graph;
+	std::string Style;
+	std::map<std::string, UINT> NodeMap;
+	std::map<std::string, UINT> EdgeMap;
+	std::vector<std::string> Defaults; //The default edge of each node
+
+	ZeroMemory(&Graph, sizeof(Graph));
+
+	// Graph attributes: id, type, initial
+	ID = Attribute(Element, "id", Style);
+	std::string Type = Attribute(Element, "type", Style);
+	std::string Initial = Attribute(Element, "initial", Style);
+
+	// id and initial must be defined, but type is optional.
+	if (ID == "" || Initial == "") {
+		return false;
+	}
+
+	Graph.FirstNode = UINT(m_Nodes.size());
+	Graph.FirstEdge = UINT(m_Edges.size());
+
+	for (xml_node<>* NodeElement = Element->first_node("Node"); NodeElement != nullptr; NodeElement = NodeElement->next_sibling("Node")) {
+		AUDIO_GRAPH_IMAGE_NODE Node;
+		std::string NodeID;
+		std::string Default;
+
+		if (CompileNode(NodeElement, Node, NodeID, Default)) {
+			NodeMap[NodeID] = UINT(m_Nodes.size()) - Graph.FirstNode;
+			m_Nodes.push_back(Node);
+			Defaults.push_back(Default);
+		}
+	}
+
+	Graph.NumNodes = UINT(m_Nodes.size()) - Graph.FirstNode;
+
+	// A graph has to be able to start somewhere
+	auto InitialNode = NodeMap.find(Initial);
+
+	if (InitialNode == NodeMap.end()) {
+		m_Nodes.resize(Graph.FirstNode);
+		return false;
+	}
+
+	std::vector<std::vector<UINT>> EdgeLists(Graph.NumNodes);
+
+	for (xml_node<>* EdgeElement = Element->first_node("Edge"); EdgeElement != nullptr; EdgeElement = EdgeElement->next_sibling("Edge")) {
+		AUDIO_GRAPH_IMAGE_EDGE Edge;
+		std::string EdgeID;
+
+		if (CompileEdge(EdgeElement, NodeMap, Edge, EdgeID)) {
+			UINT EdgeNum = UINT(m_Edges.size()) - Graph.FirstEdge;
+
+			EdgeMap[EdgeID] = EdgeNum;
+			EdgeLists[Edge.From].push_back(EdgeNum);
+			m_Edges.push_back(Edge);
+		}
+	}
+
+	Graph.NumEdges = UINT(m_Edges.size()) - Graph.FirstEdge;
+
+	// Each node lists the edges leaving it, in the order they were defined
+	for (UINT i = 0; i < Graph.NumNodes; i++) {
+		AUDIO_GRAPH_IMAGE_NODE& Node = m_Nodes[Graph.FirstNode + i];
+
+		Node.EdgeList = AddIndex(EdgeLists[i]);
+		Node.NumEdges = UINT(EdgeLists[i].size());
+
+		// A default edge that doesn't exist, or doesn't leave this node, is ignored
+		auto DefaultEdge = EdgeMap.find(Defaults[i]);
+
+		if (DefaultEdge != EdgeMap.end() && m_Edges[Graph.FirstEdge + DefaultEdge->second].From == i) {
+			Node.DefaultEdge = DefaultEdge->second;
+		}
+	}
+
+	Graph.ID = AddString(ID);
+	Graph.Type = AddString(Type);
+	Graph.Style = AddString(Style);
+	Graph.Initial = InitialNode->second;
+	Graph.NodeIndex = AddIndex(NodeMap);
+	Graph.EdgeIndex = AddIndex(EdgeMap);
+
+	m_Graphs.push_back(Graph);
+
+	return true;
+}
+
+bool CAudioGraphCompiler::CompileNode(xml_node<>* Element, AUDIO_GRAPH_IMAGE_NODE& Node, std::string& ID, std::string& Default) {
+	std::string Style;
+
+	ZeroMemory(&Node, sizeof(Node));
+	Node.DefaultEdge = AUDIO_GRAPH_IMAGE_NONE;
+
+	// Node attributes: id, filename, offset, duration, terminal, cache, default
+	ID = Attribute(Element, "id", Style);
+	std::string Filename = Attribute(Element, "filename", Style);
+	std::string Offset = Attribute(Element, "offset", Style);
+	std::string Duration = Attribute(Element, "duration", Style);
+	std::string Terminal = Attribute(Element, "terminal", Style);
+	std::string Cache = Attribute(Element, "cache", Style);
+	Default = Attribute(Element, "default", Style);
+
+	// All of these attributes must be defined.
+	if (ID == "" || Filename == "" || Offset == "" || Duration == "") {
+		return false;
+	}
+
+	// Terminal does not need to be defined, but if defined must have a valid value
+	if (Terminal == "true") {
+		Node.Flags |= AUDIO_GRAPH_IMAGE_NODE_TERMINAL;
+	} else if (Terminal != "" && Terminal != "false") {
+		return false;
+	}
+
+	// Cache does not need to be defined either, and defaults to true
+	if (Cache == "" || Cache == "true") {
+		Node.Flags |= AUDIO_GRAPH_IMAGE_NODE_CACHE;
+	} else if (Cache != "false") {
+		return false;
+	}
+
+	try {
+		Node.Offset = std::stoull(Offset);
+		Node.Duration = std::stoull(Duration);
+	} catch (...) {
+		return false;
+	}
+
+	// A graph that moved through a node with nothing in it would never get anywhere
+	if (Node.Duration == 0) {
+		return false;
+	}
+
+	Node.ID = AddString(ID);
+	Node.Filename = AddString(Filename);
+	Node.Style = AddString(Style);
+
+	return true;
+}
+
+bool CAudioGraphCompiler::CompileEdge(xml_node<>* Element, const std::map<std::string, UINT>& NodeMap, AUDIO_GRAPH_IMAGE_EDGE& Edge, std::string& ID) {
+	std::string Style;
+
+	ZeroMemory(&Edge, sizeof(Edge));
+
+	// Edge attributes: id, trigger, to, from, crossfade, curve, preroll
+	ID = Attribute(Element, "id", Style);
+	std::string Trigger = Attribute(Element, "trigger", Style);
+	auto To = NodeMap.find(Attribute(Element, "to", Style));
+	auto From = NodeMap.find(Attribute(Element, "from", Style));
+	std::string Crossfade = Attribute(Element, "crossfade", Style);
+	std::string Curve = Attribute(Element, "curve", Style);
+	std::string Preroll = Attribute(Element, "preroll", Style);
+
+	// id, trigger, to and from must be defined.
+	if (To == NodeMap.end() || From == NodeMap.end() || Trigger == "" || ID == "") {
+		return false;
+	}
+
+	// The curve is optional, and defaults to equal power
+	if (Curve == "" || Curve == "equalpower") {
+		Edge.Curve = AUDIO_GRAPH_CURVE_EQUAL_POWER;
+	} else if (Curve == "linear") {
+		Edge.Curve = AUDIO_GRAPH_CURVE_LINEAR;
+	} else {
+		return false;
+	}
+
+	// So are the crossfade and preroll, which are in milliseconds and default to 0
+	try {
+		Edge.Crossfade = Crossfade != "" ? UINT(std::stoul(Crossfade)) : 0;
+		Edge.Preroll = Preroll != "" ? UINT(std::stoul(Preroll)) : 0;
+	} catch (...) {
+		return false;
+	}
+
+	Edge.ID = AddString(ID);
+	Edge.Trigger = AddString(Trigger);
+	m_TriggerMap[Trigger] = Edge.Trigger;
+	Edge.Style = AddString(Style);
+	Edge.From = From->second;
+	Edge.To = To->second;
+
+	return true;
+}
+
+UINT CAudioGraphCompiler::AddString(const std::string& String) {
+	auto Existing = m_StringMap.find(String);
+
+	if (Existing != m_StringMap.end()) {
+		return Existing->second;
+	}
+
+	UINT Offset = UINT(m_Strings.size());
+
+	m_Strings.append(String);
+	m_Strings.push_back('\0');
+	m_StringMap[String] = Offset;
+
+	return Offset;
+}
+
+UINT CAudioGraphCompiler::AddIndex(const std::vector<UINT>& Entries) {
+	UINT Index = UINT(m_Indices.size());
+
+	m_Indices.insert(m_Indices.end(), Entries.begin(), Entries.end());
+
+	return Index;
+}
+
+UINT CAudioGraphCompiler::AddIndex(const std::map<std::string, UINT>& Entries) {
+	UINT Index = UINT(m_Indices.size());
+
+	// std::map orders its keys byte by byte, just like strcmp() does when the index is searched
+	for (auto& Entry : Entries) {
+		m_Indices.push_back(Entry.second);
+	}
+
+	return Index;
+}
+
+UINT CAudioGraphCompiler::InternTriggers() {
+	std::map<UINT, UINT> Handles; //Mapped by string offset
+	UINT Handle = 0;
+
+	// Handles follow the order of the strings, so they can be found again by a binary search of the index
+	for (auto& Trigger : m_TriggerMap) {
+		Handles[Trigger.second] = Handle++;
+	}
+
+	for (auto& Edge : m_Edges) {
+		Edge.TriggerHandle = Handles[Edge.Trigger];
+	}
+
+	return AddIndex(m_TriggerMap);
+}
+
+VOID CAudioGraphCompiler::BuildTransitions(AUDIO_GRAPH_IMAGE_GRAPH& Graph) {
+	UINT Size = 0;
+
+	// At most half full, so probes stay short and there's always an empty slot to end them
+	if (Graph.NumEdges > 0) {
+		Size = 2;
+
+		while (Size < Graph.NumEdges * 2) {
+			Size *= 2;
+		}
+	}
+
+	AUDIO_GRAPH_IMAGE_TRANSITION Empty;
+	Empty.Node = 0;
+	Empty.TriggerHandle = 0;
+	Empty.Edge = AUDIO_GRAPH_IMAGE_NONE;
+
+	Graph.FirstTransition = UINT(m_Transitions.size());
+	Graph.NumTransitions = Size;
+	m_Transitions.resize(m_Transitions.size() + Size, Empty);
+
+	AUDIO_GRAPH_IMAGE_TRANSITION* Table = m_Transitions.data() + Graph.FirstTransition;
+
+	// Edges go in the order they were defined, so a later edge with the same trigger replaces an earlier one
+	for (UINT i = 0; i < Graph.NumEdges; i++) {
+		const AUDIO_GRAPH_IMAGE_EDGE& Edge = m_Edges[Graph.FirstEdge + i];
+		UINT Slot = CAudioGraphImage::HashTransition(Edge.From, Edge.TriggerHandle) & (Size - 1);
+
+		while (Table[Slot].Edge != AUDIO_GRAPH_IMAGE_NONE && (Table[Slot].Node != Edge.From || Table[Slot].TriggerHandle != Edge.TriggerHandle)) {
+			Slot = (Slot + 1) & (Size - 1);
+		}
+
+		Table[Slot].Node = Edge.From;
+		Table[Slot].TriggerHandle = Edge.TriggerHandle;
+		Table[Slot].Edge = i;
+	}
+}
+
+HRESULT CAudioGraphCompiler::Link(UINT GraphIndex, UINT TriggerIndex, std::vector<BYTE>& Image) {
+	AUDIO_GRAPH_IMAGE_HEADER Header;
+	ZeroMemory(&Header, sizeof(Header));
+
+	UINT64 GraphOffset = sizeof(Header);
+	UINT64 NodeOffset = (GraphOffset + m_Graphs.size() * sizeof(AUDIO_GRAPH_IMAGE_GRAPH) + 7) & ~UINT64(7);
+	UINT64 EdgeOffset = NodeOffset + m_Nodes.size() * sizeof(AUDIO_GRAPH_IMAGE_NODE);
+	UINT64 TransitionOffset = EdgeOffset + m_Edges.size() * sizeof(AUDIO_GRAPH_IMAGE_EDGE);
+	UINT64 IndexOffset = TransitionOffset + m_Transitions.size() * sizeof(AUDIO_GRAPH_IMAGE_TRANSITION);
+	UINT64 StringOffset = IndexOffset + m_Indices.size() * sizeof(UINT);
+	UINT64 Size = StringOffset + m_Strings.size();
+
+	// Offsets are 32-bit
+	if (Size > MAXDWORD) {
+		return E_OUTOFMEMORY;
+	}
+
+	Header.Magic = AUDIO_GRAPH_IMAGE_MAGIC;
+	Header.Version = AUDIO_GRAPH_IMAGE_VERSION;
+	Header.Size = UINT(Size);
+	Header.NumGraphs = UINT(m_Graphs.size());
+	Header.NumNodes = UINT(m_Nodes.size());
+	Header.NumEdges = UINT(m_Edges.size());
+	Header.NumTransitions = UINT(m_Transitions.size());
+	Header.NumIndices = UINT(m_Indices.size());
+	Header.NumTriggers = UINT(m_TriggerMap.size());
+	Header.GraphOffset = UINT(GraphOffset);
+	Header.NodeOffset = UINT(NodeOffset);
+	Header.EdgeOffset = UINT(EdgeOffset);
+	Header.TransitionOffset = UINT(TransitionOffset);
+	Header.IndexOffset = UINT(IndexOffset);
+	Header.StringOffset = UINT(StringOffset);
+	Header.StringSize = UINT(m_Strings.size());
+	Header.GraphIndex = GraphIndex;
+	Header.TriggerIndex = TriggerIndex;
+
+	Image.assign(SIZE_T(Size), 0);
+
+	// Empty tables are skipped, since data() may be nullptr for them
+	static const auto Copy = [](std::vector<BYTE>& Image, UINT64 Offset, const void* Data, SIZE_T Bytes) {
+		if (Bytes > 0) {
+			memcpy(Image.data() + Offset, Data, Bytes);
+		}
+	};
+
+	Copy(Image, 0, &Header, sizeof(Header));
+	Copy(Image, GraphOffset, m_Graphs.data(), m_Graphs.size() * sizeof(AUDIO_GRAPH_IMAGE_GRAPH));
+	Copy(Image, NodeOffset, m_Nodes.data(), m_Nodes.size() * sizeof(AUDIO_GRAPH_IMAGE_NODE));
+	Copy(Image, EdgeOffset, m_Edges.data(), m_Edges.size() * sizeof(AUDIO_GRAPH_IMAGE_EDGE));
+	Copy(Image, TransitionOffset, m_Transitions.data(), m_Transitions.size() * sizeof(AUDIO_GRAPH_IMAGE_TRANSITION));
+	Copy(Image, IndexOffset, m_Indices.data(), m_Indices.size() * sizeof(UINT));
+	Copy(Image, StringOffset, m_Strings.data(), m_Strings.size());
+
+	return S_OK;
+}
+
+HRESULT CAudioGraphCompiler::WriteImage(LPCWSTR Filename, const std::vector<BYTE>& Image) {
+	DWORD Written = 0;
+
+	HANDLE File = CreateFileW (
+		Filename,
+		GENERIC_WRITE,
+		0,
+		NULL,
+		CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+
+	if (File == INVALID_HANDLE_VALUE) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	// Images never exceed 4GB, so a single write will do
+	if (!WriteFile(File, Image.data(), DWORD(Image.size()), &Written, NULL) || Written != Image.size()) {
+		HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+		CloseHandle(File);
+		return FAILED(hr) ? hr : E_FAIL;
+	}
+
+	CloseHandle(File);
+
+	return S_OK;
+}
\ No newline at end of file
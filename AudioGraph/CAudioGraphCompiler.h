@@ -0,0 +1,90 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <Windows.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "CAudioGraphImage.h"
+#include "rapidxml.hpp"
+
+/* CAudioGraphCompiler turns AudioGraph XML into a binary image (see CAudioGraphImage.h).  Graphs, nodes and
+** edges that are missing required attributes are left out, just as they always have been by the XML parser,
+** and so are graphs whose initial node doesn't exist. */
+class CAudioGraphCompiler {
+public:
+	CAudioGraphCompiler();
+
+	/* Reads an XML file and compiles it into [Image]. */
+	HRESULT CompileFile(LPCWSTR Filename, std::vector<BYTE>& Image);
+
+	/* Compiles null-terminated XML [Text] into [Image].  The text is modified by the parser. */
+	HRESULT Compile(char* Text, std::vector<BYTE>& Image);
+
+	/* Writes an image to a file, replacing it if it exists. */
+	static HRESULT WriteImage(LPCWSTR Filename, const std::vector<BYTE>& Image);
+
+private:
+	std::vector<AUDIO_GRAPH_IMAGE_GRAPH> m_Graphs;
+	std::vector<AUDIO_GRAPH_IMAGE_NODE> m_Nodes;
+	std::vector<AUDIO_GRAPH_IMAGE_EDGE> m_Edges;
+	std::vector<AUDIO_GRAPH_IMAGE_TRANSITION> m_Transitions;
+	std::vector<UINT> m_Indices;
+	std::string m_Strings; //The string table, one null-terminated string after another
+	std::map<std::string, UINT> m_StringMap; //Offsets of the strings already in the table, so each is only stored once
+	std::map<std::string, UINT> m_TriggerMap; //Offsets of the trigger strings, in the order of their handles
+
+	/* Empties the tables, leaving only the empty string. */
+	VOID Reset();
+
+	/* Adds a string to the string table if it isn't there already, and returns its offset. */
+	UINT AddString(const std::string& String);
+
+	/* Appends an index to the index array and returns where it starts. */
+	UINT AddIndex(const std::vector<UINT>& Entries);
+
+	/* Appends an index of the values of [Entries], which is sorted by ID, and returns where it starts. */
+	UINT AddIndex(const std::map<std::string, UINT>& Entries);
+
+	/* Compiles a <Graph> element with its nodes and edges.  Returns false if the graph is left out, with [ID] set to its ID otherwise. */
+	bool CompileGraph(rapidxml::xml_node<>* Element, std::string& ID);
+
+	/* Compiles a <Node> element.  Returns false if the node is left out, with [ID] set to its ID otherwise.
+	** [Default] is set to the ID of its default edge, which can only be resolved once the edges are compiled. */
+	bool CompileNode(rapidxml::xml_node<>* Element, AUDIO_GRAPH_IMAGE_NODE& Node, std::string& ID, std::string& Default);
+
+	/* Compiles an <Edge> element, resolving its nodes with [NodeMap].  Returns false if the edge is left out, with [ID] set to its ID otherwise. */
+	bool CompileEdge(rapidxml::xml_node<>* Element, const std::map<std::string, UINT>& NodeMap, AUDIO_GRAPH_IMAGE_EDGE& Edge, std::string& ID);
+
+	/* Gives every edge the handle of its trigger, once all triggers are known.  Returns the trigger index. */
+	UINT InternTriggers();
+
+	/* Lays out the transition table of a graph, once its edges have trigger handles. */
+	VOID BuildTransitions(AUDIO_GRAPH_IMAGE_GRAPH& Graph);
+
+	/* Lays the tables out one after another behind a header.  [GraphIndex] is the index of the graphs sorted by ID,
+	** and [TriggerIndex] the index of the trigger strings. */
+	HRESULT Link(UINT GraphIndex, UINT TriggerIndex, std::vector<BYTE>& Image);
+};
\ No newline at end of file
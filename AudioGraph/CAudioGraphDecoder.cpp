@@ -0,0 +1,62 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#include "CAudioGraphDecoder.h"
+#include "CAudioGraphWaveDecoder.h"
+
+#include <wchar.h>
+
+/* Returns the extension of [Filename], including the dot, or an empty string if it has none. */
+static LPCWSTR GetExtension(LPCWSTR Filename) {
+	LPCWSTR Dot = wcsrchr(Filename, L'.');
+
+	// A dot in a directory name isn't an extension
+	if (Dot == nullptr || wcspbrk(Dot, L"\\/") != nullptr) {
+		return L"";
+	}
+
+	return Dot;
+}
+
+HRESULT CAudioGraphDecoder::Create(LPCWSTR Filename, UINT SampleRate, UINT Channels, CAudioGraphDecoder** ppDecoder) {
+	HRESULT hr = S_OK;
+	LPCWSTR Extension = GetExtension(Filename);
+
+	if (_wcsicmp(Extension, L".wav") == 0 || _wcsicmp(Extension, L".wave") == 0) {
+		CComPtr<CAudioGraphWaveDecoder> Decoder;
+
+		Decoder.Attach(new CAudioGraphWaveDecoder());
+
+		hr = Decoder->Initialize (
+			Filename,
+			SampleRate,
+			Channels
+		); if (FAILED(hr)) return hr;
+
+		*ppDecoder = Decoder.Detach();
+
+		return S_OK;
+	}
+
+	// There are no built-in FLAC or Ogg Vorbis decoders, so those files are decoded by Media Foundation like any other
+	return E_NOTIMPL;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <Windows.h>
+
+/* CAudioGraphDecoder is the interface to the decoders built into AudioGraph, which read some formats without
+** going through Media Foundation.  A decoder produces floating-point frames that are already at the stream's
+** rate and channel count, and seeks to the exact frame it's asked for.  Like a source reader, a decoder is only
+** ever used by one thread at a time. */
+class CAudioGraphDecoder {
+public:
+	CAudioGraphDecoder() : m_RefCount(1) { }
+
+	virtual ~CAudioGraphDecoder() { }
+
+	ULONG AddRef() {
+		return InterlockedIncrement(&m_RefCount);
+	}
+
+	ULONG Release() {
+		ULONG RefCount = InterlockedDecrement(&m_RefCount);
+
+		if (RefCount == 0) {
+			delete this;
+		}
+
+		return RefCount;
+	}
+
+	/* Opens [Filename] with the built-in decoder for its extension, decoding to [Channels] channels at [SampleRate].
+	** Fails if there is no built-in decoder for the file, or if the decoder can't produce that format exactly, in
+	** which case the file is left to Media Foundation. */
+	static HRESULT Create(LPCWSTR Filename, UINT SampleRate, UINT Channels, CAudioGraphDecoder** ppDecoder);
+
+	/* Returns the sample rate of the file. */
+	virtual UINT GetFileRate() PURE;
+
+	/* Returns the frame that the next Read() starts on. */
+	virtual UINT64 GetPosition() PURE;
+
+	/* Moves to [Frame].  A frame past the end of the file leaves nothing to read. */
+	virtual HRESULT Seek(UINT64 Frame) PURE;
+
+	/* Decodes up to [Frames] frames into [OutputBuffer].  [pFramesRead] receives the number of frames decoded, which
+	** is only less than [Frames] at the end of the file, and is 0 if the file couldn't be read. */
+	virtual HRESULT Read(FLOAT* OutputBuffer, UINT Frames, UINT* pFramesRead) PURE;
+
+	/* Reads the part of the file holding [Frames] frames from [Frame] into memory, so that decoding them later
+	** doesn't wait on the disk.  Unlike the other methods, this may be called by another thread while the decoder
+	** is in use, since it leaves the position alone. */
+	virtual HRESULT Touch(UINT64 Frame, UINT64 Frames) PURE;
+
+private:
+	long m_RefCount;
+};
\ No newline at end of file
@@ -27,44 +27,52 @@
 
 #define FILENAME L"CAudioGraphEdge.cpp"
 
-CAudioGraphEdge::CAudioGraphEdge() : m_RefCount(1) { }
+CAudioGraphEdge::CAudioGraphEdge() :
+m_Graph(nullptr),
+m_File(nullptr),
+m_From(nullptr),
+m_To(nullptr),
+m_ID(""),
+m_Trigger(""),
+m_StyleString(""),
+m_TriggerHandle(AUDIO_GRAPH_IMAGE_NONE),
+m_CrossfadeTime(0),
+m_PrerollTime(0),
+m_Curve(AUDIO_GRAPH_CURVE_EQUAL_POWER)
+{ }
 
 CAudioGraphEdge::~CAudioGraphEdge() { }
 
-HRESULT CAudioGraphEdge::Initialize (
+ULONG CAudioGraphEdge::AddRef() {
+	return m_Graph->AddRef();
+}
+
+ULONG CAudioGraphEdge::Release() {
+	return m_Graph->Release();
+}
+
+VOID CAudioGraphEdge::Initialize (
 	IAudioGraphCallback* pCallback,
 	CAudioGraphFile* pFile,
 	CAudioGraph* pGraph,
-	std::string& Style
+	const CAudioGraphImage& Image,
+	const AUDIO_GRAPH_IMAGE_EDGE& Record,
+	CAudioGraphNode* pNodes
 ) {
 	m_Callback = pCallback;
 	m_File = pFile;
 	m_Graph = pGraph;
-	m_StyleString = Style;
-
-	// Parse style string
-
-	static const auto attribute = [&Style](LPCSTR attribute) {
-		size_t off = Style.find(attribute, 0);
-		size_t start = off + 4 + strlen(attribute);
-		size_t end = Style.find("\"", start);
-		size_t length = end - start;
-		return Style.substr(start, length);
-	};
-
-	m_ID = attribute("id");
-	m_Trigger = attribute("trigger");
-	std::string toString = attribute("to");
-	std::string fromString = attribute("from");
-	m_Graph->GetNodeByID(toString, &m_To);
-	m_Graph->GetNodeByID(fromString, &m_From);
-
-	// All attributes must be defined.
-	if (m_To == nullptr || m_From == nullptr || m_Trigger == "" || m_ID == "") {
-		return E_INVALIDARG;
-	}
 
-	return S_OK;
+	// The compiler has already checked that every attribute is defined and that both nodes exist
+	m_ID = Image.GetString(Record.ID);
+	m_Trigger = Image.GetString(Record.Trigger);
+	m_TriggerHandle = Record.TriggerHandle;
+	m_StyleString = Image.GetString(Record.Style);
+	m_From = &pNodes[Record.From];
+	m_To = &pNodes[Record.To];
+	m_CrossfadeTime = Record.Crossfade;
+	m_PrerollTime = Record.Preroll;
+	m_Curve = AUDIO_GRAPH_CURVE(Record.Curve);
 }
 
 VOID CAudioGraphEdge::GetFrom(IAudioGraphNode** ppNode) {
@@ -25,10 +25,10 @@
 #include <comdef.h>
 #include <atlbase.h>
 #include <Windows.h>
-#include <string>
 
 #include "AudioGraph.h"
 #include "QueryInterface.h"
+#include "CAudioGraphImage.h"
 
 class CAudioGraph;
 class CAudioGraphFile;
@@ -42,26 +42,17 @@ public:
 
 	//IUnknown methods
 
-	ULONG STDMETHODCALLTYPE AddRef() {
-		return ++m_RefCount;
-	}
-
-	ULONG STDMETHODCALLTYPE Release() {
-		m_RefCount--;
+	//Edges are stored in an array owned by their graph, so they share its reference count
 
-		if (m_RefCount <= 0) {
-			delete this;
-			return 0;
-		}
+	ULONG STDMETHODCALLTYPE AddRef();
 
-		return m_RefCount;
-	}
+	ULONG STDMETHODCALLTYPE Release();
 
 	//IAudioGraphEdge methods
 
 	/* Returns the ID of this particular edge. */
 	LPCSTR STDMETHODCALLTYPE GetID() final {
-		return m_ID.c_str();
+		return m_ID;
 	}
 
 	/* Retrieves the source node of this particular edge. */
@@ -72,12 +63,12 @@ public:
 
 	/* Returns the trigger string associated with this edge. */
 	LPCSTR STDMETHODCALLTYPE GetTrigger() final {
-		return m_Trigger.c_str();
+		return m_Trigger;
 	}
 
 	/* Returns this edge's formatted style string, which was used to create it. */
 	LPCSTR STDMETHODCALLTYPE GetStyleString() final {
-		return m_StyleString.c_str();
+		return m_StyleString;
 	}
 
 	/* Retrieves the audio graph that this edge is attached to. */
@@ -86,27 +77,62 @@ public:
 	/* Retrieves the audio graph file that this edge is associated with, if there is one. */
 	VOID STDMETHODCALLTYPE GetAudioGraphFile(IAudioGraphFile** ppAudioGraphFile) final;
 
+	/* Returns the length of the crossfade in milliseconds, or 0 if the edge cuts straight to the destination. */
+	UINT STDMETHODCALLTYPE GetCrossfadeTime() final {
+		return m_CrossfadeTime;
+	}
+
+	/* Returns the curve of the crossfade. */
+	AUDIO_GRAPH_CURVE STDMETHODCALLTYPE GetCrossfadeCurve() final {
+		return m_Curve;
+	}
+
+	/* Returns how many milliseconds before its offset the destination node starts playing. */
+	UINT STDMETHODCALLTYPE GetPrerollTime() final {
+		return m_PrerollTime;
+	}
+
 	//New methods
 
-	HRESULT Initialize (
+	/* Sets the edge up from its record in [Image].  [pNodes] is the graph's node array. */
+	VOID Initialize (
 		IAudioGraphCallback* pCallback,
 		CAudioGraphFile* pFile,
 		CAudioGraph* pGraph,
-		std::string& Style
+		const CAudioGraphImage& Image,
+		const AUDIO_GRAPH_IMAGE_EDGE& Record,
+		CAudioGraphNode* pNodes
 	);
 
-private:
-	long m_RefCount;
+	/* Returns the source node without going through the COM interface. */
+	CAudioGraphNode* GetFromNode() {
+		return m_From;
+	}
+
+	/* Returns the destination node without going through the COM interface. */
+	CAudioGraphNode* GetToNode() {
+		return m_To;
+	}
+
+	/* Returns the interned handle of the trigger, which is shared by every edge in the file with the same trigger. */
+	UINT GetTriggerHandle() {
+		return m_TriggerHandle;
+	}
 
-	CComPtr<CAudioGraph> m_Graph;
-	CComPtr<CAudioGraphFile> m_File;
-	CComPtr<CAudioGraphNode> m_From;
-	CComPtr<CAudioGraphNode> m_To;
+private:
+	CAudioGraph* m_Graph; //The graph owns the edge
+	CAudioGraphFile* m_File; //The file owns the graph
+	CAudioGraphNode* m_From; //Owned by the graph
+	CAudioGraphNode* m_To; //Owned by the graph
 	CComPtr<IAudioGraphCallback> m_Callback;
 
-	std::string m_ID;
-	std::string m_Trigger;
-	std::string m_StyleString;
+	LPCSTR m_ID; //Points into the file's image, like the other strings
+	LPCSTR m_Trigger;
+	LPCSTR m_StyleString;
+	UINT m_TriggerHandle;
+	UINT m_CrossfadeTime; //In milliseconds
+	UINT m_PrerollTime; //In milliseconds
+	AUDIO_GRAPH_CURVE m_Curve;
 
 	//IUnknown methods
 
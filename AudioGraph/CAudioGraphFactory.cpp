@@ -28,30 +28,99 @@
 
 CAudioGraphFactory::CAudioGraphFactory() : m_RefCount(1) { }
 
-CAudioGraphFactory::~CAudioGraphFactory() { }
+CAudioGraphFactory::~CAudioGraphFactory() {
+	// The stream must stop posting work before the loader is halted
+	m_OfflineStream.Release();
+	m_Stream.Release();
 
-HRESULT CAudioGraphFactory::Initialize(IAudioGraphCallback* pAudioGraphCallback) {
+	if (m_Loader != nullptr) {
+		m_Loader->Halt();
+	}
+}
+
+HRESULT CAudioGraphFactory::Initialize(const AUDIO_GRAPH_FACTORY_DESC* pDesc, IAudioGraphCallback* pAudioGraphCallback) {
 	HRESULT hr = S_OK;
 
 	m_Callback = pAudioGraphCallback;
 
-	DXAUDIO_STREAM_DESC StreamDesc;
-	StreamDesc.SampleRate = 44100.0f;
-	StreamDesc.Type = DXAUDIO_STREAM_TYPE_OUTPUT;
+	const UINT Channels = pDesc->Channels != 0 ? pDesc->Channels : 2;
+
+	// The mixer is sized by the channel count before the stream gets to check it
+	if (Channels > DXAUDIO_MAX_CHANNELS) {
+		return E_INVALIDARG;
+	}
+
+	DXAUDIO_STREAM_DESC_EX StreamDesc = { };
+	StreamDesc.SampleRate = FLOAT(pDesc->SampleRate);
+	StreamDesc.Channels = Channels;
+	StreamDesc.Type = pDesc->Offline ? DXAUDIO_STREAM_TYPE_OFFLINE : DXAUDIO_STREAM_TYPE_OUTPUT;
+	StreamDesc.Quality = DXAUDIO_RESAMPLER_QUALITY_DEFAULT;
+	StreamDesc.Filename = pDesc->OfflineFilename;
+	StreamDesc.Frames = pDesc->OfflineFrames;
+	StreamDesc.Shared = FALSE;
+	StreamDesc.Latency = 0;
+	StreamDesc.Backend = DXAUDIO_BACKEND_WASAPI;
+	StreamDesc.NullDevice = nullptr;
+
+	m_Loader.Attach(new CAudioGraphLoader());
+
+	hr = m_Loader->Initialize (
+		m_Callback
+	); RETURN_HR(__LINE__);
+
+	m_Loader->SetOffline (
+		pDesc->Offline != FALSE
+	);
 
 	m_WriteCallback = new (_memblockWriteCallback) CDXAudioWriteCallback();
 
 	hr = m_WriteCallback->Initialize (
-		m_Callback
+		m_Callback,
+		m_Loader,
+		Channels
 	); RETURN_HR(__LINE__);
 
-	hr = DXAudioCreateStream (
+	if (pDesc->TransitionScript != nullptr) {
+		m_WriteCallback->SetTransitionScript (
+			pDesc->TransitionScript,
+			pDesc->TransitionScriptLength
+		);
+	}
+
+	m_WriteCallback->SetAsyncTransitions (
+		pDesc->AsyncTransitions != FALSE
+	);
+
+	hr = m_WriteCallback->SetMixer (
+		pDesc->Buses,
+		pDesc->MaxVoices,
+		pDesc->RenderThreads
+	); RETURN_HR(__LINE__);
+
+	hr = DXAudioCreateStreamEx (
 		&StreamDesc,
 		m_WriteCallback,
 		&m_Stream
 	); RETURN_HR(__LINE__);
 
-	m_Stream->Start();
+	// A rate of 0 has been resolved to the device's mix rate by now
+	hr = m_WriteCallback->SetSampleRate (
+		UINT(m_Stream->GetSampleRate())
+	); RETURN_HR(__LINE__);
+
+	// Offline streams aren't started until Render() is called, so that graphs can be queued first
+	if (pDesc->Offline) {
+		hr = m_Stream->QueryInterface (
+			IID_PPV_ARGS(&m_OfflineStream)
+		); RETURN_HR(__LINE__);
+
+		m_WriteCallback->SetOfflineStream (
+			m_OfflineStream,
+			pDesc->OfflineFrames == 0
+		);
+	} else {
+		m_Stream->Start();
+	}
 
 	return S_OK;
 }
@@ -75,6 +144,98 @@ VOID CAudioGraphFactory::ParseAudioGraphFile(LPCWSTR Filename, IAudioGraphFile**
 	*ppAudioGraphFile = File;
 }
 
+/* Maps a binary image compiled by AudioGraphCompileFile(). */
+VOID CAudioGraphFactory::LoadAudioGraphImage(LPCWSTR Filename, IAudioGraphFile** ppAudioGraphFile) {
+	HRESULT hr = S_OK;
+
+	CComPtr<CAudioGraphFile> File = new CAudioGraphFile();
+
+	hr = File->Initialize(m_Callback, Filename);
+
+	if (FAILED(hr)) {
+		*ppAudioGraphFile = nullptr;
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, hr);
+		return;
+	}
+
+	File->Map();
+
+	*ppAudioGraphFile = File;
+}
+
 VOID CAudioGraphFactory::QueueAudioGraph(IAudioGraph* pAudioGraph) {
 	m_WriteCallback->QueueAudioGraph(pAudioGraph);
+}
+
+VOID CAudioGraphFactory::ClearQueue() {
+	m_WriteCallback->ClearQueue();
+}
+
+VOID CAudioGraphFactory::SkipAudioGraph() {
+	m_WriteCallback->SkipAudioGraph();
+}
+
+VOID CAudioGraphFactory::SetCacheBudget(UINT64 Bytes) {
+	m_Loader->SetCacheBudget(Bytes);
+}
+
+VOID CAudioGraphFactory::SetPrefetchTime(UINT Milliseconds) {
+	m_Loader->SetPrefetchTime(Milliseconds);
+}
+
+VOID CAudioGraphFactory::SetReadAhead(UINT Milliseconds) {
+	m_Loader->SetReadAhead(Milliseconds);
+}
+
+VOID CAudioGraphFactory::GetPlaybackStats(AUDIO_GRAPH_PLAYBACK_STATS* pStats) {
+	m_WriteCallback->GetPlaybackStats(pStats);
+}
+
+VOID CAudioGraphFactory::PlayAudioGraph(UINT Bus, IAudioGraph* pAudioGraph) {
+	m_WriteCallback->PlayAudioGraph(Bus, pAudioGraph);
+}
+
+VOID CAudioGraphFactory::StopBus(UINT Bus) {
+	m_WriteCallback->StopBus(Bus);
+}
+
+VOID CAudioGraphFactory::SetBusGain(UINT Bus, FLOAT Gain) {
+	m_WriteCallback->SetBusGain(Bus, Gain);
+}
+
+VOID CAudioGraphFactory::GetBusStats(UINT Bus, AUDIO_GRAPH_BUS_STATS* pStats) {
+	m_WriteCallback->GetBusStats(Bus, pStats);
+}
+
+VOID CAudioGraphFactory::Render(DOUBLE* pRealTimeFactor) {
+	if (m_OfflineStream == nullptr) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_UNEXPECTED);
+		return;
+	}
+
+	m_OfflineStream->Start();
+	m_OfflineStream->WaitForFinish(INFINITE);
+
+	m_WriteCallback->ReportRenderFailures();
+
+	if (pRealTimeFactor != nullptr) {
+		*pRealTimeFactor = m_OfflineStream->GetRealTimeFactor();
+	}
+}
+
+VOID CAudioGraphFactory::GetRenderBuffer(const FLOAT** ppBuffer, UINT64* pFrames) {
+	if (ppBuffer == nullptr || pFrames == nullptr) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
+		return;
+	}
+
+	if (m_OfflineStream == nullptr) {
+		*ppBuffer = nullptr;
+		*pFrames = 0;
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_UNEXPECTED);
+		return;
+	}
+
+	*ppBuffer = m_OfflineStream->GetBuffer();
+	*pFrames = *ppBuffer != nullptr ? m_OfflineStream->GetFramesRendered() : 0;
 }
\ No newline at end of file
@@ -31,6 +31,7 @@
 #include "DXAudio.h"
 #include "CDXAudioWriteCallback.h"
 #include "CAudioGraphFile.h"
+#include "CAudioGraphLoader.h"
 
 class CAudioGraphFactory : public IAudioGraphFactory {
 public:
@@ -63,15 +64,56 @@ public:
 	/* Places an audio graph in the playback queue. */
 	VOID STDMETHODCALLTYPE QueueAudioGraph(IAudioGraph* pAudioGraph) final;
 
+	/* Stops the current graph and empties the playback queue. */
+	VOID STDMETHODCALLTYPE ClearQueue() final;
+
+	/* Stops the current graph and moves on to the next one. */
+	VOID STDMETHODCALLTYPE SkipAudioGraph() final;
+
+	/* Sets the memory budget for decoded PCM node caches, in bytes. */
+	VOID STDMETHODCALLTYPE SetCacheBudget(UINT64 Bytes) final;
+
+	/* Sets how long before the end of a node its transition targets are prefetched, in milliseconds. */
+	VOID STDMETHODCALLTYPE SetPrefetchTime(UINT Milliseconds) final;
+
+	/* Retrieves the playback statistics gathered so far. */
+	VOID STDMETHODCALLTYPE GetPlaybackStats(AUDIO_GRAPH_PLAYBACK_STATS* pStats) final;
+
+	/* Starts playing a graph on a mixer bus, alongside everything else. */
+	VOID STDMETHODCALLTYPE PlayAudioGraph(UINT Bus, IAudioGraph* pAudioGraph) final;
+
+	/* Stops every graph playing on a mixer bus. */
+	VOID STDMETHODCALLTYPE StopBus(UINT Bus) final;
+
+	/* Sets the gain a mixer bus is mixed at. */
+	VOID STDMETHODCALLTYPE SetBusGain(UINT Bus, FLOAT Gain) final;
+
+	/* Retrieves the statistics of a mixer bus gathered so far. */
+	VOID STDMETHODCALLTYPE GetBusStats(UINT Bus, AUDIO_GRAPH_BUS_STATS* pStats) final;
+
+	/* Renders the playback queue offline. */
+	VOID STDMETHODCALLTYPE Render(DOUBLE* pRealTimeFactor) final;
+
+	/* Retrieves the frames rendered offline to memory. */
+	VOID STDMETHODCALLTYPE GetRenderBuffer(const FLOAT** ppBuffer, UINT64* pFrames) final;
+
+	/* Loads a compiled binary image of a set of audio graphs. */
+	VOID STDMETHODCALLTYPE LoadAudioGraphImage(LPCWSTR Filename, IAudioGraphFile** ppAudioGraphFile) final;
+
+	/* Sets how much decoded audio streamed nodes keep ready ahead of the audio thread, in milliseconds. */
+	VOID STDMETHODCALLTYPE SetReadAhead(UINT Milliseconds) final;
+
 	//New methods
 
-	HRESULT Initialize(IAudioGraphCallback* pAudioGraphCallback);
+	HRESULT Initialize(const AUDIO_GRAPH_FACTORY_DESC* pDesc, IAudioGraphCallback* pAudioGraphCallback);
 
 private:
 	long m_RefCount;
 
 	CComPtr<IAudioGraphCallback> m_Callback;
+	CComPtr<CAudioGraphLoader> m_Loader;
 	CComPtr<IDXAudioStream> m_Stream;
+	CComPtr<IDXAudioOfflineStream> m_OfflineStream; //Only for offline factories
 	CComPtr<CDXAudioWriteCallback> m_WriteCallback;
 
 	// Memory blocks below ensure that objects are sequential to the factory.
@@ -26,13 +26,21 @@
 #include "CAudioGraphNode.h"
 #include "CAudioGraphEdge.h"
 #include "CAudioGraph.h"
-#include "rapidxml.hpp"
+#include "CAudioGraphCompiler.h"
 
 #define FILENAME L"CAudioGraphFile.cpp"
+#define CHECK_HR(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return; }
 
-CAudioGraphFile::CAudioGraphFile() : m_RefCount(1) { }
+CAudioGraphFile::CAudioGraphFile() :
+m_RefCount(1),
+m_Graphs(nullptr),
+m_NumGraphs(0)
+{ }
 
-CAudioGraphFile::~CAudioGraphFile() { }
+CAudioGraphFile::~CAudioGraphFile() {
+	// The graphs point into the image, so they have to go before it does
+	delete[] m_Graphs;
+}
 
 HRESULT CAudioGraphFile::Initialize(IAudioGraphCallback* pAudioGraphCallback, LPCWSTR Filename) {
 	m_Callback = pAudioGraphCallback;
@@ -48,13 +56,13 @@ VOID CAudioGraphFile::EnumGraph(UINT GraphNum, IAudioGraph** ppAudioGraph) {
 		return;
 	}
 
-	try {
-		*ppAudioGraph = m_GraphEnum.at(GraphNum);
-	} catch (...) {
+	if (GraphNum >= m_NumGraphs) {
 		*ppAudioGraph = nullptr;
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
 		return;
 	}
+
+	*ppAudioGraph = &m_Graphs[GraphNum];
 }
 
 VOID CAudioGraphFile::GetGraphByID(LPCSTR ID, IAudioGraph** ppAudioGraph) {
@@ -63,108 +71,55 @@ VOID CAudioGraphFile::GetGraphByID(LPCSTR ID, IAudioGraph** ppAudioGraph) {
 		return;
 	}
 
-	std::string stringID = ID;
+	UINT Graph = ID != nullptr ? m_Image.FindGraph(ID) : AUDIO_GRAPH_IMAGE_NONE;
 
-	try {
-		*ppAudioGraph = m_GraphMap.at(stringID);
-	} catch (...) {
+	if (Graph == AUDIO_GRAPH_IMAGE_NONE) {
 		*ppAudioGraph = nullptr;
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
 		return;
 	}
+
+	*ppAudioGraph = &m_Graphs[Graph];
 }
 
 VOID CAudioGraphFile::Parse() {
 	HRESULT hr = S_OK;
 
-	using namespace rapidxml;
-
-	// Source: http://stackoverflow.com/questions/18398167/how-to-copy-a-txt-file-to-a-char-array-in-c
-
-	FILE *f = nullptr; 
-
-	if (_wfopen_s(&f, m_Filename.c_str(), L"rb") != 0) {
-		m_Callback->OnObjectFailure(FILENAME, __LINE__, HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
-		return;
-	}
-
-	fseek(f, 0, SEEK_END);
-	long fsize = ftell(f);
-	fseek(f, 0, SEEK_SET);
-
-	char* content = reinterpret_cast<char*>(malloc(fsize + 1));
-	fread(content, fsize, 1, f);
-	fclose(f);
-
-	content[fsize] = 0;
-
-	// XML Parsing using rapidxml
-
-	xml_document<> document;
-	document.parse<0>(content);
-	xml_node<>* root_node = document.first_node("AudioGraph");
-	if (!root_node) return;
-	std::string style_string;
+	CAudioGraphCompiler Compiler;
+	std::vector<BYTE> Image;
 
-	static const auto attribute = [&style_string](xml_node<>* node, LPCSTR attribute) {
-		if (!style_string.empty()) {
-			style_string += " ";
-		}
+	hr = Compiler.CompileFile (
+		m_Filename.c_str(),
+		Image
+	); CHECK_HR(__LINE__);
 
-		style_string += attribute;
-		style_string += " = \"";
+	hr = m_Image.Assign (
+		Image
+	); CHECK_HR(__LINE__);
 
-		if (strcmp(node->first_attribute(attribute)->value(), "") != 0) {
-			style_string += node->first_attribute(attribute)->value();
-		}
-
-		style_string += "\"";
-	};
-
-	for (xml_node<>* graph_node = root_node->first_node("Graph"); graph_node; graph_node = graph_node->next_sibling()) {
-		style_string = "";
-
-		// Graph attributes: id, type, initial
-		attribute(graph_node, "id");
-		attribute(graph_node, "type");
-		attribute(graph_node, "initial");
-
-		CComPtr<CAudioGraph> Graph = new CAudioGraph();
-
-		hr = Graph->Initialize(m_Callback, this, style_string);
-
-		if (SUCCEEDED(hr)) {
-			// Add graph to this file
-			CComPtr<IAudioGraph> I_Graph = Graph;
-			m_GraphEnum.push_back(I_Graph);
-			m_GraphMap[I_Graph->GetID()] = I_Graph;
-		} else continue;
-
-		for (xml_node<>* vertex_node = graph_node->first_node("Node"); vertex_node; vertex_node = vertex_node->next_sibling()) {
-			style_string = "";
-
-			// Node attributes: id, filename, offset, duration
-			attribute(vertex_node, "id");
-			attribute(vertex_node, "filename");
-			attribute(vertex_node, "offset");
-			attribute(vertex_node, "duration");
-			attribute(vertex_node, "terminal");
+	CreateGraphs();
+}
 
-			Graph->CreateNode(style_string);
-		}
+VOID CAudioGraphFile::Map() {
+	HRESULT hr = S_OK;
 
-		for (xml_node<>* edge_node = graph_node->first_node("Edge"); edge_node; edge_node = edge_node->next_sibling()) {
-			style_string = "";
+	hr = m_Image.Map (
+		m_Filename.c_str()
+	); CHECK_HR(__LINE__);
 
-			// Edge attributes: id, trigger, to, from
-			attribute(edge_node, "id");
-			attribute(edge_node, "trigger");
-			attribute(edge_node, "to");
-			attribute(edge_node, "from");
+	CreateGraphs();
+}
 
-			Graph->CreateEdge(style_string);
-		}
+VOID CAudioGraphFile::CreateGraphs() {
+	m_NumGraphs = m_Image.GetHeader().NumGraphs;
+	m_Graphs = new CAudioGraph[m_NumGraphs];
+
+	for (UINT i = 0; i < m_NumGraphs; i++) {
+		m_Graphs[i].Initialize (
+			m_Callback,
+			this,
+			m_Image,
+			i
+		);
 	}
-
-	free(content);
 }
\ No newline at end of file
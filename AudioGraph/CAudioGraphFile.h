@@ -26,11 +26,12 @@
 #include <atlbase.h>
 #include <Windows.h>
 #include <string>
-#include <vector>
-#include <map>
 
 #include "AudioGraph.h"
 #include "QueryInterface.h"
+#include "CAudioGraphImage.h"
+
+class CAudioGraph;
 
 class CAudioGraphFile : public IAudioGraphFile {
 public:
@@ -40,19 +41,21 @@ public:
 
 	//IUnknown methods
 
+	//The file's graphs, nodes and edges all share this reference count.  It is atomic, since the
+	//loader holds references to nodes from its own thread.
+
 	ULONG STDMETHODCALLTYPE AddRef() {
-		return ++m_RefCount;
+		return InterlockedIncrement(&m_RefCount);
 	}
 
 	ULONG STDMETHODCALLTYPE Release() {
-		m_RefCount--;
+		ULONG RefCount = InterlockedDecrement(&m_RefCount);
 
-		if (m_RefCount <= 0) {
+		if (RefCount == 0) {
 			delete this;
-			return 0;
 		}
 
-		return m_RefCount;
+		return RefCount;
 	}
 
 	//IAudioGraphFile methods
@@ -64,7 +67,7 @@ public:
 
 	/* Returns the number of graphs contained in this file. */
 	UINT STDMETHODCALLTYPE GetNumGraphs() final {
-		return m_GraphEnum.size();
+		return m_NumGraphs;
 	}
 
 	/* Retrieves a graph based on the given array index. */
@@ -77,16 +80,24 @@ public:
 
 	HRESULT Initialize(IAudioGraphCallback* pAudioGraphCallback, LPCWSTR Filename);
 
+	/* Compiles the XML file into an image in memory, and creates the graphs from it. */
 	VOID Parse();
 
+	/* Maps a binary image compiled ahead of time, and creates the graphs from it. */
+	VOID Map();
+
 private:
 	long m_RefCount;
 
 	CComPtr<IAudioGraphCallback> m_Callback;
 
 	std::wstring m_Filename;
-	std::vector<CComPtr<IAudioGraph>> m_GraphEnum;
-	std::map<std::string, CComPtr<IAudioGraph>> m_GraphMap;
+	CAudioGraphImage m_Image; //Holds every string the graphs, nodes and edges hand out
+	CAudioGraph* m_Graphs; //One allocation for all of the file's graphs, in the order of the image
+	UINT m_NumGraphs;
+
+	/* Creates the graphs once the image is attached. */
+	VOID CreateGraphs();
 
 	//IUnknown methods
 
@@ -0,0 +1,320 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#include "CAudioGraphImage.h"
+
+#include <string.h>
+
+CAudioGraphImage::CAudioGraphImage() :
+m_FileHandle(INVALID_HANDLE_VALUE),
+m_Mapping(NULL),
+m_Data(nullptr),
+m_Size(0)
+{ }
+
+CAudioGraphImage::~CAudioGraphImage() {
+	Clear();
+}
+
+HRESULT CAudioGraphImage::Map(LPCWSTR Filename) {
+	LARGE_INTEGER FileSize;
+
+	Clear();
+
+	m_FileHandle = CreateFileW (
+		Filename,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		NULL,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+
+	if (m_FileHandle == INVALID_HANDLE_VALUE) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (!GetFileSizeEx(m_FileHandle, &FileSize)) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	//Images are addressed with 32-bit offsets, and an empty file can't be mapped
+	if (FileSize.QuadPart < LONGLONG(sizeof(AUDIO_GRAPH_IMAGE_HEADER)) || FileSize.QuadPart > LONGLONG(MAXDWORD)) {
+		return E_INVALIDARG;
+	}
+
+	m_Mapping = CreateFileMappingW (
+		m_FileHandle,
+		NULL,
+		PAGE_READONLY,
+		0,
+		0,
+		NULL
+	);
+
+	if (m_Mapping == NULL) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	m_Data = reinterpret_cast<const BYTE*>(MapViewOfFile (
+		m_Mapping,
+		FILE_MAP_READ,
+		0,
+		0,
+		0
+	));
+
+	if (m_Data == nullptr) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	m_Size = SIZE_T(FileSize.QuadPart);
+
+	return Validate();
+}
+
+HRESULT CAudioGraphImage::Assign(std::vector<BYTE>& Image) {
+	Clear();
+
+	m_Buffer.swap(Image);
+	m_Data = m_Buffer.data();
+	m_Size = m_Buffer.size();
+
+	return Validate();
+}
+
+VOID CAudioGraphImage::Clear() {
+	if (m_Mapping != NULL) {
+		if (m_Data != nullptr) {
+			UnmapViewOfFile(m_Data);
+		}
+
+		CloseHandle(m_Mapping);
+		m_Mapping = NULL;
+	}
+
+	if (m_FileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_FileHandle);
+		m_FileHandle = INVALID_HANDLE_VALUE;
+	}
+
+	std::vector<BYTE>().swap(m_Buffer);
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+HRESULT CAudioGraphImage::Validate() {
+	if (m_Size < sizeof(AUDIO_GRAPH_IMAGE_HEADER)) {
+		return E_INVALIDARG;
+	}
+
+	const AUDIO_GRAPH_IMAGE_HEADER& Header = GetHeader();
+
+	if (Header.Magic != AUDIO_GRAPH_IMAGE_MAGIC || Header.Version != AUDIO_GRAPH_IMAGE_VERSION || Header.Size != m_Size) {
+		return E_INVALIDARG;
+	}
+
+	//Node records hold 64-bit fields, so they're kept 8-byte aligned, and everything else 4-byte aligned
+	if (Header.NodeOffset % 8 != 0 || Header.GraphOffset % 4 != 0 || Header.EdgeOffset % 4 != 0 || Header.TransitionOffset % 4 != 0 || Header.IndexOffset % 4 != 0) {
+		return E_INVALIDARG;
+	}
+
+	if (!IsInImage(Header.GraphOffset, Header.NumGraphs, sizeof(AUDIO_GRAPH_IMAGE_GRAPH)) ||
+		!IsInImage(Header.NodeOffset, Header.NumNodes, sizeof(AUDIO_GRAPH_IMAGE_NODE)) ||
+		!IsInImage(Header.EdgeOffset, Header.NumEdges, sizeof(AUDIO_GRAPH_IMAGE_EDGE)) ||
+		!IsInImage(Header.TransitionOffset, Header.NumTransitions, sizeof(AUDIO_GRAPH_IMAGE_TRANSITION)) ||
+		!IsInImage(Header.IndexOffset, Header.NumIndices, sizeof(UINT)) ||
+		!IsInImage(Header.StringOffset, Header.StringSize, 1)) {
+		return E_INVALIDARG;
+	}
+
+	//Every string ends before the table does, as long as the table itself ends in a terminator
+	if (Header.StringSize == 0 || GetString(Header.StringSize - 1)[0] != '\0') {
+		return E_INVALIDARG;
+	}
+
+	if (!IsIndex(Header.GraphIndex, Header.NumGraphs, Header.NumGraphs) || !IsIndex(Header.TriggerIndex, Header.NumTriggers, Header.StringSize)) {
+		return E_INVALIDARG;
+	}
+
+	const AUDIO_GRAPH_IMAGE_TRANSITION* Transitions = reinterpret_cast<const AUDIO_GRAPH_IMAGE_TRANSITION*>(m_Data + Header.TransitionOffset);
+
+	for (UINT i = 0; i < Header.NumGraphs; i++) {
+		const AUDIO_GRAPH_IMAGE_GRAPH& Graph = GetGraph(i);
+
+		if (!IsString(Graph.ID) || !IsString(Graph.Type) || !IsString(Graph.Style)) {
+			return E_INVALIDARG;
+		}
+
+		if (UINT64(Graph.FirstNode) + Graph.NumNodes > Header.NumNodes || UINT64(Graph.FirstEdge) + Graph.NumEdges > Header.NumEdges) {
+			return E_INVALIDARG;
+		}
+
+		if (Graph.Initial >= Graph.NumNodes) {
+			return E_INVALIDARG;
+		}
+
+		if (!IsIndex(Graph.NodeIndex, Graph.NumNodes, Graph.NumNodes) || !IsIndex(Graph.EdgeIndex, Graph.NumEdges, Graph.NumEdges)) {
+			return E_INVALIDARG;
+		}
+
+		for (UINT j = 0; j < Graph.NumNodes; j++) {
+			const AUDIO_GRAPH_IMAGE_NODE& Node = GetNode(Graph, j);
+
+			if (!IsString(Node.ID) || !IsString(Node.Filename) || !IsString(Node.Style)) {
+				return E_INVALIDARG;
+			}
+
+			if (!IsIndex(Node.EdgeList, Node.NumEdges, Graph.NumEdges)) {
+				return E_INVALIDARG;
+			}
+
+			if (Node.DefaultEdge != AUDIO_GRAPH_IMAGE_NONE && (Node.DefaultEdge >= Graph.NumEdges || GetEdge(Graph, Node.DefaultEdge).From != j)) {
+				return E_INVALIDARG;
+			}
+		}
+
+		for (UINT j = 0; j < Graph.NumEdges; j++) {
+			const AUDIO_GRAPH_IMAGE_EDGE& Edge = GetEdge(Graph, j);
+
+			if (!IsString(Edge.ID) || !IsString(Edge.Trigger) || !IsString(Edge.Style)) {
+				return E_INVALIDARG;
+			}
+
+			if (Edge.From >= Graph.NumNodes || Edge.To >= Graph.NumNodes) {
+				return E_INVALIDARG;
+			}
+
+			if (Edge.Curve >= AUDIO_GRAPH_CURVE_COUNT) {
+				return E_INVALIDARG;
+			}
+
+			//The handle has to name the edge's own trigger, since transitions are resolved by handle alone
+			if (Edge.TriggerHandle >= Header.NumTriggers || GetIndex(Header.TriggerIndex)[Edge.TriggerHandle] != Edge.Trigger) {
+				return E_INVALIDARG;
+			}
+		}
+
+		if (UINT64(Graph.FirstTransition) + Graph.NumTransitions > Header.NumTransitions) {
+			return E_INVALIDARG;
+		}
+
+		//A table needs an empty slot to end every probe, and a power of two size to be masked
+		if ((Graph.NumTransitions & (Graph.NumTransitions - 1)) != 0 || (Graph.NumTransitions == 0 && Graph.NumEdges != 0)) {
+			return E_INVALIDARG;
+		}
+
+		UINT EmptySlots = 0;
+
+		for (UINT j = 0; j < Graph.NumTransitions; j++) {
+			const AUDIO_GRAPH_IMAGE_TRANSITION& Transition = Transitions[Graph.FirstTransition + j];
+
+			if (Transition.Edge == AUDIO_GRAPH_IMAGE_NONE) {
+				EmptySlots++;
+			} else if (Transition.Edge >= Graph.NumEdges ||
+				GetEdge(Graph, Transition.Edge).From != Transition.Node ||
+				GetEdge(Graph, Transition.Edge).TriggerHandle != Transition.TriggerHandle) {
+				return E_INVALIDARG;
+			}
+		}
+
+		if (Graph.NumTransitions != 0 && EmptySlots == 0) {
+			return E_INVALIDARG;
+		}
+	}
+
+	return S_OK;
+}
+
+bool CAudioGraphImage::IsIndex(UINT Index, UINT Count, UINT Limit) const {
+	if (UINT64(Index) + Count > GetHeader().NumIndices) {
+		return false;
+	}
+
+	const UINT* Entries = GetIndex(Index);
+
+	for (UINT i = 0; i < Count; i++) {
+		if (Entries[i] >= Limit) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+template <typename RECORD>
+UINT CAudioGraphImage::Find(UINT Index, UINT Count, LPCSTR ID, RECORD Record) const {
+	const UINT* Entries = GetIndex(Index);
+	UINT Low = 0;
+	UINT High = Count;
+
+	while (Low < High) {
+		UINT Middle = Low + (High - Low) / 2;
+		int Order = strcmp(GetString(Record(Entries[Middle])), ID);
+
+		if (Order == 0) {
+			return Middle;
+		} else if (Order < 0) {
+			Low = Middle + 1;
+		} else {
+			High = Middle;
+		}
+	}
+
+	return AUDIO_GRAPH_IMAGE_NONE;
+}
+
+UINT CAudioGraphImage::FindGraph(LPCSTR ID) const {
+	const AUDIO_GRAPH_IMAGE_HEADER& Header = GetHeader();
+
+	UINT Position = Find(Header.GraphIndex, Header.NumGraphs, ID, [this](UINT Graph) {
+		return GetGraph(Graph).ID;
+	});
+
+	return Position != AUDIO_GRAPH_IMAGE_NONE ? GetIndex(Header.GraphIndex)[Position] : AUDIO_GRAPH_IMAGE_NONE;
+}
+
+UINT CAudioGraphImage::FindNode(const AUDIO_GRAPH_IMAGE_GRAPH& Graph, LPCSTR ID) const {
+	UINT Position = Find(Graph.NodeIndex, Graph.NumNodes, ID, [this, &Graph](UINT Node) {
+		return GetNode(Graph, Node).ID;
+	});
+
+	return Position != AUDIO_GRAPH_IMAGE_NONE ? GetIndex(Graph.NodeIndex)[Position] : AUDIO_GRAPH_IMAGE_NONE;
+}
+
+UINT CAudioGraphImage::FindEdge(const AUDIO_GRAPH_IMAGE_GRAPH& Graph, LPCSTR ID) const {
+	UINT Position = Find(Graph.EdgeIndex, Graph.NumEdges, ID, [this, &Graph](UINT Edge) {
+		return GetEdge(Graph, Edge).ID;
+	});
+
+	return Position != AUDIO_GRAPH_IMAGE_NONE ? GetIndex(Graph.EdgeIndex)[Position] : AUDIO_GRAPH_IMAGE_NONE;
+}
+
+UINT CAudioGraphImage::FindTrigger(LPCSTR Trigger) const {
+	const AUDIO_GRAPH_IMAGE_HEADER& Header = GetHeader();
+
+	// The trigger index holds the strings themselves, and a handle is simply a position in it
+	return Find(Header.TriggerIndex, Header.NumTriggers, Trigger, [](UINT String) {
+		return String;
+	});
+}
\ No newline at end of file
@@ -0,0 +1,234 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include <climits>
+
+#include "AudioGraph.h"
+
+/* The binary image format, as produced by CAudioGraphCompiler.  An image is a header followed by flat arrays
+** of graph, node, edge and transition records, an array of indices that the records refer to, and a string
+** table.  Offsets are in bytes from the start of the image, and strings are byte offsets into the string table,
+** which holds null-terminated UTF-8 strings.  Nodes and edges are numbered within their graph.
+**
+** Triggers are interned across the whole image: a trigger handle is the trigger's position in the trigger
+** index, which is sorted by string.  Each graph has a hash table of transitions, keyed by the node an edge
+** leaves and the edge's trigger handle, so that a transition can be resolved without comparing strings. */
+
+static const UINT AUDIO_GRAPH_IMAGE_MAGIC = 0x4E424741; //"AGBN"
+static const UINT AUDIO_GRAPH_IMAGE_VERSION = 4; //Bumped whenever the layout of the records changes
+static const UINT AUDIO_GRAPH_IMAGE_NONE = UINT_MAX; //An empty transition slot, or a trigger or edge that doesn't exist - the same as AUDIO_GRAPH_TRIGGER_NONE
+
+/* Flags of an AUDIO_GRAPH_IMAGE_NODE. */
+enum AUDIO_GRAPH_IMAGE_NODE_FLAGS {
+	AUDIO_GRAPH_IMAGE_NODE_TERMINAL = 0x1, //terminal = "true"
+	AUDIO_GRAPH_IMAGE_NODE_CACHE = 0x2 //cache = "true", or no cache attribute
+};
+
+struct AUDIO_GRAPH_IMAGE_HEADER {
+	UINT Magic; //AUDIO_GRAPH_IMAGE_MAGIC
+	UINT Version; //AUDIO_GRAPH_IMAGE_VERSION
+	UINT Size; //Size of the whole image in bytes
+	UINT NumGraphs;
+	UINT NumNodes; //Nodes of all graphs together
+	UINT NumEdges; //Edges of all graphs together
+	UINT NumTransitions; //Transition slots of all graphs together
+	UINT NumIndices;
+	UINT NumTriggers;
+	UINT GraphOffset; //AUDIO_GRAPH_IMAGE_GRAPH[NumGraphs]
+	UINT NodeOffset; //AUDIO_GRAPH_IMAGE_NODE[NumNodes], aligned to 8 bytes
+	UINT EdgeOffset; //AUDIO_GRAPH_IMAGE_EDGE[NumEdges]
+	UINT TransitionOffset; //AUDIO_GRAPH_IMAGE_TRANSITION[NumTransitions]
+	UINT IndexOffset; //UINT[NumIndices]
+	UINT StringOffset; //The string table
+	UINT StringSize; //Size of the string table in bytes
+	UINT GraphIndex; //Index of the graphs sorted by ID - NumGraphs entries
+	UINT TriggerIndex; //Index of the trigger strings, sorted - NumTriggers entries
+};
+
+struct AUDIO_GRAPH_IMAGE_GRAPH {
+	UINT ID;
+	UINT Type;
+	UINT Style; //The style string returned by IAudioGraph::GetStyleString()
+	UINT Initial; //The initial node
+	UINT FirstNode; //The graph's first record in the node array
+	UINT NumNodes;
+	UINT FirstEdge; //The graph's first record in the edge array
+	UINT NumEdges;
+	UINT NodeIndex; //Index of the nodes sorted by ID - NumNodes entries
+	UINT EdgeIndex; //Index of the edges sorted by ID - NumEdges entries
+	UINT FirstTransition; //The graph's first slot in the transition array
+	UINT NumTransitions; //A power of two with at least one empty slot, or 0 if the graph has no edges
+};
+
+struct AUDIO_GRAPH_IMAGE_NODE {
+	UINT64 Offset; //In samples of the file
+	UINT64 Duration; //In samples of the file
+	UINT ID;
+	UINT Filename;
+	UINT Style; //The style string returned by IAudioGraphNode::GetStyleString()
+	UINT Flags; //AUDIO_GRAPH_IMAGE_NODE_FLAGS
+	UINT EdgeList; //Index of the edges leaving the node, in the order they were defined - NumEdges entries
+	UINT NumEdges;
+	UINT DefaultEdge; //The edge given by the "default" attribute, or AUDIO_GRAPH_IMAGE_NONE
+	UINT Reserved; //Keeps the record a multiple of 8 bytes
+};
+
+struct AUDIO_GRAPH_IMAGE_EDGE {
+	UINT ID;
+	UINT Trigger;
+	UINT TriggerHandle; //Position of Trigger in the trigger index
+	UINT Style; //The style string returned by IAudioGraphEdge::GetStyleString()
+	UINT From;
+	UINT To;
+	UINT Crossfade; //In milliseconds, or 0 for a hard cut
+	UINT Curve; //AUDIO_GRAPH_CURVE
+	UINT Preroll; //In milliseconds
+};
+
+/* A slot in a graph's transition table.  Collisions are resolved by probing the following slots. */
+struct AUDIO_GRAPH_IMAGE_TRANSITION {
+	UINT Node; //The node the edge leaves
+	UINT TriggerHandle;
+	UINT Edge; //AUDIO_GRAPH_IMAGE_NONE if the slot is empty
+};
+
+/* CAudioGraphImage holds a binary image, either memory-mapped from a file or compiled in memory.  The image is
+** validated once when it is attached, so the records can be read afterwards without any checks.  An index is a
+** run of UINTs in the index array, and IDs in an index sorted by ID are unique. */
+class CAudioGraphImage {
+public:
+	CAudioGraphImage();
+
+	~CAudioGraphImage();
+
+	/* Maps an image file into memory and validates it. */
+	HRESULT Map(LPCWSTR Filename);
+
+	/* Takes over an image compiled in memory, leaving [Image] empty, and validates it. */
+	HRESULT Assign(std::vector<BYTE>& Image);
+
+	const AUDIO_GRAPH_IMAGE_HEADER& GetHeader() const {
+		return *reinterpret_cast<const AUDIO_GRAPH_IMAGE_HEADER*>(m_Data);
+	}
+
+	const AUDIO_GRAPH_IMAGE_GRAPH& GetGraph(UINT Graph) const {
+		return reinterpret_cast<const AUDIO_GRAPH_IMAGE_GRAPH*>(m_Data + GetHeader().GraphOffset)[Graph];
+	}
+
+	/* Returns a node of [Graph], numbered within the graph. */
+	const AUDIO_GRAPH_IMAGE_NODE& GetNode(const AUDIO_GRAPH_IMAGE_GRAPH& Graph, UINT Node) const {
+		return reinterpret_cast<const AUDIO_GRAPH_IMAGE_NODE*>(m_Data + GetHeader().NodeOffset)[Graph.FirstNode + Node];
+	}
+
+	/* Returns an edge of [Graph], numbered within the graph. */
+	const AUDIO_GRAPH_IMAGE_EDGE& GetEdge(const AUDIO_GRAPH_IMAGE_GRAPH& Graph, UINT Edge) const {
+		return reinterpret_cast<const AUDIO_GRAPH_IMAGE_EDGE*>(m_Data + GetHeader().EdgeOffset)[Graph.FirstEdge + Edge];
+	}
+
+	/* Returns the start of an index. */
+	const UINT* GetIndex(UINT Index) const {
+		return reinterpret_cast<const UINT*>(m_Data + GetHeader().IndexOffset) + Index;
+	}
+
+	/* Returns a string from the string table. */
+	LPCSTR GetString(UINT String) const {
+		return reinterpret_cast<LPCSTR>(m_Data + GetHeader().StringOffset) + String;
+	}
+
+	/* Returns the string of a trigger handle. */
+	LPCSTR GetTrigger(UINT Trigger) const {
+		return GetString(GetIndex(GetHeader().TriggerIndex)[Trigger]);
+	}
+
+	/* Returns the trigger handle of a trigger string, or AUDIO_GRAPH_IMAGE_NONE if no edge uses it. */
+	UINT FindTrigger(LPCSTR Trigger) const;
+
+	/* Returns the edge of [Graph] that leaves [Node] on [Trigger], or AUDIO_GRAPH_IMAGE_NONE if there is none.
+	** This doesn't allocate or compare strings, so it's safe on the render thread. */
+	UINT FindTransition(const AUDIO_GRAPH_IMAGE_GRAPH& Graph, UINT Node, UINT Trigger) const {
+		if (Graph.NumTransitions == 0) {
+			return AUDIO_GRAPH_IMAGE_NONE;
+		}
+
+		const AUDIO_GRAPH_IMAGE_TRANSITION* Table = reinterpret_cast<const AUDIO_GRAPH_IMAGE_TRANSITION*>(m_Data + GetHeader().TransitionOffset) + Graph.FirstTransition;
+		UINT Mask = Graph.NumTransitions - 1;
+
+		//Validation guarantees an empty slot, so the probe always ends
+		for (UINT Slot = HashTransition(Node, Trigger) & Mask; ; Slot = (Slot + 1) & Mask) {
+			if (Table[Slot].Edge == AUDIO_GRAPH_IMAGE_NONE) {
+				return AUDIO_GRAPH_IMAGE_NONE;
+			} else if (Table[Slot].Node == Node && Table[Slot].TriggerHandle == Trigger) {
+				return Table[Slot].Edge;
+			}
+		}
+	}
+
+	/* The hash of a transition table key.  CAudioGraphCompiler lays the tables out with it. */
+	static UINT HashTransition(UINT Node, UINT Trigger) {
+		UINT Hash = (Node * 0x9E3779B1u) ^ (Trigger * 0x85EBCA77u);
+		return Hash ^ (Hash >> 15);
+	}
+
+	/* Returns the graph with the given ID, or AUDIO_GRAPH_IMAGE_NONE if there is none. */
+	UINT FindGraph(LPCSTR ID) const;
+
+	/* Returns the node of [Graph] with the given ID, or AUDIO_GRAPH_IMAGE_NONE if there is none. */
+	UINT FindNode(const AUDIO_GRAPH_IMAGE_GRAPH& Graph, LPCSTR ID) const;
+
+	/* Returns the edge of [Graph] with the given ID, or AUDIO_GRAPH_IMAGE_NONE if there is none. */
+	UINT FindEdge(const AUDIO_GRAPH_IMAGE_GRAPH& Graph, LPCSTR ID) const;
+
+private:
+	HANDLE m_FileHandle; //The mapped file, or INVALID_HANDLE_VALUE
+	HANDLE m_Mapping; //The file mapping, or NULL
+	std::vector<BYTE> m_Buffer; //An image compiled in memory
+	const BYTE* m_Data; //The start of the image
+	SIZE_T m_Size; //The size of the image in bytes
+
+	/* Unmaps and frees the image. */
+	VOID Clear();
+
+	/* Checks that every offset, count and reference in the image is within its bounds. */
+	HRESULT Validate();
+
+	/* Checks that [Count] items of [ItemSize] bytes at [Offset] lie within the image. */
+	bool IsInImage(UINT Offset, UINT Count, SIZE_T ItemSize) const {
+		return UINT64(Offset) + UINT64(Count) * UINT64(ItemSize) <= UINT64(m_Size);
+	}
+
+	/* Checks that a string is within the string table. */
+	bool IsString(UINT String) const {
+		return String < GetHeader().StringSize;
+	}
+
+	/* Checks that an index of [Count] entries is within the index array, and that every entry is below [Limit]. */
+	bool IsIndex(UINT Index, UINT Count, UINT Limit) const;
+
+	/* Binary searches an index sorted by ID.  [Record] returns the ID of an entry.  Returns the position of the
+	** matching entry in the index, or AUDIO_GRAPH_IMAGE_NONE if there is none. */
+	template <typename RECORD>
+	UINT Find(UINT Index, UINT Count, LPCSTR ID, RECORD Record) const;
+};
\ No newline at end of file
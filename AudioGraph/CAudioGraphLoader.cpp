@@ -0,0 +1,286 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#include "CAudioGraphLoader.h"
+#include "CAudioGraphNode.h"
+#include "Realtime.h"
+
+#include <mfapi.h>
+#include <avrt.h>
+
+#pragma comment(lib, "avrt.lib")
+
+#define FILENAME L"CAudioGraphLoader.cpp"
+#define EVENT_INIT(x, ManualReset, Line) x = CreateEventW(NULL, ManualReset, FALSE, NULL); if (x == NULL) { m_Callback->OnObjectFailure(FILENAME, Line, HRESULT_FROM_WIN32(GetLastError())); return E_FAIL; }
+#define EVENT_CLEANUP(x) if (x != NULL) { CloseHandle(x); x = NULL; }
+#define CHECK_HR(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return hr; }
+
+CAudioGraphLoader::CAudioGraphLoader() :
+m_RefCount(1),
+m_WorkEvent(NULL),
+m_StreamEvent(NULL),
+m_HaltEvent(NULL),
+m_Thread(NULL),
+m_StreamThread(NULL),
+m_CacheBudget(0),
+m_CacheUsed(0),
+m_PrefetchTime(0),
+m_ReadAhead(0),
+m_Offline(false)
+{
+	InitializeSListHead(&m_Jobs);
+	InitializeSListHead(&m_StreamJobs);
+}
+
+CAudioGraphLoader::~CAudioGraphLoader() {
+	Halt();
+
+	EVENT_CLEANUP(m_WorkEvent);
+	EVENT_CLEANUP(m_StreamEvent);
+	EVENT_CLEANUP(m_HaltEvent);
+}
+
+HRESULT CAudioGraphLoader::Initialize(IAudioGraphCallback* pCallback) {
+	m_Callback = pCallback;
+
+	EVENT_INIT(m_WorkEvent, FALSE, __LINE__);
+	EVENT_INIT(m_StreamEvent, FALSE, __LINE__);
+	EVENT_INIT(m_HaltEvent, TRUE, __LINE__);
+
+	//All decoding happens on a separate thread, away from the render thread
+	m_Thread = CreateThread (
+		NULL,
+		0,
+		StaticLoaderThreadEntry,
+		this,
+		NULL,
+		NULL
+	);
+
+	//If m_Thread is NULL, an error occurred
+	if (m_Thread == NULL) {
+		m_Callback->OnObjectFailure (
+			FILENAME,
+			__LINE__,
+			HRESULT_FROM_WIN32(GetLastError())
+		); return E_FAIL;
+	}
+
+	//Decode rings are topped up on a thread of their own, so a cache being built never holds them up
+	m_StreamThread = CreateThread (
+		NULL,
+		0,
+		StaticStreamThreadEntry,
+		this,
+		NULL,
+		NULL
+	);
+
+	if (m_StreamThread == NULL) {
+		m_Callback->OnObjectFailure (
+			FILENAME,
+			__LINE__,
+			HRESULT_FROM_WIN32(GetLastError())
+		); return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+VOID CAudioGraphLoader::Halt() {
+	if (m_HaltEvent != NULL) {
+		SetEvent(m_HaltEvent);
+	}
+
+	if (m_Thread != NULL) {
+		WaitForSingleObject(m_Thread, INFINITE);
+		CloseHandle(m_Thread);
+		m_Thread = NULL;
+	}
+
+	if (m_StreamThread != NULL) {
+		WaitForSingleObject(m_StreamThread, INFINITE);
+		CloseHandle(m_StreamThread);
+		m_StreamThread = NULL;
+	}
+
+	DiscardJobs(&m_Jobs);
+	DiscardJobs(&m_StreamJobs);
+}
+
+VOID CAudioGraphLoader::DiscardJobs(PSLIST_HEADER pJobs) {
+	//Release any nodes that never had their work executed
+	PSLIST_ENTRY Entry = InterlockedFlushSList(pJobs);
+
+	while (Entry != nullptr) {
+		AUDIO_GRAPH_WORK_ITEM* Item = reinterpret_cast<AUDIO_GRAPH_WORK_ITEM*>(Entry);
+		Entry = Entry->Next;
+
+		InterlockedExchange(&Item->Pending, 0);
+		Item->Node->Release();
+	}
+}
+
+VOID CAudioGraphLoader::Post(CAudioGraphNode* pNode, LONG Work) {
+	const bool Stream = Work == AUDIO_GRAPH_NODE_WORK_STREAM || Work == AUDIO_GRAPH_NODE_WORK_TOUCH;
+	AUDIO_GRAPH_WORK_ITEM* Item = Stream ? pNode->GetStreamItem() : pNode->GetWorkItem();
+
+	//Only the first post pushes the item - later posts just add their flags to it
+	if (InterlockedOr(&Item->Pending, Work) == 0) {
+		pNode->AddRef();
+		InterlockedPushEntrySList(Stream ? &m_StreamJobs : &m_Jobs, &Item->Entry);
+		RealtimeSignalCall();
+		SetEvent(Stream ? m_StreamEvent : m_WorkEvent);
+	}
+}
+
+bool CAudioGraphLoader::ReserveCache(UINT64 Bytes) {
+	LONG64 Used = m_CacheUsed;
+
+	//Retry until the reservation is made without interference from another thread
+	for (;;) {
+		if (UINT64(Used) + Bytes > UINT64(m_CacheBudget)) {
+			return false;
+		}
+
+		LONG64 Previous = InterlockedCompareExchange64 (
+			&m_CacheUsed,
+			Used + LONG64(Bytes),
+			Used
+		);
+
+		if (Previous == Used) {
+			return true;
+		}
+
+		Used = Previous;
+	}
+}
+
+VOID CAudioGraphLoader::ReleaseCache(UINT64 Bytes) {
+	InterlockedExchangeAdd64(&m_CacheUsed, -LONG64(Bytes));
+}
+
+VOID CAudioGraphLoader::ExecuteJobs(PSLIST_HEADER pJobs) {
+	PSLIST_ENTRY Entry = nullptr;
+
+	while ((Entry = InterlockedPopEntrySList(pJobs)) != nullptr) {
+		AUDIO_GRAPH_WORK_ITEM* Item = reinterpret_cast<AUDIO_GRAPH_WORK_ITEM*>(Entry);
+
+		//Clearing the flags before executing lets the node be posted again while it is busy
+		LONG Work = InterlockedExchange(&Item->Pending, 0);
+
+		Item->Node->DoWork(Work);
+		Item->Node->Release();
+	}
+}
+
+DWORD __stdcall CAudioGraphLoader::StaticLoaderThreadEntry(LPVOID Data) {
+	CAudioGraphLoader* l_Loader = reinterpret_cast<CAudioGraphLoader*>(Data);
+
+	return l_Loader->LoaderThreadEntry();
+}
+
+DWORD CAudioGraphLoader::LoaderThreadEntry() {
+	return ServiceJobs(m_WorkEvent, &m_Jobs);
+}
+
+DWORD __stdcall CAudioGraphLoader::StaticStreamThreadEntry(LPVOID Data) {
+	CAudioGraphLoader* l_Loader = reinterpret_cast<CAudioGraphLoader*>(Data);
+
+	return l_Loader->StreamThreadEntry();
+}
+
+DWORD CAudioGraphLoader::StreamThreadEntry() {
+	HRESULT hr = S_OK;
+	DWORD TaskIndex = 0;
+	HANDLE Task = NULL;
+
+	//A ring that isn't topped up in time is heard as a dropout, so MMCSS schedules this thread ahead of ordinary work.
+	//This isn't fatal - without the service it just runs at normal priority.
+	Task = AvSetMmThreadCharacteristicsW (
+		L"Playback",
+		&TaskIndex
+	);
+
+	hr = ServiceJobs(m_StreamEvent, &m_StreamJobs);
+
+	if (Task != NULL) {
+		AvRevertMmThreadCharacteristics(Task);
+	}
+
+	return hr;
+}
+
+HRESULT CAudioGraphLoader::ServiceJobs(HANDLE WorkEvent, PSLIST_HEADER pJobs) {
+	bool run = true;
+	DWORD dwResult = 0;
+	HRESULT hr = S_OK;
+	HANDLE Events[] = {
+		WorkEvent,
+		m_HaltEvent
+	};
+
+	static const DWORD LM_WORK = WAIT_OBJECT_0;
+	static const DWORD LM_CLOSE = WAIT_OBJECT_0 + 1;
+
+	static const UINT nEvents = sizeof(Events) / sizeof(HANDLE);
+
+	//Source readers are free-threaded, so the loader lives in the multithreaded apartment
+	hr = CoInitializeEx (
+		NULL,
+		COINIT_MULTITHREADED
+	); CHECK_HR(__LINE__);
+
+	hr = MFStartup (
+		MF_VERSION
+	); CHECK_HR(__LINE__);
+
+	while (run) {
+		dwResult = WaitForMultipleObjects (
+			nEvents,
+			Events,
+			FALSE,
+			INFINITE
+		);
+
+		switch (dwResult) {
+			case LM_WORK: { //Work has been posted
+				ExecuteJobs(pJobs);
+			} break;
+
+			case LM_CLOSE: { //Close the loader
+				run = false;
+			} break;
+
+			default: { //Error occurred
+				run = false;
+				hr = E_FAIL;
+			} break;
+		}
+	}
+
+	MFShutdown();
+	CoUninitialize();
+
+	return hr;
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <Windows.h>
+
+#include "AudioGraph.h"
+
+class CAudioGraphNode;
+
+/* Work flags that can be posted to the loader for a node. */
+enum AUDIO_GRAPH_NODE_WORK {
+	AUDIO_GRAPH_NODE_WORK_CACHE = 0x1, //Decode the node's segment into its PCM cache
+	AUDIO_GRAPH_NODE_WORK_PREFETCH = 0x2, //Seek the node's source reader ahead of a transition
+	AUDIO_GRAPH_NODE_WORK_STREAM = 0x4, //Top up the node's decode ring - executed on the streaming thread
+	AUDIO_GRAPH_NODE_WORK_TOUCH = 0x8 //Read the node's mapped file into memory ahead of the render thread - executed on the streaming thread
+};
+
+/* A work item is embedded in each node, so posting work never allocates.  The entry
+** must be the first member, since the loader casts popped entries back to the item. */
+struct AUDIO_GRAPH_WORK_ITEM {
+	SLIST_ENTRY Entry; //Link in the loader's lock-free job list
+	CAudioGraphNode* Node; //The node that owns this item
+	volatile LONG Pending; //AUDIO_GRAPH_NODE_WORK flags waiting to be executed
+};
+
+/* CAudioGraphLoader owns the background threads that perform all blocking decode work
+** on behalf of the nodes, as well as the memory budget for decoded PCM caches.  Work is
+** posted through lock-free lists, so it is safe to post from the render thread.  Decode
+** rings are topped up, and mapped files read ahead, on a streaming thread of their own, so
+** that they never wait behind a cache being built. */
+class CAudioGraphLoader {
+public:
+	CAudioGraphLoader();
+
+	~CAudioGraphLoader();
+
+	ULONG AddRef() {
+		return InterlockedIncrement(&m_RefCount);
+	}
+
+	ULONG Release() {
+		ULONG RefCount = InterlockedDecrement(&m_RefCount);
+
+		if (RefCount == 0) {
+			delete this;
+		}
+
+		return RefCount;
+	}
+
+	/* Creates the loader thread. */
+	HRESULT Initialize(IAudioGraphCallback* pCallback);
+
+	/* Stops the loader thread and releases any nodes still waiting for work. */
+	VOID Halt();
+
+	/* Posts work for a node.  The node is kept alive until the work has been executed.  AUDIO_GRAPH_NODE_WORK_STREAM
+	** and AUDIO_GRAPH_NODE_WORK_TOUCH go to the streaming thread, and must each be posted on their own. */
+	VOID Post(CAudioGraphNode* pNode, LONG Work);
+
+	/* Sets the maximum number of bytes that may be used by decoded PCM caches. */
+	VOID SetCacheBudget(UINT64 Bytes) {
+		InterlockedExchange64((volatile LONG64*)(&m_CacheBudget), LONG64(Bytes));
+	}
+
+	/* Returns the maximum number of bytes that may be used by decoded PCM caches. */
+	UINT64 GetCacheBudget() {
+		return UINT64(m_CacheBudget);
+	}
+
+	/* Sets how long before the end of a node its transition targets are prefetched.  0 disables prefetching. */
+	VOID SetPrefetchTime(UINT Milliseconds) {
+		InterlockedExchange(&m_PrefetchTime, LONG(Milliseconds));
+	}
+
+	/* Returns how long before the end of a node its transition targets are prefetched. */
+	UINT GetPrefetchTime() {
+		return UINT(m_PrefetchTime);
+	}
+
+	/* Sets how much decoded audio streamed nodes keep ready ahead of the render thread.  0 disables decode rings. */
+	VOID SetReadAhead(UINT Milliseconds) {
+		InterlockedExchange(&m_ReadAhead, LONG(Milliseconds));
+	}
+
+	/* Returns how much decoded audio streamed nodes keep ready ahead of the render thread. */
+	UINT GetReadAhead() {
+		return UINT(m_ReadAhead);
+	}
+
+	/* Marks the loader as serving an offline render.  Only called before any node is set up. */
+	VOID SetOffline(bool Offline) {
+		m_Offline = Offline;
+	}
+
+	/* Returns whether the loader serves an offline render.  An offline render has to come out the same every time,
+	** so its nodes never play silence while background work catches up - they read on the render thread instead. */
+	bool IsOffline() {
+		return m_Offline;
+	}
+
+	/* Reserves memory from the cache budget.  Returns false if the budget would be exceeded. */
+	bool ReserveCache(UINT64 Bytes);
+
+	/* Returns memory previously reserved with ReserveCache() to the budget. */
+	VOID ReleaseCache(UINT64 Bytes);
+
+private:
+	long m_RefCount;
+
+	CComPtr<IAudioGraphCallback> m_Callback; //Used for error reporting
+
+	DECLSPEC_ALIGN(MEMORY_ALLOCATION_ALIGNMENT) SLIST_HEADER m_Jobs; //Nodes with pending work
+	DECLSPEC_ALIGN(MEMORY_ALLOCATION_ALIGNMENT) SLIST_HEADER m_StreamJobs; //Nodes whose decode rings need topping up
+
+	HANDLE m_WorkEvent; //Signalled whenever work is posted
+	HANDLE m_StreamEvent; //Signalled whenever streaming work is posted
+	HANDLE m_HaltEvent; //Used for closing the threads - manual reset, so that it wakes both of them
+	HANDLE m_Thread; //Handle to the loader thread
+	HANDLE m_StreamThread; //Handle to the streaming thread
+
+	volatile LONG64 m_CacheBudget; //Maximum bytes for decoded PCM caches
+	volatile LONG64 m_CacheUsed; //Bytes currently reserved by decoded PCM caches
+	volatile LONG m_PrefetchTime; //Prefetch look-ahead in milliseconds
+	volatile LONG m_ReadAhead; //Decode ring depth in milliseconds
+	bool m_Offline; //Whether the loader serves an offline render
+
+	/* Executes all work currently in a job list. */
+	VOID ExecuteJobs(PSLIST_HEADER pJobs);
+
+	/* Releases the nodes in a job list that never had their work executed. */
+	VOID DiscardJobs(PSLIST_HEADER pJobs);
+
+	/* The static thread entry point */
+	static DWORD __stdcall StaticLoaderThreadEntry(LPVOID Data);
+
+	/* The non-static thread entry point, called by StaticLoaderThreadEntry() */
+	DWORD LoaderThreadEntry();
+
+	/* The static streaming thread entry point */
+	static DWORD __stdcall StaticStreamThreadEntry(LPVOID Data);
+
+	/* The non-static streaming thread entry point, called by StaticStreamThreadEntry() */
+	DWORD StreamThreadEntry();
+
+	/* Waits on [WorkEvent] and the halt event, executing [pJobs] whenever work is posted, until the loader halts. */
+	HRESULT ServiceJobs(HANDLE WorkEvent, PSLIST_HEADER pJobs);
+};
\ No newline at end of file
@@ -24,193 +24,453 @@
 #include "CAudioGraph.h"
 #include "CAudioGraphFile.h"
 #include "CAudioGraphEdge.h"
+#include "Realtime.h"
 
 #include <algorithm>
 #include <propvarutil.h>
 
 #define FILENAME L"CAudioGraphNode.cpp"
-#define CHECK_HR(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return; }
-#define CHECK_HR2(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return Written; }
+#define CHECK_HR(Line) if (FAILED(hr)) { RealtimeReportFailure(m_Callback, FILENAME, Line, hr); return; }
+#define CHECK_HR2(Line) if (FAILED(hr)) { RealtimeReportFailure(m_Callback, FILENAME, Line, hr); return Written; }
+#define RETURN_HR(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return hr; }
 
-CAudioGraphNode::CAudioGraphNode() : m_RefCount(1) { }
+CAudioGraphNode::CAudioGraphNode() :
+m_Graph(nullptr),
+m_File(nullptr),
+m_ID(""),
+m_AudioFilename(""),
+m_StyleString(""),
+m_Edges(nullptr),
+m_EdgeList(nullptr),
+m_NumEdges(0),
+m_DefaultEdge(nullptr),
+m_SampleOffset(0),
+m_SampleDuration(0),
+m_FileRate(44100),
+m_SampleRate(44100),
+m_FrameOffset(0),
+m_FrameDuration(0),
+m_SamplePosition(0),
+m_Channels(2),
+m_LeadTime(0),
+m_TailTime(0),
+m_LeadFrames(0),
+m_TailFrames(0),
+m_IsTerminal(false),
+m_CacheEnabled(true),
+m_CacheState(AUDIO_GRAPH_NODE_CACHE_NONE),
+m_PrefetchState(AUDIO_GRAPH_NODE_PREFETCH_IDLE),
+m_CacheFrames(0),
+m_CacheBytes(0),
+m_Streaming(false),
+m_PassFrames(0),
+m_DecodePosition(0),
+m_DecodeRestart(true),
+m_DecodeDone(false),
+m_RingPosition(0),
+m_AwaitingPrefetch(false),
+m_TouchStart(0),
+m_TouchEnd(0),
+m_TouchFrame(0)
+{
+	ZeroMemory(&m_WorkItem, sizeof(m_WorkItem));
+	m_WorkItem.Node = this;
 
-CAudioGraphNode::~CAudioGraphNode() { }
+	ZeroMemory(&m_StreamItem, sizeof(m_StreamItem));
+	m_StreamItem.Node = this;
 
-HRESULT CAudioGraphNode::Initialize (
+	InitializeSRWLock(&m_StreamLock);
+}
+
+CAudioGraphNode::~CAudioGraphNode() {
+	//The loader holds a reference while it works, so the cache can't be building here
+	if (m_CacheBytes > 0) {
+		m_Loader->ReleaseCache(m_CacheBytes);
+		m_CacheBytes = 0;
+	}
+}
+
+ULONG STDMETHODCALLTYPE CAudioGraphNode::AddRef() {
+	return m_Graph->AddRef();
+}
+
+ULONG STDMETHODCALLTYPE CAudioGraphNode::Release() {
+	return m_Graph->Release();
+}
+
+VOID CAudioGraphNode::Initialize (
 	IAudioGraphCallback* pCallback,
 	CAudioGraphFile* pFile,
 	CAudioGraph* pGraph,
-	std::string& Style
+	const CAudioGraphImage& Image,
+	const AUDIO_GRAPH_IMAGE_NODE& Record,
+	CAudioGraphEdge* pEdges
 ) {
 	m_Callback = pCallback;
 	m_File = pFile;
 	m_Graph = pGraph;
-	m_StyleString = Style;
-
-	// Parse style string
-
-	static const auto attribute = [&Style](LPCSTR attribute) {
-		size_t off = Style.find(attribute, 0);
-		size_t start = off + 4 + strlen(attribute);
-		size_t end = Style.find("\"", start);
-		size_t length = end - start;
-		return Style.substr(start, length);
-	};
-
-	m_ID = attribute("id");
-	m_AudioFilename = attribute("filename");
-	std::string sampleOffsetString = attribute("offset");
-	std::string sampleDurationString = attribute("duration");
-	std::string terminalString = attribute("terminal");
-
-	// All of these attributes must be defined.
-	if (m_ID == "" || m_AudioFilename == "" || sampleOffsetString == "" || sampleDurationString == "") {
-		return E_INVALIDARG;
-	}
-
-	// Terminal does not need to be defined, but if defined must have a valid value
-	if (terminalString == "" || terminalString == "false") {
-		m_IsTerminal = false;
-	} else if (terminalString == "true") {
-		m_IsTerminal = true;
+
+	// The compiler has already checked the attributes, so they can be taken as they are
+	m_ID = Image.GetString(Record.ID);
+	m_AudioFilename = Image.GetString(Record.Filename);
+	m_StyleString = Image.GetString(Record.Style);
+	m_SampleOffset = Record.Offset;
+	m_SampleDuration = Record.Duration;
+	m_IsTerminal = (Record.Flags & AUDIO_GRAPH_IMAGE_NODE_TERMINAL) != 0;
+	m_CacheEnabled = (Record.Flags & AUDIO_GRAPH_IMAGE_NODE_CACHE) != 0;
+
+	m_Edges = pEdges;
+	m_EdgeList = Image.GetIndex(Record.EdgeList);
+	m_NumEdges = Record.NumEdges;
+	m_DefaultEdge = Record.DefaultEdge != AUDIO_GRAPH_IMAGE_NONE ? &pEdges[Record.DefaultEdge] : nullptr;
+}
+
+VOID CAudioGraphNode::Setup(IMFMediaType* pMediaType, CAudioGraphLoader* pLoader) {
+	HRESULT hr = S_OK;
+
+	m_Loader = pLoader;
+	m_Channels = MFGetAttributeUINT32(pMediaType, MF_MT_AUDIO_NUM_CHANNELS, 2);
+	m_SampleRate = MFGetAttributeUINT32(pMediaType, MF_MT_AUDIO_SAMPLES_PER_SECOND, 44100);
+
+	// A built-in decoder opens in a fraction of the time a source reader takes, and seeks exactly.
+	// Whatever it can't decode as it is goes to Media Foundation instead.
+	hr = CAudioGraphDecoder::Create (
+		GetWideFilename().c_str(),
+		m_SampleRate,
+		m_Channels,
+		&m_Decoder
+	);
+
+	if (SUCCEEDED(hr)) {
+		m_FileRate = m_Decoder->GetFileRate();
 	} else {
-		return E_INVALIDARG;
+		hr = CreateReader (
+			pMediaType,
+			&m_Reader
+		); if (FAILED(hr)) return; //Already reported by CreateReader()
+
+		hr = m_Reader->GetCurrentMediaType (
+			MF_SOURCE_READER_FIRST_AUDIO_STREAM,
+			&m_MediaType
+		); CHECK_HR(__LINE__);
+
+		CComPtr<IMFMediaType> NativeType;
+
+		hr = m_Reader->GetNativeMediaType (
+			MF_SOURCE_READER_FIRST_AUDIO_STREAM,
+			0,
+			&NativeType
+		); CHECK_HR(__LINE__);
+
+		m_FileRate = MFGetAttributeUINT32(NativeType, MF_MT_AUDIO_SAMPLES_PER_SECOND, m_SampleRate);
 	}
 
-	try {
-		m_SampleOffset = std::atoi(sampleOffsetString.c_str());
-		m_SampleDuration = std::atoi(sampleDurationString.c_str());
-	} catch (...) {
-		return E_INVALIDARG;
+	// The segment is given in samples of the file, but played in frames of the stream
+	m_FrameOffset = GetFramesFromSamples(m_SampleOffset);
+	m_FrameDuration = GetFramesFromSamples(m_SampleDuration);
+
+	// The lead can't reach back past the start of the file
+	m_LeadFrames = std::min(UINT64(m_LeadTime) * m_SampleRate / 1000, m_FrameOffset);
+	m_TailFrames = UINT64(m_TailTime) * m_SampleRate / 1000;
+
+	// Queue the segment to be decoded in the background, unless it already has been.
+	// If there is no budget, the node is simply streamed.
+	if (m_CacheEnabled && m_Loader->GetCacheBudget() > 0) {
+		if (InterlockedCompareExchange(&m_CacheState, AUDIO_GRAPH_NODE_CACHE_QUEUED, AUDIO_GRAPH_NODE_CACHE_NONE) == AUDIO_GRAPH_NODE_CACHE_NONE) {
+			m_CacheMediaType = pMediaType;
+			m_Loader->Post(this, AUDIO_GRAPH_NODE_WORK_CACHE);
+		}
 	}
 
-	return S_OK;
-}
+	// With a read-ahead, the source reader is handed to the streaming thread, and the render thread only ever
+	// copies decoded frames out of the ring.  A node that's already cached has no use for one.  An offline render
+	// runs faster than the streaming thread can be relied on to keep up, and a dry ring would leave dropouts that
+	// change from one render to the next, so it reads on the render thread instead.
+	const UINT ReadAhead = m_Loader->GetReadAhead();
 
-VOID CAudioGraphNode::Setup(IMFMediaType* pMediaType) {
-	HRESULT hr = S_OK;
+	if (ReadAhead > 0 && !IsCached() && !m_Loader->IsOffline()) {
+		AcquireSRWLockExclusive(&m_StreamLock);
+
+		// The ring also has room for the lead and tail, which are skipped whenever a pass isn't played in full
+		m_Ring.Allocate(UINT(UINT64(ReadAhead) * m_SampleRate / 1000 + m_LeadFrames + m_TailFrames), m_Channels);
+		m_PassFrames = LONG64(GetCacheLength());
+		m_RingPosition = 0;
+		m_DecodeRestart = true;
+		m_DecodeDone = false;
+		m_Streaming = true;
 
+		// Blocking is fine here, so the ring starts out full and the node can play straight away
+		DecodeRing();
+
+		ReleaseSRWLockExclusive(&m_StreamLock);
+	}
+}
+
+std::wstring CAudioGraphNode::GetWideFilename() {
 	// Source: http://stackoverflow.com/questions/10737644/convert-const-char-to-wstring
 
-	int size_needed = MultiByteToWideChar(CP_UTF8, 0, m_AudioFilename.c_str(), m_AudioFilename.size(), NULL, 0);
+	int size_needed = MultiByteToWideChar(CP_UTF8, 0, m_AudioFilename, int(strlen(m_AudioFilename)), NULL, 0);
 	std::wstring wFilename(size_needed, 0);
-	MultiByteToWideChar(CP_UTF8, 0, m_AudioFilename.c_str(), m_AudioFilename.size(), &wFilename[0], size_needed);
+	MultiByteToWideChar(CP_UTF8, 0, m_AudioFilename, int(strlen(m_AudioFilename)), &wFilename[0], size_needed);
+
+	return wFilename;
+}
+
+HRESULT CAudioGraphNode::CreateReader(IMFMediaType* pMediaType, IMFSourceReader** ppReader) {
+	HRESULT hr = S_OK;
+	CComPtr<IMFSourceReader> Reader;
+	std::wstring wFilename = GetWideFilename();
 
 	hr = MFCreateSourceReaderFromURL (
 		wFilename.c_str(),
 		nullptr,
-		&m_Reader
-	); CHECK_HR(__LINE__);
+		&Reader
+	); RETURN_HR(__LINE__);
 
-	hr = m_Reader->SetStreamSelection (
+	hr = Reader->SetStreamSelection (
 		MF_SOURCE_READER_ALL_STREAMS,
 		FALSE
-	); CHECK_HR(__LINE__);
+	); RETURN_HR(__LINE__);
 
-	hr = m_Reader->SetStreamSelection (
+	hr = Reader->SetStreamSelection (
 		MF_SOURCE_READER_FIRST_AUDIO_STREAM,
 		TRUE
-	); CHECK_HR(__LINE__);
+	); RETURN_HR(__LINE__);
 
-	hr = m_Reader->SetCurrentMediaType (
+	hr = Reader->SetCurrentMediaType (
 		MF_SOURCE_READER_FIRST_AUDIO_STREAM,
 		NULL,
 		pMediaType
-	); CHECK_HR(__LINE__);
-
-	hr = m_Reader->GetCurrentMediaType (
-		MF_SOURCE_READER_FIRST_AUDIO_STREAM,
-		&m_MediaType
-	); CHECK_HR(__LINE__);
+	); RETURN_HR(__LINE__);
 
 	// MSDN Example says to call this again:
 	// https://msdn.microsoft.com/en-us/library/windows/desktop/dd757929(v=vs.85).aspx
-	hr = m_Reader->SetStreamSelection (
+	hr = Reader->SetStreamSelection (
 		MF_SOURCE_READER_FIRST_AUDIO_STREAM,
 		TRUE
+	); RETURN_HR(__LINE__);
+
+	*ppReader = Reader.Detach();
+
+	return S_OK;
+}
+
+VOID CAudioGraphNode::WarmDecoder() {
+	HRESULT hr = S_OK;
+
+	if (m_Decoder == nullptr || IsCached() || m_Streaming) {
+		return;
+	}
+
+	m_TouchStart = GetCacheStart();
+	m_TouchEnd = std::min(GetTouchFrames(), GetCacheLength()) + m_TouchStart;
+
+	hr = m_Decoder->Touch (
+		m_TouchStart,
+		m_TouchEnd - m_TouchStart
 	); CHECK_HR(__LINE__);
 }
 
 VOID CAudioGraphNode::Flush() {
+	// The loader may still be using the source reader
+	SettlePrefetch();
+	m_AwaitingPrefetch = false;
+
+	// ...as may the streaming thread
+	AcquireSRWLockExclusive(&m_StreamLock);
+
+	m_Streaming = false;
+	m_TouchStart = 0;
+	m_TouchEnd = 0;
+	m_Ring.Free();
 	m_Sample.Release();
 	m_Reader.Release();
+	m_Decoder.Release();
 	m_MediaType.Release();
+
+	ReleaseSRWLockExclusive(&m_StreamLock);
 }
 
-#include <iostream>
+UINT CAudioGraphNode::Process(FLOAT* OutputBuffer, UINT BufferFrames, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters) {
+	const UINT64 EndFrame = m_FrameOffset + m_FrameDuration;
 
-UINT CAudioGraphNode::Process(FLOAT* OutputBuffer, UINT BufferFrames) {
+	// Once the segment has been decoded in the background, it is served straight from memory
+	if (IsCached()) {
+		return ProcessCache(OutputBuffer, BufferFrames, EndFrame);
+	}
+
+	if (m_Streaming) {
+		return ProcessRing(OutputBuffer, BufferFrames, EndFrame, Counters);
+	}
+
+	if (!ReclaimReader()) {
+		return ProcessSilence(OutputBuffer, BufferFrames, EndFrame);
+	}
+
+	return ProcessReader(OutputBuffer, BufferFrames, EndFrame);
+}
+
+UINT CAudioGraphNode::ProcessSilence(FLOAT* OutputBuffer, UINT BufferFrames, UINT64 EndFrame) {
+	// The node's timeline moves on as if the frames had been played, so it still ends on time
+	const UINT Written = m_SamplePosition < EndFrame ? UINT(std::min(UINT64(BufferFrames), EndFrame - m_SamplePosition)) : 0;
+
+	ZeroMemory(OutputBuffer, Written * sizeof(FLOAT) * m_Channels);
+
+	m_SamplePosition += Written;
+
+	return Written;
+}
+
+VOID CAudioGraphNode::ReadTail(UINT64 Position, FLOAT* OutputBuffer, UINT BufferFrames, bool FromCache, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters) {
+	const UINT64 EndFrame = m_FrameOffset + m_FrameDuration;
+	UINT Written = 0;
+
+	if (FromCache) {
+		const UINT64 First = EndFrame - GetCacheStart() + Position;
+
+		if (First < m_CacheFrames) {
+			Written = UINT(std::min(UINT64(BufferFrames), m_CacheFrames - First));
+
+			memcpy (
+				OutputBuffer,
+				&m_Cache[First * m_Channels],
+				Written * sizeof(FLOAT) * m_Channels
+			);
+		}
+	} else if (m_Streaming) {
+		Written = ProcessRing(OutputBuffer, BufferFrames, EndFrame + m_TailFrames, Counters);
+	} else if (!ReclaimReader()) {
+		Written = ProcessSilence(OutputBuffer, BufferFrames, EndFrame + m_TailFrames);
+	} else {
+		Written = ProcessReader(OutputBuffer, BufferFrames, EndFrame + m_TailFrames);
+	}
+
+	ZeroMemory(OutputBuffer + Written * m_Channels, (BufferFrames - Written) * sizeof(FLOAT) * m_Channels);
+}
+
+UINT CAudioGraphNode::ReadFrames(FLOAT* OutputBuffer, UINT BufferFrames, UINT64& Position, UINT64 EndFrame) {
 	HRESULT hr = S_OK;
-	bool done = false;
 	UINT Written = 0;
-	LONGLONG BufferDuration = (LONGLONG)((FLOAT(BufferFrames) / FLOAT(44100)) * 1.0E7f);
 
-	while (BufferFrames > 0 && !done && m_SamplePosition < m_SampleOffset + m_SampleDuration) {
+	// A built-in decoder seeks exactly, so it just has to be moved whenever the node jumped
+	if (m_Decoder != nullptr) {
+		if (Position >= EndFrame) {
+			return 0;
+		}
+
+		if (m_Decoder->GetPosition() != Position) {
+			hr = m_Decoder->Seek (
+				Position
+			); CHECK_HR2(__LINE__);
+		}
+
+		hr = m_Decoder->Read (
+			OutputBuffer,
+			UINT(std::min(UINT64(BufferFrames), EndFrame - Position)),
+			&Written
+		); CHECK_HR2(__LINE__);
+
+		Position += Written;
+
+		return Written;
+	}
+
+	// A null sample means the file ended before the segment did
+	while (BufferFrames > 0 && Position < EndFrame && m_Sample != nullptr) {
 		CComPtr<IMFMediaBuffer> Buffer;
+		DWORD BufferCount = 0;
 		DWORD BufferLength = 0;
 		BYTE* pByteBuffer = nullptr;
-		LONGLONG SamplePosition = (LONGLONG)(GetTimePosition() * 1.0E7f);
-		LONGLONG EndPosition = (LONGLONG)((GetTimeOffset() + GetTimeDuration()) * 1.0E7f);
 		LONGLONG SampleTime = 0;
-		LONGLONG SampleDuration = 0;
-		LONGLONG TimeSkip = 0;
-		LONGLONG TimeTruncate = 0;
 		UINT SampleSkip = 0;
-		UINT SampleTruncate = 0;
 		UINT SampleRead = 0;
 
 		hr = m_Sample->GetSampleTime (
 			&SampleTime
 		); CHECK_HR2(__LINE__);
 
-		m_Sample->GetSampleDuration (
-			&SampleDuration
+		hr = m_Sample->GetBufferCount (
+			&BufferCount
 		); CHECK_HR2(__LINE__);
 
-		hr = m_Sample->ConvertToContiguousBuffer (
-			&Buffer
-		); CHECK_HR2(__LINE__);
+		// Decoded audio practically always comes in a single buffer, which is used directly.
+		// Only a sample split across buffers needs the copy ConvertToContiguousBuffer() makes.
+		if (BufferCount == 1) {
+			RealtimeBlockingCall();
+
+			hr = m_Sample->GetBufferByIndex (
+				0,
+				&Buffer
+			); CHECK_HR2(__LINE__);
+		} else {
+			RealtimeBlockingCall();
+
+			hr = m_Sample->ConvertToContiguousBuffer (
+				&Buffer
+			); CHECK_HR2(__LINE__);
+		}
 
 		hr = Buffer->GetCurrentLength (
 			&BufferLength
 		); CHECK_HR2(__LINE__);
 
-		TimeSkip = SamplePosition - SampleTime;
-		TimeTruncate = (SamplePosition + BufferDuration > EndPosition) ? (SamplePosition + BufferDuration - EndPosition) : 0;
-		SampleSkip = (TimeSkip / 10000000) * 44100;
-		SampleTruncate = (TimeTruncate / 10000000) * 44100;
-		SampleRead = BufferFrames - SampleTruncate;
+		// The position is kept in frames, and the sample's time is only used to find the frame it
+		// starts on, so rounding never accumulates however long the node loops for
+		const LONGLONG FirstFrame = GetFrameAtTime(SampleTime);
+		const UINT SampleFrames = BufferLength / (sizeof(FLOAT) * m_Channels);
+		const UINT Available = UINT(std::min(UINT64(BufferFrames), EndFrame - Position));
 
-		hr = Buffer->Lock (
-			&pByteBuffer,
-			nullptr,
-			nullptr
-		); CHECK_HR2(__LINE__);
+		// If the file has a gap before this sample, the gap plays as silence
+		if (FirstFrame > LONGLONG(Position)) {
+			UINT Gap = UINT(std::min(UINT64(FirstFrame - LONGLONG(Position)), UINT64(Available)));
 
-		pByteBuffer += SampleSkip * sizeof(FLOAT) * 2;
+			ZeroMemory(OutputBuffer, Gap * sizeof(FLOAT) * m_Channels);
 
-		memcpy_s (
-			OutputBuffer,
-			BufferFrames * sizeof(FLOAT) * 2,
-			pByteBuffer,
-			SampleRead * sizeof(FLOAT) * 2
-		);
+			OutputBuffer += Gap * m_Channels;
+			BufferFrames -= Gap;
+			Written += Gap;
+			Position += Gap;
+			continue;
+		}
 
-		hr = Buffer->Unlock();
-		CHECK_HR2(__LINE__);
+		SampleSkip = UINT(std::min(UINT64(LONGLONG(Position) - FirstFrame), UINT64(SampleFrames)));
+		SampleRead = std::min(SampleFrames - SampleSkip, Available);
+
+		if (SampleRead > 0) {
+			RealtimeBlockingCall();
+
+			hr = Buffer->Lock (
+				&pByteBuffer,
+				nullptr,
+				nullptr
+			); CHECK_HR2(__LINE__);
+
+			memcpy (
+				OutputBuffer,
+				pByteBuffer + SampleSkip * sizeof(FLOAT) * m_Channels,
+				SampleRead * sizeof(FLOAT) * m_Channels
+			);
 
-		OutputBuffer += SampleRead * 2;
-		BufferFrames -= SampleRead;
-		Written += SampleRead;
-		m_SamplePosition += SampleRead;
+			RealtimeBlockingCall();
 
-		if (SampleTruncate > 0) {
-			done = true;
-		} else if (BufferFrames > 0) {
+			hr = Buffer->Unlock();
+			CHECK_HR2(__LINE__);
+
+			OutputBuffer += SampleRead * m_Channels;
+			BufferFrames -= SampleRead;
+			Written += SampleRead;
+			Position += SampleRead;
+		}
+
+		// Read the next sample once this one has been used up
+		if (SampleSkip + SampleRead == SampleFrames && BufferFrames > 0 && Position < EndFrame) {
 			DWORD dwFlags = 0;
 
-			// Read next sample
-			m_Reader->ReadSample (
+			m_Sample.Release();
+
+			RealtimeBlockingCall();
+
+			hr = m_Reader->ReadSample (
 				MF_SOURCE_READER_FIRST_AUDIO_STREAM,
 				NULL,
 				NULL,
@@ -224,19 +484,95 @@ UINT CAudioGraphNode::Process(FLOAT* OutputBuffer, UINT BufferFrames) {
 	return Written;
 }
 
+UINT CAudioGraphNode::ProcessRing(FLOAT* OutputBuffer, UINT BufferFrames, UINT64 EndFrame, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters) {
+	const UINT64 Start = GetCacheStart();
+	const UINT64 End = std::min(EndFrame, Start + UINT64(m_PassFrames));
+	const UINT Wanted = m_SamplePosition < End ? UINT(std::min(UINT64(BufferFrames), End - m_SamplePosition)) : 0;
+	const FLOAT* Span = nullptr;
+	UINT Available = 0;
+	UINT Written = 0;
+
+	while (Written < Wanted && (Available = m_Ring.BeginRead(Span)) > 0) {
+		// Reading the pass length after the frames are visible means it matches them, even if the file just ended
+		const UINT64 PassFrames = UINT64(m_PassFrames);
+		const UINT64 Target = m_SamplePosition - Start;
+		UINT Frames = 0;
+
+		if (Target >= PassFrames) {
+			break;
+		}
+
+		if (m_RingPosition >= PassFrames) {
+			// The next frame in the ring starts a new pass
+			m_RingPosition = 0;
+			continue;
+		}
+
+		if (m_RingPosition < Target) {
+			// A seek or a dropout moved the node on - drop the frames in between
+			Frames = UINT(std::min(UINT64(Available), Target - m_RingPosition));
+			m_Ring.EndRead(Frames);
+			m_RingPosition += Frames;
+			continue;
+		}
+
+		if (m_RingPosition > Target) {
+			// A seek moved the node back, so it picks up from the next pass
+			Frames = UINT(std::min(UINT64(Available), PassFrames - m_RingPosition));
+			m_Ring.EndRead(Frames);
+			m_RingPosition += Frames;
+			continue;
+		}
+
+		Frames = UINT(std::min(UINT64(std::min(Available, Wanted - Written)), PassFrames - m_RingPosition));
+
+		memcpy (
+			OutputBuffer,
+			Span,
+			Frames * sizeof(FLOAT) * m_Channels
+		);
+
+		m_Ring.EndRead(Frames);
+
+		OutputBuffer += Frames * m_Channels;
+		Written += Frames;
+		m_RingPosition += Frames;
+		m_SamplePosition += Frames;
+	}
+
+	// The streaming thread has fallen behind.  The node keeps time with silence, and the frames
+	// it missed are dropped when they arrive.
+	if (Written < Wanted && m_SamplePosition < Start + UINT64(m_PassFrames)) {
+		const UINT Missing = UINT(std::min(UINT64(Wanted - Written), Start + UINT64(m_PassFrames) - m_SamplePosition));
+
+		ZeroMemory(OutputBuffer, Missing * sizeof(FLOAT) * m_Channels);
+
+		Written += Missing;
+		m_SamplePosition += Missing;
+		InterlockedIncrement64(&Counters.DecodeUnderruns);
+	}
+
+	// Waking the streaming thread once the ring is half empty lets it decode in large batches
+	if (m_Ring.GetFill() < m_Ring.GetCapacity() / 2) {
+		m_Loader->Post(this, AUDIO_GRAPH_NODE_WORK_STREAM);
+	}
+
+	return Written;
+}
+
 VOID CAudioGraphNode::EnumEdge(UINT EdgeNum, IAudioGraphEdge** ppEdge) {
 	if (ppEdge == nullptr) {
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
 		return;
 	}
 
-	try {
-		*ppEdge = m_EdgeEnum.at(EdgeNum);
-	} catch (...) {
+	if (EdgeNum >= m_NumEdges) {
 		*ppEdge = nullptr;
 		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
 		return;
 	}
+
+	*ppEdge = &m_Edges[m_EdgeList[EdgeNum]];
 }
 
 VOID CAudioGraphNode::GetEdgeByID(LPCSTR ID, IAudioGraphEdge** ppEdge) {
@@ -245,15 +581,27 @@ VOID CAudioGraphNode::GetEdgeByID(LPCSTR ID, IAudioGraphEdge** ppEdge) {
 		return;
 	}
 
-	std::string stringID = ID;
+	// A node only has a handful of edges, so a scan beats a search.  A later edge with the same ID wins, as it always has.
+	for (UINT i = m_NumEdges; i > 0; i--) {
+		CAudioGraphEdge* Edge = &m_Edges[m_EdgeList[i - 1]];
 
-	try {
-		*ppEdge = m_EdgeMap.at(stringID);
-	} catch (...) {
-		*ppEdge = nullptr;
-		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
+		if (ID != nullptr && strcmp(Edge->GetID(), ID) == 0) {
+			*ppEdge = Edge;
+			return;
+		}
+	}
+
+	*ppEdge = nullptr;
+	m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
+}
+
+VOID CAudioGraphNode::GetDefaultEdge(IAudioGraphEdge** ppEdge) {
+	if (ppEdge == nullptr) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
 		return;
 	}
+
+	*ppEdge = m_DefaultEdge;
 }
 
 VOID CAudioGraphNode::GetGraph(IAudioGraph** ppAudioGraph) {
@@ -274,19 +622,69 @@ VOID CAudioGraphNode::GetAudioGraphFile(IAudioGraphFile** ppAudioGraphFile) {
 	*ppAudioGraphFile = m_File;
 }
 
-VOID CAudioGraphNode::Seek() {
+bool CAudioGraphNode::Seek(UINT64 Preroll) {
+	m_SamplePosition = m_FrameOffset - std::min(Preroll, m_LeadFrames);
+	m_AwaitingPrefetch = false;
+
+	// A cached node never needs to touch its source reader again
+	if (IsCached()) {
+		ReclaimPrefetch();
+		return false;
+	}
+
+	// The streaming thread decodes the segment over and over, so the ring just moves on to the next pass
+	if (m_Streaming) {
+		return false;
+	}
+
+	// A built-in decoder is moved to the new position by the next read, which only waits on the disk if that
+	// part of the file wasn't read into memory ahead of time
+	if (m_Decoder != nullptr) {
+		return m_SamplePosition < m_TouchStart || m_SamplePosition >= m_TouchEnd;
+	}
+
+	switch (ReclaimPrefetch()) {
+		// If the loader already positioned the source reader, there's nothing left to do
+		case AUDIO_GRAPH_NODE_PREFETCH_PRIMED: {
+			return false;
+		} break;
+
+		// The render thread can't wait for the loader to finish, so the node plays silence until it has
+		case AUDIO_GRAPH_NODE_PREFETCH_WARMING: {
+			m_AwaitingPrefetch = true;
+			return true;
+		} break;
+	}
+
+	SeekReader();
+
+	return true;
+}
+
+VOID CAudioGraphNode::SeekReader() {
 	HRESULT hr = S_OK;
 	DWORD dwFlags = 0;
 	LONGLONG SampleTime = 0;
 	LONGLONG SampleDuration = 0;
-	LONGLONG DesiredTime = (LONGLONG)(GetTimeOffset() * 1.0E7f); //100-nanosecond units
+	LONGLONG DesiredTime = GetStartTime(); //100-nanosecond units
 	PROPVARIANT prop;
 
+	// A built-in decoder lands on the exact frame, so there's nothing to read forward to
+	if (m_Decoder != nullptr) {
+		hr = m_Decoder->Seek (
+			GetCacheStart()
+		); CHECK_HR(__LINE__);
+
+		return;
+	}
+
 	hr = InitPropVariantFromInt64 (
 		DesiredTime,
 		&prop
 	); CHECK_HR(__LINE__);
 
+	RealtimeBlockingCall();
+
 	hr = m_Reader->SetCurrentPosition (
 		GUID_NULL,
 		prop
@@ -297,7 +695,11 @@ VOID CAudioGraphNode::Seek() {
 	); CHECK_HR(__LINE__);
 
 	do {
-		m_Reader->ReadSample (
+		m_Sample.Release();
+
+		RealtimeBlockingCall();
+
+		hr = m_Reader->ReadSample (
 			MF_SOURCE_READER_FIRST_AUDIO_STREAM,
 			NULL,
 			NULL,
@@ -306,6 +708,11 @@ VOID CAudioGraphNode::Seek() {
 			&m_Sample
 		); CHECK_HR(__LINE__);
 
+		// The file ended before the segment started, so the node plays nothing
+		if (m_Sample == nullptr) {
+			return;
+		}
+
 		hr = m_Sample->GetSampleTime (
 			&SampleTime
 		); CHECK_HR(__LINE__);
@@ -314,14 +721,392 @@ VOID CAudioGraphNode::Seek() {
 			&SampleDuration
 		); CHECK_HR(__LINE__);
 	} while (SampleTime + SampleDuration < DesiredTime);
+}
+
+UINT CAudioGraphNode::PrefetchTargets(CAudioGraphNode* pBusy) {
+	UINT Posted = 0;
+
+	for (UINT i = 0; i < m_NumEdges; i++) {
+		CAudioGraphNode* Target = m_Edges[m_EdgeList[i]].GetToNode();
+
+		// The render thread is using this node's own reader, so a self-loop relies on the cache instead.
+		// The same goes for a node still streaming a crossfade out of it.
+		if (Target != this && Target != pBusy && Target->RequestPrefetch()) {
+			Posted++;
+		}
+	}
+
+	return Posted;
+}
+
+bool CAudioGraphNode::RequestPrefetch() {
+	// Cached nodes and streamed nodes have no use for a prefetch
+	if (IsCached() || m_Streaming) {
+		return false;
+	}
+
+	// A built-in decoder seeks without reading anything, but the start of the segment may not be in memory yet
+	if (m_Decoder != nullptr) {
+		return RequestTouch(GetCacheStart());
+	}
+
+	// Nodes that haven't been set up have no use for one either
+	if (m_Reader == nullptr) {
+		return false;
+	}
+
+	if (InterlockedCompareExchange(&m_PrefetchState, AUDIO_GRAPH_NODE_PREFETCH_QUEUED, AUDIO_GRAPH_NODE_PREFETCH_IDLE) != AUDIO_GRAPH_NODE_PREFETCH_IDLE) {
+		return false;
+	}
+
+	m_Loader->Post(this, AUDIO_GRAPH_NODE_WORK_PREFETCH);
+
+	return true;
+}
+
+bool CAudioGraphNode::RequestTouch(UINT64 Position) {
+	const UINT64 End = GetCacheStart() + GetCacheLength();
+	UINT64 First = Position;
+
+	if (Position >= End) {
+		return false;
+	}
+
+	if (Position >= m_TouchStart && Position < m_TouchEnd) {
+		// Carry on from the end of the last request once the render thread is half way into it
+		if (m_TouchEnd - Position > GetTouchFrames() / 2 || m_TouchEnd >= End) {
+			return false;
+		}
+
+		First = m_TouchEnd;
+	} else {
+		// The node jumped somewhere that hasn't been asked for, so start again from there
+		m_TouchStart = Position;
+	}
+
+	m_TouchEnd = std::min(First + GetTouchFrames(), End);
+
+	// The exchange is a full barrier, so the streaming thread sees the new frame before the work
+	InterlockedExchange64(&m_TouchFrame, LONG64(First));
+	m_Loader->Post(this, AUDIO_GRAPH_NODE_WORK_TOUCH);
+
+	return true;
+}
+
+VOID CAudioGraphNode::Touch() {
+	HRESULT hr = S_OK;
+
+	AcquireSRWLockExclusive(&m_StreamLock);
+
+	// The node may have been flushed since the work was posted
+	if (m_Decoder != nullptr) {
+		hr = m_Decoder->Touch (
+			UINT64(InterlockedCompareExchange64(&m_TouchFrame, 0, 0)),
+			GetTouchFrames()
+		);
+	}
+
+	ReleaseSRWLockExclusive(&m_StreamLock);
+
+	CHECK_HR(__LINE__);
+}
+
+VOID CAudioGraphNode::Prefetch() {
+	// The render thread may have cancelled the prefetch in the meantime
+	if (InterlockedCompareExchange(&m_PrefetchState, AUDIO_GRAPH_NODE_PREFETCH_WARMING, AUDIO_GRAPH_NODE_PREFETCH_QUEUED) != AUDIO_GRAPH_NODE_PREFETCH_QUEUED) {
+		return;
+	}
+
+	SeekReader();
+
+	// The exchange is a full barrier, so the render thread sees the new sample before the state
+	InterlockedExchange(&m_PrefetchState, AUDIO_GRAPH_NODE_PREFETCH_PRIMED);
+}
+
+LONG CAudioGraphNode::ReclaimPrefetch() {
+	// A prefetch that hasn't started yet can simply be cancelled
+	InterlockedCompareExchange(&m_PrefetchState, AUDIO_GRAPH_NODE_PREFETCH_IDLE, AUDIO_GRAPH_NODE_PREFETCH_QUEUED);
+
+	// Only the loader moves a prefetch on from here, and only as far as PRIMED, so a finished one is handed
+	// straight back.  One in progress owns the source reader until it's done.
+	return InterlockedCompareExchange(&m_PrefetchState, AUDIO_GRAPH_NODE_PREFETCH_IDLE, AUDIO_GRAPH_NODE_PREFETCH_PRIMED);
+}
+
+bool CAudioGraphNode::ReclaimReader() {
+	if (m_AwaitingPrefetch) {
+		// An offline render waits for the prefetch rather than playing silence, so that it comes out the same every time
+		if (m_Loader->IsOffline()) {
+			SettlePrefetch();
+		}
+
+		if (ReclaimPrefetch() == AUDIO_GRAPH_NODE_PREFETCH_WARMING) {
+			return false;
+		}
+
+		// The reader is at the start of the lead, and reads forward to wherever the silence got to
+		m_AwaitingPrefetch = false;
+	}
+
+	return true;
+}
+
+VOID CAudioGraphNode::SettlePrefetch() {
+	// A prefetch in progress is never longer than a seek, so the wait is short
+	while (ReclaimPrefetch() == AUDIO_GRAPH_NODE_PREFETCH_WARMING) {
+		RealtimeBlockingCall();
+		SwitchToThread();
+	}
+}
+
+VOID CAudioGraphNode::DoWork(LONG Work) {
+	if (Work & AUDIO_GRAPH_NODE_WORK_PREFETCH) {
+		Prefetch();
+	}
+
+	if (Work & AUDIO_GRAPH_NODE_WORK_CACHE) {
+		BuildCache();
+	}
+
+	if (Work & AUDIO_GRAPH_NODE_WORK_STREAM) {
+		FillRing();
+	}
+
+	if (Work & AUDIO_GRAPH_NODE_WORK_TOUCH) {
+		Touch();
+	}
+}
+
+VOID CAudioGraphNode::FillRing() {
+	AcquireSRWLockExclusive(&m_StreamLock);
+
+	// The node may have been flushed since the work was posted, and once it's cached the ring is no longer read
+	if (m_Streaming && !IsCached()) {
+		DecodeRing();
+	}
+
+	ReleaseSRWLockExclusive(&m_StreamLock);
+}
+
+VOID CAudioGraphNode::DecodeRing() {
+	FLOAT* Span = nullptr;
+	UINT Free = 0;
+
+	while (!m_DecodeDone && (Free = m_Ring.BeginWrite(Span)) > 0) {
+		const UINT64 PassEnd = GetCacheStart() + UINT64(m_PassFrames);
+
+		// Every pass plays the segment from the start of its lead
+		if (m_DecodeRestart) {
+			m_DecodeRestart = false;
+			m_DecodePosition = GetCacheStart();
+			SeekReader();
+		}
+
+		const UINT Written = ReadFrames(Span, Free, m_DecodePosition, PassEnd);
 
-	m_SamplePosition = m_SampleOffset;
+		m_Ring.EndWrite(Written);
+
+		if (Written < Free) {
+			// The file ended before the pass did, so every pass is cut short from here on.  The exchange is a
+			// full barrier, so the render thread sees the new length before the frames of the next pass.
+			if (m_DecodePosition < PassEnd) {
+				InterlockedExchange64(&m_PassFrames, LONG64(m_DecodePosition - GetCacheStart()));
+			}
+
+			// A file that ends before the segment starts has nothing to play
+			m_DecodeDone = m_DecodePosition == GetCacheStart();
+			m_DecodeRestart = true;
+		}
+	}
 }
 
-VOID CAudioGraphNode::GetTransitionEdge(std::string& TransitionString, CAudioGraphEdge** ppAudioGraphEdge) {
+VOID CAudioGraphNode::BuildCache() {
+	HRESULT hr = S_OK;
+	const UINT64 Bytes = GetCacheLength() * sizeof(FLOAT) * m_Channels;
+
+	if (InterlockedCompareExchange(&m_CacheState, AUDIO_GRAPH_NODE_CACHE_BUILDING, AUDIO_GRAPH_NODE_CACHE_QUEUED) != AUDIO_GRAPH_NODE_CACHE_QUEUED) {
+		return;
+	}
+
+	// If the budget is exhausted, keep streaming - the next Setup() will try again
+	if (!m_Loader->ReserveCache(Bytes)) {
+		InterlockedExchange(&m_CacheState, AUDIO_GRAPH_NODE_CACHE_NONE);
+		return;
+	}
+
+	hr = DecodeCache();
+
+	if (FAILED(hr)) {
+		std::vector<FLOAT>().swap(m_Cache);
+		m_CacheFrames = 0;
+		m_Loader->ReleaseCache(Bytes);
+		InterlockedExchange(&m_CacheState, AUDIO_GRAPH_NODE_CACHE_NONE);
+		return;
+	}
+
+	m_CacheBytes = Bytes;
+
+	// The exchange is a full barrier, so the render thread sees the data before the state
+	InterlockedExchange(&m_CacheState, AUDIO_GRAPH_NODE_CACHE_READY);
+}
+
+HRESULT CAudioGraphNode::DecodeCache() {
+	HRESULT hr = S_OK;
+	CComPtr<IMFSourceReader> Reader;
+	CComPtr<CAudioGraphDecoder> Decoder;
+	LONGLONG DesiredTime = GetStartTime(); //100-nanosecond units
+	PROPVARIANT prop;
+
 	try {
-		*ppAudioGraphEdge = m_TransitionMap.at(TransitionString);
+		m_Cache.resize(SIZE_T(GetCacheLength()) * m_Channels);
 	} catch (...) {
-		*ppAudioGraphEdge = nullptr;
+		return E_OUTOFMEMORY;
 	}
+
+	m_CacheFrames = 0;
+
+	// The cache gets a decoder of its own, so it can be built while the node plays.  A built-in
+	// decoder converts the whole segment in one go.
+	hr = CAudioGraphDecoder::Create (
+		GetWideFilename().c_str(),
+		m_SampleRate,
+		m_Channels,
+		&Decoder
+	);
+
+	if (SUCCEEDED(hr)) {
+		hr = Decoder->Seek (
+			GetCacheStart()
+		); RETURN_HR(__LINE__);
+
+		while (m_CacheFrames < GetCacheLength()) {
+			UINT Frames = 0;
+
+			hr = Decoder->Read (
+				&m_Cache[SIZE_T(m_CacheFrames) * m_Channels],
+				UINT(std::min(GetCacheLength() - m_CacheFrames, UINT64(UINT_MAX))),
+				&Frames
+			); RETURN_HR(__LINE__);
+
+			// The file ended before the segment did - the node just ends early
+			if (Frames == 0) {
+				break;
+			}
+
+			m_CacheFrames += Frames;
+		}
+
+		return S_OK;
+	}
+
+	hr = CreateReader (
+		m_CacheMediaType,
+		&Reader
+	); if (FAILED(hr)) return hr;
+
+	hr = InitPropVariantFromInt64 (
+		DesiredTime,
+		&prop
+	); RETURN_HR(__LINE__);
+
+	hr = Reader->SetCurrentPosition (
+		GUID_NULL,
+		prop
+	); PropVariantClear(&prop); RETURN_HR(__LINE__);
+
+	while (m_CacheFrames < GetCacheLength()) {
+		CComPtr<IMFSample> Sample;
+		CComPtr<IMFMediaBuffer> Buffer;
+		DWORD dwFlags = 0;
+		DWORD BufferLength = 0;
+		BYTE* pByteBuffer = nullptr;
+		LONGLONG SampleTime = 0;
+
+		hr = Reader->ReadSample (
+			MF_SOURCE_READER_FIRST_AUDIO_STREAM,
+			NULL,
+			NULL,
+			&dwFlags,
+			NULL,
+			&Sample
+		); RETURN_HR(__LINE__);
+
+		// The file ended before the segment did - the node just ends early
+		if ((dwFlags & MF_SOURCE_READERF_ENDOFSTREAM) || Sample == nullptr) {
+			break;
+		}
+
+		hr = Sample->GetSampleTime (
+			&SampleTime
+		); RETURN_HR(__LINE__);
+
+		hr = Sample->ConvertToContiguousBuffer (
+			&Buffer
+		); RETURN_HR(__LINE__);
+
+		hr = Buffer->Lock (
+			&pByteBuffer,
+			nullptr,
+			&BufferLength
+		); RETURN_HR(__LINE__);
+
+		// Trim whatever part of the sample lies before the frames already cached.  The first
+		// sample after a seek usually starts somewhat before the start of the cache.
+		LONGLONG FirstFrame = GetFrameAtTime(SampleTime) - LONGLONG(GetCacheStart());
+		UINT SampleFrames = BufferLength / (sizeof(FLOAT) * m_Channels);
+		UINT FramesSkipped = 0;
+
+		// If the file has a gap before this sample, the gap is cached as silence, just as it plays
+		// when the node is streamed
+		if (FirstFrame > LONGLONG(m_CacheFrames)) {
+			const UINT64 GapEnd = std::min(UINT64(FirstFrame), GetCacheLength());
+
+			ZeroMemory (
+				&m_Cache[SIZE_T(m_CacheFrames) * m_Channels],
+				SIZE_T(GapEnd - m_CacheFrames) * sizeof(FLOAT) * m_Channels
+			);
+
+			m_CacheFrames = GapEnd;
+		}
+
+		if (FirstFrame < LONGLONG(m_CacheFrames)) {
+			FramesSkipped = UINT(std::min(LONGLONG(m_CacheFrames) - FirstFrame, LONGLONG(SampleFrames)));
+		}
+
+		UINT FramesCopied = UINT(std::min(UINT64(SampleFrames - FramesSkipped), GetCacheLength() - m_CacheFrames));
+
+		if (FramesCopied > 0) {
+			memcpy (
+				&m_Cache[m_CacheFrames * m_Channels],
+				pByteBuffer + FramesSkipped * sizeof(FLOAT) * m_Channels,
+				FramesCopied * sizeof(FLOAT) * m_Channels
+			);
+		}
+
+		m_CacheFrames += FramesCopied;
+
+		hr = Buffer->Unlock();
+		RETURN_HR(__LINE__);
+	}
+
+	return S_OK;
+}
+
+UINT CAudioGraphNode::ProcessCache(FLOAT* OutputBuffer, UINT BufferFrames, UINT64 EndFrame) {
+	UINT64 Position = m_SamplePosition - GetCacheStart();
+	UINT64 End = std::min(m_CacheFrames, EndFrame - GetCacheStart());
+	UINT Written = 0;
+
+	if (Position < End) {
+		Written = UINT(std::min(UINT64(BufferFrames), End - Position));
+
+		memcpy (
+			OutputBuffer,
+			&m_Cache[Position * m_Channels],
+			Written * sizeof(FLOAT) * m_Channels
+		);
+	}
+
+	m_SamplePosition += Written;
+
+	return Written;
 }
\ No newline at end of file
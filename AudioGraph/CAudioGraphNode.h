@@ -25,21 +25,45 @@
 #include <comdef.h>
 #include <atlbase.h>
 #include <Windows.h>
-#include <string>
 #include <vector>
-#include <map>
+#include <string>
+#include <algorithm>
 #include <mfapi.h>
 #include <mfidl.h>
 #include <mfreadwrite.h>
 
 #include "AudioGraph.h"
 #include "QueryInterface.h"
+#include "CAudioGraphLoader.h"
+#include "CAudioGraphImage.h"
+#include "CAudioGraphPCMRing.h"
+#include "CAudioGraphDecoder.h"
 
+struct AUDIO_GRAPH_PLAYBACK_COUNTERS;
 class CAudioGraph;
 class CAudioGraphFile;
 class CAudioGraphEdge;
 
-class CAudioGraphNode : public IAudioGraphNode {
+/* How much of a mapped file is read into memory ahead of the render thread at a time, in milliseconds. */
+static const UINT AUDIO_GRAPH_NODE_TOUCH_TIME = 1000;
+
+/* States of a node's decoded PCM cache. */
+enum AUDIO_GRAPH_NODE_CACHE {
+	AUDIO_GRAPH_NODE_CACHE_NONE = 0, //Not cached - the node is streamed from its source reader
+	AUDIO_GRAPH_NODE_CACHE_QUEUED, //Waiting for the loader to decode the segment
+	AUDIO_GRAPH_NODE_CACHE_BUILDING, //The loader is decoding the segment
+	AUDIO_GRAPH_NODE_CACHE_READY //The segment is decoded, and is served from memory
+};
+
+/* States of a node's prefetch, which positions its source reader ahead of a transition. */
+enum AUDIO_GRAPH_NODE_PREFETCH {
+	AUDIO_GRAPH_NODE_PREFETCH_IDLE = 0, //The source reader is owned by the render thread
+	AUDIO_GRAPH_NODE_PREFETCH_QUEUED, //Waiting for the loader to seek the source reader
+	AUDIO_GRAPH_NODE_PREFETCH_WARMING, //The loader owns the source reader and is seeking it
+	AUDIO_GRAPH_NODE_PREFETCH_PRIMED //The source reader is positioned at the start of the segment
+};
+
+class CAudioGraphNode : public IAudioGraphNode2 {
 public:
 	CAudioGraphNode();
 
@@ -47,36 +71,28 @@ public:
 
 	//IUnknown methods
 
-	ULONG STDMETHODCALLTYPE AddRef() {
-		return ++m_RefCount;
-	}
+	//Nodes are stored in an array owned by their graph, so they share its reference count.
+	//That count is atomic, since the loader holds references from its own thread.
 
-	ULONG STDMETHODCALLTYPE Release() {
-		m_RefCount--;
-
-		if (m_RefCount <= 0) {
-			delete this;
-			return 0;
-		}
+	ULONG STDMETHODCALLTYPE AddRef();
 
-		return m_RefCount;
-	}
+	ULONG STDMETHODCALLTYPE Release();
 
 	//IAudioGraphNode methods
 
 	/* Returns the ID of this particular node. */
 	LPCSTR STDMETHODCALLTYPE GetID() final {
-		return m_ID.c_str();
+		return m_ID;
 	}
 
 	/* Returns the name of the audio file that this node is streamed from. */
 	LPCSTR STDMETHODCALLTYPE GetAudioFilename() final {
-		return m_AudioFilename.c_str();
+		return m_AudioFilename;
 	}
 
 	/* Returns the number of edges extending from this particular node. */
 	UINT STDMETHODCALLTYPE GetNumEdges() final {
-		return m_EdgeEnum.size();
+		return m_NumEdges;
 	}
 
 	/* Returns a bool indicating whether or not the node is a terminal node. */
@@ -91,30 +107,30 @@ public:
 	VOID STDMETHODCALLTYPE GetEdgeByID(LPCSTR ID, IAudioGraphEdge** ppEdge) final;
 
 	/* Returns the offset this node has from the start of the PCM audio data in the
-	** associated file, in samples. */
+	** associated file, in samples, clamped to UINT_MAX. */
 	UINT STDMETHODCALLTYPE GetSampleOffset() final {
-		return m_SampleOffset;
+		return UINT(std::min(m_SampleOffset, UINT64(UINT_MAX)));
 	}
 
-	/* Returns the duration this node will play for, in samples. */
+	/* Returns the duration this node will play for, in samples, clamped to UINT_MAX. */
 	UINT STDMETHODCALLTYPE GetSampleDuration() final {
-		return m_SampleDuration;
+		return UINT(std::min(m_SampleDuration, UINT64(UINT_MAX)));
 	}
 
 	/* Returns the offset this node has from the start of the PCM audio data in the
 	** associated file, in seconds. */
 	FLOAT STDMETHODCALLTYPE GetTimeOffset() final {
-		return FLOAT(m_SampleOffset) / FLOAT(44100);
+		return FLOAT(DOUBLE(m_SampleOffset) / DOUBLE(m_FileRate));
 	}
 
 	/* Returns the duration this node will play for, in seconds. */
 	FLOAT STDMETHODCALLTYPE GetTimeDuration() final {
-		return FLOAT(m_SampleDuration) / FLOAT(44100);
+		return FLOAT(DOUBLE(m_SampleDuration) / DOUBLE(m_FileRate));
 	}
 
 	/* Returns this node's formatted style string, which was used to create it. */
 	LPCSTR STDMETHODCALLTYPE GetStyleString() final {
-		return m_StyleString.c_str();
+		return m_StyleString;
 	}
 
 	/* Retrieves the audio graph that this node is attatched to. */
@@ -123,65 +139,288 @@ public:
 	/* Retrieves the audio graph file that this node is associated with, if there is one. */
 	VOID STDMETHODCALLTYPE GetAudioGraphFile(IAudioGraphFile** ppAudioGraphFile) final;
 
+	/* Retrieves the node's default edge, if it has one. */
+	VOID STDMETHODCALLTYPE GetDefaultEdge(IAudioGraphEdge** ppEdge) final;
+
+	//IAudioGraphNode2 methods
+
+	/* Returns the offset this node has from the start of the PCM audio data in the
+	** associated file, in samples. */
+	UINT64 STDMETHODCALLTYPE GetSampleOffset64() final {
+		return m_SampleOffset;
+	}
+
+	/* Returns the duration this node will play for, in samples. */
+	UINT64 STDMETHODCALLTYPE GetSampleDuration64() final {
+		return m_SampleDuration;
+	}
+
 	//New methods
 
-	HRESULT Initialize (
+	/* Returns the default edge without going through the COM interface, or nullptr if there is none. */
+	CAudioGraphEdge* GetDefaultEdge() {
+		return m_DefaultEdge;
+	}
+
+	/* Sets the node up from its record in [Image].  [pEdges] is the graph's edge array. */
+	VOID Initialize (
 		IAudioGraphCallback* pCallback,
 		CAudioGraphFile* pFile,
 		CAudioGraph* pGraph,
-		std::string& Style
+		const CAudioGraphImage& Image,
+		const AUDIO_GRAPH_IMAGE_NODE& Record,
+		CAudioGraphEdge* pEdges
 	);
 
-	/* Prepares the graph for playback by activating its stream reader. */
-	VOID Setup(IMFMediaType* pMediaType);
+	/* Prepares the graph for playback by opening its file, with a built-in decoder if there is one for the
+	** file and a stream reader otherwise.  If the loader has
+	** a cache budget, the node's segment is also queued to be decoded in the background.
+	** If it has a read-ahead, the node is streamed through a decode ring, which is filled here
+	** for the first time. */
+	VOID Setup(IMFMediaType* pMediaType, CAudioGraphLoader* pLoader);
 
-	/* Closes and releases the stream reader and related objects. */
+	/* Closes and releases the decoder or stream reader and related objects. */
 	VOID Flush();
 
 	/* Fetches a set of samples.  Returns the number of samples written.
 	** If any value less than BufferFrames is returned, the node has finished
-	** playing. */
-	UINT Process(FLOAT* OutputBuffer, UINT BufferFrames);
+	** playing.  A decode ring that runs dry is counted in [Counters]. */
+	UINT Process(FLOAT* OutputBuffer, UINT BufferFrames, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters);
+
+	/* Seeks to the start of the node's segment, less [Preroll] frames if an edge starts it early.  Returns true
+	** if the source reader had to be read on the calling thread, or if a prefetch still has it and the node
+	** plays silence until it's done, or if the node has a built-in decoder and that part of its file wasn't
+	** read into memory ahead of time.  Returns false if the node was cached, prefetched or streamed through a
+	** decode ring.  This never waits for the loader. */
+	bool Seek(UINT64 Preroll);
+
+	/* Reads the start of the segment into memory if the node has a built-in decoder, so that playback can start
+	** on the node without waiting on the disk.  This blocks, so it's only used while the graph is set up. */
+	VOID WarmDecoder();
+
+	/* Makes sure the node can start [Time] milliseconds ahead of its offset, for an edge's preroll.
+	** This has to be done before Setup(). */
+	VOID ReserveLead(UINT Time) {
+		m_LeadTime = std::max(m_LeadTime, Time);
+	}
 
-	/* Seeks to the start of the node's segment. */
-	VOID Seek();
+	/* Makes sure the node can play on for [Time] milliseconds past its end, for an edge's crossfade.
+	** This has to be done before Setup(). */
+	VOID ReserveTail(UINT Time) {
+		m_TailTime = std::max(m_TailTime, Time);
+	}
 
-	/* Retrieves the edge that a particular transition string is associated with.
-	** If none exists, ppAudioGraphEdge is set to nullptr. */
-	VOID GetTransitionEdge(std::string& TransitionString, CAudioGraphEdge** ppAudioGraphEdge);
+	/* Returns the number of frames the node can play on past its end. */
+	UINT64 GetTailFrames() {
+		return m_TailFrames;
+	}
 
-private:
-	long m_RefCount;
+	/* Returns whether the node is served from its cache, which includes its lead and tail. */
+	bool IsCached() {
+		return m_CacheState == AUDIO_GRAPH_NODE_CACHE_READY;
+	}
+
+	/* Fetches frames of the audio that follows the node's segment, for a crossfade out of it.  If [FromCache] is
+	** true, they are copied from [Position] frames past the end in the cache, which leaves the node free to play
+	** again at the same time.  Otherwise the source reader or decode ring simply carries on from the end, and
+	** [Position] is ignored.  Frames the file doesn't have are silent. */
+	VOID ReadTail(UINT64 Position, FLOAT* OutputBuffer, UINT BufferFrames, bool FromCache, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters);
 
+	/* Returns the number of frames left before the node finishes playing. */
+	UINT64 GetFramesRemaining() {
+		return m_FrameOffset + m_FrameDuration - m_SamplePosition;
+	}
+
+	/* Posts a prefetch to the loader for every node this node can transition to, other than itself
+	** and [pBusy], whose source reader may still be playing a tail.  Returns the number of prefetches posted. */
+	UINT PrefetchTargets(CAudioGraphNode* pBusy);
+
+	/* Returns the work item used by CAudioGraphLoader to queue this node. */
+	AUDIO_GRAPH_WORK_ITEM* GetWorkItem() {
+		return &m_WorkItem;
+	}
+
+	/* Returns the work item used by CAudioGraphLoader to queue this node's streaming work. */
+	AUDIO_GRAPH_WORK_ITEM* GetStreamItem() {
+		return &m_StreamItem;
+	}
+
+	/* Executes work posted to the loader.  This is called on the loader's threads. */
+	VOID DoWork(LONG Work);
+
+private:
 	CComPtr<IAudioGraphCallback> m_Callback;
-	CComPtr<CAudioGraph> m_Graph;
-	CComPtr<CAudioGraphFile> m_File;
+	CAudioGraph* m_Graph; //The graph owns the node
+	CAudioGraphFile* m_File; //The file owns the graph
 	CComPtr<IMFMediaType> m_MediaType;
 	CComPtr<IMFSourceReader> m_Reader;
 	CComPtr<IMFSample> m_Sample;
-
-	std::string m_ID;
-	std::string m_AudioFilename;
-	std::string m_StyleString;
-	UINT m_SampleOffset;
-	UINT m_SampleDuration;
-	UINT m_SamplePosition;
+	CComPtr<CAudioGraphDecoder> m_Decoder; //Used instead of m_Reader when the file has a built-in decoder
+	CComPtr<CAudioGraphLoader> m_Loader;
+	CComPtr<IMFMediaType> m_CacheMediaType; //The requested media type, used by the loader to build the cache
+
+	LPCSTR m_ID; //Points into the file's image, like the other strings
+	LPCSTR m_AudioFilename;
+	LPCSTR m_StyleString;
+	UINT64 m_SampleOffset; //In samples of the file, as given by the "offset" attribute
+	UINT64 m_SampleDuration; //In samples of the file, as given by the "duration" attribute
+	UINT m_FileRate; //Sample rate of the file - 44100 until Setup() has opened it
+	UINT m_SampleRate; //Sample rate of the media type the node decodes to
+	UINT64 m_FrameOffset; //m_SampleOffset at m_SampleRate
+	UINT64 m_FrameDuration; //m_SampleDuration at m_SampleRate
+	UINT64 m_SamplePosition; //The next frame to play, at m_SampleRate
+	UINT m_Channels; //Interleaved channels in the media type the node decodes to
+	UINT m_LeadTime; //The longest preroll of the edges into the node, in milliseconds
+	UINT m_TailTime; //The longest crossfade of the edges out of the node, in milliseconds
+	UINT64 m_LeadFrames; //m_LeadTime at m_SampleRate, never more than m_FrameOffset
+	UINT64 m_TailFrames; //m_TailTime at m_SampleRate
 	bool m_IsTerminal;
-
-	std::vector<CComPtr<CAudioGraphEdge>> m_EdgeEnum;
-	std::map<std::string, CComPtr<CAudioGraphEdge>> m_EdgeMap; //Mapped by ID string
-	std::map<std::string, CComPtr<CAudioGraphEdge>> m_TransitionMap; //Mapped by transition string
+	bool m_CacheEnabled; //Whether or not this node may be cached (the "cache" attribute)
+
+	AUDIO_GRAPH_WORK_ITEM m_WorkItem; //Used to post work to the loader without allocating
+	volatile LONG m_CacheState; //One of AUDIO_GRAPH_NODE_CACHE
+	volatile LONG m_PrefetchState; //One of AUDIO_GRAPH_NODE_PREFETCH
+	std::vector<FLOAT> m_Cache; //Decoded PCM for [offset - lead, offset + duration + tail)
+	UINT64 m_CacheFrames; //Number of frames held in m_Cache
+	UINT64 m_CacheBytes; //Number of bytes reserved from the loader's cache budget
+
+	//While a node is streamed through its decode ring, the source reader belongs to the streaming thread.  The ring
+	//holds the segment, lead and tail included, over and over - each pass is m_PassFrames long.
+	AUDIO_GRAPH_WORK_ITEM m_StreamItem; //Used to post streaming work to the loader without allocating
+	CAudioGraphPCMRing m_Ring; //Decoded frames waiting for the render thread
+	SRWLOCK m_StreamLock; //Held by the streaming thread while it decodes or reads ahead, and by Setup() and Flush()
+	bool m_Streaming; //Whether the node is streamed through m_Ring - only changed under m_StreamLock
+	volatile LONG64 m_PassFrames; //Frames in each pass, which is less than GetCacheLength() if the file ends early
+	UINT64 m_DecodePosition; //The next frame the streaming thread decodes, at m_SampleRate
+	bool m_DecodeRestart; //Whether the next frame decoded starts a new pass
+	bool m_DecodeDone; //Whether the file has nothing to decode for the segment
+	UINT64 m_RingPosition; //The frame of the pass that the next frame read from the ring belongs to - render thread only
+	bool m_AwaitingPrefetch; //Whether Seek() found the loader still seeking the source reader - render thread only
+
+	//A built-in decoder reads a mapped file, which is only read from the disk when it's first accessed.  The streaming
+	//thread accesses it ahead of the render thread, so that the render thread never waits on the disk.
+	UINT64 m_TouchStart; //The first frame that has been read, or asked to be read, into memory - render thread only
+	UINT64 m_TouchEnd; //The frame after the last one that has been read, or asked to be read, into memory - render thread only
+	volatile LONG64 m_TouchFrame; //The first frame the streaming thread is asked to read into memory
+
+	CAudioGraphEdge* m_Edges; //The graph's edge array
+	const UINT* m_EdgeList; //The edges leaving this node, in the order they were defined - points into the file's image
+	UINT m_NumEdges;
+	CAudioGraphEdge* m_DefaultEdge; //Points into m_Edges, or nullptr
 
 	//IUnknown methods
 
 	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(IAudioGraphNode2);
 		QUERY_INTERFACE_CAST(IAudioGraphNode);
 		QUERY_INTERFACE_CAST(IUnknown);
 		QUERY_INTERFACE_FAIL();
 	}
 
 	//New methods
-	FLOAT GetTimePosition() {
-		return FLOAT(m_SamplePosition) / FLOAT(44100);
+
+	/* Returns the offset of the node's segment in 100-nanosecond units. */
+	LONGLONG GetOffsetTime() {
+		return LONGLONG(m_SampleOffset) * 10000000 / LONGLONG(m_FileRate);
+	}
+
+	/* Returns the earliest time the node may start playing from, in 100-nanosecond units. */
+	LONGLONG GetStartTime() {
+		return std::max(GetOffsetTime() - LONGLONG(m_LeadFrames) * 10000000 / LONGLONG(m_SampleRate), 0LL);
 	}
+
+	/* Returns the frame at m_SampleRate that the cache starts on. */
+	UINT64 GetCacheStart() {
+		return m_FrameOffset - m_LeadFrames;
+	}
+
+	/* Returns the number of frames the cache holds once it's complete. */
+	UINT64 GetCacheLength() {
+		return m_LeadFrames + m_FrameDuration + m_TailFrames;
+	}
+
+	/* Returns the frame, at m_SampleRate, closest to a time in 100-nanosecond units. */
+	LONGLONG GetFrameAtTime(LONGLONG Time) {
+		return (Time * LONGLONG(m_SampleRate) + 5000000) / 10000000;
+	}
+
+	/* Converts a number of samples of the file to frames at m_SampleRate. */
+	UINT64 GetFramesFromSamples(UINT64 Samples) {
+		return (Samples * m_SampleRate + m_FileRate / 2) / m_FileRate;
+	}
+
+	/* Returns the node's filename as UTF-16. */
+	std::wstring GetWideFilename();
+
+	/* Creates a source reader for the node's file that decodes to the given media type. */
+	HRESULT CreateReader(IMFMediaType* pMediaType, IMFSourceReader** ppReader);
+
+	/* Decodes the node's segment into the cache.  This is called on the loader thread. */
+	VOID BuildCache();
+
+	/* Fills m_Cache using a private source reader.  Returns a failure if the segment couldn't be decoded. */
+	HRESULT DecodeCache();
+
+	/* Serves frames up to [EndFrame] from the cache with a plain copy. */
+	UINT ProcessCache(FLOAT* OutputBuffer, UINT BufferFrames, UINT64 EndFrame);
+
+	/* Reads frames up to [EndFrame] from the decoder or source reader. */
+	UINT ProcessReader(FLOAT* OutputBuffer, UINT BufferFrames, UINT64 EndFrame) {
+		if (m_Decoder != nullptr) {
+			RequestTouch(m_SamplePosition);
+		}
+
+		return ReadFrames(OutputBuffer, BufferFrames, m_SamplePosition, EndFrame);
+	}
+
+	/* Fills the buffer with silence up to [EndFrame], in place of frames the source reader can't provide yet. */
+	UINT ProcessSilence(FLOAT* OutputBuffer, UINT BufferFrames, UINT64 EndFrame);
+
+	/* Reads frames from [Position] up to [EndFrame] from the decoder or source reader, advancing [Position]. */
+	UINT ReadFrames(FLOAT* OutputBuffer, UINT BufferFrames, UINT64& Position, UINT64 EndFrame);
+
+	/* Reads frames up to [EndFrame] from the decode ring.  If the ring runs dry, the rest is silent. */
+	UINT ProcessRing(FLOAT* OutputBuffer, UINT BufferFrames, UINT64 EndFrame, AUDIO_GRAPH_PLAYBACK_COUNTERS& Counters);
+
+	/* Tops up the decode ring, unless the node has been flushed or cached since.  This is called on the streaming thread. */
+	VOID FillRing();
+
+	/* Decodes into the decode ring until it's full.  m_StreamLock must be held. */
+	VOID DecodeRing();
+
+	/* Positions the decoder or source reader at the start of the segment, less the lead.  A source reader also
+	** reads its first sample. */
+	VOID SeekReader();
+
+	/* Posts a prefetch of this node to the loader, unless it has no use for one. */
+	bool RequestPrefetch();
+
+	/* Returns the number of frames of a mapped file the streaming thread reads into memory at a time. */
+	UINT64 GetTouchFrames() {
+		return UINT64(AUDIO_GRAPH_NODE_TOUCH_TIME) * m_SampleRate / 1000;
+	}
+
+	/* Asks the streaming thread to read the mapped file into memory from [Position] on, unless that has already
+	** been asked for far enough ahead of it.  Returns whether anything was posted. */
+	bool RequestTouch(UINT64 Position);
+
+	/* Reads the part of the mapped file asked for by RequestTouch() into memory.  This is called on the streaming thread. */
+	VOID Touch();
+
+	/* Seeks the source reader on behalf of a transition.  This is called on the loader thread. */
+	VOID Prefetch();
+
+	/* Cancels a queued prefetch, or takes back the source reader from a finished one.  A prefetch in progress
+	** is left alone.  Returns AUDIO_GRAPH_NODE_PREFETCH_PRIMED if the source reader was positioned by the loader,
+	** AUDIO_GRAPH_NODE_PREFETCH_WARMING if the loader still has it, and AUDIO_GRAPH_NODE_PREFETCH_IDLE otherwise. */
+	LONG ReclaimPrefetch();
+
+	/* Takes back the source reader once a prefetch that was in progress when the node was sought has finished.
+	** Returns false if the loader still has it.  In an offline render, it waits for the loader instead. */
+	bool ReclaimReader();
+
+	/* Cancels a queued prefetch, or waits for one in progress to finish, so that the node owns the source
+	** reader again.  This blocks, so it's only used by Flush() on the application thread, and by an offline render,
+	** which has no deadline to miss. */
+	VOID SettlePrefetch();
 };
\ No newline at end of file
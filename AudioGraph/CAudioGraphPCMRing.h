@@ -0,0 +1,131 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+/* CAudioGraphPCMRing is a lock-free, single-producer/single-consumer ring of interleaved float frames.  A decoder
+** thread writes frames straight into the ring while the render thread reads them out, without either of them
+** locking or allocating.  Both sides work on contiguous spans of the buffer, so the producer can decode into the
+** ring in place.  The indices count frames since the ring was cleared, and only ever grow - the capacity is a
+** power of two, so they still map onto the buffer once they wrap around. */
+class CAudioGraphPCMRing {
+public:
+	CAudioGraphPCMRing() :
+	m_Channels(0),
+	m_Capacity(0),
+	m_Head(0),
+	m_Tail(0)
+	{ }
+
+	/* Makes room for at least [Frames] frames of [Channels] channels and empties the ring.  Neither side may be
+	** using it. */
+	VOID Allocate(UINT Frames, UINT Channels) {
+		UINT Capacity = 1;
+
+		while (Capacity < Frames) {
+			Capacity <<= 1;
+		}
+
+		Frames = Capacity;
+
+		if (Frames != m_Capacity || Channels != m_Channels) {
+			m_Buffer.assign(SIZE_T(Frames) * Channels, 0.0f);
+			m_Channels = Channels;
+			m_Capacity = Frames;
+		}
+
+		Clear();
+	}
+
+	/* Releases the buffer.  Allocate() has to be called again before the ring is used. */
+	VOID Free() {
+		std::vector<FLOAT>().swap(m_Buffer);
+		m_Channels = 0;
+		m_Capacity = 0;
+		Clear();
+	}
+
+	/* Empties the ring.  Neither side may be using it. */
+	VOID Clear() {
+		m_Head.store(0, std::memory_order_relaxed);
+		m_Tail.store(0, std::memory_order_release);
+	}
+
+	/* Returns the number of frames the ring can hold. */
+	UINT GetCapacity() {
+		return m_Capacity;
+	}
+
+	/* Returns the number of frames waiting to be read.  Consumer only. */
+	UINT GetFill() {
+		return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_relaxed);
+	}
+
+	/* Points [Span] at the free frames that follow the newest frame without wrapping, and returns how many there
+	** are.  Producer only. */
+	UINT BeginWrite(FLOAT*& Span) {
+		UINT Tail = m_Tail.load(std::memory_order_relaxed);
+		UINT Free = m_Capacity - (Tail - m_Head.load(std::memory_order_acquire));
+		UINT Start = Tail & (m_Capacity - 1);
+
+		Span = m_Buffer.data() + SIZE_T(Start) * m_Channels;
+
+		return std::min(Free, m_Capacity - Start);
+	}
+
+	/* Hands [Frames] frames written to the span from BeginWrite() over to the consumer.  Producer only. */
+	VOID EndWrite(UINT Frames) {
+		//Publishing the tail after the frames are written hands them over to the consumer
+		m_Tail.store(m_Tail.load(std::memory_order_relaxed) + Frames, std::memory_order_release);
+	}
+
+	/* Points [Span] at the oldest frames that can be read without wrapping, and returns how many there are.
+	** Consumer only. */
+	UINT BeginRead(const FLOAT*& Span) {
+		UINT Head = m_Head.load(std::memory_order_relaxed);
+		UINT Fill = m_Tail.load(std::memory_order_acquire) - Head;
+		UINT Start = Head & (m_Capacity - 1);
+
+		Span = m_Buffer.data() + SIZE_T(Start) * m_Channels;
+
+		return std::min(Fill, m_Capacity - Start);
+	}
+
+	/* Removes [Frames] of the frames from BeginRead(), whether or not they were read.  Consumer only. */
+	VOID EndRead(UINT Frames) {
+		//Publishing the head hands the frames' space back to the producer
+		m_Head.store(m_Head.load(std::memory_order_relaxed) + Frames, std::memory_order_release);
+	}
+
+private:
+	std::vector<FLOAT> m_Buffer; //The interleaved frames
+	UINT m_Channels; //The number of channels in a frame
+	UINT m_Capacity; //The number of frames the buffer can hold, a power of two
+	std::atomic<UINT> m_Head; //Frames read since the ring was cleared, written by the consumer
+	BYTE m_Padding[64]; //Keeps the producer and consumer indices on separate cache lines
+	std::atomic<UINT> m_Tail; //Frames written since the ring was cleared, written by the producer
+};
\ No newline at end of file
@@ -0,0 +1,92 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+
+/* CAudioGraphRing is a bounded, lock-free, single-producer/single-consumer ring buffer.  One thread
+** may call Push() while another calls Peek() and Pop(), without either of them locking or allocating.
+** [Capacity] must be a power of two, and the ring holds exactly [Capacity] items. */
+template <typename T, UINT Capacity>
+class CAudioGraphRing {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	CAudioGraphRing() :
+	m_Head(0),
+	m_Tail(0)
+	{ }
+
+	/* Appends an item to the ring.  Returns false if the ring is full.  Producer only. */
+	bool Push(const T& Item) {
+		UINT Tail = m_Tail.load(std::memory_order_relaxed);
+
+		if (Tail - m_Head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+
+		m_Items[Tail & (Capacity - 1)] = Item;
+
+		//Publishing the tail after the store hands the item over to the consumer
+		m_Tail.store(Tail + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	/* Reads the oldest item without removing it.  Returns false if the ring is empty.  Consumer only. */
+	bool Peek(T& Item) {
+		UINT Head = m_Head.load(std::memory_order_relaxed);
+
+		if (Head == m_Tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		Item = m_Items[Head & (Capacity - 1)];
+
+		return true;
+	}
+
+	/* Removes the oldest item.  Returns false if the ring is empty.  Consumer only. */
+	bool Pop(T& Item) {
+		if (!Peek(Item)) {
+			return false;
+		}
+
+		//Publishing the head hands the slot back to the producer
+		m_Head.store(m_Head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	/* Returns true if the ring holds no items. */
+	bool IsEmpty() {
+		return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire);
+	}
+
+private:
+	T m_Items[Capacity]; //Item storage
+	std::atomic<UINT> m_Head; //Index of the oldest item, written by the consumer
+	BYTE m_Padding[64]; //Keeps the producer and consumer indices on separate cache lines
+	std::atomic<UINT> m_Tail; //Index one past the newest item, written by the producer
+};
\ No newline at end of file
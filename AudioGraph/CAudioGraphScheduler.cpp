@@ -0,0 +1,199 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#include "CAudioGraphScheduler.h"
+#include "Realtime.h"
+
+#include <algorithm>
+#include <mfapi.h>
+#include <avrt.h>
+
+#pragma comment(lib, "avrt.lib")
+
+#define FILENAME L"CAudioGraphScheduler.cpp"
+
+//m_NextJob between batches.  Late workers only ever add a few to it, so it never reaches a real job.
+static const LONG AUDIO_GRAPH_SCHEDULER_CLOSED = 0x40000000;
+
+CAudioGraphScheduler::CAudioGraphScheduler() :
+m_Threads(nullptr),
+m_NumThreads(0),
+m_WakeSemaphore(NULL),
+m_Halt(0),
+m_Job(nullptr),
+m_Context(nullptr),
+m_NumJobs(0),
+m_NextJob(AUDIO_GRAPH_SCHEDULER_CLOSED),
+m_DoneJobs(0)
+{ }
+
+CAudioGraphScheduler::~CAudioGraphScheduler() {
+	Halt();
+}
+
+HRESULT CAudioGraphScheduler::Initialize(IAudioGraphCallback* pCallback, UINT Threads) {
+	m_Callback = pCallback;
+
+	if (Threads == 0) {
+		return S_OK;
+	}
+
+	m_WakeSemaphore = CreateSemaphoreW(NULL, 0, LONG(Threads), NULL);
+
+	if (m_WakeSemaphore == NULL) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, HRESULT_FROM_WIN32(GetLastError()));
+		return E_FAIL;
+	}
+
+	m_Threads = new HANDLE[Threads];
+
+	for (UINT i = 0; i < Threads; i++) {
+		m_Threads[i] = CreateThread (
+			NULL,
+			0,
+			StaticWorkerThreadEntry,
+			this,
+			NULL,
+			NULL
+		);
+
+		//If the thread is NULL, an error occurred
+		if (m_Threads[i] == NULL) {
+			m_Callback->OnObjectFailure (
+				FILENAME,
+				__LINE__,
+				HRESULT_FROM_WIN32(GetLastError())
+			); return E_FAIL;
+		}
+
+		m_NumThreads++;
+	}
+
+	return S_OK;
+}
+
+VOID CAudioGraphScheduler::Halt() {
+	if (m_NumThreads > 0) {
+		InterlockedExchange(&m_Halt, 1);
+		ReleaseSemaphore(m_WakeSemaphore, LONG(m_NumThreads), NULL);
+		WaitForMultipleObjects(m_NumThreads, m_Threads, TRUE, INFINITE);
+
+		for (UINT i = 0; i < m_NumThreads; i++) {
+			CloseHandle(m_Threads[i]);
+		}
+
+		m_NumThreads = 0;
+	}
+
+	delete[] m_Threads;
+	m_Threads = nullptr;
+
+	if (m_WakeSemaphore != NULL) {
+		CloseHandle(m_WakeSemaphore);
+		m_WakeSemaphore = NULL;
+	}
+}
+
+VOID CAudioGraphScheduler::Run(AUDIO_GRAPH_JOB Job, LPVOID Context, UINT NumJobs) {
+	if (NumJobs == 0) {
+		return;
+	}
+
+	m_Job = Job;
+	m_Context = Context;
+	m_NumJobs = LONG(NumJobs);
+	m_DoneJobs = 0;
+
+	//The exchange is a full barrier, so a worker that claims a job sees the batch it belongs to
+	InterlockedExchange(&m_NextJob, 0);
+
+	//This thread takes a job too, so one fewer worker is needed than there are jobs
+	if (m_NumThreads > 0 && NumJobs > 1) {
+		RealtimeSignalCall();
+		ReleaseSemaphore(m_WakeSemaphore, LONG(std::min(m_NumThreads, NumJobs - 1)), NULL);
+	}
+
+	Execute();
+
+	//Whatever is still running was claimed by a worker, and is never longer than a job
+	while (m_DoneJobs < m_NumJobs) {
+		YieldProcessor();
+	}
+
+	//A worker that wakes up after this finds nothing left to claim
+	InterlockedExchange(&m_NextJob, AUDIO_GRAPH_SCHEDULER_CLOSED);
+}
+
+VOID CAudioGraphScheduler::Execute() {
+	LONG Job = 0;
+
+	while ((Job = InterlockedIncrement(&m_NextJob) - 1) < m_NumJobs) {
+		m_Job(m_Context, UINT(Job));
+		InterlockedIncrement(&m_DoneJobs);
+	}
+}
+
+DWORD __stdcall CAudioGraphScheduler::StaticWorkerThreadEntry(LPVOID Data) {
+	CAudioGraphScheduler* l_Scheduler = reinterpret_cast<CAudioGraphScheduler*>(Data);
+
+	return l_Scheduler->WorkerThreadEntry();
+}
+
+DWORD CAudioGraphScheduler::WorkerThreadEntry() {
+	HRESULT hr = S_OK;
+	DWORD TaskIndex = 0;
+	HANDLE Task = NULL;
+
+	//Jobs read from source readers, which are free-threaded, so the workers live in the multithreaded apartment
+	hr = CoInitializeEx (
+		NULL,
+		COINIT_MULTITHREADED
+	); if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, __LINE__, hr); return hr; }
+
+	hr = MFStartup (
+		MF_VERSION
+	); if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, __LINE__, hr); CoUninitialize(); return hr; }
+
+	//The workers render audio against the same deadline as the audio thread, so MMCSS schedules them like it.
+	//This isn't fatal - without the service they just run at normal priority.
+	Task = AvSetMmThreadCharacteristicsW (
+		L"Pro Audio",
+		&TaskIndex
+	);
+
+	for (;;) {
+		if (WaitForSingleObject(m_WakeSemaphore, INFINITE) != WAIT_OBJECT_0 || m_Halt != 0) {
+			break;
+		}
+
+		Execute();
+	}
+
+	if (Task != NULL) {
+		AvRevertMmThreadCharacteristics(Task);
+	}
+
+	MFShutdown();
+	CoUninitialize();
+
+	return S_OK;
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <Windows.h>
+
+#include "AudioGraph.h"
+
+/* A job run by CAudioGraphScheduler.  [Job] is the index of the job, from 0 to the number of jobs. */
+typedef VOID (*AUDIO_GRAPH_JOB)(LPVOID Context, UINT Job);
+
+/* CAudioGraphScheduler spreads a batch of jobs over a fixed pool of real-time threads, and the thread that
+** runs the batch.  Jobs are claimed one at a time from a shared counter, so a thread that finishes early
+** simply takes the next job instead of waiting on a slower one.  Running a batch never locks or allocates,
+** so it is safe on the render thread. */
+class CAudioGraphScheduler {
+public:
+	CAudioGraphScheduler();
+
+	~CAudioGraphScheduler();
+
+	/* Creates [Threads] worker threads. */
+	HRESULT Initialize(IAudioGraphCallback* pCallback, UINT Threads);
+
+	/* Stops and closes the worker threads. */
+	VOID Halt();
+
+	/* Returns the number of worker threads. */
+	UINT GetNumThreads() {
+		return m_NumThreads;
+	}
+
+	/* Runs [NumJobs] jobs, taking part in them on the calling thread, and returns once every job has finished.
+	** Only one thread may run batches. */
+	VOID Run(AUDIO_GRAPH_JOB Job, LPVOID Context, UINT NumJobs);
+
+private:
+	CComPtr<IAudioGraphCallback> m_Callback; //Used for error reporting
+
+	HANDLE* m_Threads; //The worker threads
+	UINT m_NumThreads;
+	HANDLE m_WakeSemaphore; //Released once for each worker needed by a batch
+	volatile LONG m_Halt; //Set when the workers should exit
+
+	AUDIO_GRAPH_JOB m_Job; //The batch being run - written before m_NextJob opens it
+	LPVOID m_Context;
+	LONG m_NumJobs;
+	volatile LONG m_NextJob; //The next job to be claimed, or AUDIO_GRAPH_SCHEDULER_CLOSED between batches
+	volatile LONG m_DoneJobs; //Jobs of the batch that have finished
+
+	/* Claims and runs jobs until there are none left. */
+	VOID Execute();
+
+	/* The static thread entry point */
+	static DWORD __stdcall StaticWorkerThreadEntry(LPVOID Data);
+
+	/* The non-static thread entry point, called by StaticWorkerThreadEntry() */
+	DWORD WorkerThreadEntry();
+};
\ No newline at end of file
@@ -0,0 +1,304 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#include "CAudioGraphWaveDecoder.h"
+#include "Realtime.h"
+
+#include <algorithm>
+#include <string.h>
+
+/* 24-bit WAV samples are signed, unlike the 24-bit samples of an endpoint that the endpoint kernels read, so they're
+** converted here.  The file always has the stream's channel count, so [Channels] and [AppChannels] are the same. */
+static VOID ReadWaveInt24(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	for (UINT i = 0; i < Frames * Channels; i++) {
+		// Putting the sample in the top three bytes and shifting it back down extends its sign
+		const INT32 Sample = INT32((UINT32(In[0]) << 8) | (UINT32(In[1]) << 16) | (UINT32(In[2]) << 24)) >> 8;
+
+		*Out++ = FLOAT(Sample) * (1.0f / 8388608.0f);
+		In += 3;
+	}
+}
+
+/* Catches the exception raised by an access to the mapping whose page couldn't be read, which happens if the file
+** shrinks underneath the mapping, or its volume goes away.  Any other exception is passed on.  [phr] receives the
+** reason the page couldn't be read. */
+static int FilterPageError(const EXCEPTION_POINTERS* pException, HRESULT* phr) {
+	const EXCEPTION_RECORD* Record = pException->ExceptionRecord;
+
+	if (Record->ExceptionCode != EXCEPTION_IN_PAGE_ERROR) {
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+
+	// The third parameter is the NTSTATUS of the read that failed
+	*phr = Record->NumberParameters >= 3 ? HRESULT_FROM_NT(LONG(Record->ExceptionInformation[2])) : HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+
+	return EXCEPTION_EXECUTE_HANDLER;
+}
+
+CAudioGraphWaveDecoder::CAudioGraphWaveDecoder() :
+m_FileHandle(INVALID_HANDLE_VALUE),
+m_Mapping(NULL),
+m_View(nullptr),
+m_Size(0),
+m_Frames(nullptr),
+m_NumFrames(0),
+m_BlockAlign(0),
+m_Channels(0),
+m_FileRate(0),
+m_Position(0),
+m_Kernel(nullptr)
+{ }
+
+CAudioGraphWaveDecoder::~CAudioGraphWaveDecoder() {
+	if (m_View != nullptr) {
+		UnmapViewOfFile(m_View);
+	}
+
+	if (m_Mapping != NULL) {
+		CloseHandle(m_Mapping);
+	}
+
+	if (m_FileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_FileHandle);
+	}
+}
+
+HRESULT CAudioGraphWaveDecoder::Initialize(LPCWSTR Filename, UINT SampleRate, UINT Channels) {
+	LARGE_INTEGER FileSize;
+
+	m_FileHandle = CreateFileW (
+		Filename,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		NULL,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+
+	if (m_FileHandle == INVALID_HANDLE_VALUE) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	if (!GetFileSizeEx(m_FileHandle, &FileSize)) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	// The whole file is mapped at once, which a 32-bit process can't do for files of several gigabytes
+	if (FileSize.QuadPart < 12 || UINT64(FileSize.QuadPart) > UINT64(SIZE_T(-1))) {
+		return E_NOTIMPL;
+	}
+
+	m_Size = UINT64(FileSize.QuadPart);
+
+	m_Mapping = CreateFileMappingW (
+		m_FileHandle,
+		NULL,
+		PAGE_READONLY,
+		0,
+		0,
+		NULL
+	);
+
+	if (m_Mapping == NULL) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	m_View = reinterpret_cast<const BYTE*>(MapViewOfFile (
+		m_Mapping,
+		FILE_MAP_READ,
+		0,
+		0,
+		0
+	));
+
+	if (m_View == nullptr) {
+		return HRESULT_FROM_WIN32(GetLastError());
+	}
+
+	HRESULT hr = S_OK;
+
+	__try {
+		hr = Parse(SampleRate, Channels);
+	} __except (FilterPageError(GetExceptionInformation(), &hr)) { }
+
+	return hr;
+}
+
+HRESULT CAudioGraphWaveDecoder::Parse(UINT SampleRate, UINT Channels) {
+	WAVEFORMATEXTENSIBLE Format;
+	DWORD FormatSize = 0;
+	UINT64 DataSize = 0;
+	const BYTE* Chunk = m_View + 12;
+	const BYTE* End = m_View + m_Size;
+
+	ZeroMemory(&Format, sizeof(Format));
+
+	if (memcmp(m_View, "RIFF", 4) != 0 || memcmp(m_View + 8, "WAVE", 4) != 0) {
+		return E_INVALIDARG;
+	}
+
+	while (End - Chunk >= 8) {
+		const BYTE* Body = Chunk + 8;
+		const UINT64 Available = UINT64(End - Body);
+		DWORD ChunkSize = 0;
+
+		memcpy(&ChunkSize, Chunk + 4, sizeof(ChunkSize));
+
+		if (memcmp(Chunk, "fmt ", 4) == 0) {
+			if (ChunkSize < 16 || ChunkSize > Available) {
+				return E_INVALIDARG;
+			}
+
+			FormatSize = ChunkSize;
+			memcpy(&Format, Body, std::min(SIZE_T(ChunkSize), sizeof(Format)));
+		} else if (memcmp(Chunk, "data", 4) == 0) {
+			if (FormatSize == 0) {
+				return E_INVALIDARG;
+			}
+
+			// A file that was cut off while it was written claims more data than it has, so only the
+			// frames that are actually there are played
+			m_Frames = Body;
+			DataSize = std::min(UINT64(ChunkSize), Available);
+			break;
+		}
+
+		// Chunks are padded to an even length
+		const UINT64 Skip = 8 + UINT64(ChunkSize) + (ChunkSize & 1);
+
+		if (Skip > UINT64(End - Chunk)) {
+			break;
+		}
+
+		Chunk += Skip;
+	}
+
+	if (m_Frames == nullptr) {
+		return E_INVALIDARG;
+	}
+
+	// The kernels take their format as a WAVEFORMATEXTENSIBLE, so plain PCM and float formats are described as one
+	if (Format.Format.wFormatTag == WAVE_FORMAT_PCM) {
+		Format.SubFormat = KSDATAFORMAT_SUBTYPE_PCM;
+	} else if (Format.Format.wFormatTag == WAVE_FORMAT_IEEE_FLOAT) {
+		Format.SubFormat = KSDATAFORMAT_SUBTYPE_IEEE_FLOAT;
+	} else if (Format.Format.wFormatTag != WAVE_FORMAT_EXTENSIBLE || FormatSize < sizeof(WAVEFORMATEXTENSIBLE)) {
+		return E_NOTIMPL;
+	}
+
+	const WORD Bits = Format.Format.wBitsPerSample;
+
+	// Samples narrower than their container are left-justified, so they read just like full-width ones
+	Format.Samples.wValidBitsPerSample = Bits;
+
+	if (Format.SubFormat == KSDATAFORMAT_SUBTYPE_PCM) {
+		if (Bits != 16 && Bits != 24 && Bits != 32) {
+			return E_NOTIMPL;
+		}
+	} else if (Format.SubFormat != KSDATAFORMAT_SUBTYPE_IEEE_FLOAT || Bits != 32) {
+		return E_NOTIMPL;
+	}
+
+	// Resampling and mixing are left to Media Foundation
+	if (Format.Format.nSamplesPerSec != SampleRate || Format.Format.nChannels != Channels) {
+		return E_NOTIMPL;
+	}
+
+	if (Format.Format.nBlockAlign != Channels * (Bits / 8)) {
+		return E_INVALIDARG;
+	}
+
+	m_Channels = Channels;
+	m_FileRate = SampleRate;
+	m_BlockAlign = Format.Format.nBlockAlign;
+	m_NumFrames = DataSize / m_BlockAlign;
+	m_Kernel = Format.SubFormat == KSDATAFORMAT_SUBTYPE_PCM && Bits == 24 ? ReadWaveInt24 : SelectReadKernel(&Format, Channels);
+
+	return S_OK;
+}
+
+HRESULT CAudioGraphWaveDecoder::Seek(UINT64 Frame) {
+	m_Position = std::min(Frame, m_NumFrames);
+
+	return S_OK;
+}
+
+HRESULT CAudioGraphWaveDecoder::Read(FLOAT* OutputBuffer, UINT Frames, UINT* pFramesRead) {
+	HRESULT hr = S_OK;
+
+	*pFramesRead = 0;
+	Frames = UINT(std::min(UINT64(Frames), m_NumFrames - m_Position));
+
+	if (Frames == 0) {
+		return S_OK;
+	}
+
+	// A page the streaming thread hasn't read in yet is read from the disk right here
+	RealtimeBlockingCall();
+
+	__try {
+		m_Kernel (
+			m_Frames + m_Position * m_BlockAlign,
+			OutputBuffer,
+			Frames,
+			m_Channels,
+			m_Channels
+		);
+	} __except (FilterPageError(GetExceptionInformation(), &hr)) {
+		return hr;
+	}
+
+	m_Position += Frames;
+	*pFramesRead = Frames;
+
+	return S_OK;
+}
+
+HRESULT CAudioGraphWaveDecoder::Touch(UINT64 Frame, UINT64 Frames) {
+	HRESULT hr = S_OK;
+
+	Frame = std::min(Frame, m_NumFrames);
+	Frames = std::min(Frames, m_NumFrames - Frame);
+
+	if (Frames == 0) {
+		return S_OK;
+	}
+
+	// Pages that aren't in memory yet are read from the file by the first access to them, so reading a byte
+	// of each one here saves the thread that decodes them from waiting on the disk
+	const volatile BYTE* First = m_Frames + Frame * m_BlockAlign;
+	const volatile BYTE* Last = First + Frames * m_BlockAlign - 1;
+	BYTE Touched = 0;
+
+	__try {
+		for (const volatile BYTE* Page = First; Page < Last; Page += AUDIO_GRAPH_WAVE_PAGE_SIZE) {
+			Touched ^= *Page;
+		}
+
+		Touched ^= *Last;
+	} __except (FilterPageError(GetExceptionInformation(), &hr)) {
+		return hr;
+	}
+
+	return S_OK;
+}
\ No newline at end of file
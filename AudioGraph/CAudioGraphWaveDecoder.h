@@ -0,0 +1,86 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <Windows.h>
+
+#include "CAudioGraphDecoder.h"
+#include "SampleKernels.h"
+
+/* The stride Touch() reads the mapping with - the page size of every processor Windows runs on. */
+static const UINT AUDIO_GRAPH_WAVE_PAGE_SIZE = 4096;
+
+/* CAudioGraphWaveDecoder reads PCM WAV files through a memory mapping.  The frames are converted to floating-point
+** with the same kernels the endpoints use, straight out of the mapping, and a seek is just an index into it.  Only
+** files that are already at the stream's rate and channel count are decoded - anything else is left to Media
+** Foundation, which can resample and mix them. */
+class CAudioGraphWaveDecoder : public CAudioGraphDecoder {
+public:
+	CAudioGraphWaveDecoder();
+
+	~CAudioGraphWaveDecoder();
+
+	//CAudioGraphDecoder methods
+
+	/* Returns the sample rate of the file. */
+	UINT GetFileRate() final {
+		return m_FileRate;
+	}
+
+	/* Returns the frame that the next Read() starts on. */
+	UINT64 GetPosition() final {
+		return m_Position;
+	}
+
+	/* Moves to [Frame]. */
+	HRESULT Seek(UINT64 Frame) final;
+
+	/* Converts up to [Frames] frames into [OutputBuffer]. */
+	HRESULT Read(FLOAT* OutputBuffer, UINT Frames, UINT* pFramesRead) final;
+
+	/* Faults in the pages of the mapping that hold [Frames] frames from [Frame]. */
+	HRESULT Touch(UINT64 Frame, UINT64 Frames) final;
+
+	//New methods
+
+	/* Maps [Filename] and finds its frames.  Returns E_NOTIMPL if the file is a WAV file this decoder can't read
+	** as [Channels] channels at [SampleRate]. */
+	HRESULT Initialize(LPCWSTR Filename, UINT SampleRate, UINT Channels);
+
+private:
+	HANDLE m_FileHandle; //The mapped file, or INVALID_HANDLE_VALUE
+	HANDLE m_Mapping; //The file mapping, or NULL
+	const BYTE* m_View; //The whole file, or nullptr
+	UINT64 m_Size; //Size of the file in bytes
+
+	const BYTE* m_Frames; //The first frame of the "data" chunk
+	UINT64 m_NumFrames; //Complete frames in the "data" chunk
+	UINT m_BlockAlign; //Bytes per frame
+	UINT m_Channels; //Channels in a frame
+	UINT m_FileRate; //Frames per second
+	UINT64 m_Position; //The next frame to read
+	SAMPLE_READ_KERNEL m_Kernel; //Converts the file's frames to floating-point
+
+	/* Finds the "fmt " and "data" chunks, and checks that the format can be read as it is. */
+	HRESULT Parse(UINT SampleRate, UINT Channels);
+};
\ No newline at end of file
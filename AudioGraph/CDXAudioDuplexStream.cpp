@@ -22,19 +22,42 @@
 
 #include "CDXAudioDuplexStream.h"
 #include <math.h>
+#include <algorithm>
 
 #define FILENAME L"CDXAudioDuplexStream.cpp"
 #define HANDLE_HR(Line) if (FAILED(HandleHR(Line, hr))) return
 #define HALT_HR() if (FAILED(hr) && hr != AUDCLNT_E_DEVICE_INVALIDATED) { Halt(); return; }
 
+//How much of each period's ring fill goes into the running average
+static const DOUBLE DRIFT_SMOOTHING = 0.02;
+
+//Correction applied per second of averaged latency error - 10ms off trims the ratio by 1000ppm
+static const DOUBLE DRIFT_PROPORTIONAL = 0.1;
+
+//How quickly the latency error accumulates into the part of the correction that tracks the clocks' difference
+static const DOUBLE DRIFT_INTEGRAL = 0.01;
+
+//The largest correction ever applied - real clocks are well within this, and it keeps the pitch change inaudible
+static const DOUBLE DRIFT_MAX_CORRECTION = 0.002;
+
+//Periods of input the ring can hold beyond the target, before captured frames start being dropped
+static const UINT RING_SPARE_PERIODS = 8;
+
 //Zero out all data
 CDXAudioDuplexStream::CDXAudioDuplexStream() :
 m_ClientReader(*this),
 m_ClientWriter(*this),
 m_InputDeviceID(nullptr),
 m_OutputDeviceID(nullptr),
-m_Running(false)
-{ }
+m_Running(false),
+m_Latency(0),
+m_TargetFrames(0),
+m_AverageFill(-1.0),
+m_DriftIntegral(0.0)
+{
+	//The output follows the input's clock by trimming its resample ratio, so it always needs a resampler
+	m_ClientWriter.SetAdaptive(true);
+}
 
 //Close the thread before releasing data/COM objects
 CDXAudioDuplexStream::~CDXAudioDuplexStream() {
@@ -52,7 +75,7 @@ CDXAudioDuplexStream::~CDXAudioDuplexStream() {
 	}
 }
 
-HRESULT CDXAudioDuplexStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioDuplexStream::Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -70,10 +93,13 @@ HRESULT CDXAudioDuplexStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDX
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
+	m_SampleRate = pDesc->SampleRate;
+	m_Channels = pDesc->Channels != 0 ? pDesc->Channels : 2;
+	m_Quality = pDesc->Quality;
+	m_Latency = pDesc->Latency;
 
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(Callback, pDesc);
 
 	if (FAILED(hr)) return E_FAIL;
 
@@ -117,6 +143,7 @@ VOID CDXAudioDuplexStream::ImplInitialize() {
 //Start the stream(s)
 VOID CDXAudioDuplexStream::ImplStart() {
 	m_Running = true;
+	ResetRing();
 	m_ClientReader.Start();
 	m_ClientWriter.Start();
 }
@@ -251,8 +278,11 @@ VOID CDXAudioDuplexStream::ImplProcess() {
 	//m_ClientReader.GetPeriodFrames() returns the frames needed at the endpoint sample rate,
 	//so we need to multiply by the resample ratio to get the correct number of frames.
 	UINT InputBufferSize = (UINT)(ceil((DOUBLE)(m_ClientReader.GetPeriodFrames()) * m_ClientReader.GetRatio()));
-	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
+	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
 	UINT FramesRead = 0;
+	UINT FramesQueued = 0;
+	UINT32 EndpointFrames = 0;
+	UINT Frames = 0;
 
 	//Read the resampled data from the device
 	m_ClientReader.Read (
@@ -261,21 +291,153 @@ VOID CDXAudioDuplexStream::ImplProcess() {
 		FramesRead
 	);
 
-	//Generate an output buffer of equal size to the input buffer, also on the stack
-	FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * FramesRead));
-
-	//Give the application the input data and tell it to generate output
-	m_ReadWriteCallback->OnProcess (
-		m_SampleRate,
+	//Queue it for the output - the ring only fills up if the output has stopped taking frames
+	FramesQueued = m_Ring.Write (
 		InputBuffer,
-		OutputBuffer,
 		FramesRead
 	);
 
-	//Write this data to the stream
-	m_ClientWriter.Write (
-		OutputBuffer,
-		FramesRead
+	if (FramesQueued < FramesRead) {
+		GetCounters().AddDroppedFrames(FramesRead - FramesQueued);
+	}
+
+	//Find out how much the output endpoint needs to stay topped up
+	hr = m_ClientWriter.GetFramesWritable (
+		EndpointFrames
+	); HALT_HR();
+
+	//If the output is being re-initialized, keep queueing until it's back
+	if (FAILED(hr)) return;
+
+	//Take that much from the ring, converted to the application's sample rate at the corrected ratio
+	Frames = (UINT)((DOUBLE)(EndpointFrames) / m_ClientWriter.GetCorrectedRatio());
+
+	if (Frames > m_Ring.GetFill()) {
+		Frames = m_Ring.GetFill();
+	}
+
+	if (Frames != 0) {
+		//The frames taken are handed to the application where they lie in the ring, unless they wrap around its end
+		FLOAT* RingBuffer = m_Ring.Peek(Frames);
+		const bool InPlace = RingBuffer != nullptr;
+
+		//The output is always resampled, to follow the input's clock, so it needs a buffer on the stack
+		FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * Frames));
+
+		if (!InPlace) {
+			RingBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * Frames));
+
+			m_Ring.Read (
+				RingBuffer,
+				Frames
+			);
+		}
+
+		//Give the application the input data and tell it to generate output
+		m_ReadWriteCallback->OnProcess (
+			m_SampleRate,
+			RingBuffer,
+			OutputBuffer,
+			Frames
+		);
+
+		if (InPlace) {
+			m_Ring.Skip(Frames);
+		}
+
+		//Write this data to the stream
+		m_ClientWriter.Write (
+			OutputBuffer,
+			Frames
+		);
+	}
+
+	UpdateDrift();
+}
+
+VOID CDXAudioDuplexStream::AllocateRing() {
+	//The input period at the application's sample rate
+	UINT PeriodFrames = (UINT)(ceil((DOUBLE)(m_ClientReader.GetPeriodFrames()) * m_ClientReader.GetRatio()));
+
+	//Without a requested latency, hold back one input period, which covers the input waking a little late
+	if (m_Latency != 0) {
+		m_TargetFrames = (UINT)((DOUBLE)(m_Latency) * m_SampleRate / 1000.0);
+	} else {
+		m_TargetFrames = PeriodFrames;
+	}
+
+	GetCounters().SetTargetLatency (
+		LONGLONG((DOUBLE)(m_TargetFrames) * 10000000.0 / m_SampleRate)
+	);
+
+	//Besides the target, the ring has to hold the periods read while the output isn't taking any,
+	//and whatever the output asks for in one go, which is up to the two periods its buffer is topped up to
+	UINT OutputFrames = 0;
+
+	if (m_ClientWriter.GetRatio() != 0.0) {
+		OutputFrames = (UINT)(ceil((DOUBLE)(m_ClientWriter.GetPeriodFrames()) * 2.0 / m_ClientWriter.GetRatio()));
+	}
+
+	m_Ring.Allocate (
+		m_TargetFrames + PeriodFrames * RING_SPARE_PERIODS + OutputFrames,
+		m_Channels
+	);
+
+	//The endpoint that changed has been re-initialized, so the stream starts over from the target
+	if (m_Running) {
+		ResetRing();
+	}
+}
+
+VOID CDXAudioDuplexStream::ResetRing() {
+	m_Ring.Clear();
+
+	//Starting out at the target means the correction only ever has to deal with drift
+	m_Ring.WriteSilence (
+		m_TargetFrames
+	);
+
+	m_AverageFill = -1.0;
+	m_DriftIntegral = 0.0;
+	m_ClientWriter.SetRatioCorrection(1.0);
+}
+
+VOID CDXAudioDuplexStream::UpdateDrift() {
+	const DOUBLE Fill = (DOUBLE)(m_Ring.GetFill());
+	const DOUBLE Period = (DOUBLE)(m_ClientReader.GetPeriod()) / 10000000.0;
+
+	//The fill jumps around from period to period as the endpoints wake out of step, so the drift is
+	//measured from its average instead
+	if (m_AverageFill < 0.0) {
+		m_AverageFill = Fill;
+	} else {
+		m_AverageFill += (Fill - m_AverageFill) * DRIFT_SMOOTHING;
+	}
+
+	//The error in seconds, positive if too much is being held back
+	DOUBLE Error = (m_AverageFill - (DOUBLE)(m_TargetFrames)) / m_SampleRate;
+	DOUBLE Instant = (Fill - (DOUBLE)(m_TargetFrames)) / m_SampleRate;
+
+	//The integral settles on the difference between the clocks, and the proportional term pulls the fill back to the target
+	m_DriftIntegral += Error * DRIFT_INTEGRAL * Period;
+	m_DriftIntegral = std::max(-DRIFT_MAX_CORRECTION, std::min(DRIFT_MAX_CORRECTION, m_DriftIntegral));
+
+	DOUBLE Correction = Error * DRIFT_PROPORTIONAL + m_DriftIntegral;
+	Correction = std::max(-DRIFT_MAX_CORRECTION, std::min(DRIFT_MAX_CORRECTION, Correction));
+
+	//Too much held back means the input runs fast, so the output has to get through its frames quicker,
+	//producing fewer endpoint frames from each of them - a lower ratio
+	DOUBLE RatioCorrection = 1.0 / (1.0 + Correction);
+
+	m_ClientWriter.SetRatioCorrection(RatioCorrection);
+
+	GetCounters().SetLatencyError (
+		LONGLONG(Error * 10000000.0),
+		LONGLONG(Instant * 10000000.0)
+	);
+
+	GetCounters().SetDriftCorrection (
+		LONGLONG((RatioCorrection - 1.0) * 1000000.0)
 	);
 }
 
@@ -286,10 +448,14 @@ VOID CDXAudioDuplexStream::InitClientReader() {
 	HRESULT hr = m_ClientReader.Initialize (
 		false,
 		m_SampleRate,
+		m_Channels,
+		m_Quality,
 		GetWaitEvent(),
 		m_InputDevice,
 		Callback
 	); HALT_HR();
+
+	AllocateRing();
 }
 
 //Initialize the client writer
@@ -298,10 +464,16 @@ VOID CDXAudioDuplexStream::InitClientWriter() {
 
 	HRESULT hr = m_ClientWriter.Initialize (
 		m_SampleRate,
+		m_Channels,
+		m_Quality,
 		NULL,
 		m_OutputDevice,
 		Callback
 	); HALT_HR();
+
+	GetCounters().SetOutputPath(m_ClientWriter.IsDirect() ? DXAUDIO_OUTPUT_PATH_DIRECT : DXAUDIO_OUTPUT_PATH_CONVERTED);
+
+	AllocateRing();
 }
 
 //Handle bad or good HRESULTS
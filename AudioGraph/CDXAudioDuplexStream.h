@@ -29,6 +29,7 @@
 #include "CDXAudioStream.h"
 #include "ClientReader.h"
 #include "ClientWriter.h"
+#include "CDXAudioFrameRing.h"
 
 /* This class is a final implementation of IDXAudioStream.  It is used for streams
 ** that both read/write data to/from the default audio input/output endpoints. */
@@ -64,14 +65,15 @@ public:
 	** if not, the client is re-initialized */
 	VOID ImplPropertyChange() final;
 
-	/* Reads data from the input stream, calls Process() on the callback object, then writes the given data
-	** to the output stream. */
+	/* Queues data from the input stream, then takes as much of it as the output stream needs, calls Process()
+	** on the callback object, and writes the given data to the output stream.  The output is resampled at a
+	** slightly corrected ratio to keep the queue at its target, since the two endpoints run on separate clocks. */
 	VOID ImplProcess() final;
 
 	//New methods
 
 	/* Checks to see if the callback is valid, then calls CDXAudioStream::Initialize() */
-	HRESULT Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback);
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback);
 
 private:
 	CComPtr<IMMDevice> m_InputDevice; //The device we're reading from
@@ -82,6 +84,11 @@ private:
 	ClientReader m_ClientReader; //Used for reading input data from the stream
 	ClientWriter m_ClientWriter; //Used for writing output data to the stream
 	bool m_Running; //Indicates whether or not the stream is running (used for routing)
+	CDXAudioFrameRing m_Ring; //Captured frames waiting for the output, at the application's sample rate
+	UINT m_Latency; //The requested target latency in milliseconds, or 0 for one input period
+	UINT m_TargetFrames; //The number of frames the ring is steered towards
+	DOUBLE m_AverageFill; //The ring's fill after each period, smoothed, or negative before the first period
+	DOUBLE m_DriftIntegral; //The accumulated part of the drift correction, which settles on the clocks' actual difference
 
 	/* Initializes the client reader object */
 	VOID InitClientReader();
@@ -89,6 +96,15 @@ private:
 	/* Initializes the client writer object */
 	VOID InitClientWriter();
 
+	/* Sizes the ring for the current endpoints and target latency.  If the stream is running, the ring is primed again. */
+	VOID AllocateRing();
+
+	/* Empties the ring, primes it with the target latency's worth of silence and forgets the measured drift. */
+	VOID ResetRing();
+
+	/* Measures how far the ring's fill is from the target, and corrects the output resample ratio to bring it back. */
+	VOID UpdateDrift();
+
 	/* Responds to an HRESULT - if there is a failure, it will call the OnObjectFailure() method
 	** on the callback object.  Otherwise, it will return S_OK. */
 	HRESULT HandleHR(UINT Line, HRESULT hr);
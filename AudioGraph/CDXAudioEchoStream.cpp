@@ -46,7 +46,7 @@ CDXAudioEchoStream::~CDXAudioEchoStream() {
 	}
 }
 
-HRESULT CDXAudioEchoStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioEchoStream::Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -64,10 +64,12 @@ HRESULT CDXAudioEchoStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAu
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
+	m_SampleRate = pDesc->SampleRate;
+	m_Channels = pDesc->Channels != 0 ? pDesc->Channels : 2;
+	m_Quality = pDesc->Quality;
 
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(Callback, pDesc);
 
 	if (FAILED(hr)) return E_FAIL;
 
@@ -196,7 +198,7 @@ VOID CDXAudioEchoStream::ImplProcess() {
 	//m_ClientReader.GetPeriodFrames() returns the frames needed at the endpoint sample rate,
 	//so we need to multiply by the resample ratio to get the correct number of frames.
 	UINT InputBufferSize = (UINT)(ceil((DOUBLE)(m_ClientReader.GetPeriodFrames()) * m_ClientReader.GetRatio()));
-	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
+	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
 	UINT FramesRead = 0;
 
 	//Read the resampled data from the device
@@ -206,8 +208,14 @@ VOID CDXAudioEchoStream::ImplProcess() {
 		FramesRead
 	);
 
-	//Generate an output buffer of equal size to the input buffer, also on the stack
-	FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * FramesRead));
+	//If the endpoint takes the application's frames as they are, the application writes straight into its buffer
+	FLOAT* EndpointBuffer = m_ClientWriter.IsDirect() ? m_ClientWriter.BeginWrite(FramesRead) : nullptr;
+	FLOAT* OutputBuffer = EndpointBuffer;
+
+	//Otherwise, generate an output buffer of equal size to the input buffer, also on the stack
+	if (OutputBuffer == nullptr) {
+		OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * FramesRead));
+	}
 
 	//Give the application the input data and tell it to generate output
 	m_ReadWriteCallback->OnProcess (
@@ -218,10 +226,16 @@ VOID CDXAudioEchoStream::ImplProcess() {
 	);
 
 	//Write this data to the stream
-	m_ClientWriter.Write (
-		OutputBuffer,
-		FramesRead
-	);
+	if (EndpointBuffer != nullptr) {
+		m_ClientWriter.EndWrite (
+			FramesRead
+		);
+	} else if (!m_ClientWriter.IsDirect()) {
+		m_ClientWriter.Write (
+			OutputBuffer,
+			FramesRead
+		);
+	}
 }
 
 //Initialize the client reader
@@ -231,6 +245,8 @@ VOID CDXAudioEchoStream::InitClientReader() {
 	HRESULT hr = m_ClientReader.Initialize (
 		true,
 		m_SampleRate,
+		m_Channels,
+		m_Quality,
 		NULL,
 		m_OutputDevice,
 		Callback
@@ -243,10 +259,14 @@ VOID CDXAudioEchoStream::InitClientWriter() {
 
 	HRESULT hr = m_ClientWriter.Initialize (
 		m_SampleRate,
+		m_Channels,
+		m_Quality,
 		GetWaitEvent(),
 		m_OutputDevice,
 		Callback
 	); HALT_HR();
+
+	GetCounters().SetOutputPath(m_ClientWriter.IsDirect() ? DXAUDIO_OUTPUT_PATH_DIRECT : DXAUDIO_OUTPUT_PATH_CONVERTED);
 }
 
 //Handle bad or good HRESULTS
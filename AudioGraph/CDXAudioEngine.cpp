@@ -0,0 +1,378 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "CDXAudioEngine.h"
+#include "CDXAudioStream.h"
+#include "CMMNotificationClient.h"
+#include <avrt.h>
+
+#pragma comment(lib, "avrt.lib")
+
+#define FILENAME L"CDXAudioEngine.cpp"
+#define EVENT_INIT(x, Line) x = CreateEventW(NULL, FALSE, FALSE, NULL); if (x == NULL) { m_Callback->OnObjectFailure(FILENAME, Line, HRESULT_FROM_WIN32(GetLastError())); return E_FAIL; }
+#define EVENT_CLEANUP(x) if (x != NULL) { CloseHandle(x); x = NULL; }
+#define CHECK_HR(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return hr; }
+
+//Every running engine, so that streams can find one with room for them
+static SRWLOCK s_EngineLock = SRWLOCK_INIT;
+static CDXAudioEngine* s_Engines = nullptr;
+
+CDXAudioEngine::CDXAudioEngine() :
+m_Next(nullptr),
+m_Attached(0),
+m_NumPending(0),
+m_NumStreams(0),
+m_WakeEvent(NULL),
+m_HaltEvent(NULL),
+m_ReadyEvent(NULL),
+m_Thread(NULL)
+{
+	InitializeCriticalSection(&m_Lock);
+}
+
+CDXAudioEngine::~CDXAudioEngine() {
+	if (m_Thread != NULL) {
+		SetEvent(m_HaltEvent);
+		WaitForSingleObject(m_Thread, INFINITE);
+		CloseHandle(m_Thread);
+		m_Thread = NULL;
+	}
+
+	EVENT_CLEANUP(m_WakeEvent);
+	EVENT_CLEANUP(m_HaltEvent);
+	EVENT_CLEANUP(m_ReadyEvent);
+
+	DeleteCriticalSection(&m_Lock);
+}
+
+HRESULT CDXAudioEngine::Attach(CDXAudioStream* pStream, IDXAudioCallback* pCallback, CDXAudioEngine** ppEngine) {
+	HRESULT hr = S_OK;
+	CDXAudioEngine* Engine = nullptr;
+
+	AcquireSRWLockExclusive(&s_EngineLock);
+
+	for (Engine = s_Engines; Engine != nullptr; Engine = Engine->m_Next) {
+		if (Engine->m_Attached < DXAUDIO_ENGINE_CAPACITY) {
+			break;
+		}
+	}
+
+	//Every engine is full (or there are none yet), so start another one
+	if (Engine == nullptr) {
+		Engine = new CDXAudioEngine();
+
+		hr = Engine->Initialize(pCallback);
+
+		if (FAILED(hr)) {
+			ReleaseSRWLockExclusive(&s_EngineLock);
+			delete Engine;
+			return hr;
+		}
+
+		Engine->m_Next = s_Engines;
+		s_Engines = Engine;
+	}
+
+	Engine->m_Attached++;
+
+	ReleaseSRWLockExclusive(&s_EngineLock);
+
+	//The stream is initialized by the engine thread, since the enumerator lives in its apartment
+	EnterCriticalSection(&Engine->m_Lock);
+	Engine->m_Pending[Engine->m_NumPending++] = pStream;
+	LeaveCriticalSection(&Engine->m_Lock);
+
+	Engine->Wake();
+
+	*ppEngine = Engine;
+
+	return S_OK;
+}
+
+VOID CDXAudioEngine::Detach(CDXAudioStream* pStream) {
+	HANDLE Handles[] = {
+		pStream->m_DetachEvent,
+		m_Thread
+	};
+
+	//If the engine thread has died, it will never get around to detaching the stream
+	WaitForMultipleObjects(2, Handles, FALSE, INFINITE);
+
+	AcquireSRWLockExclusive(&s_EngineLock);
+
+	bool Last = --m_Attached == 0;
+
+	if (Last) {
+		CDXAudioEngine** ppEngine = &s_Engines;
+
+		while (*ppEngine != this) {
+			ppEngine = &(*ppEngine)->m_Next;
+		}
+
+		*ppEngine = m_Next;
+	}
+
+	ReleaseSRWLockExclusive(&s_EngineLock);
+
+	if (Last) {
+		delete this;
+	}
+}
+
+HRESULT CDXAudioEngine::Initialize(IDXAudioCallback* pCallback) {
+	m_Callback = pCallback;
+
+	EVENT_INIT(m_WakeEvent, __LINE__);
+	EVENT_INIT(m_HaltEvent, __LINE__);
+	EVENT_INIT(m_ReadyEvent, __LINE__);
+
+	m_Thread = CreateThread (
+		NULL,
+		0,
+		StaticEngineThreadEntry,
+		this,
+		NULL,
+		NULL
+	);
+
+	//If m_Thread is NULL, an error occurred
+	if (m_Thread == NULL) {
+		m_Callback->OnObjectFailure (
+			FILENAME,
+			__LINE__,
+			HRESULT_FROM_WIN32(GetLastError())
+		); return E_FAIL;
+	}
+
+	HANDLE Handles[] = {
+		m_ReadyEvent,
+		m_Thread
+	};
+
+	//If the thread exits instead of becoming ready, it has already reported why
+	DWORD dwResult = WaitForMultipleObjects(2, Handles, FALSE, INFINITE);
+
+	//Failures from here on belong to the streams, which report them through their own callbacks
+	m_Callback.Release();
+
+	if (dwResult != WAIT_OBJECT_0) {
+		return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+DWORD CDXAudioEngine::ServiceStreams(HANDLE* Handles) {
+	CDXAudioStream* Pending[DXAUDIO_ENGINE_CAPACITY];
+	UINT NumPending = 0;
+
+	EnterCriticalSection(&m_Lock);
+
+	for (UINT i = 0; i < m_NumPending; i++) {
+		Pending[i] = m_Pending[i];
+	}
+
+	NumPending = m_NumPending;
+	m_NumPending = 0;
+
+	LeaveCriticalSection(&m_Lock);
+
+	//Initialize the new streams outside of the lock, since this can take a while
+	//Streams on the Windows audio service share the engine's enumerator, but each stream on the null
+	//backend has its own simulated clock
+	for (UINT i = 0; i < NumPending; i++) {
+		if (Pending[i]->m_Backend == DXAUDIO_BACKEND_NULL) {
+			Pending[i]->CreateEnumerator();
+		} else {
+			Pending[i]->m_Enumerator = m_Enumerator;
+		}
+
+		Pending[i]->ThreadInitialize();
+
+		EnterCriticalSection(&m_Lock);
+		m_Streams[m_NumStreams++] = Pending[i];
+		LeaveCriticalSection(&m_Lock);
+	}
+
+	//Deliver messages, and let go of the streams that have been halted
+	for (UINT i = 0; i < m_NumStreams;) {
+		CDXAudioStream* Stream = m_Streams[i];
+
+		if (Stream->DispatchMessages()) {
+			i++;
+			continue;
+		}
+
+		EnterCriticalSection(&m_Lock);
+		m_Streams[i] = m_Streams[--m_NumStreams];
+		LeaveCriticalSection(&m_Lock);
+
+		SetEvent(Stream->m_DetachEvent);
+	}
+
+	Handles[0] = m_WakeEvent;
+	Handles[1] = m_HaltEvent;
+
+	for (UINT i = 0; i < m_NumStreams; i++) {
+		Handles[i + 2] = m_Streams[i]->GetWaitEvent();
+	}
+
+	return m_NumStreams + 2;
+}
+
+VOID CDXAudioEngine::OnDefaultDeviceChanged() {
+	//Notifications arrive on a thread of the audio service, so the list can't change underneath us
+	EnterCriticalSection(&m_Lock);
+
+	for (UINT i = 0; i < m_NumStreams; i++) {
+		if (m_Streams[i]->m_Backend == DXAUDIO_BACKEND_WASAPI) {
+			m_Streams[i]->OnDefaultDeviceChanged();
+		}
+	}
+
+	LeaveCriticalSection(&m_Lock);
+}
+
+VOID CDXAudioEngine::OnPropertyValueChanged() {
+	EnterCriticalSection(&m_Lock);
+
+	for (UINT i = 0; i < m_NumStreams; i++) {
+		if (m_Streams[i]->m_Backend == DXAUDIO_BACKEND_WASAPI) {
+			m_Streams[i]->OnPropertyValueChanged();
+		}
+	}
+
+	LeaveCriticalSection(&m_Lock);
+}
+
+DWORD __stdcall CDXAudioEngine::StaticEngineThreadEntry(LPVOID Data) {
+	CDXAudioEngine* l_Engine = reinterpret_cast<CDXAudioEngine*>(Data);
+
+	return l_Engine->EngineThreadEntry();
+}
+
+DWORD CDXAudioEngine::EngineThreadEntry() {
+	bool run = true;
+	DWORD dwResult = 0;
+	DWORD nEvents = 0;
+	UINT First = 0;
+	DWORD TaskIndex = 0;
+	HANDLE Task = NULL;
+	HRESULT hr = S_OK;
+	HANDLE Events[MAXIMUM_WAIT_OBJECTS];
+	HANDLE Turn[MAXIMUM_WAIT_OBJECTS];
+
+	static const DWORD EM_WAKE = WAIT_OBJECT_0;
+	static const DWORD EM_CLOSE = WAIT_OBJECT_0 + 1;
+	static const DWORD EM_PROCESS = WAIT_OBJECT_0 + 2;
+
+	//Initialize the COM server
+	hr = CoInitializeEx (
+		NULL,
+		COINIT_SPEED_OVER_MEMORY |
+		COINIT_APARTMENTTHREADED
+	); CHECK_HR(__LINE__);
+
+	//Create the device enumerator shared by all of the engine's streams
+	hr = CoCreateInstance (
+		__uuidof(MMDeviceEnumerator),
+		NULL,
+		CLSCTX_ALL,
+		__uuidof(IMMDeviceEnumerator),
+		(void**)(&m_Enumerator)
+	); if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, __LINE__, hr); CoUninitialize(); return hr; }
+
+	CMMNotificationClient NotificationClient(*this);
+
+	//Register the callback for default device / property changes once, for every stream
+	hr = m_Enumerator->RegisterEndpointNotificationCallback (
+		&NotificationClient
+	); if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, __LINE__, hr); m_Enumerator.Release(); CoUninitialize(); return hr; }
+
+	//The engine services many streams, so let MMCSS schedule it ahead of ordinary threads.
+	//This isn't fatal - without the service the engine just runs at normal priority.
+	Task = AvSetMmThreadCharacteristicsW (
+		L"Pro Audio",
+		&TaskIndex
+	);
+
+	SetEvent(m_ReadyEvent);
+
+	nEvents = ServiceStreams(Events);
+
+	while (run) {
+		const UINT NumStreams = nEvents - 2;
+
+		//The wait returns the first event that is set, so the streams take turns at coming first.  Otherwise a
+		//stream that's always ready by the time the engine waits again, like one on the null backend, would
+		//starve every stream after it.  The engine's own events always come first, since they're rare.
+		if (First >= NumStreams) {
+			First = 0;
+		}
+
+		Turn[0] = Events[0];
+		Turn[1] = Events[1];
+
+		memcpy(Turn + 2, Events + 2 + First, (NumStreams - First) * sizeof(HANDLE));
+		memcpy(Turn + 2 + NumStreams - First, Events + 2, First * sizeof(HANDLE));
+
+		//Wait for a message, or for any stream's period
+		dwResult = WaitForMultipleObjectsEx (
+			nEvents,
+			Turn,
+			FALSE,
+			INFINITE,
+			FALSE
+		);
+
+		if (dwResult == EM_WAKE) { //A stream has a message, or has been attached
+			nEvents = ServiceStreams(Events);
+		} else if (dwResult == EM_CLOSE) { //Close the engine
+			run = false;
+		} else if (dwResult >= EM_PROCESS && dwResult < WAIT_OBJECT_0 + nEvents) { //Process a stream, and put the one after it first
+			const UINT Stream = (First + (dwResult - EM_PROCESS)) % NumStreams;
+
+			m_Streams[Stream]->Process();
+
+			First = Stream + 1;
+		} else { //Error occurred
+			run = false;
+			hr = E_FAIL;
+		}
+	}
+
+	if (Task != NULL) {
+		AvRevertMmThreadCharacteristics(Task);
+	}
+
+	// Prevent any more notifications
+	m_Enumerator->UnregisterEndpointNotificationCallback (
+		&NotificationClient
+	);
+
+	m_Enumerator.Release();
+
+	CoUninitialize();
+
+	return hr;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include "DXAudio.h"
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include "CMMNotificationClientListener.h"
+
+class CDXAudioStream;
+
+/* The number of streams one engine thread can service.  The thread waits on one event per
+** stream, plus its own wake and halt events. */
+static const UINT DXAUDIO_ENGINE_CAPACITY = MAXIMUM_WAIT_OBJECTS - 2;
+
+/* CDXAudioEngine is a thread shared by streams created with DXAUDIO_STREAM_DESC_EX::Shared.  Rather than
+** every stream having its own thread, COM apartment, device enumerator and notification registration,
+** an engine has one of each and waits on the wait events of all of its streams at once.  Once an engine
+** is full, another one is started, and an engine closes once its last stream has been detached. */
+class CDXAudioEngine : public CMMNotificationClientListener {
+public:
+	/* Attaches a stream to an engine with room for it, starting one if there is none.  The stream is
+	** initialized on the engine thread, which sets its init event once done.  [pCallback] is used to
+	** report a failure to start the engine. */
+	static HRESULT Attach(CDXAudioStream* pStream, IDXAudioCallback* pCallback, CDXAudioEngine** ppEngine);
+
+	/* Waits for the engine thread to let go of a halted stream.  The engine must not be used by the
+	** stream after this, since it is closed along with its last stream. */
+	VOID Detach(CDXAudioStream* pStream);
+
+	/* Wakes the engine thread so that it looks at the messages of its streams. */
+	VOID Wake() {
+		SetEvent(m_WakeEvent);
+	}
+
+	/* Returns a handle to the engine thread. */
+	HANDLE GetThread() {
+		return m_Thread;
+	}
+
+private:
+	CDXAudioEngine();
+
+	~CDXAudioEngine();
+
+	CComPtr<IDXAudioCallback> m_Callback; //Used for error reporting while the engine starts
+	CComPtr<IMMDeviceEnumerator> m_Enumerator; //Shared by every stream on the engine that's on the Windows audio service
+
+	CDXAudioEngine* m_Next; //Next engine in the list of running engines
+	UINT m_Attached; //Streams attached to the engine, guarded by the engine list lock
+
+	CRITICAL_SECTION m_Lock; //Guards m_Pending, and changes to m_Streams
+	CDXAudioStream* m_Pending[DXAUDIO_ENGINE_CAPACITY]; //Streams waiting to be initialized on the engine thread
+	UINT m_NumPending;
+	CDXAudioStream* m_Streams[DXAUDIO_ENGINE_CAPACITY]; //Streams being serviced - only changed by the engine thread
+	UINT m_NumStreams;
+
+	HANDLE m_WakeEvent; //Set whenever a stream has a message, or a stream is attached
+	HANDLE m_HaltEvent; //Used for closing the thread
+	HANDLE m_ReadyEvent; //Set by the thread once it's ready for streams
+	HANDLE m_Thread; //Handle to the engine thread
+
+	/* Starts the engine thread, and waits for it to be ready. */
+	HRESULT Initialize(IDXAudioCallback* pCallback);
+
+	/* Initializes newly attached streams, delivers messages, and detaches halted streams.
+	** Fills [Handles] with the events to wait on, and returns how many there are. */
+	DWORD ServiceStreams(HANDLE* Handles);
+
+	//CMMNotificationClientListener methods
+
+	/* Forwarded to every stream on the engine */
+	virtual VOID OnDefaultDeviceChanged() final;
+
+	/* Forwarded to every stream on the engine */
+	virtual VOID OnPropertyValueChanged() final;
+
+	/* The static thread entry point */
+	static DWORD __stdcall StaticEngineThreadEntry(LPVOID Data);
+
+	/* The non-static thread entry point, called by StaticEngineThreadEntry() */
+	DWORD EngineThreadEntry();
+};
\ No newline at end of file
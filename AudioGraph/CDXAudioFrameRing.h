@@ -0,0 +1,157 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+#pragma once
+
+#include <Windows.h>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+/* CDXAudioFrameRing is a ring buffer of interleaved float frames.  It's used by duplex streams to hold captured
+** audio until the output endpoint is ready for it.  It is only ever touched by the stream thread, so it doesn't
+** lock, and it only allocates in Allocate(). */
+class CDXAudioFrameRing {
+public:
+	CDXAudioFrameRing() :
+	m_Channels(0),
+	m_Capacity(0),
+	m_Head(0),
+	m_Fill(0)
+	{ }
+
+	/* Makes room for [Frames] frames of [Channels] channels and empties the ring. */
+	VOID Allocate(UINT Frames, UINT Channels) {
+		m_Buffer.assign(SIZE_T(Frames) * Channels, 0.0f);
+		m_Channels = Channels;
+		m_Capacity = Frames;
+		Clear();
+	}
+
+	/* Empties the ring. */
+	VOID Clear() {
+		m_Head = 0;
+		m_Fill = 0;
+	}
+
+	/* Returns the number of frames waiting to be read. */
+	UINT GetFill() {
+		return m_Fill;
+	}
+
+	/* Appends up to [Frames] frames from [Buffer], and returns how many fit. */
+	UINT Write(const FLOAT* Buffer, UINT Frames) {
+		Frames = std::min(Frames, m_Capacity - m_Fill);
+
+		UINT Tail = m_Head + m_Fill;
+
+		if (Tail >= m_Capacity) {
+			Tail -= m_Capacity;
+		}
+
+		UINT First = std::min(Frames, m_Capacity - Tail); //Frames that fit before the end of the buffer
+
+		Copy(m_Buffer.data() + SIZE_T(Tail) * m_Channels, Buffer, First);
+		Copy(m_Buffer.data(), Buffer + SIZE_T(First) * m_Channels, Frames - First);
+
+		m_Fill += Frames;
+
+		return Frames;
+	}
+
+	/* Appends up to [Frames] frames of silence, and returns how many fit. */
+	UINT WriteSilence(UINT Frames) {
+		Frames = std::min(Frames, m_Capacity - m_Fill);
+
+		UINT Tail = m_Head + m_Fill;
+
+		if (Tail >= m_Capacity) {
+			Tail -= m_Capacity;
+		}
+
+		UINT First = std::min(Frames, m_Capacity - Tail);
+
+		Zero(m_Buffer.data() + SIZE_T(Tail) * m_Channels, First);
+		Zero(m_Buffer.data(), Frames - First);
+
+		m_Fill += Frames;
+
+		return Frames;
+	}
+
+	/* Removes up to [Frames] of the oldest frames into [Buffer], and returns how many there were. */
+	UINT Read(FLOAT* Buffer, UINT Frames) {
+		Frames = std::min(Frames, m_Fill);
+
+		UINT First = std::min(Frames, m_Capacity - m_Head); //Frames that can be read before the end of the buffer
+
+		Copy(Buffer, m_Buffer.data() + SIZE_T(m_Head) * m_Channels, First);
+		Copy(Buffer + SIZE_T(First) * m_Channels, m_Buffer.data(), Frames - First);
+
+		return Skip(Frames);
+	}
+
+	/* Returns the oldest [Frames] frames where they lie in the ring, or nullptr if there aren't that many or they wrap
+	** around the end of the buffer.  The frames stay in the ring until Skip() is called, and may be written over. */
+	FLOAT* Peek(UINT Frames) {
+		if (Frames == 0 || Frames > m_Fill || Frames > m_Capacity - m_Head) {
+			return nullptr;
+		}
+
+		return m_Buffer.data() + SIZE_T(m_Head) * m_Channels;
+	}
+
+	/* Removes up to [Frames] of the oldest frames without reading them, and returns how many there were. */
+	UINT Skip(UINT Frames) {
+		Frames = std::min(Frames, m_Fill);
+
+		m_Head += Frames;
+
+		if (m_Head >= m_Capacity) {
+			m_Head -= m_Capacity;
+		}
+
+		m_Fill -= Frames;
+
+		return Frames;
+	}
+
+private:
+	std::vector<FLOAT> m_Buffer; //The interleaved frames
+	UINT m_Channels; //The number of channels in a frame
+	UINT m_Capacity; //The number of frames the buffer can hold
+	UINT m_Head; //The index of the oldest frame
+	UINT m_Fill; //The number of frames waiting to be read
+
+	/* Copies [Frames] frames from [Source] to [Dest]. */
+	VOID Copy(FLOAT* Dest, const FLOAT* Source, UINT Frames) {
+		if (Frames != 0) {
+			memcpy(Dest, Source, sizeof(FLOAT) * m_Channels * Frames);
+		}
+	}
+
+	/* Zeroes [Frames] frames at [Dest]. */
+	VOID Zero(FLOAT* Dest, UINT Frames) {
+		if (Frames != 0) {
+			memset(Dest, 0, sizeof(FLOAT) * m_Channels * Frames);
+		}
+	}
+};
\ No newline at end of file
@@ -45,7 +45,7 @@ CDXAudioInputStream::~CDXAudioInputStream() {
 	}
 }
 
-HRESULT CDXAudioInputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioInputStream::Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -63,10 +63,12 @@ HRESULT CDXAudioInputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXA
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
+	m_SampleRate = pDesc->SampleRate;
+	m_Channels = pDesc->Channels != 0 ? pDesc->Channels : 2;
+	m_Quality = pDesc->Quality;
 
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(Callback, pDesc);
 
 	if (FAILED(hr)) return hr;
 
@@ -172,7 +174,7 @@ VOID CDXAudioInputStream::ImplProcess() {
 	//m_ClientReader.GetPeriodFrames() returns the frames needed at the endpoint sample rate,
 	//so we need to multiply by the resample ratio to get the correct number of frames.
 	UINT InputBufferSize = (UINT)(ceil((DOUBLE)(m_ClientReader.GetPeriodFrames()) * m_ClientReader.GetRatio()));
-	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
+	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
 	UINT FramesRead = 0; //Used to find out how many frames were actually read
 
 	//Read the input data from the stream
@@ -197,6 +199,8 @@ VOID CDXAudioInputStream::InitClientReader() {
 	HRESULT hr = m_ClientReader.Initialize (
 		false,
 		m_SampleRate,
+		m_Channels,
+		m_Quality,
 		GetWaitEvent(),
 		m_InputDevice,
 		Callback
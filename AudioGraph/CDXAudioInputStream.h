@@ -69,7 +69,7 @@ public:
 	//New methods
 
 	/* Checks to see if the callback is valid, then calls CDXAudioStream::Initialize() */
-	HRESULT Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback);
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback);
 
 private:
 	CComPtr<IMMDevice> m_InputDevice; //The device we're reading from
@@ -46,7 +46,7 @@ CDXAudioLoopbackStream::~CDXAudioLoopbackStream() {
 	}
 }
 
-HRESULT CDXAudioLoopbackStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioLoopbackStream::Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -64,10 +64,12 @@ HRESULT CDXAudioLoopbackStream::Initialize(FLOAT SampleRate, IDXAudioCallback* p
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
+	m_SampleRate = pDesc->SampleRate;
+	m_Channels = pDesc->Channels != 0 ? pDesc->Channels : 2;
+	m_Quality = pDesc->Quality;
 
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(Callback, pDesc);
 
 	if (FAILED(hr)) return E_FAIL;
 
@@ -196,7 +198,7 @@ VOID CDXAudioLoopbackStream::ImplProcess() {
 	//m_ClientReader.GetPeriodFrames() returns the frames needed at the endpoint sample rate,
 	//so we need to multiply by the resample ratio to get the correct number of frames.
 	UINT InputBufferSize = (UINT)(ceil((DOUBLE)(m_ClientReader.GetPeriodFrames()) * m_ClientReader.GetRatio()));
-	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
+	FLOAT* InputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * InputBufferSize)); //Create the buffer on the stack (_alloca is safe here)
 	UINT FramesRead = 0;
 
 	//Read the resampled data from the device
@@ -214,8 +216,8 @@ VOID CDXAudioLoopbackStream::ImplProcess() {
 	);
 
 	//Generate a "fake" output buffer with silence to appease the render stream
-	FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * FramesRead));
-	ZeroMemory(OutputBuffer, sizeof(FLOAT) * 2 * FramesRead);
+	FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * FramesRead));
+	ZeroMemory(OutputBuffer, sizeof(FLOAT) * m_Channels * FramesRead);
 
 	//Write this data to the stream
 	m_ClientWriter.Write (
@@ -231,6 +233,8 @@ VOID CDXAudioLoopbackStream::InitClientReader() {
 	HRESULT hr = m_ClientReader.Initialize (
 		true,
 		m_SampleRate,
+		m_Channels,
+		m_Quality,
 		NULL,
 		m_OutputDevice,
 		Callback
@@ -243,6 +247,8 @@ VOID CDXAudioLoopbackStream::InitClientWriter() {
 
 	HRESULT hr = m_ClientWriter.Initialize (
 		m_SampleRate,
+		m_Channels,
+		m_Quality,
 		GetWaitEvent(),
 		m_OutputDevice,
 		Callback
@@ -0,0 +1,478 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "CDXAudioNullClient.h"
+#include <math.h>
+
+#define FILENAME L"CDXAudioNullClient.cpp"
+
+CDXAudioNullClient::CDXAudioNullClient(CDXAudioNullEnumerator* pEnumerator, EDataFlow DataFlow) :
+m_RefCount(1),
+m_Enumerator(pEnumerator),
+m_DataFlow(DataFlow),
+m_FramesPerTick(0.0),
+m_PeriodFrames(0),
+m_Initialized(false),
+m_Capture(DataFlow == eCapture),
+m_EventDriven(false),
+m_Running(false),
+m_Event(NULL),
+m_BufferFrames(0),
+m_Padding(0),
+m_Locked(0),
+m_Discontinuity(false),
+m_LastTime(0.0),
+m_Ticks(0.0),
+m_Position(0),
+m_ReadPosition(0)
+{
+	const DXAUDIO_NULL_DEVICE_DESC& Desc = m_Enumerator->GetDesc();
+	const INT Drift = DataFlow == eCapture ? Desc.InputDrift : Desc.OutputDrift;
+	WORD Bits = 32;
+
+	if (Desc.Format == DXAUDIO_NULL_DEVICE_FORMAT_INT16) {
+		Bits = 16;
+	} else if (Desc.Format == DXAUDIO_NULL_DEVICE_FORMAT_INT24) {
+		Bits = 24;
+	}
+
+	//The mix format is extensible, like the mix format of a real endpoint
+	ZeroMemory(&m_Format, sizeof(m_Format));
+	m_Format.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+	m_Format.Format.nChannels = WORD(Desc.Channels);
+	m_Format.Format.nSamplesPerSec = Desc.SampleRate;
+	m_Format.Format.wBitsPerSample = Bits;
+	m_Format.Format.nBlockAlign = WORD(Desc.Channels * Bits / 8);
+	m_Format.Format.nAvgBytesPerSec = Desc.SampleRate * m_Format.Format.nBlockAlign;
+	m_Format.Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+	m_Format.Samples.wValidBitsPerSample = Bits;
+	m_Format.dwChannelMask = Desc.Channels < 32 ? (1u << Desc.Channels) - 1 : 0xFFFFFFFF; //The first speaker positions, in order
+	m_Format.SubFormat = Desc.Format == DXAUDIO_NULL_DEVICE_FORMAT_FLOAT ? KSDATAFORMAT_SUBTYPE_IEEE_FLOAT : KSDATAFORMAT_SUBTYPE_PCM;
+
+	m_FramesPerTick = DOUBLE(Desc.SampleRate) * (1.0 + DOUBLE(Drift) / 1000000.0) / 10000000.0;
+	m_PeriodFrames = UINT32((Desc.Period * Desc.SampleRate + 9999999) / 10000000);
+}
+
+CDXAudioNullClient::~CDXAudioNullClient() {
+	if (m_Running && m_Event != NULL) {
+		m_Enumerator->StopWakeups(m_Event);
+	}
+}
+
+HRESULT CDXAudioNullClient::QueryInterface(REFIID riid, void** ppvObject) {
+	//IUnknown is reached through IAudioClient, so that the object always has the same identity
+	if (riid == __uuidof(IUnknown) || riid == __uuidof(IAudioClient)) {
+		*ppvObject = static_cast<IAudioClient*>(this);
+	} else {
+		*ppvObject = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	AddRef();
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::Initialize(AUDCLNT_SHAREMODE ShareMode, DWORD StreamFlags, REFERENCE_TIME BufferDuration, REFERENCE_TIME Periodicity, const WAVEFORMATEX* pFormat, LPCGUID AudioSessionGuid) {
+	if (m_Initialized) {
+		return AUDCLNT_E_ALREADY_INITIALIZED;
+	}
+
+	if (pFormat == nullptr) {
+		return E_POINTER;
+	}
+
+	//The endpoint only takes its own mix format, the way a shared-mode endpoint does
+	if (pFormat->nChannels != m_Format.Format.nChannels ||
+		pFormat->nSamplesPerSec != m_Format.Format.nSamplesPerSec ||
+		pFormat->wBitsPerSample != m_Format.Format.wBitsPerSample) {
+		return AUDCLNT_E_UNSUPPORTED_FORMAT;
+	}
+
+	//Only a render endpoint can be captured from in loopback
+	if ((StreamFlags & AUDCLNT_STREAMFLAGS_LOOPBACK) != 0) {
+		if (m_DataFlow != eRender) {
+			return AUDCLNT_E_WRONG_ENDPOINT_TYPE;
+		}
+
+		m_Capture = true;
+	}
+
+	m_EventDriven = (StreamFlags & AUDCLNT_STREAMFLAGS_EVENTCALLBACK) != 0;
+
+	//The buffer holds at least a period, however short a duration was asked for
+	m_BufferFrames = UINT32((BufferDuration * m_Format.Format.nSamplesPerSec + 9999999) / 10000000);
+
+	if (m_BufferFrames < m_PeriodFrames) {
+		m_BufferFrames = m_PeriodFrames;
+	}
+
+	m_Buffer.assign(m_BufferFrames * m_Format.Format.nBlockAlign, 0);
+	m_Initialized = true;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::GetBufferSize(UINT32* pNumBufferFrames) {
+	if (pNumBufferFrames == nullptr) {
+		return E_POINTER;
+	}
+
+	if (!m_Initialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	*pNumBufferFrames = m_BufferFrames;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::GetStreamLatency(REFERENCE_TIME* pLatency) {
+	if (pLatency == nullptr) {
+		return E_POINTER;
+	}
+
+	if (!m_Initialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	//There's no hardware behind the endpoint, so the only latency is the period it's serviced in
+	*pLatency = m_Enumerator->GetDesc().Period;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::GetCurrentPadding(UINT32* pNumPaddingFrames) {
+	if (pNumPaddingFrames == nullptr) {
+		return E_POINTER;
+	}
+
+	if (!m_Initialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	Update();
+
+	*pNumPaddingFrames = m_Padding;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::IsFormatSupported(AUDCLNT_SHAREMODE ShareMode, const WAVEFORMATEX* pFormat, WAVEFORMATEX** ppClosestMatch) {
+	if (pFormat == nullptr) {
+		return E_POINTER;
+	}
+
+	if (ppClosestMatch != nullptr) {
+		*ppClosestMatch = nullptr;
+	}
+
+	if (pFormat->nChannels == m_Format.Format.nChannels &&
+		pFormat->nSamplesPerSec == m_Format.Format.nSamplesPerSec &&
+		pFormat->wBitsPerSample == m_Format.Format.wBitsPerSample) {
+		return S_OK;
+	}
+
+	return AUDCLNT_E_UNSUPPORTED_FORMAT;
+}
+
+HRESULT CDXAudioNullClient::GetMixFormat(WAVEFORMATEX** ppDeviceFormat) {
+	if (ppDeviceFormat == nullptr) {
+		return E_POINTER;
+	}
+
+	//The caller frees the format with CoTaskMemFree(), as it would one from a real endpoint
+	WAVEFORMATEXTENSIBLE* Format = (WAVEFORMATEXTENSIBLE*)(CoTaskMemAlloc(sizeof(WAVEFORMATEXTENSIBLE)));
+
+	if (Format == nullptr) {
+		*ppDeviceFormat = nullptr;
+		return E_OUTOFMEMORY;
+	}
+
+	*Format = m_Format;
+	*ppDeviceFormat = (WAVEFORMATEX*)(Format);
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::GetDevicePeriod(REFERENCE_TIME* pDefaultDevicePeriod, REFERENCE_TIME* pMinimumDevicePeriod) {
+	if (pDefaultDevicePeriod != nullptr) {
+		*pDefaultDevicePeriod = m_Enumerator->GetDesc().Period;
+	}
+
+	if (pMinimumDevicePeriod != nullptr) {
+		*pMinimumDevicePeriod = m_Enumerator->GetDesc().Period;
+	}
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::Start() {
+	if (!m_Initialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (m_Running) {
+		return AUDCLNT_E_NOT_STOPPED;
+	}
+
+	if (m_EventDriven && m_Event == NULL) {
+		return AUDCLNT_E_EVENTHANDLE_NOT_SET;
+	}
+
+	//The endpoint's clock doesn't tick while it's stopped
+	m_LastTime = m_Enumerator->GetTime();
+	m_Running = true;
+
+	//The endpoint's periods are measured on its own clock, so a fast endpoint wakes the stream sooner
+	if (m_Event != NULL) {
+		m_Enumerator->StartWakeups (
+			m_Event,
+			DOUBLE(m_PeriodFrames) / m_FramesPerTick
+		);
+	}
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::Stop() {
+	if (!m_Initialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (!m_Running) {
+		return S_FALSE;
+	}
+
+	Update();
+
+	m_Running = false;
+
+	if (m_Event != NULL) {
+		m_Enumerator->StopWakeups(m_Event);
+	}
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::Reset() {
+	if (!m_Initialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (m_Running) {
+		return AUDCLNT_E_NOT_STOPPED;
+	}
+
+	if (m_Locked != 0) {
+		return AUDCLNT_E_BUFFER_OPERATION_PENDING;
+	}
+
+	m_Padding = 0;
+	m_Discontinuity = false;
+	m_ReadPosition = m_Position;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::SetEventHandle(HANDLE EventHandle) {
+	if (EventHandle == NULL) {
+		return E_INVALIDARG;
+	}
+
+	if (!m_Initialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (!m_EventDriven) {
+		return AUDCLNT_E_EVENTHANDLE_NOT_EXPECTED;
+	}
+
+	m_Event = EventHandle;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::GetService(REFIID riid, void** ppv) {
+	if (ppv == nullptr) {
+		return E_POINTER;
+	}
+
+	*ppv = nullptr;
+
+	if (!m_Initialized) {
+		return AUDCLNT_E_NOT_INITIALIZED;
+	}
+
+	if (riid == __uuidof(IAudioRenderClient)) {
+		if (m_Capture) {
+			return AUDCLNT_E_WRONG_ENDPOINT_TYPE;
+		}
+
+		*ppv = static_cast<IAudioRenderClient*>(this);
+	} else if (riid == __uuidof(IAudioCaptureClient)) {
+		if (!m_Capture) {
+			return AUDCLNT_E_WRONG_ENDPOINT_TYPE;
+		}
+
+		*ppv = static_cast<IAudioCaptureClient*>(this);
+	} else {
+		return E_NOINTERFACE;
+	}
+
+	AddRef();
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::GetBuffer(UINT32 NumFramesRequested, BYTE** ppData) {
+	if (ppData == nullptr) {
+		return E_POINTER;
+	}
+
+	*ppData = nullptr;
+
+	if (m_Locked != 0) {
+		return AUDCLNT_E_OUT_OF_ORDER;
+	}
+
+	Update();
+
+	if (NumFramesRequested > m_BufferFrames - m_Padding) {
+		return AUDCLNT_E_BUFFER_TOO_LARGE;
+	}
+
+	//Nothing is ever played, so every write can go to the start of the buffer
+	*ppData = m_Buffer.data();
+	m_Locked = NumFramesRequested;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::ReleaseBuffer(UINT32 NumFramesWritten, DWORD Flags) {
+	if (NumFramesWritten > m_Locked) {
+		return AUDCLNT_E_INVALID_SIZE;
+	}
+
+	m_Padding += NumFramesWritten;
+	m_Locked = 0;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::GetBuffer(BYTE** ppData, UINT32* pNumFramesToRead, DWORD* pFlags, UINT64* pDevicePosition, UINT64* pQPCPosition) {
+	if (ppData == nullptr || pNumFramesToRead == nullptr || pFlags == nullptr) {
+		return E_POINTER;
+	}
+
+	*ppData = nullptr;
+	*pNumFramesToRead = 0;
+	*pFlags = 0;
+
+	if (m_Locked != 0) {
+		return AUDCLNT_E_OUT_OF_ORDER;
+	}
+
+	Update();
+
+	if (m_Padding == 0) {
+		return AUDCLNT_S_BUFFER_EMPTY;
+	}
+
+	//Frames are captured a period at a time, like the packets of a real endpoint
+	m_Locked = m_Padding < m_PeriodFrames ? m_Padding : m_PeriodFrames;
+
+	*ppData = m_Buffer.data();
+	*pNumFramesToRead = m_Locked;
+	*pFlags = AUDCLNT_BUFFERFLAGS_SILENT;
+
+	if (m_Discontinuity) {
+		*pFlags |= AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY;
+		m_Discontinuity = false;
+	}
+
+	if (pDevicePosition != nullptr) {
+		*pDevicePosition = m_ReadPosition;
+	}
+
+	//The packet was captured at a simulated time, which has nothing to do with the performance counter
+	if (pQPCPosition != nullptr) {
+		*pQPCPosition = 0;
+	}
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::ReleaseBuffer(UINT32 NumFramesRead) {
+	//A packet is either read in full, or not at all
+	if (NumFramesRead != 0 && NumFramesRead != m_Locked) {
+		return AUDCLNT_E_INVALID_SIZE;
+	}
+
+	m_Padding -= NumFramesRead;
+	m_ReadPosition += NumFramesRead;
+	m_Locked = 0;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullClient::GetNextPacketSize(UINT32* pNumFramesInNextPacket) {
+	if (pNumFramesInNextPacket == nullptr) {
+		return E_POINTER;
+	}
+
+	Update();
+
+	*pNumFramesInNextPacket = m_Padding < m_PeriodFrames ? m_Padding : m_PeriodFrames;
+
+	return S_OK;
+}
+
+VOID CDXAudioNullClient::Update() {
+	const DOUBLE Now = m_Enumerator->GetTime();
+	UINT64 Frames = 0;
+
+	if (!m_Running) {
+		return;
+	}
+
+	//The clock is kept in fractional frames, so that a rate that doesn't divide the period evenly doesn't drift
+	m_Ticks += (Now - m_LastTime) * m_FramesPerTick;
+	m_LastTime = Now;
+
+	//The small bias keeps a whole number of frames from being rounded down to one less
+	Frames = UINT64(floor(m_Ticks + 0.000001)) - m_Position;
+	m_Position += Frames;
+
+	if (!m_Capture) {
+		//Once the buffer runs dry, the endpoint plays silence
+		m_Padding -= Frames < m_Padding ? UINT32(Frames) : m_Padding;
+	} else if (Frames > m_BufferFrames - m_Padding) {
+		//The oldest frames are overwritten once the buffer is full
+		m_ReadPosition += Frames - (m_BufferFrames - m_Padding);
+		m_Padding = m_BufferFrames;
+		m_Discontinuity = true;
+	} else {
+		m_Padding += UINT32(Frames);
+	}
+}
\ No newline at end of file
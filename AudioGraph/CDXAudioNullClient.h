@@ -0,0 +1,134 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include "DXAudio.h"
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include <mmreg.h>
+#include <Audioclient.h>
+#include <vector>
+#include "CDXAudioNullEnumerator.h"
+
+/* CDXAudioNullClient stands in for the WASAPI audio client of a simulated endpoint.  It's a render client, or a
+** capture client if the endpoint captures or the client is initialized for loopback, and it serves the matching
+** interface through GetService().  The endpoint's clock is the enumerator's simulated clock, sped up or slowed down
+** by the endpoint's drift: a render client's buffer drains as it ticks, and a capture client's buffer fills, losing
+** the oldest frames and flagging a discontinuity once it's full.  The buffers are brought up to date lazily, whenever
+** the client is called. */
+class CDXAudioNullClient : public IAudioClient, public IAudioRenderClient, public IAudioCaptureClient {
+public:
+	CDXAudioNullClient(CDXAudioNullEnumerator* pEnumerator, EDataFlow DataFlow);
+
+	~CDXAudioNullClient();
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final;
+
+	ULONG STDMETHODCALLTYPE AddRef() final {
+		return ++m_RefCount;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() final {
+		m_RefCount--;
+
+		if (m_RefCount <= 0) {
+			delete this;
+			return 0;
+		}
+
+		return m_RefCount;
+	}
+
+	//IAudioClient methods
+
+	STDMETHODIMP Initialize(AUDCLNT_SHAREMODE ShareMode, DWORD StreamFlags, REFERENCE_TIME BufferDuration, REFERENCE_TIME Periodicity, const WAVEFORMATEX* pFormat, LPCGUID AudioSessionGuid) final;
+
+	STDMETHODIMP GetBufferSize(UINT32* pNumBufferFrames) final;
+
+	STDMETHODIMP GetStreamLatency(REFERENCE_TIME* pLatency) final;
+
+	STDMETHODIMP GetCurrentPadding(UINT32* pNumPaddingFrames) final;
+
+	STDMETHODIMP IsFormatSupported(AUDCLNT_SHAREMODE ShareMode, const WAVEFORMATEX* pFormat, WAVEFORMATEX** ppClosestMatch) final;
+
+	STDMETHODIMP GetMixFormat(WAVEFORMATEX** ppDeviceFormat) final;
+
+	STDMETHODIMP GetDevicePeriod(REFERENCE_TIME* pDefaultDevicePeriod, REFERENCE_TIME* pMinimumDevicePeriod) final;
+
+	STDMETHODIMP Start() final;
+
+	STDMETHODIMP Stop() final;
+
+	STDMETHODIMP Reset() final;
+
+	STDMETHODIMP SetEventHandle(HANDLE EventHandle) final;
+
+	STDMETHODIMP GetService(REFIID riid, void** ppv) final;
+
+	//IAudioRenderClient methods
+
+	STDMETHODIMP GetBuffer(UINT32 NumFramesRequested, BYTE** ppData) final;
+
+	STDMETHODIMP ReleaseBuffer(UINT32 NumFramesWritten, DWORD Flags) final;
+
+	//IAudioCaptureClient methods
+
+	STDMETHODIMP GetBuffer(BYTE** ppData, UINT32* pNumFramesToRead, DWORD* pFlags, UINT64* pDevicePosition, UINT64* pQPCPosition) final;
+
+	STDMETHODIMP ReleaseBuffer(UINT32 NumFramesRead) final;
+
+	STDMETHODIMP GetNextPacketSize(UINT32* pNumFramesInNextPacket) final;
+
+private:
+	long m_RefCount; //Reference counter
+
+	CComPtr<CDXAudioNullEnumerator> m_Enumerator; //Keeps the simulated clock
+	EDataFlow m_DataFlow; //The flow of the endpoint
+	WAVEFORMATEXTENSIBLE m_Format; //The mix format of the endpoint
+	DOUBLE m_FramesPerTick; //Frames the endpoint's clock moves on by for every 100 nanoseconds of simulated time
+	UINT32 m_PeriodFrames; //Frames in a device period
+
+	bool m_Initialized;
+	bool m_Capture; //Whether the client captures, rather than renders
+	bool m_EventDriven; //Whether the client was initialized with AUDCLNT_STREAMFLAGS_EVENTCALLBACK
+	bool m_Running;
+	HANDLE m_Event; //The event set on every wakeup, or NULL
+
+	std::vector<BYTE> m_Buffer; //The endpoint buffer - silence for a capture client, and thrown away by a render client
+	UINT32 m_BufferFrames; //Size of the endpoint buffer
+	UINT32 m_Padding; //Frames written and not yet played, or captured and not yet read
+	UINT32 m_Locked; //Frames handed out by the GetBuffer() that hasn't been released, or 0
+	bool m_Discontinuity; //Whether captured frames have been lost since the last packet was read
+
+	DOUBLE m_LastTime; //The simulated time the endpoint's clock was last brought up to
+	DOUBLE m_Ticks; //The endpoint's clock, in frames
+	UINT64 m_Position; //Whole frames the endpoint's clock has ticked, which have been played or captured
+	UINT64 m_ReadPosition; //Capture only - the device position of the next frame to be read
+
+	/* Brings the endpoint's clock up to the simulated time, playing or capturing the frames it ticked. */
+	VOID Update();
+};
\ No newline at end of file
@@ -0,0 +1,70 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "CDXAudioNullDevice.h"
+#include "CDXAudioNullClient.h"
+
+#define FILENAME L"CDXAudioNullDevice.cpp"
+
+CDXAudioNullDevice::CDXAudioNullDevice(CDXAudioNullEnumerator* pEnumerator, EDataFlow DataFlow) :
+m_RefCount(1),
+m_Enumerator(pEnumerator),
+m_DataFlow(DataFlow)
+{ }
+
+CDXAudioNullDevice::~CDXAudioNullDevice() { }
+
+HRESULT CDXAudioNullDevice::Activate(REFIID iid, DWORD ClsCtx, PROPVARIANT* pActivationParams, void** ppInterface) {
+	if (ppInterface == nullptr) {
+		return E_POINTER;
+	}
+
+	if (iid != __uuidof(IAudioClient)) {
+		*ppInterface = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	*ppInterface = static_cast<IAudioClient*>(new CDXAudioNullClient(m_Enumerator, m_DataFlow));
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullDevice::GetId(LPWSTR* ppID) {
+	LPCWSTR ID = GetDeviceID(m_DataFlow);
+	SIZE_T Size = (wcslen(ID) + 1) * sizeof(WCHAR);
+
+	if (ppID == nullptr) {
+		return E_POINTER;
+	}
+
+	//The caller frees the ID with CoTaskMemFree(), as it would one from a real endpoint
+	*ppID = (LPWSTR)(CoTaskMemAlloc(Size));
+
+	if (*ppID == nullptr) {
+		return E_OUTOFMEMORY;
+	}
+
+	memcpy(*ppID, ID, Size);
+
+	return S_OK;
+}
\ No newline at end of file
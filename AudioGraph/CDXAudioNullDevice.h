@@ -0,0 +1,99 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include "DXAudio.h"
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include "CDXAudioNullEnumerator.h"
+#include "QueryInterface.h"
+
+/* CDXAudioNullDevice is a simulated endpoint, created by CDXAudioNullEnumerator.  Activating it creates a
+** CDXAudioNullClient in place of the WASAPI audio client. */
+class CDXAudioNullDevice : public IMMDevice {
+public:
+	CDXAudioNullDevice(CDXAudioNullEnumerator* pEnumerator, EDataFlow DataFlow);
+
+	~CDXAudioNullDevice();
+
+	//IUnknown methods
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return ++m_RefCount;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() {
+		m_RefCount--;
+
+		if (m_RefCount <= 0) {
+			delete this;
+			return 0;
+		}
+
+		return m_RefCount;
+	}
+
+	//IMMDevice methods
+
+	/* Only IAudioClient can be activated */
+	STDMETHODIMP Activate(REFIID iid, DWORD ClsCtx, PROPVARIANT* pActivationParams, void** ppInterface) final;
+
+	STDMETHODIMP OpenPropertyStore(DWORD StgmAccess, IPropertyStore** ppProperties) final {
+		return E_NOTIMPL; //Not used
+	}
+
+	STDMETHODIMP GetId(LPWSTR* ppID) final;
+
+	STDMETHODIMP GetState(DWORD* pState) final {
+		if (pState == nullptr) {
+			return E_POINTER;
+		}
+
+		*pState = DEVICE_STATE_ACTIVE;
+
+		return S_OK;
+	}
+
+	//New methods
+
+	/* Returns the ID of the simulated endpoint of [DataFlow]. */
+	static LPCWSTR GetDeviceID(EDataFlow DataFlow) {
+		return DataFlow == eRender ? L"{DXAudio.Null.Render}" : L"{DXAudio.Null.Capture}";
+	}
+
+private:
+	long m_RefCount; //Reference counter
+
+	CComPtr<CDXAudioNullEnumerator> m_Enumerator; //Keeps the clock alive for the device's clients
+	EDataFlow m_DataFlow; //eRender or eCapture
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(IMMDevice);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+};
\ No newline at end of file
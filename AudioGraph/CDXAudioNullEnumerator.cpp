@@ -0,0 +1,147 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "CDXAudioNullEnumerator.h"
+#include "CDXAudioNullDevice.h"
+
+#define FILENAME L"CDXAudioNullEnumerator.cpp"
+
+CDXAudioNullEnumerator::CDXAudioNullEnumerator() :
+m_RefCount(1),
+m_Time(0.0),
+m_LastWake(-1.0),
+m_WakeEvent(NULL),
+m_WakePeriod(0.0),
+m_ScheduledWake(0.0),
+m_NextWake(0.0),
+m_Wakes(0)
+{
+	ZeroMemory(&m_Desc, sizeof(m_Desc));
+}
+
+CDXAudioNullEnumerator::~CDXAudioNullEnumerator() { }
+
+VOID CDXAudioNullEnumerator::Initialize(const DXAUDIO_NULL_DEVICE_DESC* pDesc) {
+	if (pDesc != nullptr) {
+		m_Desc = *pDesc;
+	}
+
+	if (m_Desc.SampleRate == 0) {
+		m_Desc.SampleRate = 48000;
+	}
+
+	if (m_Desc.Channels == 0) {
+		m_Desc.Channels = 2;
+	}
+
+	if (m_Desc.Period <= 0) {
+		m_Desc.Period = 100000;
+	}
+
+	if (m_Desc.GlitchDelay < 0) {
+		m_Desc.GlitchDelay = 0;
+	}
+}
+
+HRESULT CDXAudioNullEnumerator::GetDefaultAudioEndpoint(EDataFlow DataFlow, ERole Role, IMMDevice** ppEndpoint) {
+	if (ppEndpoint == nullptr) {
+		return E_POINTER;
+	}
+
+	//There is one endpoint of each flow, which is the default for every role
+	if (DataFlow != eRender && DataFlow != eCapture) {
+		*ppEndpoint = nullptr;
+		return E_INVALIDARG;
+	}
+
+	*ppEndpoint = new CDXAudioNullDevice(this, DataFlow);
+
+	return S_OK;
+}
+
+HRESULT CDXAudioNullEnumerator::GetDevice(LPCWSTR ID, IMMDevice** ppDevice) {
+	if (ID == nullptr || ppDevice == nullptr) {
+		return E_POINTER;
+	}
+
+	if (wcscmp(ID, CDXAudioNullDevice::GetDeviceID(eRender)) == 0) {
+		*ppDevice = new CDXAudioNullDevice(this, eRender);
+	} else if (wcscmp(ID, CDXAudioNullDevice::GetDeviceID(eCapture)) == 0) {
+		*ppDevice = new CDXAudioNullDevice(this, eCapture);
+	} else {
+		*ppDevice = nullptr;
+		return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+	}
+
+	return S_OK;
+}
+
+VOID CDXAudioNullEnumerator::StartWakeups(HANDLE Event, DOUBLE Period) {
+	m_WakeEvent = Event;
+	m_WakePeriod = Period;
+	m_ScheduledWake = m_Time + Period;
+	m_NextWake = m_ScheduledWake;
+	m_Wakes = 0;
+	m_LastWake = -1.0;
+
+	SetEvent(m_WakeEvent);
+}
+
+VOID CDXAudioNullEnumerator::StopWakeups(HANDLE Event) {
+	if (m_WakeEvent == Event) {
+		m_WakeEvent = NULL;
+	}
+}
+
+LONGLONG CDXAudioNullEnumerator::Advance() {
+	LONGLONG Interval = 0;
+
+	//A wakeup left over from before the endpoint stopped doesn't move the clock
+	if (m_WakeEvent == NULL) {
+		return 0;
+	}
+
+	if (m_NextWake > m_Time) {
+		m_Time = m_NextWake;
+	}
+
+	if (m_LastWake >= 0.0) {
+		Interval = LONGLONG(m_Time - m_LastWake + 0.5);
+	}
+
+	m_LastWake = m_Time;
+	m_Wakes++;
+
+	//A late wakeup doesn't move the endpoint's schedule, so the one after it comes early to make up for it
+	m_ScheduledWake += m_WakePeriod;
+	m_NextWake = m_ScheduledWake;
+
+	if (m_Desc.GlitchInterval != 0 && (m_Wakes + 1) % m_Desc.GlitchInterval == 0) {
+		m_NextWake += DOUBLE(m_Desc.GlitchDelay);
+	}
+
+	//The stream is still busy with this wakeup, so it takes the next one as soon as it's done
+	SetEvent(m_WakeEvent);
+
+	return Interval;
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include "DXAudio.h"
+#include <comdef.h>
+#include <atlbase.h>
+#include <mmdeviceapi.h>
+#include "QueryInterface.h"
+
+/* CDXAudioNullEnumerator stands in for the WASAPI device enumerator of a stream created with DXAUDIO_BACKEND_NULL.
+** Its endpoints are CDXAudioNullDevice objects, whose clients run on the simulated clock kept here.  The clock only
+** moves when the stream takes a wakeup, which makes every run of a stream the same.  Only one client at a time can
+** wake the stream, just like only one of a stream's endpoints is given the wait event.  Used only on the thread
+** servicing the stream. */
+class CDXAudioNullEnumerator : public IMMDeviceEnumerator {
+public:
+	CDXAudioNullEnumerator();
+
+	~CDXAudioNullEnumerator();
+
+	//IUnknown methods
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return ++m_RefCount;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() {
+		m_RefCount--;
+
+		if (m_RefCount <= 0) {
+			delete this;
+			return 0;
+		}
+
+		return m_RefCount;
+	}
+
+	//IMMDeviceEnumerator methods
+
+	STDMETHODIMP EnumAudioEndpoints(EDataFlow DataFlow, DWORD StateMask, IMMDeviceCollection** ppDevices) final {
+		return E_NOTIMPL; //Not used
+	}
+
+	STDMETHODIMP GetDefaultAudioEndpoint(EDataFlow DataFlow, ERole Role, IMMDevice** ppEndpoint) final;
+
+	STDMETHODIMP GetDevice(LPCWSTR ID, IMMDevice** ppDevice) final;
+
+	/* The simulated endpoints never change, so there's nothing to notify the client of */
+	STDMETHODIMP RegisterEndpointNotificationCallback(IMMNotificationClient* pClient) final {
+		return S_OK;
+	}
+
+	STDMETHODIMP UnregisterEndpointNotificationCallback(IMMNotificationClient* pClient) final {
+		return S_OK;
+	}
+
+	//New methods
+
+	/* Copies [pDesc], filling in its defaults.  If [pDesc] is NULL, every default is used. */
+	VOID Initialize(const DXAUDIO_NULL_DEVICE_DESC* pDesc);
+
+	/* Returns the description of the endpoints, with the defaults filled in. */
+	const DXAUDIO_NULL_DEVICE_DESC& GetDesc() {
+		return m_Desc;
+	}
+
+	/* Returns the simulated time, in 100-nanosecond units since the enumerator was created. */
+	DOUBLE GetTime() {
+		return m_Time;
+	}
+
+	/* Starts waking the stream through [Event] every [Period] of simulated time, the first time a period from now. */
+	VOID StartWakeups(HANDLE Event, DOUBLE Period);
+
+	/* Stops the wakeups started with [Event]. */
+	VOID StopWakeups(HANDLE Event);
+
+	/* Moves the clock on to the wakeup the stream is taking, and sets the event for the next one straight away.
+	** Returns the simulated time since the previous wakeup, or 0 if there wasn't one. */
+	LONGLONG Advance();
+
+private:
+	long m_RefCount; //Reference counter
+
+	DXAUDIO_NULL_DEVICE_DESC m_Desc; //The endpoints, with the defaults filled in
+	DOUBLE m_Time; //The simulated time
+	DOUBLE m_LastWake; //When the previous wakeup was taken, or a negative value if it hasn't been yet
+
+	HANDLE m_WakeEvent; //The event set for every wakeup, or NULL if nothing is running with one
+	DOUBLE m_WakePeriod; //Simulated time between wakeups
+	DOUBLE m_ScheduledWake; //When the next wakeup is due, if it isn't late
+	DOUBLE m_NextWake; //When the next wakeup happens, which is later than scheduled if it's glitched
+	UINT64 m_Wakes; //Wakeups taken since they were started
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(IMMDeviceEnumerator);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+};
\ No newline at end of file
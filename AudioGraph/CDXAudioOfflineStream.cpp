@@ -0,0 +1,454 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+#include "CDXAudioOfflineStream.h"
+#include <mmreg.h>
+#include <math.h>
+
+#define FILENAME L"CDXAudioOfflineStream.cpp"
+#define EVENT_INIT(x, Line) x = CreateEventW(NULL, FALSE, FALSE, NULL); if (x == NULL) { m_WriteCallback->OnObjectFailure(FILENAME, Line, HRESULT_FROM_WIN32(GetLastError())); return E_FAIL; }
+#define EVENT_CLEANUP(x) if (x != NULL) { CloseHandle(x); x = NULL; }
+#define WAVE_TAG(a, b, c, d) (DWORD(BYTE(a)) | (DWORD(BYTE(b)) << 8) | (DWORD(BYTE(c)) << 16) | (DWORD(BYTE(d)) << 24))
+
+//The header of a floating-point WAV file, as it is laid out on disk
+#pragma pack(push, 1)
+struct WAVE_FILE_HEADER {
+	DWORD Riff;
+	DWORD RiffSize;
+	DWORD Wave;
+	DWORD Fmt;
+	DWORD FmtSize;
+	WAVEFORMATEX Format;
+	DWORD Fact; //Non-PCM formats are expected to have a fact chunk
+	DWORD FactSize;
+	DWORD FactFrames;
+	DWORD Data;
+	DWORD DataSize;
+};
+#pragma pack(pop)
+
+//Zero out all data
+CDXAudioOfflineStream::CDXAudioOfflineStream() :
+m_RefCount(1),
+m_SampleRate(0.0f),
+m_Channels(2),
+m_Frames(0),
+m_PeriodFrames(0),
+m_File(INVALID_HANDLE_VALUE),
+m_FramesRendered(0),
+m_RenderTicks(0),
+m_Finishing(FALSE),
+m_Finished(false),
+m_Running(false),
+m_StartEvent(NULL),
+m_StopEvent(NULL),
+m_FinishEvent(NULL),
+m_DoneEvent(NULL),
+m_HaltEvent(NULL),
+m_InitEvent(NULL),
+m_Thread(NULL)
+{
+	QueryPerformanceFrequency(&m_Frequency);
+	m_StartTime.QuadPart = 0;
+}
+
+//Close the thread before releasing data/COM objects
+CDXAudioOfflineStream::~CDXAudioOfflineStream() {
+	if (m_Thread != NULL) {
+		SetEvent(m_HaltEvent);
+		WaitForSingleObject(m_Thread, INFINITE);
+		CloseHandle(m_Thread);
+		m_Thread = NULL;
+	}
+
+	//The thread closes the output on its way out, unless it never ran
+	if (m_File != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+
+	EVENT_CLEANUP(m_StartEvent);
+	EVENT_CLEANUP(m_StopEvent);
+	EVENT_CLEANUP(m_FinishEvent);
+	EVENT_CLEANUP(m_DoneEvent);
+	EVENT_CLEANUP(m_HaltEvent);
+	EVENT_CLEANUP(m_InitEvent);
+}
+
+HRESULT CDXAudioOfflineStream::Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback) {
+	HRESULT hr = S_OK;
+
+	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
+
+	//The callback must implement IDXAudioWriteCallback
+	hr = Callback->QueryInterface (
+		IID_PPV_ARGS(&m_WriteCallback)
+	);
+
+	if (FAILED(hr) || pDesc->SampleRate < 0.0f || pDesc->Channels > DXAUDIO_MAX_CHANNELS) {
+		Callback->OnObjectFailure (
+			FILENAME,
+			__LINE__,
+			E_INVALIDARG
+		); return E_FAIL;
+	}
+
+	//There's no endpoint to take a rate from, so 0 falls back to the rate the library has always used
+	m_SampleRate = pDesc->SampleRate != 0.0f ? pDesc->SampleRate : 44100.0f;
+	m_Channels = pDesc->Channels != 0 ? pDesc->Channels : 2;
+	m_Frames = pDesc->Frames;
+
+	//Ask the callback for 10ms at a time, which is what it would typically see from an endpoint
+	m_PeriodFrames = (UINT)(ceil(m_SampleRate / 100.0f));
+	m_PeriodBuffer.resize(m_PeriodFrames * m_Channels);
+
+	if (pDesc->Filename != nullptr) {
+		m_File = CreateFileW (
+			pDesc->Filename,
+			GENERIC_WRITE,
+			0,
+			NULL,
+			CREATE_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL,
+			NULL
+		);
+
+		if (m_File == INVALID_HANDLE_VALUE) {
+			m_WriteCallback->OnObjectFailure (
+				FILENAME,
+				__LINE__,
+				HRESULT_FROM_WIN32(GetLastError())
+			); return E_FAIL;
+		}
+
+		//Written again with the real length once the render has finished
+		hr = WriteWaveHeader(0);
+
+		if (FAILED(hr)) return hr;
+	} else if (m_Frames != 0) {
+		m_MemoryBuffer.reserve(size_t(m_Frames) * m_Channels);
+	}
+
+	EVENT_INIT(m_StartEvent, __LINE__);
+	EVENT_INIT(m_StopEvent, __LINE__);
+	EVENT_INIT(m_FinishEvent, __LINE__);
+	EVENT_INIT(m_HaltEvent, __LINE__);
+	EVENT_INIT(m_InitEvent, __LINE__);
+
+	//Manual reset, so that any number of waits see the render as finished
+	m_DoneEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+	if (m_DoneEvent == NULL) {
+		m_WriteCallback->OnObjectFailure (
+			FILENAME,
+			__LINE__,
+			HRESULT_FROM_WIN32(GetLastError())
+		); return E_FAIL;
+	}
+
+	//Rendering happens on a separate thread, just like any other stream
+	m_Thread = CreateThread (
+		NULL,
+		0,
+		StaticStreamThreadEntry,
+		this,
+		NULL,
+		NULL
+	);
+
+	//If m_Thread is NULL, an error occurred
+	if (m_Thread == NULL) {
+		m_WriteCallback->OnObjectFailure (
+			FILENAME,
+			__LINE__,
+			HRESULT_FROM_WIN32(GetLastError())
+		); return E_FAIL;
+	}
+
+	HANDLE Handles[] = {
+		m_InitEvent,
+		m_Thread
+	};
+
+	//Like the other streams, creation doesn't return until the callback's OnThreadInit() has
+	if (WaitForMultipleObjects(2, Handles, FALSE, INFINITE) != WAIT_OBJECT_0) {
+		return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+VOID CDXAudioOfflineStream::Finish() {
+	InterlockedExchange(&m_Finishing, TRUE);
+	SetEvent(m_FinishEvent);
+}
+
+BOOL CDXAudioOfflineStream::WaitForFinish(DWORD Milliseconds) {
+	return WaitForSingleObject(m_DoneEvent, Milliseconds) == WAIT_OBJECT_0;
+}
+
+VOID CDXAudioOfflineStream::GetStats(DXAUDIO_STREAM_STATS* pStats) {
+	if (pStats == nullptr) {
+		m_WriteCallback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
+		return;
+	}
+
+	m_Counters.GetStats(pStats);
+}
+
+DOUBLE CDXAudioOfflineStream::GetRealTimeFactor() {
+	LONG64 Ticks = InterlockedCompareExchange64(&m_RenderTicks, 0, 0);
+
+	if (Ticks == 0) {
+		return 0.0;
+	}
+
+	DOUBLE AudioSeconds = DOUBLE(GetFramesRendered()) / DOUBLE(m_SampleRate);
+	DOUBLE RenderSeconds = DOUBLE(Ticks) / DOUBLE(m_Frequency.QuadPart);
+
+	return AudioSeconds / RenderSeconds;
+}
+
+const FLOAT* CDXAudioOfflineStream::GetBuffer() {
+	//The buffer still belongs to the stream thread until the render has finished
+	if (WaitForSingleObject(m_DoneEvent, 0) != WAIT_OBJECT_0 || m_MemoryBuffer.empty()) {
+		return nullptr;
+	}
+
+	return m_MemoryBuffer.data();
+}
+
+VOID CDXAudioOfflineStream::RenderPeriod() {
+	UINT64 Rendered = UINT64(m_FramesRendered);
+	UINT Frames = m_PeriodFrames;
+
+	//The last period is cut short so that exactly m_Frames frames are rendered
+	if (m_Frames != 0 && m_Frames - Rendered < Frames) {
+		Frames = (UINT)(m_Frames - Rendered);
+	}
+
+	//Get the application to generate new output data
+	m_WriteCallback->OnProcess (
+		m_SampleRate,
+		m_PeriodBuffer.data(),
+		Frames
+	);
+
+	if (m_File != INVALID_HANDLE_VALUE) {
+		DWORD Written = 0;
+
+		if (!WriteFile(m_File, m_PeriodBuffer.data(), Frames * sizeof(FLOAT) * m_Channels, &Written, NULL)) {
+			m_WriteCallback->OnObjectFailure (
+				FILENAME,
+				__LINE__,
+				HRESULT_FROM_WIN32(GetLastError())
+			); InterlockedExchange(&m_Finishing, TRUE); return;
+		}
+	} else {
+		m_MemoryBuffer.insert (
+			m_MemoryBuffer.end(),
+			m_PeriodBuffer.begin(),
+			m_PeriodBuffer.begin() + Frames * m_Channels
+		);
+	}
+
+	InterlockedExchangeAdd64(&m_FramesRendered, Frames);
+
+	if (m_Frames != 0 && Rendered + Frames >= m_Frames) {
+		InterlockedExchange(&m_Finishing, TRUE);
+	}
+}
+
+VOID CDXAudioOfflineStream::StartClock() {
+	if (!m_Running) {
+		m_Running = true;
+		QueryPerformanceCounter(&m_StartTime);
+	}
+}
+
+VOID CDXAudioOfflineStream::StopClock() {
+	LARGE_INTEGER EndTime;
+
+	if (m_Running) {
+		m_Running = false;
+		QueryPerformanceCounter(&EndTime);
+		InterlockedExchangeAdd64(&m_RenderTicks, EndTime.QuadPart - m_StartTime.QuadPart);
+	}
+}
+
+VOID CDXAudioOfflineStream::CloseOutput() {
+	if (m_Finished) {
+		return;
+	}
+
+	m_Finished = true;
+
+	StopClock();
+
+	if (m_File != INVALID_HANDLE_VALUE) {
+		//Failures are reported by WriteWaveHeader(), and the audio is still on disk either way
+		WriteWaveHeader(GetFramesRendered());
+
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+
+	SetEvent(m_DoneEvent);
+}
+
+HRESULT CDXAudioOfflineStream::WriteWaveHeader(UINT64 Frames) {
+	WAVE_FILE_HEADER Header;
+	LARGE_INTEGER Position;
+	DWORD Written = 0;
+
+	//WAV sizes are 32-bit, so a longer render is still written, but its header is clamped
+	const DWORD BlockAlign = sizeof(FLOAT) * m_Channels;
+	const UINT64 MaxFrames = (0xFFFFFFFF - sizeof(WAVE_FILE_HEADER)) / BlockAlign;
+	const DWORD FrameCount = (DWORD)(Frames < MaxFrames ? Frames : MaxFrames);
+
+	Header.Riff = WAVE_TAG('R', 'I', 'F', 'F');
+	Header.RiffSize = sizeof(WAVE_FILE_HEADER) - 8 + FrameCount * BlockAlign;
+	Header.Wave = WAVE_TAG('W', 'A', 'V', 'E');
+	Header.Fmt = WAVE_TAG('f', 'm', 't', ' ');
+	Header.FmtSize = sizeof(WAVEFORMATEX);
+	Header.Format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+	Header.Format.nChannels = (WORD)(m_Channels);
+	Header.Format.nSamplesPerSec = (DWORD)(m_SampleRate);
+	Header.Format.nBlockAlign = (WORD)(BlockAlign);
+	Header.Format.nAvgBytesPerSec = Header.Format.nSamplesPerSec * Header.Format.nBlockAlign;
+	Header.Format.wBitsPerSample = sizeof(FLOAT) * 8;
+	Header.Format.cbSize = 0;
+	Header.Fact = WAVE_TAG('f', 'a', 'c', 't');
+	Header.FactSize = sizeof(DWORD);
+	Header.FactFrames = FrameCount;
+	Header.Data = WAVE_TAG('d', 'a', 't', 'a');
+	Header.DataSize = FrameCount * BlockAlign;
+
+	Position.QuadPart = 0;
+
+	if (!SetFilePointerEx(m_File, Position, NULL, FILE_BEGIN) ||
+		!WriteFile(m_File, &Header, sizeof(Header), &Written, NULL) ||
+		!SetFilePointerEx(m_File, Position, NULL, FILE_END)) {
+		m_WriteCallback->OnObjectFailure (
+			FILENAME,
+			__LINE__,
+			HRESULT_FROM_WIN32(GetLastError())
+		); return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+DWORD __stdcall CDXAudioOfflineStream::StaticStreamThreadEntry(LPVOID Data) {
+	CDXAudioOfflineStream* l_Stream = reinterpret_cast<CDXAudioOfflineStream*>(Data);
+
+	return l_Stream->StreamThreadEntry();
+}
+
+DWORD CDXAudioOfflineStream::StreamThreadEntry() {
+	bool run = true;
+	DWORD dwResult = 0;
+	HRESULT hr = S_OK;
+	HANDLE Events[] = {
+		m_StartEvent,
+		m_StopEvent,
+		m_FinishEvent,
+		m_HaltEvent
+	};
+
+	static const DWORD SM_START = WAIT_OBJECT_0;
+	static const DWORD SM_STOP = WAIT_OBJECT_0 + 1;
+	static const DWORD SM_FINISH = WAIT_OBJECT_0 + 2;
+	static const DWORD SM_CLOSE = WAIT_OBJECT_0 + 3;
+	static const DWORD SM_PROCESS = WAIT_TIMEOUT;
+
+	static const UINT nEvents = sizeof(Events) / sizeof(HANDLE);
+
+	//Initialize the COM server, the same way the other streams do
+	hr = CoInitializeEx (
+		NULL,
+		COINIT_SPEED_OVER_MEMORY |
+		COINIT_APARTMENTTHREADED
+	);
+
+	if (FAILED(hr)) {
+		m_WriteCallback->OnObjectFailure(FILENAME, __LINE__, hr);
+		CloseOutput();
+		return hr;
+	}
+
+	m_WriteCallback->OnThreadInit();
+
+	SetEvent(m_InitEvent);
+
+	while (run) {
+		//While running, messages are only polled for between periods, so rendering never waits
+		dwResult = WaitForMultipleObjects (
+			nEvents,
+			Events,
+			FALSE,
+			m_Running ? 0 : INFINITE
+		);
+
+		switch (dwResult) {
+			case SM_PROCESS: { //Process
+				m_Counters.BeginPeriod();
+				RenderPeriod();
+				m_Counters.EndPeriod();
+
+				if (m_Finishing) {
+					CloseOutput();
+				}
+			} break;
+
+			case SM_START: { //Start the stream
+				if (!m_Finished) {
+					StartClock();
+				}
+			} break;
+
+			case SM_STOP: { //Stop the stream
+				StopClock();
+			} break;
+
+			case SM_FINISH: { //Finish the render
+				CloseOutput();
+			} break;
+
+			case SM_CLOSE: { //Close the stream
+				run = false;
+			} break;
+
+			default: { //Error occurred
+				m_WriteCallback->OnObjectFailure(FILENAME, __LINE__, E_FAIL);
+				run = false;
+				hr = E_FAIL;
+			} break;
+		}
+	}
+
+	CloseOutput();
+
+	CoUninitialize();
+
+	return hr;
+}
\ No newline at end of file
@@ -0,0 +1,169 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+#pragma once
+
+#include "DXAudio.h"
+#include <comdef.h>
+#include <atlbase.h>
+#include <vector>
+#include "CDXAudioStreamCounters.h"
+#include "QueryInterface.h"
+
+/* This class is a final implementation of IDXAudioOfflineStream.  It doesn't share CDXAudioStream's
+** thread, since it has no endpoint to wait on and no device notifications to respond to.  Instead, its
+** thread calls the write callback back to back for as long as the stream is running. */
+class CDXAudioOfflineStream : public IDXAudioOfflineStream {
+public:
+	CDXAudioOfflineStream();
+
+	~CDXAudioOfflineStream();
+
+	//IUnknown methods
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return ++m_RefCount;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() {
+		m_RefCount--;
+
+		if (m_RefCount <= 0) {
+			delete this;
+			return 0;
+		}
+
+		return m_RefCount;
+	}
+
+	//IDXAudioStream methods
+
+	/* Sets the start event, eventually causing the stream to start rendering */
+	VOID STDMETHODCALLTYPE Start() final {
+		SetEvent(m_StartEvent);
+	}
+
+	/* Sets the stop event, eventually causing the stream to pause rendering */
+	VOID STDMETHODCALLTYPE Stop() final {
+		SetEvent(m_StopEvent);
+	}
+
+	/* Returns the sample rate of the stream */
+	FLOAT STDMETHODCALLTYPE GetSampleRate() final {
+		return m_SampleRate;
+	}
+
+	/* Returns the type of the stream */
+	DXAUDIO_STREAM_TYPE STDMETHODCALLTYPE GetStreamType() final {
+		return DXAUDIO_STREAM_TYPE_OFFLINE;
+	}
+
+	//IDXAudioStream2 methods
+
+	/* Copies the processing figures of the stream - there is no endpoint, so that's all there is */
+	VOID STDMETHODCALLTYPE GetStats(DXAUDIO_STREAM_STATS* pStats) final;
+
+	//IDXAudioOfflineStream methods
+
+	/* Ends the render and closes the output file */
+	VOID STDMETHODCALLTYPE Finish() final;
+
+	/* Waits for the render to finish */
+	BOOL STDMETHODCALLTYPE WaitForFinish(DWORD Milliseconds) final;
+
+	/* Returns the number of frames rendered so far */
+	UINT64 STDMETHODCALLTYPE GetFramesRendered() final {
+		return UINT64(InterlockedCompareExchange64(&m_FramesRendered, 0, 0));
+	}
+
+	/* Returns the duration of the audio rendered divided by the time it took to render it */
+	DOUBLE STDMETHODCALLTYPE GetRealTimeFactor() final;
+
+	/* Returns the rendered frames when rendering to memory */
+	const FLOAT* STDMETHODCALLTYPE GetBuffer() final;
+
+	//New methods
+
+	/* Checks to see if the callback is valid, opens the output file, and creates the thread */
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback);
+
+private:
+	long m_RefCount; //Reference counter
+
+	CComPtr<IDXAudioWriteCallback> m_WriteCallback; //The callback object
+	FLOAT m_SampleRate; //The sample rate requested by the application
+	UINT m_Channels; //The number of channels requested by the application
+	UINT64 m_Frames; //Number of frames to render, or 0 to render until Finish() is called
+	UINT m_PeriodFrames; //Number of frames requested from the callback at a time
+	std::vector<FLOAT> m_PeriodBuffer; //Output of a single callback
+	std::vector<FLOAT> m_MemoryBuffer; //All output, when rendering to memory
+
+	HANDLE m_File; //The output file, or INVALID_HANDLE_VALUE when rendering to memory
+	volatile LONG64 m_FramesRendered; //Frames rendered so far
+	volatile LONG64 m_RenderTicks; //Performance counter ticks spent rendering
+	LARGE_INTEGER m_Frequency; //Performance counter frequency
+	volatile LONG m_Finishing; //Set by Finish() - no more frames are rendered once this is set
+	bool m_Finished; //Whether the output has been closed (stream thread only)
+	bool m_Running; //Whether the stream is rendering (stream thread only)
+	LARGE_INTEGER m_StartTime; //When the stream last started rendering
+	CDXAudioStreamCounters m_Counters; //Processing figures reported by GetStats()
+
+	HANDLE m_StartEvent; //Used as a message for starting the stream
+	HANDLE m_StopEvent; //Used as a message for stopping the stream
+	HANDLE m_FinishEvent; //Used as a message for finishing the stream
+	HANDLE m_DoneEvent; //Manual-reset event, signalled once the output is closed
+	HANDLE m_HaltEvent; //Used for closing the thread/stream
+	HANDLE m_InitEvent; //Set by the thread once the callback has been initialized
+
+	HANDLE m_Thread; //Handle to the stream thread
+
+	/* Renders a single period and writes it to the output */
+	VOID RenderPeriod();
+
+	/* Starts timing the render */
+	VOID StartClock();
+
+	/* Stops timing the render, adding the elapsed time to m_RenderTicks */
+	VOID StopClock();
+
+	/* Closes the output, patching the WAV header with the final length */
+	VOID CloseOutput();
+
+	/* Writes the WAV header for [Frames] frames at the start of the output file */
+	HRESULT WriteWaveHeader(UINT64 Frames);
+
+	//IUnknown methods
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(IDXAudioOfflineStream);
+		QUERY_INTERFACE_CAST(IDXAudioStream2);
+		QUERY_INTERFACE_CAST(IDXAudioStream);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+
+	/* The static thread entry point */
+	static DWORD __stdcall StaticStreamThreadEntry(LPVOID Data);
+
+	/* The non-static thread entry point, called by StaticStreamThreadEntry() */
+	DWORD StreamThreadEntry();
+};
\ No newline at end of file
@@ -46,7 +46,7 @@ CDXAudioOutputStream::~CDXAudioOutputStream() {
 	}
 }
 
-HRESULT CDXAudioOutputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback) {
+HRESULT CDXAudioOutputStream::Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback) {
 	HRESULT hr = S_OK;
 
 	CComPtr<IDXAudioCallback> Callback = pDXAudioCallback;
@@ -64,10 +64,12 @@ HRESULT CDXAudioOutputStream::Initialize(FLOAT SampleRate, IDXAudioCallback* pDX
 		); return E_FAIL;
 	}
 
-	m_SampleRate = SampleRate;
+	m_SampleRate = pDesc->SampleRate;
+	m_Channels = pDesc->Channels != 0 ? pDesc->Channels : 2;
+	m_Quality = pDesc->Quality;
 
 	//Create the thread (done in CDXAudioStream)
-	hr = CDXAudioStream::Initialize(Callback);
+	hr = CDXAudioStream::Initialize(Callback, pDesc);
 
 	if (FAILED(hr)) return hr;
 
@@ -180,7 +182,16 @@ VOID CDXAudioOutputStream::ImplProcess() {
 	//so we need to divide by the resample ratio to get the correct number of frames.
 	m_SamplesNeeded += DOUBLE(m_ClientWriter.GetPeriodFrames()) / m_ClientWriter.GetRatio();
 	const UINT SamplesGen = (UINT)(ceil(m_SamplesNeeded)); //We'll generate an integral number of samples
-	FLOAT* OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * SamplesGen)); //Create the buffer on the stack (_alloca is safe here)
+
+	//If the endpoint takes the application's frames as they are, the application writes straight into its buffer
+	FLOAT* EndpointBuffer = m_ClientWriter.IsDirect() ? m_ClientWriter.BeginWrite(SamplesGen) : nullptr;
+	FLOAT* OutputBuffer = EndpointBuffer;
+
+	//Otherwise, create the buffer on the stack (_alloca is safe here).  A direct writer that couldn't lock the
+	//endpoint's buffer still calls the application, so that it keeps time, but its frames go nowhere.
+	if (OutputBuffer == nullptr) {
+		OutputBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * SamplesGen));
+	}
 
 	//Get the application to generate new output data
 	m_WriteCallback->OnProcess (
@@ -190,10 +201,16 @@ VOID CDXAudioOutputStream::ImplProcess() {
 	);
 
 	//Write that output data to the stream
-	m_ClientWriter.Write (
-		OutputBuffer,
-		SamplesGen
-	);
+	if (EndpointBuffer != nullptr) {
+		m_ClientWriter.EndWrite (
+			SamplesGen
+		);
+	} else if (!m_ClientWriter.IsDirect()) {
+		m_ClientWriter.Write (
+			OutputBuffer,
+			SamplesGen
+		);
+	}
 
 	//Subtract the integral number of samples from the decimal number of samples.
 	//If there is a remainder > 0.5, it is used in the next period to generate an extra
@@ -210,10 +227,14 @@ VOID CDXAudioOutputStream::InitClientWriter() {
 
 	HRESULT hr = m_ClientWriter.Initialize (
 		m_SampleRate,
+		m_Channels,
+		m_Quality,
 		GetWaitEvent(),
 		m_OutputDevice,
 		Callback
 	); HALT_HR();
+
+	GetCounters().SetOutputPath(m_ClientWriter.IsDirect() ? DXAUDIO_OUTPUT_PATH_DIRECT : DXAUDIO_OUTPUT_PATH_CONVERTED);
 }
 
 //Handle bad or good HRESULTS
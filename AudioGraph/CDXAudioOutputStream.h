@@ -70,7 +70,7 @@ public:
 	//New methods
 
 	/* Checks to see if the callback is valid, then calls CDXAudioStream::Initialize() */
-	HRESULT Initialize(FLOAT SampleRate, IDXAudioCallback* pDXAudioCallback);
+	HRESULT Initialize(const DXAUDIO_STREAM_DESC_EX* pDesc, IDXAudioCallback* pDXAudioCallback);
 
 private:
 	CComPtr<IMMDevice> m_OutputDevice; //The device we're outputting to
@@ -15,10 +15,10 @@ CDXAudioResampler::~CDXAudioResampler() {
 }
 
 //Create the SRC_STATE object
-HRESULT CDXAudioResampler::Initialize() {
+HRESULT CDXAudioResampler::Initialize(DXAUDIO_RESAMPLER_QUALITY Quality) {
 	int error = 0;
 
-	m_SrcState = src_new(SRC_SINC_FASTEST, 2, &error);
+	m_SrcState = src_new(GetConverterType(Quality), 2, &error);
 
 	if (m_SrcState == nullptr) {
 		return E_FAIL;
@@ -40,6 +40,17 @@ VOID CDXAudioResampler::Process (
 	int error = 0;
 	SRC_DATA SrcData;
 
+	//libsamplerate still filters (and delays) the signal at a ratio of 1.0, so just copy it
+	if (Ratio == 1.0) {
+		UINT Frames = InBufferFrames < OutBufferFrames ? InBufferFrames : OutBufferFrames;
+
+		CopyMemory(OutBuffer, InBuffer, Frames * sizeof(FLOAT) * 2);
+
+		*pInBufferFramesUsed = Frames;
+		*pOutBufferFramesGen = Frames;
+		return;
+	}
+
 	SrcData.data_in = InBuffer;
 	SrcData.data_out = OutBuffer;
 	SrcData.end_of_input = 0;
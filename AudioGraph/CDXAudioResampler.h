@@ -1,5 +1,6 @@
 #pragma once
 
+#include "DXAudio.h"
 #include "DXAudioResampler.h"
 #include "samplerate.h"
 #include "QueryInterface.h"
@@ -50,7 +51,18 @@ public:
 	//New methods
 
 	/* Creates the SRC_STATE object. */
-	HRESULT Initialize();
+	HRESULT Initialize(DXAUDIO_RESAMPLER_QUALITY Quality);
+
+	/* Returns the libsamplerate converter type used for [Quality]. */
+	static int GetConverterType(DXAUDIO_RESAMPLER_QUALITY Quality) {
+		switch (Quality) {
+			case DXAUDIO_RESAMPLER_QUALITY_ZERO_ORDER_HOLD: return SRC_ZERO_ORDER_HOLD;
+			case DXAUDIO_RESAMPLER_QUALITY_LINEAR: return SRC_LINEAR;
+			case DXAUDIO_RESAMPLER_QUALITY_SINC_MEDIUM: return SRC_SINC_MEDIUM_QUALITY;
+			case DXAUDIO_RESAMPLER_QUALITY_SINC_BEST: return SRC_SINC_BEST_QUALITY;
+			default: return SRC_SINC_FASTEST;
+		}
+	}
 
 private:
 	long m_RefCount;
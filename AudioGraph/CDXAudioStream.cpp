@@ -29,6 +29,8 @@
 #define CHECK_HR(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return hr; }
 
 CDXAudioStream::CDXAudioStream() :
+m_Channels(2),
+m_Quality(DXAUDIO_RESAMPLER_QUALITY_DEFAULT),
 m_RefCount(1),
 m_StartEvent(NULL),
 m_StopEvent(NULL),
@@ -36,8 +38,14 @@ m_DeviceChangeEvent(NULL),
 m_PropertyChangeEvent(NULL),
 m_WaitEvent(NULL),
 m_HaltEvent(NULL),
-m_Thread(NULL)
-{ }
+m_InitEvent(NULL),
+m_DetachEvent(NULL),
+m_Thread(NULL),
+m_Engine(nullptr),
+m_Backend(DXAUDIO_BACKEND_WASAPI)
+{
+	ZeroMemory(&m_NullDevice, sizeof(m_NullDevice));
+}
 
 CDXAudioStream::~CDXAudioStream() {
 	//Expects thread to be halted by child class
@@ -53,10 +61,31 @@ CDXAudioStream::~CDXAudioStream() {
 	EVENT_CLEANUP(m_PropertyChangeEvent);
 	EVENT_CLEANUP(m_WaitEvent);
 	EVENT_CLEANUP(m_HaltEvent);
+	EVENT_CLEANUP(m_InitEvent);
+	EVENT_CLEANUP(m_DetachEvent);
 }
 
-HRESULT CDXAudioStream::Initialize(CComPtr<IDXAudioCallback> Callback) {
+HRESULT CDXAudioStream::Initialize(CComPtr<IDXAudioCallback> Callback, const DXAUDIO_STREAM_DESC_EX* pDesc) {
+	HRESULT hr = S_OK;
+	HANDLE Thread = NULL;
+
 	m_Callback = Callback;
+	m_Backend = pDesc->Backend;
+
+	if (m_Backend != DXAUDIO_BACKEND_WASAPI && m_Backend != DXAUDIO_BACKEND_NULL) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
+		return E_FAIL;
+	}
+
+	if (pDesc->NullDevice != nullptr) {
+		m_NullDevice = *pDesc->NullDevice;
+	}
+
+	//The streams convert a period at a time in buffers on the stack, which are sized by the channel counts
+	if (pDesc->Channels > DXAUDIO_MAX_CHANNELS || m_NullDevice.Channels > DXAUDIO_MAX_CHANNELS) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
+		return E_FAIL;
+	}
 
 	EVENT_INIT(m_StartEvent, __LINE__);
 	EVENT_INIT(m_StopEvent, __LINE__);
@@ -64,27 +93,132 @@ HRESULT CDXAudioStream::Initialize(CComPtr<IDXAudioCallback> Callback) {
 	EVENT_INIT(m_PropertyChangeEvent, __LINE__);
 	EVENT_INIT(m_WaitEvent, __LINE__);
 	EVENT_INIT(m_HaltEvent, __LINE__);
+	EVENT_INIT(m_InitEvent, __LINE__);
+	EVENT_INIT(m_DetachEvent, __LINE__);
+
+	if (pDesc->Shared) {
+		//Everything will happen on the thread of a shared engine
+		hr = CDXAudioEngine::Attach (
+			this,
+			m_Callback,
+			&m_Engine
+		); if (FAILED(hr)) return hr; //Already reported by Attach()
+
+		Thread = m_Engine->GetThread();
+	} else {
+		//Everything will happen on a separate thread
+		m_Thread = CreateThread (
+			NULL,
+			0,
+			StaticStreamThreadEntry,
+			this,
+			NULL,
+			NULL
+		);
 
-	//Everything will happen on a separate thread
-	m_Thread = CreateThread (
-		NULL,
-		0,
-		StaticStreamThreadEntry,
-		this,
+		//If m_Thread is NULL, an error occurred
+		if (m_Thread == NULL) {
+			m_Callback->OnObjectFailure (
+				FILENAME,
+				__LINE__,
+				HRESULT_FROM_WIN32(GetLastError())
+			); return E_FAIL;
+		}
+
+		Thread = m_Thread;
+	}
+
+	HANDLE Handles[] = {
+		m_InitEvent,
+		Thread
+	};
+
+	//Wait for the endpoints to be initialized, so that the sample rate is known once this returns.
+	//If the thread exits instead, it has already reported why.
+	if (WaitForMultipleObjects(2, Handles, FALSE, INFINITE) != WAIT_OBJECT_0) {
+		return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+VOID CDXAudioStream::ThreadInitialize() {
+	//Initialize the child object
+	ImplInitialize();
+
+	//The sample rate is final now, so the callback can rely on it
+	m_Callback->OnThreadInit();
+
+	SetEvent(m_InitEvent);
+}
+
+bool CDXAudioStream::DispatchMessages() {
+	//The events are auto-reset, so polling them consumes the messages just like a wait would
+	if (WaitForSingleObject(m_HaltEvent, 0) == WAIT_OBJECT_0) {
+		return false;
+	}
+
+	if (WaitForSingleObject(m_StartEvent, 0) == WAIT_OBJECT_0) {
+		Restart();
+	}
+
+	if (WaitForSingleObject(m_StopEvent, 0) == WAIT_OBJECT_0) {
+		ImplStop();
+	}
+
+	if (WaitForSingleObject(m_DeviceChangeEvent, 0) == WAIT_OBJECT_0) {
+		ImplDeviceChange();
+	}
+
+	if (WaitForSingleObject(m_PropertyChangeEvent, 0) == WAIT_OBJECT_0) {
+		ImplPropertyChange();
+	}
+
+	return true;
+}
+
+HRESULT CDXAudioStream::CreateEnumerator() {
+	if (m_Backend == DXAUDIO_BACKEND_NULL) {
+		m_NullEnumerator.Attach(new CDXAudioNullEnumerator());
+		m_NullEnumerator->Initialize(&m_NullDevice);
+		m_Enumerator = m_NullEnumerator;
+
+		return S_OK;
+	}
+
+	return CoCreateInstance (
+		__uuidof(MMDeviceEnumerator),
 		NULL,
-		NULL
+		CLSCTX_ALL,
+		__uuidof(IMMDeviceEnumerator),
+		(void**)(&m_Enumerator)
 	);
+}
 
-	//If m_Thread is NULL, an error occurred
-	if (m_Thread == NULL) {
-		m_Callback->OnObjectFailure (
-			FILENAME,
-			__LINE__,
-			HRESULT_FROM_WIN32(GetLastError())
-		); return E_FAIL;
+VOID CDXAudioStream::Process() {
+	//A simulated endpoint's clock moves on as the stream takes each wakeup, so jitter is measured on that clock
+	if (m_NullEnumerator != nullptr) {
+		m_Counters.BeginPeriod(m_NullEnumerator->Advance());
+	} else {
+		m_Counters.BeginPeriod();
 	}
 
-	return S_OK;
+	ImplProcess();
+	m_Counters.EndPeriod();
+}
+
+VOID CDXAudioStream::Restart() {
+	m_Counters.Restart();
+	ImplStart();
+}
+
+VOID CDXAudioStream::GetStats(DXAUDIO_STREAM_STATS* pStats) {
+	if (pStats == nullptr) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
+		return;
+	}
+
+	m_Counters.GetStats(pStats);
 }
 
 DWORD __stdcall CDXAudioStream::StaticStreamThreadEntry(LPVOID Data) {
@@ -97,13 +231,15 @@ DWORD CDXAudioStream::StreamThreadEntry() {
 	bool run = true;
 	DWORD dwResult = 0;
 	HRESULT hr = S_OK;
+	//The wait returns the first event that is set, so the wait event comes last - a simulated
+	//endpoint sets it again as soon as a period has been processed, which would starve the rest
 	HANDLE Events[] = {
 		m_StartEvent,
 		m_StopEvent,
 		m_DeviceChangeEvent,
 		m_PropertyChangeEvent,
-		m_WaitEvent,
-		m_HaltEvent
+		m_HaltEvent,
+		m_WaitEvent
 	};
 
 	bool StreamRunning = false;
@@ -112,8 +248,8 @@ DWORD CDXAudioStream::StreamThreadEntry() {
 	static const DWORD SM_STOP = WAIT_OBJECT_0 + 1;
 	static const DWORD SM_DEVICECHANGE = WAIT_OBJECT_0 + 2;
 	static const DWORD SM_PROPERTYCHANGE = WAIT_OBJECT_0 + 3;
-	static const DWORD SM_PROCESS = WAIT_OBJECT_0 + 4;
-	static const DWORD SM_CLOSE = WAIT_OBJECT_0 + 5;
+	static const DWORD SM_CLOSE = WAIT_OBJECT_0 + 4;
+	static const DWORD SM_PROCESS = WAIT_OBJECT_0 + 5;
 
 	static const UINT nEvents = sizeof(Events) / sizeof(HANDLE);
 
@@ -124,16 +260,8 @@ DWORD CDXAudioStream::StreamThreadEntry() {
 		COINIT_APARTMENTTHREADED
 	); CHECK_HR(__LINE__);
 
-	m_Callback->OnThreadInit();
-
-	//Create the device enumerator
-	hr = CoCreateInstance (
-		__uuidof(MMDeviceEnumerator),
-		NULL,
-		CLSCTX_ALL,
-		__uuidof(IMMDeviceEnumerator),
-		(void**)(&m_Enumerator)
-	); CHECK_HR(__LINE__);
+	//Create the device enumerator, or the null backend's stand-in for it
+	hr = CreateEnumerator(); CHECK_HR(__LINE__);
 
 	CMMNotificationClient NotificationClient(*this);
 
@@ -142,8 +270,7 @@ DWORD CDXAudioStream::StreamThreadEntry() {
 		&NotificationClient
 	); CHECK_HR(__LINE__);
 
-	//Initialize the child object
-	ImplInitialize();
+	ThreadInitialize();
 
 	hr = S_OK;
 
@@ -159,11 +286,11 @@ DWORD CDXAudioStream::StreamThreadEntry() {
 
 		switch (dwResult) {
 			case SM_PROCESS: { //Process
-				ImplProcess();
+				Process();
 			} break;
 
 			case SM_START: { //Start the stream
-				ImplStart();
+				Restart();
 			} break;
 
 			case SM_STOP: { //Stop the stream
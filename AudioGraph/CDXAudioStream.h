@@ -27,10 +27,13 @@
 #include <atlbase.h>
 #include <mmdeviceapi.h>
 #include "CMMNotificationClientListener.h"
+#include "CDXAudioEngine.h"
+#include "CDXAudioStreamCounters.h"
+#include "CDXAudioNullEnumerator.h"
 #include "QueryInterface.h"
 
 /* This is the base class for all streams - it handles threading issues */
-class CDXAudioStream abstract : public IDXAudioStream, public CMMNotificationClientListener {
+class CDXAudioStream abstract : public IDXAudioStream2, public CMMNotificationClientListener {
 public:
 	CDXAudioStream();
 
@@ -53,25 +56,38 @@ public:
 		return m_RefCount;
 	}
 
+	/* Returns the counters reported by GetStats().  Used by the clients on the stream thread. */
+	CDXAudioStreamCounters& GetCounters() {
+		return m_Counters;
+	}
+
 	/* Calling this will exit the thread gracefully */
 	/* This must be the first thing called in the destructor of the child class, before WaitForThread() */
 	VOID Halt() {
-		SetEvent(m_HaltEvent);
+		Notify(m_HaltEvent);
 	}
 
 protected:
-	/* Initializes the thread - must be called by child class in its Initialize() method */
-	HRESULT Initialize(CComPtr<IDXAudioCallback> Callback);
+	/* Initializes the thread - must be called by child class in its Initialize() method.  If [pDesc] is
+	** shared, the stream is attached to a shared CDXAudioEngine rather than getting a thread of its own, unless
+	** it uses the null backend.  This returns once the endpoints have been initialized, so a sample rate of 0
+	** has been resolved by then. */
+	HRESULT Initialize(CComPtr<IDXAudioCallback> Callback, const DXAUDIO_STREAM_DESC_EX* pDesc);
 
 	/* Returns a handle to the event used for waking the thread each device period */
 	HANDLE GetWaitEvent() {
 		return m_WaitEvent;
 	}
 
-	/* Calling this will wait for the thread to die */
+	/* Calling this will wait for the thread to die, or for a shared engine to let go of the stream */
 	/* This must be the second thing called in the destructor of the child class, after Halt() */
 	VOID WaitForThread() {
-		WaitForSingleObject(m_Thread, INFINITE);
+		if (m_Engine != nullptr) {
+			m_Engine->Detach(this);
+			m_Engine = nullptr;
+		} else {
+			WaitForSingleObject(m_Thread, INFINITE);
+		}
 	}
 
 	//To be implemented
@@ -94,10 +110,14 @@ protected:
 	/* Child class must read/write stream data and call their callback's process method */
 	virtual VOID ImplProcess() PURE;
 
-	CComPtr<IMMDeviceEnumerator> m_Enumerator; //The WASAPI device enumerator
+	CComPtr<IMMDeviceEnumerator> m_Enumerator; //The WASAPI device enumerator, or the null backend's stand-in for it
 	FLOAT m_SampleRate; //The sample rate requested by the application - input/output will be resampled to this
+	UINT m_Channels; //The number of channels requested by the application - the endpoint's channels are mapped to these
+	DXAUDIO_RESAMPLER_QUALITY m_Quality; //The resampler quality requested by the application
 
 private:
+	friend class CDXAudioEngine;
+
 	long m_RefCount; //Reference counter
 
 	HANDLE m_StartEvent; //Used as a message for starting the stream
@@ -106,14 +126,24 @@ private:
 	HANDLE m_PropertyChangeEvent; //Used as a message for checking for property value changes
 	HANDLE m_WaitEvent; //Used as the callback event for WASAPI
 	HANDLE m_HaltEvent; //Used for closing the thread/stream
+	HANDLE m_InitEvent; //Set by the thread once the endpoints are initialized
+	HANDLE m_DetachEvent; //Set by a shared engine once it has let go of the stream
 
-	HANDLE m_Thread; //Handle to the thread (one thread for each stream)
+	HANDLE m_Thread; //Handle to the thread (one thread for each stream), or NULL if the stream is shared
+	CDXAudioEngine* m_Engine; //The shared engine servicing the stream, or nullptr if it has its own thread
 
 	CComPtr<IDXAudioCallback> m_Callback; //Used for error reporting
 
+	CDXAudioStreamCounters m_Counters; //Latency and timing figures
+
+	DXAUDIO_BACKEND m_Backend; //What is behind the stream's endpoints
+	DXAUDIO_NULL_DEVICE_DESC m_NullDevice; //The simulated endpoints, if the backend is DXAUDIO_BACKEND_NULL
+	CComPtr<CDXAudioNullEnumerator> m_NullEnumerator; //Keeps the simulated clock, or nullptr
+
 	//IUnknown methods
 
 	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(IDXAudioStream2);
 		QUERY_INTERFACE_CAST(IDXAudioStream);
 		QUERY_INTERFACE_CAST(IUnknown);
 		QUERY_INTERFACE_FAIL();
@@ -123,12 +153,12 @@ private:
 
 	/* Sets the start event, eventually causing the stream to start */
 	VOID STDMETHODCALLTYPE Start() final {
-		SetEvent(m_StartEvent);
+		Notify(m_StartEvent);
 	}
 
 	/* Sets the stop event, eventually causing the stream to stop */
 	VOID STDMETHODCALLTYPE Stop() final {
-		SetEvent(m_StopEvent);
+		Notify(m_StopEvent);
 	}
 
 	/* Returns the sample rate of the stream */
@@ -136,18 +166,49 @@ private:
 		return m_SampleRate;
 	}
 
+	//IDXAudioStream2 methods
+
+	/* Copies the latency and timing figures of the stream */
+	VOID STDMETHODCALLTYPE GetStats(DXAUDIO_STREAM_STATS* pStats) final;
+
 	//CMMNotificationClientListener methods
 
 	/* Called when the user changes the default device for any data flow or role */
 	virtual VOID OnDefaultDeviceChanged() final {
-		SetEvent(m_DeviceChangeEvent);
+		Notify(m_DeviceChangeEvent);
 	}
 
 	/* Called when the user changes properties such as sample rate on an endpoint */
 	virtual VOID OnPropertyValueChanged() final {
-		SetEvent(m_PropertyChangeEvent);
+		Notify(m_PropertyChangeEvent);
 	}
 
+	/* Sets a message event, and wakes the shared engine if there is one, since it only waits on
+	** the wait events of its streams */
+	VOID Notify(HANDLE Event) {
+		SetEvent(Event);
+
+		if (m_Engine != nullptr) {
+			m_Engine->Wake();
+		}
+	}
+
+	/* Initializes the child object and lets the callback know.  Called on the thread servicing the stream. */
+	VOID ThreadInitialize();
+
+	/* Shared streams only.  Delivers any pending messages to the child object.  Returns false once
+	** the stream has been halted. */
+	bool DispatchMessages();
+
+	/* Creates m_Enumerator for the stream's backend.  Called on the thread servicing the stream. */
+	HRESULT CreateEnumerator();
+
+	/* Processes a period, timing it for GetStats(). */
+	VOID Process();
+
+	/* Starts the child object, and restarts the jitter measurement. */
+	VOID Restart();
+
 	/* The static thread entry point */
 	static DWORD __stdcall StaticStreamThreadEntry(LPVOID Data);
 
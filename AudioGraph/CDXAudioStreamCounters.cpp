@@ -0,0 +1,150 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#include "CDXAudioStreamCounters.h"
+#include <intrin.h>
+
+CDXAudioStreamCounters::CDXAudioStreamCounters() :
+m_WakeTime(0),
+m_LastWake(0),
+m_DevicePeriod(0),
+m_OutputBufferFrames(0),
+m_OutputBufferFill(0),
+m_InputBufferFill(0),
+m_OutputResamplerDelay(0),
+m_InputResamplerDelay(0),
+m_Periods(0),
+m_MaxProcessTime(0),
+m_JitterSamples(0),
+m_TotalJitter(0),
+m_MaxJitter(0),
+m_Underruns(0),
+m_Overruns(0),
+m_DroppedFrames(0),
+m_TargetLatency(0),
+m_LatencyError(0),
+m_MaxLatencyError(0),
+m_DriftCorrection(0),
+m_OutputPath(DXAUDIO_OUTPUT_PATH_NONE)
+{
+	QueryPerformanceFrequency(&m_Frequency);
+	ZeroMemory((void*)(m_ProcessHistogram), sizeof(m_ProcessHistogram));
+}
+
+VOID CDXAudioStreamCounters::BeginPeriod() {
+	LARGE_INTEGER Now;
+	QueryPerformanceCounter(&Now);
+
+	m_WakeTime = Now.QuadPart;
+
+	if (m_LastWake != 0) {
+		AddJitter(TicksToTime(m_WakeTime - m_LastWake));
+	}
+
+	m_LastWake = m_WakeTime;
+}
+
+VOID CDXAudioStreamCounters::BeginPeriod(LONGLONG Interval) {
+	LARGE_INTEGER Now;
+	QueryPerformanceCounter(&Now);
+
+	//The wall clock still times the processing
+	m_WakeTime = Now.QuadPart;
+
+	if (m_LastWake != 0 && Interval != 0) {
+		AddJitter(Interval);
+	}
+
+	m_LastWake = m_WakeTime;
+}
+
+VOID CDXAudioStreamCounters::AddJitter(LONGLONG Interval) {
+	//Ideally the stream wakes exactly one device period after it last woke
+	if (m_DevicePeriod != 0) {
+		LONGLONG Jitter = Interval - m_DevicePeriod;
+
+		if (Jitter < 0) {
+			Jitter = -Jitter;
+		}
+
+		InterlockedIncrement64(&m_JitterSamples);
+		InterlockedExchangeAdd64(&m_TotalJitter, Jitter);
+
+		//Only this thread writes the maximum, so a plain comparison is enough
+		if (Jitter > m_MaxJitter) {
+			InterlockedExchange64(&m_MaxJitter, Jitter);
+		}
+	}
+}
+
+VOID CDXAudioStreamCounters::EndPeriod() {
+	LARGE_INTEGER Now;
+	QueryPerformanceCounter(&Now);
+
+	LONGLONG Time = TicksToTime(Now.QuadPart - m_WakeTime);
+	LONGLONG Microseconds = Time / 10;
+	unsigned long Bucket = 0;
+
+	//Bucket i holds [2^i, 2^(i+1)) microseconds
+	if (Microseconds > 0) {
+		_BitScanReverse(&Bucket, Microseconds > 0xFFFFFFFF ? 0xFFFFFFFF : (unsigned long)(Microseconds));
+	}
+
+	if (Bucket >= DXAUDIO_STREAM_STATS_BUCKETS) {
+		Bucket = DXAUDIO_STREAM_STATS_BUCKETS - 1;
+	}
+
+	InterlockedIncrement64(&m_ProcessHistogram[Bucket]);
+	InterlockedIncrement64(&m_Periods);
+
+	if (Time > m_MaxProcessTime) {
+		InterlockedExchange64(&m_MaxProcessTime, Time);
+	}
+}
+
+VOID CDXAudioStreamCounters::GetStats(DXAUDIO_STREAM_STATS* pStats) {
+	LONGLONG JitterSamples = Read(&m_JitterSamples);
+
+	pStats->DevicePeriod = Read(&m_DevicePeriod);
+	pStats->OutputBufferFrames = UINT(Read(&m_OutputBufferFrames));
+	pStats->OutputBufferFill = UINT(Read(&m_OutputBufferFill));
+	pStats->InputBufferFill = UINT(Read(&m_InputBufferFill));
+	pStats->ResamplerDelay = Read(&m_OutputResamplerDelay) + Read(&m_InputResamplerDelay);
+	pStats->Periods = UINT64(Read(&m_Periods));
+
+	for (UINT i = 0; i < DXAUDIO_STREAM_STATS_BUCKETS; i++) {
+		pStats->ProcessHistogram[i] = UINT64(Read(&m_ProcessHistogram[i]));
+	}
+
+	pStats->MaxProcessTime = Read(&m_MaxProcessTime);
+	pStats->MeanJitter = JitterSamples != 0 ? Read(&m_TotalJitter) / JitterSamples : 0;
+	pStats->MaxJitter = Read(&m_MaxJitter);
+	pStats->Underruns = UINT64(Read(&m_Underruns));
+	pStats->Overruns = UINT64(Read(&m_Overruns));
+	pStats->DroppedFrames = UINT64(Read(&m_DroppedFrames));
+	pStats->TargetLatency = Read(&m_TargetLatency);
+	pStats->LatencyError = Read(&m_LatencyError);
+	pStats->MaxLatencyError = Read(&m_MaxLatencyError);
+	pStats->DriftCorrection = Read(&m_DriftCorrection);
+	pStats->OutputPath = DXAUDIO_OUTPUT_PATH(Read(&m_OutputPath));
+}
\ No newline at end of file
@@ -0,0 +1,168 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+
+#pragma once
+
+#include <Windows.h>
+#include "DXAudio.h"
+
+/* CDXAudioStreamCounters collects the timing and latency figures reported by IDXAudioStream2::GetStats().
+** Only the thread servicing the stream writes them, and every value shared with other threads is a
+** 64-bit interlocked variable, so collecting never takes a lock and reading never sees a torn value. */
+class CDXAudioStreamCounters {
+public:
+	CDXAudioStreamCounters();
+
+	/* Marks the thread waking for a period.  The time since the previous wakeup is compared to the
+	** device period to measure jitter.  Stream thread only. */
+	VOID BeginPeriod();
+
+	/* Marks the thread waking for a period of a simulated endpoint, whose clock has moved on by [Interval]
+	** since the previous wakeup.  Jitter is measured on that clock rather than the wall clock.  Stream thread only. */
+	VOID BeginPeriod(LONGLONG Interval);
+
+	/* Marks the end of a period, recording how long it took to process.  Stream thread only. */
+	VOID EndPeriod();
+
+	/* Forgets the previous wakeup, so that the time a stream spends stopped isn't counted as jitter.
+	** Stream thread only. */
+	VOID Restart() {
+		m_LastWake = 0;
+	}
+
+	/* Sets the period of the endpoint that wakes the stream, in 100-nanosecond units. */
+	VOID SetDevicePeriod(LONGLONG Period) {
+		InterlockedExchange64(&m_DevicePeriod, Period);
+	}
+
+	/* Sets the size of the output endpoint's buffer, in endpoint frames. */
+	VOID SetOutputBufferFrames(UINT Frames) {
+		InterlockedExchange64(&m_OutputBufferFrames, Frames);
+	}
+
+	/* Sets the number of frames queued for playback, in endpoint frames. */
+	VOID SetOutputBufferFill(UINT Frames) {
+		InterlockedExchange64(&m_OutputBufferFill, Frames);
+	}
+
+	/* Sets the number of frames waiting to be captured, in endpoint frames. */
+	VOID SetInputBufferFill(UINT Frames) {
+		InterlockedExchange64(&m_InputBufferFill, Frames);
+	}
+
+	/* Sets the delay of the output resampler, in 100-nanosecond units. */
+	VOID SetOutputResamplerDelay(LONGLONG Delay) {
+		InterlockedExchange64(&m_OutputResamplerDelay, Delay);
+	}
+
+	/* Sets the delay of the input resampler, in 100-nanosecond units. */
+	VOID SetInputResamplerDelay(LONGLONG Delay) {
+		InterlockedExchange64(&m_InputResamplerDelay, Delay);
+	}
+
+	/* Counts a period in which the output endpoint had run out of frames. */
+	VOID AddUnderrun() {
+		InterlockedIncrement64(&m_Underruns);
+	}
+
+	/* Counts a capture packet that the endpoint flagged as discontinuous. */
+	VOID AddOverrun() {
+		InterlockedIncrement64(&m_Overruns);
+	}
+
+	/* Counts frames that were thrown away. */
+	VOID AddDroppedFrames(UINT Frames) {
+		InterlockedExchangeAdd64(&m_DroppedFrames, Frames);
+	}
+
+	/* Sets the amount of captured audio a duplex stream aims to hold back, in 100-nanosecond units. */
+	VOID SetTargetLatency(LONGLONG Latency) {
+		InterlockedExchange64(&m_TargetLatency, Latency);
+	}
+
+	/* Sets how far the amount a duplex stream is holding back is from its target, in 100-nanosecond units.
+	** [Error] is the averaged figure, and [Instant] is the figure for the period that just ended. */
+	VOID SetLatencyError(LONGLONG Error, LONGLONG Instant) {
+		InterlockedExchange64(&m_LatencyError, Error);
+
+		if (Instant < 0) {
+			Instant = -Instant;
+		}
+
+		if (Instant > m_MaxLatencyError) {
+			InterlockedExchange64(&m_MaxLatencyError, Instant);
+		}
+	}
+
+	/* Sets the adjustment made to the output resample ratio of a duplex stream, in parts per million. */
+	VOID SetDriftCorrection(LONGLONG Correction) {
+		InterlockedExchange64(&m_DriftCorrection, Correction);
+	}
+
+	/* Sets how the callback's output reaches the output endpoint. */
+	VOID SetOutputPath(DXAUDIO_OUTPUT_PATH Path) {
+		InterlockedExchange64(&m_OutputPath, Path);
+	}
+
+	/* Copies the counters into [pStats].  May be called from any thread. */
+	VOID GetStats(DXAUDIO_STREAM_STATS* pStats);
+
+private:
+	LARGE_INTEGER m_Frequency; //Performance counter frequency
+	LONGLONG m_WakeTime; //When the current period started, in performance counter ticks (stream thread only)
+	LONGLONG m_LastWake; //When the previous period started, or 0 after a restart (stream thread only)
+
+	volatile LONG64 m_DevicePeriod;
+	volatile LONG64 m_OutputBufferFrames;
+	volatile LONG64 m_OutputBufferFill;
+	volatile LONG64 m_InputBufferFill;
+	volatile LONG64 m_OutputResamplerDelay;
+	volatile LONG64 m_InputResamplerDelay;
+	volatile LONG64 m_Periods;
+	volatile LONG64 m_ProcessHistogram[DXAUDIO_STREAM_STATS_BUCKETS];
+	volatile LONG64 m_MaxProcessTime;
+	volatile LONG64 m_JitterSamples; //Number of wakeups that jitter was measured for
+	volatile LONG64 m_TotalJitter;
+	volatile LONG64 m_MaxJitter;
+	volatile LONG64 m_Underruns;
+	volatile LONG64 m_Overruns;
+	volatile LONG64 m_DroppedFrames;
+	volatile LONG64 m_TargetLatency;
+	volatile LONG64 m_LatencyError;
+	volatile LONG64 m_MaxLatencyError;
+	volatile LONG64 m_DriftCorrection;
+	volatile LONG64 m_OutputPath; //A DXAUDIO_OUTPUT_PATH
+
+	/* Compares the time from one wakeup to the next with the device period. */
+	VOID AddJitter(LONGLONG Interval);
+
+	/* Converts performance counter ticks to 100-nanosecond units. */
+	LONGLONG TicksToTime(LONGLONG Ticks) {
+		return Ticks * 10000000 / m_Frequency.QuadPart;
+	}
+
+	/* Reads a counter without tearing it on 32-bit builds. */
+	static LONGLONG Read(volatile LONG64* pCounter) {
+		return InterlockedCompareExchange64(pCounter, 0, 0);
+	}
+};
\ No newline at end of file
@@ -21,6 +21,9 @@
 */
 
 #include "CDXAudioWriteCallback.h"
+#include "MixKernels.h"
+
+#include <algorithm>
 
 #pragma comment(lib, "mfplat.lib")
 #pragma comment(lib, "mfreadwrite.lib")
@@ -28,64 +31,567 @@
 
 #define FILENAME L"CDXAudioWriteCallback.cpp"
 #define CHECK_HR(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return; }
+#define RETURN_HR(Line) if (FAILED(hr)) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return hr; }
 
-CDXAudioWriteCallback::CDXAudioWriteCallback() : m_RefCount(1) { }
+CDXAudioWriteCallback::CDXAudioWriteCallback() :
+m_RefCount(1),
+m_Channels(2),
+m_OfflineStream(nullptr),
+m_FinishWhenIdle(false),
+m_Scripted(false),
+m_AsyncTransitions(false),
+m_SampleRate(44100),
+m_Buses(nullptr),
+m_NumBuses(0),
+m_NumVoices(0),
+m_MaxVoices(0),
+m_MixedFrames(0)
+{
+	m_Script.Position = 0;
+	ZeroMemory(&m_Counters, sizeof(m_Counters));
+	m_Counters.Realtime.Trap = TRUE;
+	QueryPerformanceFrequency(&m_Frequency);
+	InitializeCriticalSection(&m_ProducerLock);
+}
 
 CDXAudioWriteCallback::~CDXAudioWriteCallback() { 
+	AUDIO_GRAPH_COMMAND Command;
+	CAudioGraph* Graph = nullptr;
+
+	//The stream has stopped by now, so every ring can be emptied from this thread
+	while (m_Commands.Pop(Command)) {
+		if (Command.Graph != nullptr) {
+			ReleaseGraph(Command.Graph);
+		}
+	}
+
+	while (m_PlaybackQueue.Pop(Graph)) {
+		Graph->SetPlaying(false);
+		ReleaseGraph(Graph);
+	}
+
+	//The workers are idle between callbacks, but they're stopped before anything they render goes away
+	m_Scheduler.Halt();
+
+	for (UINT i = 0; i < m_NumBuses; i++) {
+		StopVoices(m_Buses[i]);
+	}
+
+	CollectRetired();
+	ReportRenderFailures();
+
+	delete[] m_Buses;
+
+	DeleteCriticalSection(&m_ProducerLock);
+
 	MFShutdown();
 }
 
-HRESULT CDXAudioWriteCallback::Initialize(IAudioGraphCallback* pAudioGraphCallback) {
+HRESULT CDXAudioWriteCallback::Initialize(IAudioGraphCallback* pAudioGraphCallback, CAudioGraphLoader* pLoader, UINT Channels) {
 	m_Callback = pAudioGraphCallback;
+	m_Loader = pLoader;
+	m_Channels = Channels;
 
 	return S_OK;
 }
 
 VOID CDXAudioWriteCallback::QueueAudioGraph(IAudioGraph* pAudioGraph) {
-	m_PlaybackQueue.push((CAudioGraph*)(pAudioGraph));
+	if (pAudioGraph == nullptr) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
+		return;
+	}
+
+	PostCommand(AUDIO_GRAPH_COMMAND_QUEUE, (CAudioGraph*)(pAudioGraph), 0, 0.0f);
+}
+
+VOID CDXAudioWriteCallback::PlayAudioGraph(UINT Bus, IAudioGraph* pAudioGraph) {
+	if (pAudioGraph == nullptr) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
+		return;
+	}
+
+	if (Bus >= m_NumBuses) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
+		return;
+	}
+
+	PostCommand(AUDIO_GRAPH_COMMAND_PLAY, (CAudioGraph*)(pAudioGraph), Bus, 0.0f);
+}
+
+VOID CDXAudioWriteCallback::StopBus(UINT Bus) {
+	if (Bus >= m_NumBuses) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
+		return;
+	}
+
+	PostCommand(AUDIO_GRAPH_COMMAND_STOP_BUS, nullptr, Bus, 0.0f);
+}
+
+VOID CDXAudioWriteCallback::SetBusGain(UINT Bus, FLOAT Gain) {
+	if (Bus >= m_NumBuses) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
+		return;
+	}
+
+	PostCommand(AUDIO_GRAPH_COMMAND_BUS_GAIN, nullptr, Bus, Gain);
+}
+
+HRESULT CDXAudioWriteCallback::SetSampleRate(UINT SampleRate) {
+	HRESULT hr = S_OK;
+
+	//Either OnThreadInit() or the endpoint failed, and has already reported why
+	if (m_MediaType == nullptr || SampleRate == 0) {
+		return E_FAIL;
+	}
+
+	//Files are decoded straight to the stream's rate, so a file at that rate isn't resampled at all
+	hr = m_MediaType->SetUINT32 (
+		MF_MT_AUDIO_SAMPLES_PER_SECOND,
+		SampleRate
+	); RETURN_HR(__LINE__);
+
+	hr = m_MediaType->SetUINT32 (
+		MF_MT_AUDIO_AVG_BYTES_PER_SECOND,
+		sizeof(FLOAT) * m_Channels * SampleRate
+	); RETURN_HR(__LINE__);
+
+	m_SampleRate = SampleRate;
+
+	return S_OK;
+}
+
+HRESULT CDXAudioWriteCallback::SetMixer(UINT Buses, UINT MaxVoices, UINT RenderThreads) {
+	HRESULT hr = S_OK;
+
+	if (Buses > AUDIO_GRAPH_MAX_BUSES || MaxVoices > AUDIO_GRAPH_MAX_VOICES || RenderThreads > AUDIO_GRAPH_MAX_RENDER_THREADS) {
+		return E_INVALIDARG;
+	}
+
+	if (Buses > 0) {
+		m_Buses = new AUDIO_GRAPH_BUS[Buses];
+		ZeroMemory((void*)(m_Buses), sizeof(AUDIO_GRAPH_BUS) * Buses);
+
+		for (UINT i = 0; i < Buses; i++) {
+			m_Buses[i].Gain = 1.0f;
+			m_Buses[i].TargetGain = 1.0f;
+		}
+	}
+
+	m_NumBuses = Buses;
+	m_MaxVoices = MaxVoices != 0 ? MaxVoices : AUDIO_GRAPH_MAX_VOICES;
+
+	//A callback that asks for transitions, or a shared transition script, has to be used from one thread
+	if (Buses == 0 || m_Scripted || !m_AsyncTransitions) {
+		RenderThreads = 0;
+	}
+
+	hr = m_Scheduler.Initialize (
+		m_Callback,
+		RenderThreads
+	); RETURN_HR(__LINE__);
+
+	//The render thread mixes voices through this, so it can't grow once the stream has started.  Voices
+	//rendered in parallel each need their own block.
+	m_VoiceBuffer.resize(AUDIO_GRAPH_MIX_FRAMES * m_Channels * (RenderThreads > 0 ? m_MaxVoices : 1));
+
+	return S_OK;
+}
+
+VOID CDXAudioWriteCallback::SetOfflineStream(IDXAudioOfflineStream* pStream, bool FinishWhenIdle) {
+	m_OfflineStream = pStream;
+	m_FinishWhenIdle = FinishWhenIdle;
+	m_Counters.Realtime.Trap = pStream == nullptr;
+}
+
+VOID CDXAudioWriteCallback::SetTransitionScript(const LPCSTR* pTransitions, UINT NumTransitions) {
+	m_Script.Transitions.assign(pTransitions, pTransitions + NumTransitions);
+	m_Script.Position = 0;
+	m_Scripted = true;
+}
+
+VOID CDXAudioWriteCallback::SetAsyncTransitions(bool AsyncTransitions) {
+	m_AsyncTransitions = AsyncTransitions;
+}
+
+VOID CDXAudioWriteCallback::ClearQueue() {
+	PostCommand(AUDIO_GRAPH_COMMAND_CLEAR, nullptr, 0, 0.0f);
+}
+
+VOID CDXAudioWriteCallback::SkipAudioGraph() {
+	PostCommand(AUDIO_GRAPH_COMMAND_SKIP, nullptr, 0, 0.0f);
+}
+
+VOID CDXAudioWriteCallback::PostCommand(AUDIO_GRAPH_COMMAND_TYPE Type, CAudioGraph* pGraph, UINT Bus, FLOAT Gain) {
+	AUDIO_GRAPH_COMMAND Command;
+	Command.Type = Type;
+	Command.Graph = pGraph;
+	Command.Bus = Bus;
+	Command.Gain = Gain;
+
+	ReportRenderFailures();
+
+	EnterCriticalSection(&m_ProducerLock);
+
+	CollectRetired();
+
+	//A graph only has one playback position, so a voice can't be anywhere else at the same time
+	if (pGraph != nullptr && (pGraph->IsVoice() || (Type == AUDIO_GRAPH_COMMAND_PLAY && pGraph->IsQueued()))) {
+		LeaveCriticalSection(&m_ProducerLock);
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
+		return;
+	}
+
+	//The reference is handed over to the render thread along with the command.  Opening the
+	//graph's files happens here, since the render thread must never wait on I/O.
+	if (pGraph != nullptr) {
+		pGraph->AddRef();
+		pGraph->SetVoice(Type == AUDIO_GRAPH_COMMAND_PLAY);
+
+		if (pGraph->AddQueueReference()) {
+			pGraph->Setup(m_MediaType, m_Loader, m_Scripted ? &m_Script : nullptr, m_AsyncTransitions);
+		}
+	}
+
+	if (!m_Commands.Push(Command)) {
+		if (pGraph != nullptr) {
+			ReleaseGraph(pGraph);
+		}
+
+		LeaveCriticalSection(&m_ProducerLock);
+
+		//The render thread hasn't kept up with the application
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, HRESULT_FROM_WIN32(ERROR_BUFFER_OVERFLOW));
+		return;
+	}
+
+	LeaveCriticalSection(&m_ProducerLock);
+}
+
+VOID CDXAudioWriteCallback::ReportRenderFailures() {
+	RealtimeReportHeldFailure(m_Counters.Realtime, m_Callback);
+}
+
+VOID CDXAudioWriteCallback::CollectRetired() {
+	CAudioGraph* Graph = nullptr;
+
+	while (m_Retired.Pop(Graph)) {
+		ReleaseGraph(Graph);
+	}
+}
+
+VOID CDXAudioWriteCallback::ReleaseGraph(CAudioGraph* pGraph) {
+	//A graph can be queued more than once, and only the last one out closes its files
+	if (pGraph->ReleaseQueueReference()) {
+		pGraph->Flush();
+		pGraph->SetVoice(false);
+	}
+
+	pGraph->Release();
+}
+
+VOID CDXAudioWriteCallback::ExecuteCommands() {
+	AUDIO_GRAPH_COMMAND Command;
+	CAudioGraph* Graph = nullptr;
+
+	while (m_Commands.Pop(Command)) {
+		switch (Command.Type) {
+			case AUDIO_GRAPH_COMMAND_QUEUE: {
+				if (!m_PlaybackQueue.Push(Command.Graph)) {
+					RetireGraph(Command.Graph);
+					RealtimeReportFailure(m_Callback, FILENAME, __LINE__, HRESULT_FROM_WIN32(ERROR_BUFFER_OVERFLOW));
+				}
+			} break;
+
+			case AUDIO_GRAPH_COMMAND_CLEAR: {
+				while (m_PlaybackQueue.Pop(Graph)) {
+					RetireGraph(Graph);
+				}
+			} break;
+
+			case AUDIO_GRAPH_COMMAND_SKIP: {
+				if (m_PlaybackQueue.Pop(Graph)) {
+					RetireGraph(Graph);
+				}
+			} break;
+
+			case AUDIO_GRAPH_COMMAND_PLAY: {
+				AUDIO_GRAPH_BUS& Bus = m_Buses[Command.Bus];
+
+				//Over the cap, the new graph is dropped rather than cutting off one that's already playing
+				if (m_NumVoices >= m_MaxVoices) {
+					RetireGraph(Command.Graph);
+					InterlockedIncrement64(&Bus.DroppedVoices);
+					break;
+				}
+
+				//It was set up when it was sent
+				Command.Graph->Start(m_Counters);
+				Command.Graph->SetPlaying(true);
+
+				Bus.Voices[Bus.NumVoices++] = Command.Graph;
+				m_NumVoices++;
+
+				InterlockedExchange64(&Bus.CurrentVoices, Bus.NumVoices);
+
+				if (LONG64(Bus.NumVoices) > Bus.PeakVoices) {
+					InterlockedExchange64(&Bus.PeakVoices, Bus.NumVoices);
+				}
+			} break;
+
+			case AUDIO_GRAPH_COMMAND_STOP_BUS: {
+				StopVoices(m_Buses[Command.Bus]);
+			} break;
+
+			case AUDIO_GRAPH_COMMAND_BUS_GAIN: {
+				m_Buses[Command.Bus].TargetGain = Command.Gain;
+			} break;
+		}
+	}
+}
+
+VOID CDXAudioWriteCallback::StopVoices(AUDIO_GRAPH_BUS& Bus) {
+	while (Bus.NumVoices > 0) {
+		RetireGraph(Bus.Voices[--Bus.NumVoices]);
+		m_NumVoices--;
+	}
+
+	InterlockedExchange64(&Bus.CurrentVoices, 0);
+}
+
+VOID CDXAudioWriteCallback::MixBuses(FLOAT* OutputBuffer, UINT BufferFrames) {
+	const UINT BlockSize = AUDIO_GRAPH_MIX_FRAMES * m_Channels;
+
+	for (UINT Offset = 0; Offset < BufferFrames && m_NumVoices > 0; Offset += AUDIO_GRAPH_MIX_FRAMES) {
+		const UINT Frames = std::min(AUDIO_GRAPH_MIX_FRAMES, BufferFrames - Offset);
+		const bool Parallel = m_Scheduler.GetNumThreads() > 0 && m_NumVoices >= AUDIO_GRAPH_PARALLEL_VOICES;
+		UINT NumJobs = 0;
+
+		//Every voice becomes a job, and the buses are refilled with the voices still playing as they're mixed.
+		//Rendered inline, the voices take turns with the same buffer.
+		for (UINT i = 0; i < m_NumBuses; i++) {
+			AUDIO_GRAPH_BUS& Bus = m_Buses[i];
+
+			for (UINT j = 0; j < Bus.NumVoices; j++) {
+				AUDIO_GRAPH_VOICE_JOB& Job = m_Jobs[NumJobs];
+				Job.Voice = Bus.Voices[j];
+				Job.Bus = &Bus;
+				Job.Buffer = m_VoiceBuffer.data() + (Parallel ? NumJobs * BlockSize : 0);
+				Job.Frames = Frames;
+				Job.Written = 0;
+				NumJobs++;
+			}
+
+			Bus.NumVoices = 0;
+		}
+
+		//Returns once every voice has been rendered, so the mix below is the join
+		if (Parallel) {
+			m_Scheduler.Run (
+				StaticRenderVoice,
+				this,
+				NumJobs
+			);
+		}
+
+		//The voices are mixed in the same order whichever threads rendered them, so the output doesn't change with the timing
+		for (UINT k = 0; k < NumJobs; k++) {
+			AUDIO_GRAPH_VOICE_JOB& Job = m_Jobs[k];
+			AUDIO_GRAPH_BUS& Bus = *Job.Bus;
+
+			if (!Parallel) {
+				RenderVoice(Job);
+			}
+
+			MixRamp (
+				OutputBuffer + Offset * m_Channels,
+				Job.Buffer,
+				Job.Written,
+				m_Channels,
+				Bus.Gain,
+				(Bus.TargetGain - Bus.Gain) / FLOAT(Frames)
+			);
+
+			if (Job.Written < Frames) {
+				RetireGraph(Job.Voice);
+				m_NumVoices--;
+			} else {
+				Bus.Voices[Bus.NumVoices++] = Job.Voice;
+			}
+		}
+
+		//Each bus has ramped to its target by the end of the block
+		for (UINT i = 0; i < m_NumBuses; i++) {
+			m_Buses[i].Gain = m_Buses[i].TargetGain;
+		}
+	}
+
+	for (UINT i = 0; i < m_NumBuses; i++) {
+		AUDIO_GRAPH_BUS& Bus = m_Buses[i];
+
+		//A silent bus has nothing to ramp, so its gain can simply jump
+		if (Bus.NumVoices == 0) {
+			Bus.Gain = Bus.TargetGain;
+		}
+
+		//The workers have all finished with the bus by now
+		LONGLONG Time = InterlockedExchange64(&Bus.CallbackTime, 0);
+
+		InterlockedExchangeAdd64(&Bus.ProcessTime, Time);
+		InterlockedExchange64(&Bus.CurrentVoices, Bus.NumVoices);
+
+		if (Time > Bus.MaxProcessTime) {
+			InterlockedExchange64(&Bus.MaxProcessTime, Time);
+		}
+	}
+}
+
+VOID CDXAudioWriteCallback::RenderVoice(AUDIO_GRAPH_VOICE_JOB& Job) {
+	LARGE_INTEGER Start, End;
+
+	//Workers render under the same rules as the render thread, which renders jobs here too
+	AUDIO_GRAPH_REALTIME_COUNTERS* Previous = RealtimeEnter(&m_Counters.Realtime);
+
+	QueryPerformanceCounter(&Start);
+
+	Job.Written = Job.Voice->Process (
+		Job.Buffer,
+		Job.Frames,
+		m_Counters
+	);
+
+	QueryPerformanceCounter(&End);
+
+	InterlockedExchangeAdd64(&Job.Bus->CallbackTime, TicksToTime(End.QuadPart - Start.QuadPart));
+
+	RealtimeLeave(Previous);
+}
+
+VOID CDXAudioWriteCallback::StaticRenderVoice(LPVOID Context, UINT Job) {
+	CDXAudioWriteCallback* l_Callback = reinterpret_cast<CDXAudioWriteCallback*>(Context);
+
+	l_Callback->RenderVoice(l_Callback->m_Jobs[Job]);
+}
+
+VOID CDXAudioWriteCallback::RetireGraph(CAudioGraph* pGraph) {
+	pGraph->SetPlaying(false);
+
+	//Can't fail - the ring has room for every graph that can be on this side of it
+	m_Retired.Push(pGraph);
+}
+
+VOID CDXAudioWriteCallback::GetPlaybackStats(AUDIO_GRAPH_PLAYBACK_STATS* pStats) {
+	if (pStats == nullptr) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
+		return;
+	}
+
+	//Interlocked reads, so the 64-bit values are never torn
+	pStats->Callbacks = UINT64(InterlockedCompareExchange64(&m_Counters.Callbacks, 0, 0));
+	pStats->Xruns = UINT64(InterlockedCompareExchange64(&m_Counters.Xruns, 0, 0));
+	pStats->Transitions = UINT64(InterlockedCompareExchange64(&m_Counters.Transitions, 0, 0));
+	pStats->ColdTransitions = UINT64(InterlockedCompareExchange64(&m_Counters.ColdTransitions, 0, 0));
+	pStats->Prefetches = UINT64(InterlockedCompareExchange64(&m_Counters.Prefetches, 0, 0));
+	pStats->Crossfades = UINT64(InterlockedCompareExchange64(&m_Counters.Crossfades, 0, 0));
+	pStats->RealtimeAllocations = UINT64(InterlockedCompareExchange64(&m_Counters.Realtime.Allocations, 0, 0));
+	pStats->DecodeUnderruns = UINT64(InterlockedCompareExchange64(&m_Counters.DecodeUnderruns, 0, 0));
+	pStats->RealtimeBlockingCalls = UINT64(InterlockedCompareExchange64(&m_Counters.Realtime.BlockingCalls, 0, 0));
+	pStats->RenderFailures = UINT64(InterlockedCompareExchange64(&m_Counters.Realtime.Failures, 0, 0));
+
+	ReportRenderFailures();
+}
+
+VOID CDXAudioWriteCallback::GetBusStats(UINT Bus, AUDIO_GRAPH_BUS_STATS* pStats) {
+	if (pStats == nullptr) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_POINTER);
+		return;
+	}
+
+	if (Bus >= m_NumBuses) {
+		m_Callback->OnObjectFailure(FILENAME, __LINE__, E_INVALIDARG);
+		return;
+	}
+
+	AUDIO_GRAPH_BUS& Counters = m_Buses[Bus];
+	LONGLONG MixedTime = InterlockedCompareExchange64(&m_MixedFrames, 0, 0) * 10000000 / m_SampleRate;
+
+	pStats->Voices = UINT(InterlockedCompareExchange64(&Counters.CurrentVoices, 0, 0));
+	pStats->PeakVoices = UINT(InterlockedCompareExchange64(&Counters.PeakVoices, 0, 0));
+	pStats->DroppedVoices = UINT64(InterlockedCompareExchange64(&Counters.DroppedVoices, 0, 0));
+	pStats->ProcessTime = InterlockedCompareExchange64(&Counters.ProcessTime, 0, 0);
+	pStats->MaxProcessTime = InterlockedCompareExchange64(&Counters.MaxProcessTime, 0, 0);
+	pStats->CpuUsage = MixedTime != 0 ? DOUBLE(pStats->ProcessTime) / DOUBLE(MixedTime) : 0.0;
 }
 
 VOID CDXAudioWriteCallback::OnObjectFailure(LPCWSTR File, UINT Line, HRESULT hr) {
 	m_Callback->OnObjectFailure(File, Line, hr);
 }
 
-#include <iostream>
-
 VOID CDXAudioWriteCallback::OnProcess(FLOAT SampleRate, FLOAT* OutputBuffer, UINT BufferFrames) {
 	HRESULT hr = S_OK;
 	UINT Written = 0;
 	UINT Frames = BufferFrames;
+	FLOAT* MixBuffer = OutputBuffer;
+	LARGE_INTEGER Start, End;
+
+	CAudioGraph* Graph = nullptr;
 
-	while (BufferFrames > 0 && !m_PlaybackQueue.empty()) {
-		CComPtr<CAudioGraph> Graph = m_PlaybackQueue.front();
+	QueryPerformanceCounter(&Start);
 
-		// If graph isn't currently active, activate it
+	RealtimeEnter(&m_Counters.Realtime);
+
+	ExecuteCommands();
+
+	while (BufferFrames > 0 && m_PlaybackQueue.Peek(Graph)) {
+		// If graph isn't currently active, activate it.  It was set up when it was queued.
 		if (!Graph->IsPlaying()) {
-			Graph->Setup(m_MediaType);
+			Graph->Start(m_Counters);
 			Graph->SetPlaying(true);
 		}
 
-		Written = Graph->Process(OutputBuffer, BufferFrames);
+		Written = Graph->Process(OutputBuffer, BufferFrames, m_Counters);
 
 		BufferFrames -= Written;
-		OutputBuffer += Written * 2;
+		OutputBuffer += Written * m_Channels;
 
-		// If graph is done playing, flush its buffers and remove it from the queue.
+		// If graph is done playing, remove it from the queue.  Its buffers are flushed by the application thread.
 		if (BufferFrames > 0) {
-			Graph->Flush();
-			m_PlaybackQueue.pop();
-			std::cout << "POP";
+			m_PlaybackQueue.Pop(Graph);
+			RetireGraph(Graph);
 		}
 	}
 
 	if (BufferFrames > 0) {
-		ZeroMemory(OutputBuffer, BufferFrames * sizeof(FLOAT) * 2);
+		ZeroMemory(OutputBuffer, BufferFrames * sizeof(FLOAT) * m_Channels);
+	}
+
+	// The buses play on top of the playback queue
+	MixBuses(MixBuffer, Frames);
+
+	InterlockedExchangeAdd64(&m_MixedFrames, Frames);
+
+	// An offline render of the playback queue ends with the callback that drained it, once the buses are quiet too
+	if (m_OfflineStream != nullptr && m_FinishWhenIdle && m_PlaybackQueue.IsEmpty() && m_NumVoices == 0) {
+		RealtimeSignalCall();
+		m_OfflineStream->Finish();
 	}
+
+	RealtimeLeave(nullptr);
+
+	QueryPerformanceCounter(&End);
+
+	//A callback that takes longer than the audio it produced will eventually starve the device
+	if (DOUBLE(End.QuadPart - Start.QuadPart) * SampleRate > DOUBLE(Frames) * DOUBLE(m_Frequency.QuadPart)) {
+		InterlockedIncrement64(&m_Counters.Xruns);
+	}
+
+	InterlockedIncrement64(&m_Counters.Callbacks);
 }
 
 VOID CDXAudioWriteCallback::OnThreadInit() {
 	HRESULT hr = S_OK;
 
+	RealtimeInstallHooks();
+
 	hr = MFStartup (
 		MF_VERSION
 	); CHECK_HR(__LINE__);
@@ -104,24 +610,15 @@ VOID CDXAudioWriteCallback::OnThreadInit() {
 		MFAudioFormat_Float
 	); CHECK_HR(__LINE__);
 
+	// The source readers up- or down-mix every file to the stream's channels
 	hr = m_MediaType->SetUINT32 (
 		MF_MT_AUDIO_NUM_CHANNELS,
-		2
-	); CHECK_HR(__LINE__);
-
-	hr = m_MediaType->SetUINT32 (
-		MF_MT_AUDIO_SAMPLES_PER_SECOND,
-		44100
+		m_Channels
 	); CHECK_HR(__LINE__);
 
 	hr = m_MediaType->SetUINT32 (
 		MF_MT_AUDIO_BLOCK_ALIGNMENT,
-		sizeof(FLOAT) * 2
-	); CHECK_HR(__LINE__);
-
-	hr = m_MediaType->SetUINT32 (
-		MF_MT_AUDIO_AVG_BYTES_PER_SECOND,
-		sizeof(FLOAT) * 2 * 44100
+		sizeof(FLOAT) * m_Channels
 	); CHECK_HR(__LINE__);
 
 	hr = m_MediaType->SetUINT32 (
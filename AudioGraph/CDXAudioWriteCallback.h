@@ -25,14 +25,70 @@
 #include <comdef.h>
 #include <atlbase.h>
 #include <Windows.h>
-#include <queue>
 #include <map>
+#include <vector>
 
 #include "DXAudio.h"
 #include "AudioGraph.h"
 #include "CAudioGraph.h"
+#include "CAudioGraphLoader.h"
+#include "CAudioGraphRing.h"
+#include "CAudioGraphScheduler.h"
 #include "QueryInterface.h"
 
+/* Commands sent from the application to the render thread. */
+enum AUDIO_GRAPH_COMMAND_TYPE {
+	AUDIO_GRAPH_COMMAND_QUEUE, //Append a graph to the playback queue
+	AUDIO_GRAPH_COMMAND_CLEAR, //Stop the current graph and empty the playback queue
+	AUDIO_GRAPH_COMMAND_SKIP, //Stop the current graph and move on to the next one
+	AUDIO_GRAPH_COMMAND_PLAY, //Start a graph playing on a mixer bus
+	AUDIO_GRAPH_COMMAND_STOP_BUS, //Stop every graph playing on a mixer bus
+	AUDIO_GRAPH_COMMAND_BUS_GAIN //Set the gain of a mixer bus
+};
+
+struct AUDIO_GRAPH_COMMAND {
+	AUDIO_GRAPH_COMMAND_TYPE Type;
+	CAudioGraph* Graph; //Holds a reference for AUDIO_GRAPH_COMMAND_QUEUE and AUDIO_GRAPH_COMMAND_PLAY, otherwise nullptr
+	UINT Bus; //Mixer commands only
+	FLOAT Gain; //AUDIO_GRAPH_COMMAND_BUS_GAIN only
+};
+
+static const UINT AUDIO_GRAPH_COMMAND_CAPACITY = 64; //Commands that can be in flight at once
+static const UINT AUDIO_GRAPH_PLAYBACK_CAPACITY = 64; //Graphs that can wait in the playback queue
+static const UINT AUDIO_GRAPH_MAX_BUSES = 32; //Mixer buses a factory can have
+static const UINT AUDIO_GRAPH_MAX_VOICES = 256; //Graphs that can play on the mixer buses at once
+static const UINT AUDIO_GRAPH_MAX_RENDER_THREADS = 32; //Worker threads that can render voices alongside the audio thread
+static const UINT AUDIO_GRAPH_PARALLEL_VOICES = 8; //Below this many voices, waking the workers costs more than it saves
+static const UINT AUDIO_GRAPH_MIX_FRAMES = 256; //Frames the mixer renders at a time, which is also how long a change of bus gain is ramped over
+static const UINT AUDIO_GRAPH_RETIRED_CAPACITY = 512; //Graphs that can be handed back to the application at once
+
+static_assert(AUDIO_GRAPH_RETIRED_CAPACITY >= AUDIO_GRAPH_COMMAND_CAPACITY + AUDIO_GRAPH_PLAYBACK_CAPACITY + AUDIO_GRAPH_MAX_VOICES,
+	"Every graph on the render thread's side must fit in the retired ring");
+
+/* A mixer bus.  The voices and gains belong to the render thread.  The counters are only written by the
+** render thread, but may be read from any thread. */
+struct AUDIO_GRAPH_BUS {
+	CAudioGraph* Voices[AUDIO_GRAPH_MAX_VOICES]; //The graphs playing on the bus, in no particular order
+	UINT NumVoices;
+	FLOAT Gain; //The gain the bus was last mixed at
+	FLOAT TargetGain; //The gain last set by the application, which Gain is ramped to
+	volatile LONG64 CurrentVoices; //NumVoices, for other threads
+	volatile LONG64 PeakVoices;
+	volatile LONG64 DroppedVoices; //Graphs dropped because the voice cap had been reached
+	volatile LONG64 ProcessTime; //In 100-nanosecond units
+	volatile LONG64 MaxProcessTime; //In 100-nanosecond units
+	volatile LONG64 CallbackTime; //Time spent rendering the bus so far in this callback, added to by every thread that renders its voices
+};
+
+/* A voice rendered for one block of the mixer, on whichever thread claims it. */
+struct AUDIO_GRAPH_VOICE_JOB {
+	CAudioGraph* Voice;
+	AUDIO_GRAPH_BUS* Bus; //The bus the voice plays on
+	FLOAT* Buffer; //Where the voice is rendered to, in m_VoiceBuffer
+	UINT Frames; //Frames to render
+	UINT Written; //Frames the voice rendered - fewer than Frames once it has finished
+};
+
 class CDXAudioWriteCallback : public IDXAudioWriteCallback {
 public:
 	CDXAudioWriteCallback();
@@ -66,16 +122,119 @@ public:
 
 	//New methods
 
-	HRESULT Initialize(IAudioGraphCallback* pAudioGraphCallback);
+	/* [Channels] is the number of interleaved channels the stream renders, which graphs are decoded to. */
+	HRESULT Initialize(IAudioGraphCallback* pAudioGraphCallback, CAudioGraphLoader* pLoader, UINT Channels);
+
+	/* Completes the media type graphs are decoded to with the stream's sample rate.  Must be called
+	** once the stream has been created, and before it is started. */
+	HRESULT SetSampleRate(UINT SampleRate);
 
 	VOID QueueAudioGraph(IAudioGraph* pAudioGraph);
 
+	VOID ClearQueue();
+
+	VOID SkipAudioGraph();
+
+	/* Makes the callback render for an offline stream.  If [FinishWhenIdle] is true, the stream is
+	** finished as soon as the playback queue is empty. */
+	VOID SetOfflineStream(IDXAudioOfflineStream* pStream, bool FinishWhenIdle);
+
+	/* Replaces IAudioGraphCallback::OnTransition() with a fixed sequence of transition strings.
+	** Must be called before the stream is started. */
+	VOID SetTransitionScript(const LPCSTR* pTransitions, UINT NumTransitions);
+
+	/* Stops graphs from asking IAudioGraphCallback for transitions, so the render thread never
+	** calls into the application.  Must be called before the stream is started. */
+	VOID SetAsyncTransitions(bool AsyncTransitions);
+
+	/* Copies the playback counters into [pStats].  May be called from any thread. */
+	VOID GetPlaybackStats(AUDIO_GRAPH_PLAYBACK_STATS* pStats);
+
+	/* Passes a failure the render thread held back to the application's callback.  Application thread only. */
+	VOID ReportRenderFailures();
+
+	/* Creates [Buses] mixer buses, which together play at most [MaxVoices] graphs at once, or
+	** AUDIO_GRAPH_MAX_VOICES if it's 0.  [RenderThreads] worker threads render voices alongside the
+	** render thread, but only with asynchronous, unscripted transitions - otherwise voices would ask
+	** for transitions from several threads at once.  Must be called before the stream is started,
+	** and after SetTransitionScript() and SetAsyncTransitions(). */
+	HRESULT SetMixer(UINT Buses, UINT MaxVoices, UINT RenderThreads);
+
+	VOID PlayAudioGraph(UINT Bus, IAudioGraph* pAudioGraph);
+
+	VOID StopBus(UINT Bus);
+
+	VOID SetBusGain(UINT Bus, FLOAT Gain);
+
+	/* Copies the counters of a mixer bus into [pStats].  May be called from any thread. */
+	VOID GetBusStats(UINT Bus, AUDIO_GRAPH_BUS_STATS* pStats);
+
 private:
 	long m_RefCount;
 
 	CComPtr<IAudioGraphCallback> m_Callback;
-	std::queue<CComPtr<CAudioGraph>> m_PlaybackQueue;
+	CComPtr<CAudioGraphLoader> m_Loader;
+
+	/* Graph references only ever change hands through these rings, so the render thread never
+	** locks, allocates, or releases the last reference to a graph.  Graphs are set up before
+	** they're sent to the render thread, and once it is done with them they're handed back
+	** through m_Retired to be flushed and released on the application thread. */
+	CAudioGraphRing<AUDIO_GRAPH_COMMAND, AUDIO_GRAPH_COMMAND_CAPACITY> m_Commands; //Application -> render thread
+	CAudioGraphRing<CAudioGraph*, AUDIO_GRAPH_RETIRED_CAPACITY> m_Retired; //Render -> application thread
+	CAudioGraphRing<CAudioGraph*, AUDIO_GRAPH_PLAYBACK_CAPACITY> m_PlaybackQueue; //Owned by the render thread
+	CRITICAL_SECTION m_ProducerLock; //Serializes application threads, which share the producer side of m_Commands
 	CComPtr<IMFMediaType> m_MediaType;
+	UINT m_Channels; //Interleaved channels in the output buffer
+	IDXAudioOfflineStream* m_OfflineStream; //Not held, since the stream holds this callback
+	bool m_FinishWhenIdle; //Whether the offline stream finishes once the playback queue is empty
+	AUDIO_GRAPH_TRANSITION_SCRIPT m_Script; //Scripted transitions, if any
+	bool m_Scripted; //Whether m_Script is used
+	bool m_AsyncTransitions; //Whether graphs only take posted triggers and default edges
+	AUDIO_GRAPH_PLAYBACK_COUNTERS m_Counters; //Written on the render thread, read by GetPlaybackStats()
+	LARGE_INTEGER m_Frequency; //Performance counter frequency, for timing callbacks
+	UINT m_SampleRate; //Sample rate of the stream
+
+	AUDIO_GRAPH_BUS* m_Buses; //One allocation for every mixer bus, or nullptr if there are none
+	UINT m_NumBuses;
+	UINT m_NumVoices; //Graphs playing on all of the buses together - render thread only
+	UINT m_MaxVoices; //The cap on m_NumVoices
+	std::vector<FLOAT> m_VoiceBuffer; //AUDIO_GRAPH_MIX_FRAMES frames for each voice rendered at once, before they're mixed into the output
+	volatile LONG64 m_MixedFrames; //Frames played since the stream started, which the buses' CPU usage is measured against
+
+	CAudioGraphScheduler m_Scheduler; //The worker threads that render voices, if there are any
+	AUDIO_GRAPH_VOICE_JOB m_Jobs[AUDIO_GRAPH_MAX_VOICES]; //The voices of the block being mixed - render thread only
+
+	/* Sends a command to the render thread.  [Bus] and [Gain] are only used by mixer commands.  Application thread only. */
+	VOID PostCommand(AUDIO_GRAPH_COMMAND_TYPE Type, CAudioGraph* pGraph, UINT Bus, FLOAT Gain);
+
+	/* Releases graphs that the render thread has finished with.  Application thread only. */
+	VOID CollectRetired();
+
+	/* Releases a graph that was queued, flushing it if it isn't queued anymore.  Application thread only. */
+	VOID ReleaseGraph(CAudioGraph* pGraph);
+
+	/* Applies commands sent by the application.  Render thread only. */
+	VOID ExecuteCommands();
+
+	/* Stops a graph and hands it back to the application to be flushed.  Render thread only. */
+	VOID RetireGraph(CAudioGraph* pGraph);
+
+	/* Stops every graph playing on a bus.  Render thread only. */
+	VOID StopVoices(AUDIO_GRAPH_BUS& Bus);
+
+	/* Renders every bus, at its gain, on top of what's already in [OutputBuffer].  Render thread only. */
+	VOID MixBuses(FLOAT* OutputBuffer, UINT BufferFrames);
+
+	/* Renders one voice of the block being mixed.  Called on the render thread or a worker thread. */
+	VOID RenderVoice(AUDIO_GRAPH_VOICE_JOB& Job);
+
+	/* The scheduler's entry point for RenderVoice() */
+	static VOID StaticRenderVoice(LPVOID Context, UINT Job);
+
+	/* Converts performance counter ticks to 100-nanosecond units. */
+	LONGLONG TicksToTime(LONGLONG Ticks) {
+		return Ticks * 10000000 / m_Frequency.QuadPart;
+	}
 
 	//IUnknown methods
 
@@ -29,7 +29,11 @@
 
 ClientReader::ClientReader(CDXAudioStream& Stream) :
 m_Stream(Stream),
+m_Channels(2),
 m_ResampleState(nullptr),
+m_ResampleIn(0),
+m_ResampleOut(0),
+m_ReadKernel(nullptr),
 m_WaveFormat(nullptr)
 { }
 
@@ -47,25 +51,15 @@ ClientReader::~ClientReader() {
 	}
 }
 
-HRESULT ClientReader::Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback) {
+HRESULT ClientReader::Initialize(bool IsLoopback, FLOAT& SampleRate, UINT Channels, DXAUDIO_RESAMPLER_QUALITY Quality, HANDLE WaitEvent, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback) {
 	HRESULT hr = S_OK;
 	BYTE* Buffer = nullptr;
 	int error = 0;
 
 	m_Callback = Callback;
-
-	//Create the SRC_STATE object
-	m_ResampleState = src_new (
-		SRC_SINC_FASTEST, //More than adequate for a real time stream
-		2,				  //Two channels (stereo)
-		&error
-	); if (error != 0) {
-		m_Callback->OnObjectFailure (
-			FILENAME,
-			__LINE__,
-			E_FAIL
-		); return E_FAIL;
-	}
+	m_Channels = Channels;
+	m_ResampleIn = 0;
+	m_ResampleOut = 0;
 
 	//"Activate" the device (create the IAudioClient interface)
 	hr = InputDevice->Activate (
@@ -112,14 +106,43 @@ HRESULT ClientReader::Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitE
 		); RETURN_HR(__LINE__);
 	}
 
+	//The endpoint driving the wait event is the one that sets the stream's pace
+	if (WaitEvent != NULL) {
+		m_Stream.GetCounters().SetDevicePeriod(m_Period);
+	}
+
+	//Pick the conversion kernel once, rather than branching on the format for every frame
+	m_ReadKernel = SelectReadKernel(m_WaveFormat, m_Channels);
+
 	//Calculate the number of frames the endpoint is going to give us each period.
-	m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+	m_PeriodFrames = (UINT32)((m_Period * m_WaveFormat->Format.nSamplesPerSec + 9999999) / 10000000);
+
+	//A sample rate of 0 asks for the endpoint's own rate, so that nothing needs to be resampled
+	if (SampleRate == 0.0f) {
+		SampleRate = FLOAT(m_WaveFormat->Format.nSamplesPerSec);
+	}
 
 	//Calculate the resample ratio - this is the ratio of the output sample rate to the input sample rate, IE
 	//the sample rate specified by the application developer divided by the sample rate used by the endpoint.
 	//This value is used by libsamplerate.
 	m_ResampleRatio = DOUBLE(SampleRate) / DOUBLE(m_WaveFormat->Format.nSamplesPerSec); //Output sample rate / input sample rate
 
+	//Create the SRC_STATE object, unless the endpoint already runs at the application's sample rate.
+	//libsamplerate still filters (and delays) the signal at a ratio of 1.0, so it's skipped entirely.
+	if (m_ResampleRatio != 1.0) {
+		m_ResampleState = src_new (
+			CDXAudioResampler::GetConverterType(Quality),
+			m_Channels, //Resampling happens in the application's channel layout
+			&error
+		); if (error != 0) {
+			m_Callback->OnObjectFailure (
+				FILENAME,
+				__LINE__,
+				E_FAIL
+			); return E_FAIL;
+		}
+	}
+
 	return S_OK;
 }
 
@@ -129,8 +152,13 @@ VOID ClientReader::Clean() {
 	m_Client.Release();
 	CoTaskMemFree(m_WaveFormat);
 	m_WaveFormat = nullptr;
-	src_delete(m_ResampleState);
-	m_ResampleState = nullptr;
+	if (m_ResampleState != nullptr) {
+		src_delete(m_ResampleState);
+		m_ResampleState = nullptr;
+	}
+	m_ResampleIn = 0;
+	m_ResampleOut = 0;
+	m_ReadKernel = nullptr;
 	m_ResampleRatio = 0.0;
 	m_PeriodFrames = 0;
 	m_Period = 0;
@@ -150,14 +178,13 @@ VOID ClientReader::Stop() {
 
 VOID ClientReader::Read(FLOAT* Buffer, UINT BufferLength, UINT& FramesRead) {
 	HRESULT hr = S_OK;
-	const UINT32 ExcessChannels = m_WaveFormat->Format.nChannels - 2;
 	BYTE* ByteBuffer = nullptr;
 	UINT32 FramesToRead = 0;
+	UINT32 FramesToConvert = 0;
 	DWORD Flags = NULL;
 
 	//_alloca is safe here, as this is not recursive and only takes up a few KB at most
-	FLOAT* LocalBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * m_PeriodFrames));
-	FLOAT* LocalBufferIndex = LocalBuffer;
+	FLOAT* LocalBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * m_PeriodFrames));
 	SRC_DATA Data;
 	int error = 0;
 
@@ -179,61 +206,67 @@ VOID ClientReader::Read(FLOAT* Buffer, UINT BufferLength, UINT& FramesRead) {
 		HALT_HR(__LINE__);
 	} else return;
 
-	//Convert the byte buffer into a stereo floating-point format and store
-	//in LocalBuffer
-	if (m_WaveFormat->SubFormat == KSDATAFORMAT_SUBTYPE_PCM) { //PCM data
-		if (m_WaveFormat->Samples.wValidBitsPerSample == 16) { //16-bit signed int
-			for (UINT i = 0; i < FramesToRead; i++) {
-				for (UINT j = 0; j < 2; j++) { //Two channels
-					*LocalBufferIndex++ = FLOAT(*((INT16*)(ByteBuffer))) / 32767; //Convert to normalized float [-1.0, 1.0]
-					ByteBuffer += sizeof(INT16); //Move the byte pointer to the next channel or sample
-				}
-
-				//Ignore excess channels by skipping over those bytes
-				ByteBuffer += sizeof(INT16) * ExcessChannels;
-			}
-		} else if (m_WaveFormat->Format.wBitsPerSample == 24) { //24-bit unsigned (never signed)
-			for (UINT i = 0; i < FramesToRead; i++) {
-				for (UINT j = 0; j < 2; j++) {
-					*LocalBufferIndex++ = (FLOAT(*((UINT32*)(ByteBuffer))) / 8388607) - 1.0f;
-					ByteBuffer += 3;
-				}
-
-				ByteBuffer += 3 * ExcessChannels;
-			}
-		} else { //32-bit signed
-			for (UINT i = 0; i < FramesToRead; i++) {
-				for (UINT j = 0; j < 2; j++) {
-					*LocalBufferIndex++ = FLOAT(*((INT32*)(ByteBuffer))) / 2147483647;
-					ByteBuffer += sizeof(INT32);
-				}
-
-				ByteBuffer += sizeof(INT32) * ExcessChannels;
-			}
-		}
-	} else { //32-bit floating-point
-		for (UINT i = 0; i < FramesToRead; i++) {
-			for (UINT j = 0; j < 2; j++) {
-				*LocalBufferIndex++ = *((FLOAT*)(ByteBuffer));
-				ByteBuffer += sizeof(FLOAT);
-			}
-
-			ByteBuffer += sizeof(FLOAT) * ExcessChannels;
+	//The endpoint flags a packet like this when the previous one wasn't read in time
+	if (Flags & AUDCLNT_BUFFERFLAGS_DATA_DISCONTINUITY) {
+		m_Stream.GetCounters().AddOverrun();
+	}
+
+	//Without resampling, the data can be converted straight into the output buffer
+	if (m_ResampleState == nullptr) {
+		FramesRead = FramesToRead < BufferLength ? FramesToRead : BufferLength;
+
+		if (FramesRead < FramesToRead) {
+			m_Stream.GetCounters().AddDroppedFrames(FramesToRead - FramesRead);
 		}
+
+		m_ReadKernel (
+			ByteBuffer,
+			Buffer,
+			FramesRead,
+			m_WaveFormat->Format.nChannels,
+			m_Channels
+		);
+
+		hr = m_CaptureClient->ReleaseBuffer (
+			FramesToRead
+		); HALT_HR(__LINE__);
+
+		UpdateInputBufferFill();
+
+		return;
 	}
 
+	//LocalBuffer only has room for a period, which is what the endpoint normally delivers
+	FramesToConvert = FramesToRead < m_PeriodFrames ? FramesToRead : m_PeriodFrames;
+
+	if (FramesToConvert < FramesToRead) {
+		m_Stream.GetCounters().AddDroppedFrames(FramesToRead - FramesToConvert);
+	}
+
+	//Convert the byte buffer into the application's channels in floating-point
+	//format and store in LocalBuffer, ignoring any excess channels
+	m_ReadKernel (
+		ByteBuffer,
+		LocalBuffer,
+		FramesToConvert,
+		m_WaveFormat->Format.nChannels,
+		m_Channels
+	);
+
 	//We're done using the input data
 	hr = m_CaptureClient->ReleaseBuffer (
 		FramesToRead
 	); HALT_HR(__LINE__);
 
+	UpdateInputBufferFill();
+
 	ByteBuffer = nullptr;
 
 	//Fill the SRC_DATA structure
-	Data.data_in = LocalBuffer;	//Use the converted stereo samples
+	Data.data_in = LocalBuffer;	//Use the converted samples
 	Data.data_out = Buffer;	//Store the result in the output buffer
 	Data.end_of_input = 0; //Since this is realtime, there is never an end of input
-	Data.input_frames = FramesToRead; //This is equal to m_PeriodFrames
+	Data.input_frames = FramesToConvert; //This is normally equal to m_PeriodFrames
 	Data.input_frames_used = 0;	//Zero out this value (it's an out value generated by src_process)
 	Data.output_frames = BufferLength; //Notify src_process of the length of the output buffer (always enough to store everything)
 	Data.output_frames_gen = 0;	//Zero out this value (it's an out value generated by src_process)
@@ -253,6 +286,33 @@ VOID ClientReader::Read(FLOAT* Buffer, UINT BufferLength, UINT& FramesRead) {
 
 	//Let the application developer know how many samples are available
 	FramesRead = Data.output_frames_gen;
+
+	m_ResampleIn += Data.input_frames_used;
+	m_ResampleOut += Data.output_frames_gen;
+	UpdateResamplerDelay();
+
+	//Anything the resampler didn't take is gone along with LocalBuffer
+	if (Data.input_frames_used < FramesToConvert) {
+		m_Stream.GetCounters().AddDroppedFrames(FramesToConvert - Data.input_frames_used);
+	}
+}
+
+VOID ClientReader::UpdateInputBufferFill() {
+	UINT32 Padding = 0;
+
+	//For a capture client, the padding is the number of frames waiting to be read
+	if (SUCCEEDED(m_Client->GetCurrentPadding(&Padding))) {
+		m_Stream.GetCounters().SetInputBufferFill(Padding);
+	}
+}
+
+VOID ClientReader::UpdateResamplerDelay() {
+	//Frames go in at the endpoint's rate and come out at the application's
+	DOUBLE Frames = DOUBLE(m_ResampleIn) - DOUBLE(m_ResampleOut) / m_ResampleRatio;
+
+	m_Stream.GetCounters().SetInputResamplerDelay (
+		LONGLONG(Frames * 10000000.0 / DOUBLE(m_WaveFormat->Format.nSamplesPerSec))
+	);
 }
 
 HRESULT ClientReader::VerifyClient() {
@@ -28,7 +28,9 @@
 #include <Audioclient.h>
 #include "DXAudio.h"
 #include "samplerate.h"
+#include "CDXAudioResampler.h"
 #include "CDXAudioStream.h"
+#include "SampleKernels.h"
 
 /* ClientReader is used to read stream data from an endpoint.  This can be used
 ** for both an input device or an output device for a loopback stream. */
@@ -39,11 +41,12 @@ public:
 	~ClientReader();
 
 	/* This initializes the reader by creating the necessary interfaces and data.  [IsLoopback] is
-	** used to indicate whether or not this is a loopback stream.  [SampleRate] is the desired sample
-	** rate to be used by the stream callback.  The endpoint data will automatically be resampled
-	** to this format.  [WaitEvent] is the event handle for the event callback mechanism - if NULL,
-	** there will be no event callback on this end. */
-	HRESULT Initialize(bool IsLoopback, FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback);
+	** used to indicate whether or not this is a loopback stream.  [SampleRate] and [Channels] are the desired
+	** sample rate and channel count to be used by the stream callback.  The endpoint data will automatically be
+	** mapped to these channels, and resampled to this rate with the given [Quality], unless the rates already
+	** match.  If [SampleRate] is 0, it is set to the endpoint's sample rate.  [WaitEvent] is the event handle
+	** for the event callback mechanism - if NULL, there will be no event callback on this end. */
+	HRESULT Initialize(bool IsLoopback, FLOAT& SampleRate, UINT Channels, DXAUDIO_RESAMPLER_QUALITY Quality, HANDLE WaitEvent, CComPtr<IMMDevice> InputDevice, CComPtr<IDXAudioCallback> Callback);
 
 	/* This releases all interfaces and dynamically allocated data and sets the object to a pre-initialized state. */
 	VOID Clean();
@@ -83,9 +86,19 @@ private:
 	CComPtr<IAudioClient> m_Client; //Audio client interface (WASAPI)
 	CComPtr<IAudioCaptureClient> m_CaptureClient; //Capture client interface (WASAPI)
 	WAVEFORMATEXTENSIBLE* m_WaveFormat; //The wave format of the endpoint
+	UINT m_Channels; //The number of channels used by the stream callback
 	DOUBLE m_ResampleRatio; //The resample ratio for the stream
-	SRC_STATE* m_ResampleState; //The resample state (libsamplerate object)
+	SRC_STATE* m_ResampleState; //The resample state (libsamplerate object), or nullptr if no resampling is needed
+	UINT64 m_ResampleIn; //Frames consumed by the resampler since it was created
+	UINT64 m_ResampleOut; //Frames produced by the resampler since it was created
+	SAMPLE_READ_KERNEL m_ReadKernel; //Converts the endpoint format to the application's channels in float
 	UINT32 m_PeriodFrames; //Number of frames in a period
 	REFERENCE_TIME m_Period; //Periodicity of the endpoint
 	CDXAudioStream& m_Stream; //Stream reference
+
+	/* Publishes how much audio the resampler is holding on to, which is what it has consumed but not yet produced. */
+	VOID UpdateResamplerDelay();
+
+	/* Publishes how many frames are left waiting in the capture buffer. */
+	VOID UpdateInputBufferFill();
 };
\ No newline at end of file
@@ -22,14 +22,26 @@
 
 #include "ClientWriter.h"
 #include <math.h>
+#include <algorithm>
 
 #define FILENAME L"ClientWriter.cpp"
 #define RETURN_HR(Line) if (FAILED(hr)) { if (hr != AUDCLNT_E_DEVICE_INVALIDATED) { m_Callback->OnObjectFailure(FILENAME, Line, hr); return E_FAIL; } else return hr; }
 #define HALT_HR(Line) if (FAILED(hr)) { if (hr != AUDCLNT_E_DEVICE_INVALIDATED) { m_Callback->OnObjectFailure(FILENAME, Line, hr); m_Stream.Halt(); return; } else return; }
+#define HALT_HR_NULL(Line) if (FAILED(hr)) { if (hr != AUDCLNT_E_DEVICE_INVALIDATED) { m_Callback->OnObjectFailure(FILENAME, Line, hr); m_Stream.Halt(); } return nullptr; }
 
 ClientWriter::ClientWriter(CDXAudioStream& Stream) :
 m_Stream(Stream),
+m_Channels(2),
 m_ResampleState(nullptr),
+m_ResampleBacklog(0.0),
+m_Adaptive(false),
+m_RatioCorrection(1.0),
+m_WriteKernel(nullptr),
+m_Direct(false),
+m_Padding(0),
+m_ResampleRatio(0.0),
+m_PeriodFrames(0),
+m_Period(0),
 m_WaveFormat(nullptr)
 { }
 
@@ -47,25 +59,16 @@ ClientWriter::~ClientWriter() {
 	}
 }
 
-HRESULT ClientWriter::Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback) {
+HRESULT ClientWriter::Initialize(FLOAT& SampleRate, UINT Channels, DXAUDIO_RESAMPLER_QUALITY Quality, HANDLE WaitEvent, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback) {
 	HRESULT hr = S_OK;
 	BYTE* Buffer = nullptr;
+	UINT32 BufferFrames = 0;
 	int error = 0;
 
 	m_Callback = Callback;
-
-	//Create the SRC_STATE object
-	m_ResampleState = src_new (
-		SRC_SINC_FASTEST, //More than adequate for a real time stream
-		2,				  //Two channels (stereo)
-		&error
-	); if (error != 0) {
-		m_Callback->OnObjectFailure (
-			FILENAME,
-			__LINE__,
-			E_FAIL
-		); return E_FAIL;
-	}
+	m_Channels = Channels;
+	m_ResampleBacklog = 0.0;
+	m_RatioCorrection = 1.0;
 
 	//"Activate" the device (create the IAudioClient interface)
 	hr = OutputDevice->Activate (
@@ -110,8 +113,28 @@ HRESULT ClientWriter::Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMM
 		); RETURN_HR(__LINE__);
 	}
 
+	//The buffer ends up four periods long, as requested above, but the endpoint may round it
+	hr = m_Client->GetBufferSize (
+		&BufferFrames
+	); RETURN_HR(__LINE__);
+
+	m_Stream.GetCounters().SetOutputBufferFrames(BufferFrames);
+
+	//The endpoint driving the wait event is the one that sets the stream's pace
+	if (WaitEvent != NULL) {
+		m_Stream.GetCounters().SetDevicePeriod(m_Period);
+	}
+
+	//Pick the conversion kernel once, rather than branching on the format for every frame
+	m_WriteKernel = SelectWriteKernel(m_WaveFormat, m_Channels);
+
 	//Calculate the number of frames the endpoint is going to need from us each period.
-	m_PeriodFrames = (UINT32)(ceil(DOUBLE(m_Period * m_WaveFormat->Format.nSamplesPerSec) / 10000000));
+	m_PeriodFrames = (UINT32)((m_Period * m_WaveFormat->Format.nSamplesPerSec + 9999999) / 10000000);
+
+	//A sample rate of 0 asks for the endpoint's own rate, so that nothing needs to be resampled
+	if (SampleRate == 0.0f) {
+		SampleRate = FLOAT(m_WaveFormat->Format.nSamplesPerSec);
+	}
 
 	//We need to initialize the client with a little bit of slience.  The endpoint requires one period
 	//worth of silence before Start() is called to even work.  We should give it two just in case the stream
@@ -128,11 +151,33 @@ HRESULT ClientWriter::Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMM
 		AUDCLNT_BUFFERFLAGS_SILENT
 	); RETURN_HR(__LINE__);
 
+	m_Stream.GetCounters().SetOutputBufferFill(m_PeriodFrames * 2);
+
 	//Calculate the resample ratio - this is the ratio of the output sample rate to the input sample rate, IE
 	//the sample rate specified used by the endpoint divided by that which is specified by the application developer.
 	//This value is used by libsamplerate.
 	m_ResampleRatio = DOUBLE(m_WaveFormat->Format.nSamplesPerSec) / DOUBLE(SampleRate);
 
+	//Create the SRC_STATE object, unless the endpoint already runs at the application's sample rate.
+	//libsamplerate still filters (and delays) the signal at a ratio of 1.0, so it's skipped entirely,
+	//unless the ratio is going to be corrected later on.
+	if (m_ResampleRatio != 1.0 || m_Adaptive) {
+		m_ResampleState = src_new (
+			CDXAudioResampler::GetConverterType(Quality),
+			m_Channels, //Resampling happens in the application's channel layout
+			&error
+		); if (error != 0) {
+			m_Callback->OnObjectFailure (
+				FILENAME,
+				__LINE__,
+				E_FAIL
+			); return E_FAIL;
+		}
+	}
+
+	//With nothing to resample or convert, the application might as well write into the endpoint's buffer itself
+	m_Direct = m_ResampleState == nullptr && IsApplicationFormat(m_WaveFormat, m_Channels);
+
 	return S_OK;
 }
 
@@ -142,8 +187,15 @@ VOID ClientWriter::Clean() {
 	m_Client.Release();
 	CoTaskMemFree(m_WaveFormat);
 	m_WaveFormat = nullptr;
-	src_delete(m_ResampleState);
-	m_ResampleState = nullptr;
+	if (m_ResampleState != nullptr) {
+		src_delete(m_ResampleState);
+		m_ResampleState = nullptr;
+	}
+	m_ResampleBacklog = 0.0;
+	m_RatioCorrection = 1.0;
+	m_WriteKernel = nullptr;
+	m_Direct = false;
+	m_Padding = 0;
 	m_ResampleRatio = 0.0;
 	m_PeriodFrames = 0;
 	m_Period = 0;
@@ -163,47 +215,71 @@ VOID ClientWriter::Stop() {
 
 VOID ClientWriter::Write(FLOAT* Buffer, UINT BufferLength) {
 	HRESULT hr = S_OK;
-	UINT32 ExcessChannels = m_WaveFormat->Format.nChannels - 2;
 	BYTE* ByteBuffer = nullptr;
 
 	//_alloca is safe here, as this is not recursive and only takes up a few KB at most
 	//The size of the local buffer needs to be larger than just its period frames in the
 	//case that the periodicity of the input device on a duplex stream is greater than
 	//the periodicity of the output device.  Multiplying its period frames by 1.5
-	//provides for adequate uncertainty.
-	const UINT LocalBufferSize = (UINT)(m_PeriodFrames * 1.5);
-	FLOAT* LocalBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * 2 * LocalBufferSize));
-	FLOAT* LocalBufferIndex = LocalBuffer;
+	//provides for adequate uncertainty, but a duplex stream topping up an empty buffer
+	//can hand over more than that, so it's also sized to whatever the input resamples to.
+	const DOUBLE Ratio = GetCorrectedRatio();
+	const UINT LocalBufferSize = (UINT)(std::max(m_PeriodFrames * 1.5, ceil(BufferLength * Ratio) + 1.0));
+	FLOAT* LocalBuffer = (FLOAT*)(_alloca(sizeof(FLOAT) * m_Channels * LocalBufferSize));
+	FLOAT* EndpointBuffer = Buffer; //The frames to give the endpoint
+	UINT EndpointFrames = BufferLength; //The number of frames to give the endpoint
+	UINT32 Padding = 0; //The number of frames the endpoint has yet to play
 	SRC_DATA Data;
 	int error = 0;
 
-	LocalBufferIndex = LocalBuffer;
-
-	//Start by resampling the data given to us by the application developer.
-	Data.data_in = Buffer; //Use the data given to us
-	Data.data_out = LocalBuffer; //Store the resampled frames in the local buffer
-	Data.end_of_input = 0; //Since this is realtime, there is never an end of input
-	Data.input_frames = BufferLength; //This is equal to m_PeriodFrames / m_ResampleRatio
-	Data.input_frames_used = 0;	//Zero out this value (it's an out value generated by src_process)
-	Data.output_frames = LocalBufferSize; //This is the number of frames to give the endpoint
-	Data.output_frames_gen = 0; //Zero out this value (it's an out value generated by src_process)
-	Data.src_ratio = m_ResampleRatio; //Use the current resample ratio
-
-	//Resample the data to the sample rate used by the endpoint
-	error = src_process (
-		m_ResampleState,
-		&Data
-	); if (error != 0) {
-		m_Callback->OnObjectFailure (
-			FILENAME,
-			__LINE__,
-			E_FAIL
-		); m_Stream.Halt(); return;
+	//Start by resampling the data given to us by the application developer, unless
+	//the endpoint already runs at the application's sample rate.
+	if (m_ResampleState != nullptr) {
+		Data.data_in = Buffer; //Use the data given to us
+		Data.data_out = LocalBuffer; //Store the resampled frames in the local buffer
+		Data.end_of_input = 0; //Since this is realtime, there is never an end of input
+		Data.input_frames = BufferLength; //This is equal to m_PeriodFrames / m_ResampleRatio
+		Data.input_frames_used = 0;	//Zero out this value (it's an out value generated by src_process)
+		Data.output_frames = LocalBufferSize; //This is the number of frames to give the endpoint
+		Data.output_frames_gen = 0; //Zero out this value (it's an out value generated by src_process)
+		Data.src_ratio = Ratio; //Use the current resample ratio, including any correction
+
+		//Resample the data to the sample rate used by the endpoint
+		error = src_process (
+			m_ResampleState,
+			&Data
+		); if (error != 0) {
+			m_Callback->OnObjectFailure (
+				FILENAME,
+				__LINE__,
+				E_FAIL
+			); m_Stream.Halt(); return;
+		}
+
+		EndpointBuffer = LocalBuffer;
+		EndpointFrames = Data.output_frames_gen;
+
+		m_ResampleBacklog += DOUBLE(Data.input_frames_used) * Ratio - DOUBLE(Data.output_frames_gen);
+		UpdateResamplerDelay();
+
+		//Anything the resampler didn't take won't be offered to it again
+		if (Data.input_frames_used < BufferLength) {
+			m_Stream.GetCounters().AddDroppedFrames(BufferLength - Data.input_frames_used);
+		}
+	}
+
+	//An empty endpoint buffer means the endpoint ran dry before this period arrived
+	hr = m_Client->GetCurrentPadding (
+		&Padding
+	); HALT_HR(__LINE__);
+
+	if (Padding == 0) {
+		m_Stream.GetCounters().AddUnderrun();
 	}
 
 	//Lock the buffer resource
 	hr = m_RenderClient->GetBuffer (
-		Data.output_frames_gen,
+		EndpointFrames,
 		&ByteBuffer
 	);
 
@@ -215,64 +291,95 @@ VOID ClientWriter::Write(FLOAT* Buffer, UINT BufferLength) {
 	//the stream data into a brick wall).  In this case, just skip this frame.
 	if (hr != AUDCLNT_E_BUFFER_TOO_LARGE) {
 		HALT_HR(__LINE__);
-	} else return;
+	} else {
+		m_Stream.GetCounters().AddDroppedFrames(EndpointFrames);
+		return;
+	}
 
 	//Convert the local buffer into the endpoint format and store it
-	//in the buffer resource
-	if (m_WaveFormat->SubFormat == KSDATAFORMAT_SUBTYPE_PCM) { //PCM data
-		if (m_WaveFormat->Samples.wValidBitsPerSample == 16) { //16-bit signed int
-			for (long i = 0; i < Data.output_frames_gen; i++) {
-				for (UINT j = 0; j < 2; j++) { //Two channels
-					*(INT16*)(ByteBuffer) = (INT16)(*LocalBufferIndex * 32767); //Convert from normalized float [-1.0, 1.0]
-					ByteBuffer += sizeof(INT16); //Move the byte pointer to the next channel or sample
-					LocalBufferIndex++; //Move the local buffer pointer to the next channel or sample
-				}
-
-				//Ignore excess channels by zeroing out those bytes
-				ZeroMemory(ByteBuffer, ExcessChannels * sizeof(INT16));
-				ByteBuffer += sizeof(INT16) * ExcessChannels;
-			}
-		} else if (m_WaveFormat->Format.wBitsPerSample == 24) { //24-bit unsigned (never signed)
-			for (long i = 0; i < Data.output_frames_gen; i++) {
-				for (UINT j = 0; j < 2; j++) {
-					*(UINT32*)(ByteBuffer) = (UINT32)((*LocalBufferIndex + 1.0f) * 8388607);
-					ByteBuffer += 3;
-					LocalBufferIndex++;
-				}
-
-				ZeroMemory(ByteBuffer, ExcessChannels * 3);
-				ByteBuffer += 3 * ExcessChannels;
-			}
-		} else { //32-bit signed
-			for (long i = 0; i < Data.output_frames_gen; i++) {
-				for (UINT j = 0; j < 2; j++) {
-					*(INT32*)(ByteBuffer) = (INT32)(*LocalBufferIndex * 2147483647);
-					ByteBuffer += sizeof(INT32);
-					LocalBufferIndex++;
-				}
-
-				ZeroMemory(ByteBuffer, ExcessChannels * sizeof(INT32));
-				ByteBuffer += sizeof(INT32) * ExcessChannels;
-			}
-		}
-	} else { //32-bit floating-point
-		for (long i = 0; i < Data.output_frames_gen; i++) {
-			for (UINT j = 0; j < 2; j++) {
-				*(FLOAT*)(ByteBuffer) = *LocalBufferIndex;
-				ByteBuffer += sizeof(FLOAT);
-				LocalBufferIndex++;
-			}
-
-			ZeroMemory(ByteBuffer, ExcessChannels * sizeof(FLOAT));
-			ByteBuffer += sizeof(FLOAT) * ExcessChannels;
-		}
-	}
+	//in the buffer resource, zeroing any excess channels
+	m_WriteKernel (
+		EndpointBuffer,
+		ByteBuffer,
+		EndpointFrames,
+		m_WaveFormat->Format.nChannels,
+		m_Channels
+	);
 
 	//We're done using the data
 	hr = m_RenderClient->ReleaseBuffer (
-		Data.output_frames_gen,
+		EndpointFrames,
 		NULL
 	); HALT_HR(__LINE__);
+
+	m_Stream.GetCounters().SetOutputBufferFill(Padding + EndpointFrames);
+}
+
+FLOAT* ClientWriter::BeginWrite(UINT Frames) {
+	HRESULT hr = S_OK;
+	BYTE* ByteBuffer = nullptr;
+
+	if (Frames == 0) {
+		return nullptr;
+	}
+
+	//An empty endpoint buffer means the endpoint ran dry before this period arrived
+	hr = m_Client->GetCurrentPadding (
+		&m_Padding
+	); HALT_HR_NULL(__LINE__);
+
+	if (m_Padding == 0) {
+		m_Stream.GetCounters().AddUnderrun();
+	}
+
+	hr = m_RenderClient->GetBuffer (
+		Frames,
+		&ByteBuffer
+	);
+
+	//As in Write(), the endpoint may be switching properties without having told us yet
+	if (hr == AUDCLNT_E_BUFFER_TOO_LARGE) {
+		m_Stream.GetCounters().AddDroppedFrames(Frames);
+		return nullptr;
+	} else HALT_HR_NULL(__LINE__);
+
+	return reinterpret_cast<FLOAT*>(ByteBuffer);
+}
+
+VOID ClientWriter::EndWrite(UINT Frames) {
+	HRESULT hr = S_OK;
+
+	hr = m_RenderClient->ReleaseBuffer (
+		Frames,
+		NULL
+	); HALT_HR(__LINE__);
+
+	m_Stream.GetCounters().SetOutputBufferFill(m_Padding + Frames);
+}
+
+VOID ClientWriter::UpdateResamplerDelay() {
+	//The backlog is kept in endpoint frames, since the ratio that converts to them can change from write to write
+	m_Stream.GetCounters().SetOutputResamplerDelay (
+		LONGLONG(m_ResampleBacklog * 10000000.0 / DOUBLE(m_WaveFormat->Format.nSamplesPerSec))
+	);
+}
+
+HRESULT ClientWriter::GetFramesWritable(UINT32& Frames) {
+	HRESULT hr = S_OK;
+	UINT32 Padding = 0;
+
+	Frames = 0;
+
+	hr = m_Client->GetCurrentPadding (
+		&Padding
+	); RETURN_HR(__LINE__);
+
+	//The endpoint is primed with two periods in Initialize(), so that's the level it's kept at
+	if (Padding < m_PeriodFrames * 2) {
+		Frames = m_PeriodFrames * 2 - Padding;
+	}
+
+	return S_OK;
 }
 
 HRESULT ClientWriter::VerifyClient() {
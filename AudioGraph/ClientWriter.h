@@ -28,7 +28,9 @@
 #include <Audioclient.h>
 #include "DXAudio.h"
 #include "samplerate.h"
+#include "CDXAudioResampler.h"
 #include "CDXAudioStream.h"
+#include "SampleKernels.h"
 
 /* ClientWriter is used to write stream data to an endpoint.  This can only be
 ** used with output endpoints. */
@@ -38,11 +40,12 @@ public:
 
 	~ClientWriter();
 
-	/* This initializes the writer by creating the necessary interfaces and data. [SampleRate] is the desired
-	** sample rate to be used by the stream callback.  The endpoint data will automatically be resampled
-	** from this format.  [WaitEvent] is the event handle for the event callback mechanism - if NULL,
-	** there will be no event callback on this end. */
-	HRESULT Initialize(FLOAT SampleRate, HANDLE WaitEvent, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback);
+	/* This initializes the writer by creating the necessary interfaces and data. [SampleRate] and [Channels]
+	** are the desired sample rate and channel count to be used by the stream callback.  The endpoint data will
+	** automatically be mapped from these channels, and resampled from this rate with the given [Quality], unless
+	** the rates already match.  If [SampleRate] is 0, it is set to the endpoint's sample rate.  [WaitEvent] is
+	** the event handle for the event callback mechanism - if NULL, there will be no event callback on this end. */
+	HRESULT Initialize(FLOAT& SampleRate, UINT Channels, DXAUDIO_RESAMPLER_QUALITY Quality, HANDLE WaitEvent, CComPtr<IMMDevice> OutputDevice, CComPtr<IDXAudioCallback> Callback);
 
 	/* This releases all interfaces and dynamically allocated data and sets the object to a pre-initialized state. */
 	VOID Clean();
@@ -57,6 +60,24 @@ public:
 	** which is the number of frames to be provided. */
 	VOID Write(FLOAT* Buffer, UINT BufferLength);
 
+	/* Returns true if the endpoint takes the application's frames as they are - it runs at the application's sample
+	** rate and channel count, in floating-point, and nothing needs resampling.  Decided in Initialize(). */
+	bool IsDirect() {
+		return m_Direct;
+	}
+
+	/* Locks [Frames] frames of the endpoint's buffer, for the application to write into directly instead of calling
+	** Write().  Direct writers only.  Returns nullptr if the endpoint can't take the frames right now, in which case
+	** EndWrite() must not be called. */
+	FLOAT* BeginWrite(UINT Frames);
+
+	/* Hands the [Frames] frames locked by BeginWrite() over to the endpoint. */
+	VOID EndWrite(UINT Frames);
+
+	/* Stores in [Frames] the number of endpoint frames needed to bring the endpoint's buffer back up to the two periods
+	** it's primed with.  Used by duplex streams, which top the buffer up rather than writing whatever they're given. */
+	HRESULT GetFramesWritable(UINT32& Frames);
+
 	/* This determines if the client is still in a valid, usable state. */
 	HRESULT VerifyClient();
 
@@ -75,14 +96,41 @@ public:
 		return m_ResampleRatio;
 	}
 
+	/* If [Adaptive] is set before Initialize(), the resampler is created even when the rates match, so that the
+	** ratio can be trimmed with SetRatioCorrection().  Used by duplex streams to follow the input device's clock. */
+	VOID SetAdaptive(bool Adaptive) {
+		m_Adaptive = Adaptive;
+	}
+
+	/* Scales the resample ratio by [Correction] from the next Write() on.  libsamplerate glides to the new ratio
+	** over the course of the write, so this can be changed every period without clicks.  Adaptive writers only. */
+	VOID SetRatioCorrection(DOUBLE Correction) {
+		m_RatioCorrection = Correction;
+	}
+
+	/* Returns the resample ratio with the correction applied. */
+	DOUBLE GetCorrectedRatio() {
+		return m_ResampleRatio * m_RatioCorrection;
+	}
+
 private:
 	CComPtr<IDXAudioCallback> m_Callback; //Used for error reporting
 	CComPtr<IAudioClient> m_Client; //Audio client interface (WASAPI)
 	CComPtr<IAudioRenderClient> m_RenderClient; //Render client interface (WASAPI)
 	WAVEFORMATEXTENSIBLE* m_WaveFormat; //The wave format of the endpoint
+	UINT m_Channels; //The number of channels used by the stream callback
 	DOUBLE m_ResampleRatio; //The resample ratio for the stream
-	SRC_STATE* m_ResampleState; //The resample state (libsamplerate object)
+	SRC_STATE* m_ResampleState; //The resample state (libsamplerate object), or nullptr if no resampling is needed
+	DOUBLE m_ResampleBacklog; //Endpoint frames' worth of input the resampler has consumed but not yet produced
+	bool m_Adaptive; //Whether the resampler is always created, so the ratio can be corrected
+	DOUBLE m_RatioCorrection; //Scales the resample ratio (1.0 unless adaptive)
+	SAMPLE_WRITE_KERNEL m_WriteKernel; //Converts the application's channels in float to the endpoint format
+	bool m_Direct; //Whether the application can write straight into the endpoint's buffer
+	UINT32 m_Padding; //The endpoint's padding when BeginWrite() was called
 	UINT32 m_PeriodFrames; //Number of frames in a period
 	REFERENCE_TIME m_Period; //Periodicity of the endpoint
 	CDXAudioStream& m_Stream; //Stream reference
+
+	/* Publishes how much audio the resampler is holding on to, which is what it has consumed but not yet produced. */
+	VOID UpdateResamplerDelay();
 };
\ No newline at end of file
@@ -26,6 +26,7 @@
 #include "CDXAudioLoopbackStream.h"
 #include "CDXAudioDuplexStream.h"
 #include "CDXAudioEchoStream.h"
+#include "CDXAudioOfflineStream.h"
 
 #include <atlbase.h>
 
@@ -33,7 +34,7 @@
 
 /* Creates an output stream. */
 static HRESULT DXAudioCreateOutputStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC_EX* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -41,7 +42,7 @@ static HRESULT DXAudioCreateOutputStream (
 
 	CComPtr<CDXAudioOutputStream> OutputStream = new CDXAudioOutputStream();
 
-	hr = OutputStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = OutputStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -55,7 +56,7 @@ static HRESULT DXAudioCreateOutputStream (
 
 /* Creates an input stream. */
 static HRESULT DXAudioCreateInputStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC_EX* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -63,7 +64,7 @@ static HRESULT DXAudioCreateInputStream (
 
 	CComPtr<CDXAudioInputStream> InputStream = new CDXAudioInputStream();
 
-	hr = InputStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = InputStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -77,7 +78,7 @@ static HRESULT DXAudioCreateInputStream (
 
 /* Creates a loopback stream. */
 static HRESULT DXAudioCreateLoopbackStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC_EX* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -85,7 +86,7 @@ static HRESULT DXAudioCreateLoopbackStream (
 
 	CComPtr<CDXAudioLoopbackStream> LoopbackStream = new CDXAudioLoopbackStream();
 
-	hr = LoopbackStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = LoopbackStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -99,7 +100,7 @@ static HRESULT DXAudioCreateLoopbackStream (
 
 /* Creates a duplex stream. */
 static HRESULT DXAudioCreateDuplexStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC_EX* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -107,7 +108,7 @@ static HRESULT DXAudioCreateDuplexStream (
 
 	CComPtr<CDXAudioDuplexStream> DuplexStream = new CDXAudioDuplexStream();
 
-	hr = DuplexStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = DuplexStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -121,7 +122,7 @@ static HRESULT DXAudioCreateDuplexStream (
 
 /* Creates an echo stream. */
 static HRESULT DXAudioCreateEchoStream (
-	FLOAT SampleRate,
+	const DXAUDIO_STREAM_DESC_EX* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 ) {
@@ -129,7 +130,7 @@ static HRESULT DXAudioCreateEchoStream (
 
 	CComPtr<CDXAudioEchoStream> EchoStream = new CDXAudioEchoStream();
 
-	hr = EchoStream->Initialize(SampleRate, pDXAudioCallback);
+	hr = EchoStream->Initialize(pDesc, pDXAudioCallback);
 
 	if (FAILED(hr)) {
 		*ppDXAudioStream = nullptr;
@@ -141,11 +142,56 @@ static HRESULT DXAudioCreateEchoStream (
 	return S_OK;
 }
 
-/* Entry point into the dll - creates a stream as specified by the application. */
+/* Creates an offline stream. */
+static HRESULT DXAudioCreateOfflineStream (
+	const DXAUDIO_STREAM_DESC_EX* pDesc,
+	IDXAudioCallback* pDXAudioCallback,
+	IDXAudioStream** ppDXAudioStream
+) {
+	HRESULT hr = S_OK;
+
+	CComPtr<CDXAudioOfflineStream> OfflineStream = new CDXAudioOfflineStream();
+
+	hr = OfflineStream->Initialize(pDesc, pDXAudioCallback);
+
+	if (FAILED(hr)) {
+		*ppDXAudioStream = nullptr;
+		return hr;
+	}
+
+	*ppDXAudioStream = OfflineStream;
+
+	return S_OK;
+}
+
+/* Entry point into the dll - creates a stream with the basic properties, and defaults for the rest. */
 HRESULT DXAudioCreateStream (
 	const DXAUDIO_STREAM_DESC* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
+) {
+	DXAUDIO_STREAM_DESC_EX DescEx;
+
+	if (pDesc == nullptr) {
+		return E_POINTER;
+	}
+
+	ZeroMemory(&DescEx, sizeof(DescEx));
+	DescEx.SampleRate = pDesc->SampleRate;
+	DescEx.Type = pDesc->Type;
+
+	return DXAudioCreateStreamEx (
+		&DescEx,
+		pDXAudioCallback,
+		ppDXAudioStream
+	);
+}
+
+/* Entry point into the dll - creates a stream as specified by the application. */
+HRESULT DXAudioCreateStreamEx (
+	const DXAUDIO_STREAM_DESC_EX* pDesc,
+	IDXAudioCallback* pDXAudioCallback,
+	IDXAudioStream** ppDXAudioStream
 ) {
 	if (pDesc == nullptr || pDXAudioCallback == nullptr ||
 		ppDXAudioStream == nullptr) {
@@ -155,7 +201,7 @@ HRESULT DXAudioCreateStream (
 	switch (pDesc->Type) {
 		case DXAUDIO_STREAM_TYPE_OUTPUT: {
 			return DXAudioCreateOutputStream (
-				pDesc->SampleRate,
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
@@ -163,7 +209,7 @@ HRESULT DXAudioCreateStream (
 
 		case DXAUDIO_STREAM_TYPE_INPUT: {
 			return DXAudioCreateInputStream (
-				pDesc->SampleRate,
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
@@ -171,7 +217,7 @@ HRESULT DXAudioCreateStream (
 
 		case DXAUDIO_STREAM_TYPE_LOOPBACK: {
 			return DXAudioCreateLoopbackStream (
-				pDesc->SampleRate,
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
@@ -179,7 +225,7 @@ HRESULT DXAudioCreateStream (
 
 		case DXAUDIO_STREAM_TYPE_DUPLEX: {
 			return DXAudioCreateDuplexStream (
-				pDesc->SampleRate,
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
@@ -187,7 +233,15 @@ HRESULT DXAudioCreateStream (
 
 		case DXAUDIO_STREAM_TYPE_ECHO: {
 			return DXAudioCreateEchoStream (
-				pDesc->SampleRate,
+				pDesc,
+				pDXAudioCallback,
+				ppDXAudioStream
+			);
+		} break;
+
+		case DXAUDIO_STREAM_TYPE_OFFLINE: {
+			return DXAudioCreateOfflineStream (
+				pDesc,
 				pDXAudioCallback,
 				ppDXAudioStream
 			);
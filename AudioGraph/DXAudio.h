@@ -30,27 +30,123 @@ enum DXAUDIO_STREAM_TYPE {
 	DXAUDIO_STREAM_TYPE_INPUT,      //An input stream from the default audio input endpoint
 	DXAUDIO_STREAM_TYPE_LOOPBACK,   //An input stream from the default audio output endpoint (reads what's currently playing)
 	DXAUDIO_STREAM_TYPE_DUPLEX,		//A duplex stream between the default audio input and output endpoints
-	DXAUDIO_STREAM_TYPE_ECHO		//A duplex stream between the default audio output endpoint and itself (IE, a loopback stream with output functionality)
+	DXAUDIO_STREAM_TYPE_ECHO,		//A duplex stream between the default audio output endpoint and itself (IE, a loopback stream with output functionality)
+	DXAUDIO_STREAM_TYPE_OFFLINE		//An output stream with no endpoint, which renders to a file or to memory as fast as possible
 };
 
+/* DXAUDIO_RESAMPLER_QUALITY is used to choose how audio is resampled between the application's sample rate and the endpoint's.
+** Higher qualities cost more CPU and add more latency.  When the two rates are equal, no resampling is done at all. */
+enum DXAUDIO_RESAMPLER_QUALITY {
+	DXAUDIO_RESAMPLER_QUALITY_DEFAULT = 0,		//The same as DXAUDIO_RESAMPLER_QUALITY_SINC_FASTEST
+	DXAUDIO_RESAMPLER_QUALITY_ZERO_ORDER_HOLD,	//Repeats samples - the cheapest option with no added latency, but audibly aliased (suitable for voice)
+	DXAUDIO_RESAMPLER_QUALITY_LINEAR,			//Interpolates between samples - cheap with no added latency, but still aliased
+	DXAUDIO_RESAMPLER_QUALITY_SINC_FASTEST,		//Band-limited sinc interpolation - more than adequate for a real time stream
+	DXAUDIO_RESAMPLER_QUALITY_SINC_MEDIUM,		//Band-limited sinc interpolation with a wider passband
+	DXAUDIO_RESAMPLER_QUALITY_SINC_BEST			//The best quality available, meant for offline rendering
+};
+
+/* DXAUDIO_BACKEND is used to choose what is behind a stream's endpoints. */
+enum DXAUDIO_BACKEND {
+	DXAUDIO_BACKEND_WASAPI = 0,	//The default endpoints of the Windows audio service
+	DXAUDIO_BACKEND_NULL		//Simulated endpoints with no device behind them, described by a DXAUDIO_NULL_DEVICE_DESC
+};
+
+/* DXAUDIO_NULL_DEVICE_FORMAT is the sample format of the simulated endpoints. */
+enum DXAUDIO_NULL_DEVICE_FORMAT {
+	DXAUDIO_NULL_DEVICE_FORMAT_FLOAT = 0,	//32-bit floating-point, like the mix format of the Windows audio service
+	DXAUDIO_NULL_DEVICE_FORMAT_INT16,		//16-bit integer
+	DXAUDIO_NULL_DEVICE_FORMAT_INT24,		//24-bit integer, packed into 3 bytes
+	DXAUDIO_NULL_DEVICE_FORMAT_INT32		//32-bit integer
+};
+
+/* DXAUDIO_NULL_DEVICE_DESC describes the endpoints of a stream created with DXAUDIO_BACKEND_NULL.  The endpoints run on a
+** simulated clock rather than the wall clock: the stream is woken again as soon as it has processed a period, and the clock
+** moves on by one period of the endpoint that wakes it.  Buffer fills, underruns and overruns follow from that clock alone,
+** so a stream behaves the same way on every run and on any machine, while processing as fast as it can.  The input and
+** loopback endpoints capture silence, and whatever is written to the output endpoint is thrown away. */
+struct DXAUDIO_NULL_DEVICE_DESC {
+	UINT SampleRate; //Mix rate of the endpoints, or 0 for 48000
+	UINT Channels; //Number of channels of the endpoints, up to DXAUDIO_MAX_CHANNELS, or 0 for stereo
+	DXAUDIO_NULL_DEVICE_FORMAT Format; //Sample format of the endpoints (see enum above)
+	LONGLONG Period; //Device period in 100-nanosecond units, or 0 for 10 milliseconds
+	INT InputDrift; //How much faster the input endpoint's clock runs than the simulated clock, in parts per million - negative if it's slower
+	INT OutputDrift; //How much faster the output endpoint's clock runs, in parts per million - also used by loopback and echo streams
+	UINT GlitchInterval; //Every GlitchInterval-th wakeup of the stream is late, or 0 for none
+	LONGLONG GlitchDelay; //How late a glitched wakeup is, in 100-nanosecond units
+};
+
+/* The most interleaved channels a stream or a simulated endpoint can have. */
+static const UINT DXAUDIO_MAX_CHANNELS = 32;
+
 /* DXAUDIO_STREAM_DESC is used for creating an audio stream to determine its properties */
 struct DXAUDIO_STREAM_DESC {
 	FLOAT SampleRate; //Sample rate of the stream
 	DXAUDIO_STREAM_TYPE Type; //Type of the stream to be created (see enum above)
 };
 
+/* DXAUDIO_STREAM_DESC_EX is used by DXAudioCreateStreamEx() to create a stream with more than the basic properties.
+** It must be zero-initialized (DXAUDIO_STREAM_DESC_EX Desc = { };) before any of it is filled in, since 0 always
+** means the default, and fields added later will rely on that too. */
+struct DXAUDIO_STREAM_DESC_EX {
+	FLOAT SampleRate; //Sample rate of the stream, or 0 to use the endpoint's own rate so nothing is resampled (44100 for offline streams)
+	DXAUDIO_STREAM_TYPE Type; //Type of the stream to be created (see enum above)
+	UINT Channels; //Number of interleaved channels in the callback's buffers, up to DXAUDIO_MAX_CHANNELS, or 0 for stereo
+	DXAUDIO_RESAMPLER_QUALITY Quality; //How the stream resamples to and from the endpoint (see enum above)
+	LPCWSTR Filename; //Offline streams only - the WAV file to render to, or NULL to render to memory
+	UINT64 Frames; //Offline streams only - the number of frames to render, or 0 to render until Finish() is called
+	BOOL Shared; //If TRUE, the stream is serviced by a thread shared with other shared streams instead of one of its own (ignored by offline streams)
+	UINT Latency; //Duplex streams only - milliseconds of captured audio to hold back for the output, on top of the endpoint buffers, or 0 for one input period
+	DXAUDIO_BACKEND Backend; //What is behind the stream's endpoints (see enum above, ignored by offline streams)
+	const DXAUDIO_NULL_DEVICE_DESC* NullDevice; //DXAUDIO_BACKEND_NULL only - the simulated endpoints, or NULL for the defaults
+};
+
+/* DXAUDIO_OUTPUT_PATH is how the frames produced by a stream callback reach the output endpoint. */
+enum DXAUDIO_OUTPUT_PATH {
+	DXAUDIO_OUTPUT_PATH_NONE = 0,	//The stream has no output endpoint
+	DXAUDIO_OUTPUT_PATH_CONVERTED,	//The callback writes into a buffer of the stream's, which is then resampled and/or converted into the endpoint's buffer
+	DXAUDIO_OUTPUT_PATH_DIRECT		//The callback writes straight into the endpoint's buffer - the endpoint runs at the stream's sample rate and channel count, in floating-point
+};
+
+/* The number of buckets in DXAUDIO_STREAM_STATS::ProcessHistogram. */
+static const UINT DXAUDIO_STREAM_STATS_BUCKETS = 16;
+
+/* DXAUDIO_STREAM_STATS reports the latency and timing of a stream.  It is filled by IDXAudioStream2::GetStats().  Times are
+** in 100-nanosecond units, and buffer sizes are in frames at the endpoint's sample rate.  Offline streams have no endpoint,
+** so only the processing figures are filled in for them. */
+struct DXAUDIO_STREAM_STATS {
+	LONGLONG DevicePeriod; //Period of the endpoint that wakes the stream
+	UINT OutputBufferFrames; //Size of the output endpoint's buffer
+	UINT OutputBufferFill; //Frames queued for playback after the last period - the latency added by the output buffer
+	UINT InputBufferFill; //Frames left waiting in the capture buffer after the last period
+	LONGLONG ResamplerDelay; //Audio held inside the resamplers, input and output combined
+	UINT64 Periods; //Number of periods processed
+	UINT64 ProcessHistogram[DXAUDIO_STREAM_STATS_BUCKETS]; //Time taken to process a period, callback included - bucket i counts periods of [2^i, 2^(i+1)) microseconds, and the last bucket anything longer
+	LONGLONG MaxProcessTime; //The longest time taken to process a period
+	LONGLONG MeanJitter; //The average difference between the time from one wakeup to the next and the device period
+	LONGLONG MaxJitter; //The largest difference between the time from one wakeup to the next and the device period
+	UINT64 Underruns; //Periods that found the output endpoint had run out of frames to play
+	UINT64 Overruns; //Capture packets that the endpoint flagged as discontinuous, because they weren't read in time
+	UINT64 DroppedFrames; //Frames thrown away because there was no room for them
+	LONGLONG TargetLatency; //Duplex streams only - how much captured audio is meant to be held back for the output
+	LONGLONG LatencyError; //Duplex streams only - how far the averaged amount held back is from the target, positive if there's too much
+	LONGLONG MaxLatencyError; //Duplex streams only - the furthest the amount held back has been from the target after a period
+	LONGLONG DriftCorrection; //Duplex streams only - how far the output's resample ratio has been trimmed to follow the input's clock, in parts per million - negative if the input runs fast
+	DXAUDIO_OUTPUT_PATH OutputPath; //How the callback's output reaches the endpoint, as decided when the endpoint was last initialized (see enum above)
+};
+
 /* IDXAudioStream is the interface for all DXAudio streams. */
 struct __declspec(uuid("58127943-2ecc-4e74-845b-e4933263a880")) IDXAudioStream : public IUnknown {
 	/* Start() causes the stream to become active.  When this happens, your stream callback will
-	** be called repeatedly on a separate thread that is unique to the stream.  Note that the
-	** stream is initialized in a stopped state, so this must be called for the stream to
-	** begin playing. */
+	** be called repeatedly on a separate thread that is unique to the stream, or shared with other
+	** shared streams.  Note that the stream is initialized in a stopped state, so this must be
+	** called for the stream to begin playing. */
 	virtual VOID STDMETHODCALLTYPE Start() PURE;
 
 	/* Stop() pauses the stream until Start() is called a second time. */
 	virtual VOID STDMETHODCALLTYPE Stop() PURE;
 
-	/* GetSampleRate() returns the sample rate of the stream.  Note that this value remains
+	/* GetSampleRate() returns the sample rate of the stream, which is the endpoint's own rate if the stream
+	** was created with a sample rate of 0.  Note that this value remains
 	** constant throughout the lifetime of the stream.  If you want to change the sample
 	** rate, you will need to re-create the stream object. */
 	virtual FLOAT STDMETHODCALLTYPE GetSampleRate() PURE;
@@ -61,6 +157,39 @@ struct __declspec(uuid("58127943-2ecc-4e74-845b-e4933263a880")) IDXAudioStream :
 	virtual DXAUDIO_STREAM_TYPE STDMETHODCALLTYPE GetStreamType() PURE;
 };
 
+/* IDXAudioStream2 extends IDXAudioStream with the stream's statistics.  Every stream implements it, and it's
+** retrieved from the stream with QueryInterface(). */
+struct __declspec(uuid("2ca87794-f3c1-479c-955d-5d90d51168c2")) IDXAudioStream2 : public IDXAudioStream {
+	/* GetStats() copies the stream's latency and timing figures into [pStats].  They're collected without locking,
+	** so this can be called from any thread, as often as you like, without disturbing the stream. */
+	virtual VOID STDMETHODCALLTYPE GetStats(DXAUDIO_STREAM_STATS* pStats) PURE;
+};
+
+/* IDXAudioOfflineStream is the interface for offline streams, which can be retrieved from the stream with QueryInterface().
+** An offline stream has no endpoint - once started, its write callback is called back to back from a tight loop, and the
+** output is written to a 32-bit floating-point WAV file or kept in memory.  This makes it possible to render faster
+** than real time, and on machines without an audio device. */
+struct __declspec(uuid("3c0f2a8e-7d51-4b6e-9a34-55e1c7b2d9f0")) IDXAudioOfflineStream : public IDXAudioStream2 {
+	/* Finish() ends the render and closes the output file.  If called from the stream callback, no more frames are
+	** rendered after the current call.  A finished stream can't be started again. */
+	virtual VOID STDMETHODCALLTYPE Finish() PURE;
+
+	/* WaitForFinish() blocks until the render has finished, or until [Milliseconds] have passed.  Returns TRUE if
+	** the render has finished. */
+	virtual BOOL STDMETHODCALLTYPE WaitForFinish(DWORD Milliseconds) PURE;
+
+	/* GetFramesRendered() returns the number of frames rendered so far. */
+	virtual UINT64 STDMETHODCALLTYPE GetFramesRendered() PURE;
+
+	/* GetRealTimeFactor() returns the duration of the audio rendered so far divided by the time it took to render it.
+	** A value of 10.0 means that the stream rendered ten times faster than real time. */
+	virtual DOUBLE STDMETHODCALLTYPE GetRealTimeFactor() PURE;
+
+	/* GetBuffer() returns the rendered interleaved frames when rendering to memory, or nullptr when rendering to a file.
+	** This may only be called once the render has finished, and is valid until the stream is released. */
+	virtual const FLOAT* STDMETHODCALLTYPE GetBuffer() PURE;
+};
+
 /* IDXAudioCallback is the parent interface for all stream callbacks.   This should not be directly inherited.
 ** Instead, inherit from either of IDXAudioReadCallback, IDXAudioWriteCallback, or IDXAudioReadWriteCallback. */
 struct __declspec(uuid("b19d3575-b174-409c-9a27-1b8bf5d938d4")) IDXAudioCallback : public IUnknown {
@@ -71,16 +200,18 @@ struct __declspec(uuid("b19d3575-b174-409c-9a27-1b8bf5d938d4")) IDXAudioCallback
 
 	/* OnThreadInit() is called when the stream is first created, on the new thread.  Because COM is initialized
 	** to apartment threaded mode, if you wish to use any COM objects you must create them here.  This is also
-	** useful for any general initialization that must be done with your audio rendering code. */
+	** useful for any general initialization that must be done with your audio rendering code.  The endpoints
+	** have been initialized by then, so the stream's sample rate is final, and stream creation doesn't return
+	** until this does. */
 	virtual VOID STDMETHODCALLTYPE OnThreadInit() PURE;
 };
 
 /* IDXAudioReadCallback is the callback interface for input and loopback streams. */
 struct __declspec(uuid("63366a5b-5a66-43bf-8d3b-36421d4036d3")) IDXAudioReadCallback : public IDXAudioCallback {
 	/* Process() is called once every stream period.  This provides the input data from the default endpoint
-	** as it arrives, at the given sample rate.  [Frames] represents the number of floating-point stereo samples
-	** available in the [AudioIn] buffer.  Note that this value is likely to frequently change between calls due to
-	** the process of resampling the input.  You should write your application to be flexible of this number.
+	** as it arrives, at the given sample rate.  [Frames] represents the number of interleaved floating-point frames
+	** (of the stream's channel count) available in the [AudioIn] buffer.  Note that this value is likely to
+	** frequently change between calls due to the process of resampling the input.  You should write your application to be flexible of this number.
 	** Note that this must be implemented. */
 	virtual VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioIn, UINT Frames) PURE;
 };
@@ -97,10 +228,11 @@ public:
 /* IDXAudioWriteCallback is the callback interface for output streams. */
 struct __declspec(uuid("34ae23e3-6e51-4c41-86dd-37d0461ac6ae")) IDXAudioWriteCallback : public IDXAudioCallback {
 	/* Process() is called once every stream period.  This delivers your output data to the default endpoint
-	** at the given sample rate.  [Frames] represents the number of floating-point stereo samples you must produce
-	** to the [AudioOut] buffer.  Note that this value is likely to frequently change between calls due to
-	** the process of resampling the output.  You should write your application to be flexible of this number.
-	** Note that this must be implemented. */
+	** at the given sample rate.  [Frames] represents the number of interleaved floating-point frames (of the
+	** stream's channel count) you must produce to the [AudioOut] buffer.  Note that this value is likely to
+	** frequently change between calls due to the process of resampling the output.  You should write your application to be flexible of this number.
+	** [AudioOut] may point straight into the endpoint's buffer (see DXAUDIO_OUTPUT_PATH), so every frame of it must be written,
+	** and it must not be used after the call returns.  Note that this must be implemented. */
 	virtual VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioOut, UINT Frames) PURE;
 };
 
@@ -117,11 +249,12 @@ public:
 struct __declspec(uuid("857d0781-1b48-4494-b829-24f3b731ff6b")) IDXAudioReadWriteCallback : public IDXAudioCallback {
 	/* Process() is called once every stream period.  This retrieves input data from the default input endpoint and
 	** delivers your output data to the default output endpoint at the given sample rate.
-	** [Frames] represents the number of floating-point stereo samples available in the [AudioIn] buffer, as well as
-	** the number of samples you must produce to the [AudioOut] buffer.
+	** [Frames] represents the number of interleaved floating-point frames (of the stream's channel count) available
+	** in the [AudioIn] buffer, as well as the number of frames you must produce to the [AudioOut] buffer.
 	** Note that this value is likely to frequently change between calls due to the process of resampling.
 	** You should write your application to be flexible of this number.
-	** Note that this must be implemented. */
+	** As with IDXAudioWriteCallback, [AudioOut] may point straight into the endpoint's buffer, so every frame of it must be
+	** written, and neither buffer may be used after the call returns.  Note that this must be implemented. */
 	virtual VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioIn, FLOAT* AudioOut, UINT Frames) PURE;
 };
 
@@ -144,9 +277,18 @@ public:
 
 /* DXAudioCreateStream() is used to create any audio stream.  [ppDXAudioCallback] must inherit from
 ** one of either IDXAudioReadCallback, IDXAudioWriteCallback, or IDXAudioReadWriteCallback and must
-** be the appropriate callback interface for the stream you want to create. */
+** be the appropriate callback interface for the stream you want to create.  Every property that
+** DXAUDIO_STREAM_DESC doesn't have is left at its default. */
 extern "C" HRESULT _DXAUDIO_EXPORT_TAG DXAudioCreateStream (
 	const DXAUDIO_STREAM_DESC* pDesc,
 	IDXAudioCallback* pDXAudioCallback,
 	IDXAudioStream** ppDXAudioStream
 );
+
+/* DXAudioCreateStreamEx() is the same as DXAudioCreateStream(), but takes every property of the stream.
+** [pDesc] must have been zero-initialized before it was filled in. */
+extern "C" HRESULT _DXAUDIO_EXPORT_TAG DXAudioCreateStreamEx (
+	const DXAUDIO_STREAM_DESC_EX* pDesc,
+	IDXAudioCallback* pDXAudioCallback,
+	IDXAudioStream** ppDXAudioStream
+);
@@ -5,11 +5,16 @@
 
 /* Create the CDXAudioResampler object. */
 HRESULT DXAudioCreateResampler(IDXAudioResampler** ppDXAudioResampler) {
+	return DXAudioCreateResamplerEx(DXAUDIO_RESAMPLER_QUALITY_DEFAULT, ppDXAudioResampler);
+}
+
+/* Create the CDXAudioResampler object with the given quality. */
+HRESULT DXAudioCreateResamplerEx(DXAUDIO_RESAMPLER_QUALITY Quality, IDXAudioResampler** ppDXAudioResampler) {
 	HRESULT hr = S_OK;
 
 	CComPtr<CDXAudioResampler> Resampler = new CDXAudioResampler();
 
-	hr = Resampler->Initialize();
+	hr = Resampler->Initialize(Quality);
 
 	if (FAILED(hr)) {
 		*ppDXAudioResampler = nullptr;
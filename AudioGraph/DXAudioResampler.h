@@ -2,6 +2,7 @@
 
 #include <Windows.h>
 #include <comdef.h>
+#include "DXAudio.h"
 
 /* The resampler interface.  This exposes functionality courtesy of secret rabbit code. */
 struct __declspec(uuid("4170135b-1f5b-4a32-9e22-08de2626b5f7")) IDXAudioResampler : public IUnknown {
@@ -9,7 +10,8 @@ struct __declspec(uuid("4170135b-1f5b-4a32-9e22-08de2626b5f7")) IDXAudioResample
 	** of stereo floating-point samples in this buffer.  [OutBuffer] is the pointer to the output buffer,
 	** and [OutBufferFrames] is the number of frames available in the buffer.  You can set this to a number
 	** higher than the expected number of received samples - in fact, you should by one sample.  Finally, [Ratio]
-	** refers to the ratio of the output sample rate over the input sample rate.  */
+	** refers to the ratio of the output sample rate over the input sample rate.  A ratio of exactly 1.0 copies the
+** input straight through without filtering it.  */
 	virtual VOID STDMETHODCALLTYPE Process (
 		FLOAT* InBuffer,
 		UINT InBufferFrames,
@@ -29,5 +31,8 @@ struct __declspec(uuid("4170135b-1f5b-4a32-9e22-08de2626b5f7")) IDXAudioResample
 	#endif
 #endif
 
-/* Creates the resampler object. */
-HRESULT _DXAUDIO_EXPORT_TAG DXAudioCreateResampler(IDXAudioResampler** ppDXAudioResampler);
\ No newline at end of file
+/* Creates the resampler object, using DXAUDIO_RESAMPLER_QUALITY_DEFAULT. */
+HRESULT _DXAUDIO_EXPORT_TAG DXAudioCreateResampler(IDXAudioResampler** ppDXAudioResampler);
+
+/* Creates the resampler object with the given quality. */
+HRESULT _DXAUDIO_EXPORT_TAG DXAudioCreateResamplerEx(DXAUDIO_RESAMPLER_QUALITY Quality, IDXAudioResampler** ppDXAudioResampler);
\ No newline at end of file
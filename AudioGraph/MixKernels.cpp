@@ -0,0 +1,93 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#include "MixKernels.h"
+#include <emmintrin.h>
+
+/* Writes [In] scaled by the ramp to [Out], adding it to what's there if [Mix] is true.  Scaling in place
+** passes the same buffer as both.  The gain of every frame is worked out from its index rather than
+** accumulated, so long ramps land exactly where they should. */
+template <bool Mix>
+static VOID Ramp(FLOAT* Out, const FLOAT* In, UINT Frames, UINT Channels, FLOAT Gain, FLOAT Step) {
+	const __m128 Start = _mm_set1_ps(Gain);
+	const __m128 Steps = _mm_set1_ps(Step);
+	UINT i = 0;
+
+	if (Channels == 1) {
+		//Four frames per vector
+		for (; i + 4 <= Frames; i += 4) {
+			__m128 Gains = _mm_add_ps(Start, _mm_mul_ps(Steps, _mm_setr_ps(FLOAT(i), FLOAT(i + 1), FLOAT(i + 2), FLOAT(i + 3))));
+			__m128 Samples = _mm_mul_ps(_mm_loadu_ps(In + i), Gains);
+
+			if (Mix) {
+				Samples = _mm_add_ps(Samples, _mm_loadu_ps(Out + i));
+			}
+
+			_mm_storeu_ps(Out + i, Samples);
+		}
+	} else if (Channels == 2) {
+		//Two frames per vector, each gain used for both channels
+		for (; i + 2 <= Frames; i += 2) {
+			__m128 Gains = _mm_add_ps(Start, _mm_mul_ps(Steps, _mm_setr_ps(FLOAT(i), FLOAT(i), FLOAT(i + 1), FLOAT(i + 1))));
+			__m128 Samples = _mm_mul_ps(_mm_loadu_ps(In + i * 2), Gains);
+
+			if (Mix) {
+				Samples = _mm_add_ps(Samples, _mm_loadu_ps(Out + i * 2));
+			}
+
+			_mm_storeu_ps(Out + i * 2, Samples);
+		}
+	} else if (Channels % 4 == 0) {
+		//One frame at a time, with its gain broadcast across the channels
+		for (; i < Frames; i++) {
+			__m128 Gains = _mm_set1_ps(Gain + Step * FLOAT(i));
+
+			for (UINT j = 0; j < Channels; j += 4) {
+				__m128 Samples = _mm_mul_ps(_mm_loadu_ps(In + i * Channels + j), Gains);
+
+				if (Mix) {
+					Samples = _mm_add_ps(Samples, _mm_loadu_ps(Out + i * Channels + j));
+				}
+
+				_mm_storeu_ps(Out + i * Channels + j, Samples);
+			}
+		}
+	}
+
+	//Whatever the vectors didn't cover
+	for (; i < Frames; i++) {
+		const FLOAT FrameGain = Gain + Step * FLOAT(i);
+
+		for (UINT j = 0; j < Channels; j++) {
+			const FLOAT Sample = In[i * Channels + j] * FrameGain;
+			Out[i * Channels + j] = Mix ? Out[i * Channels + j] + Sample : Sample;
+		}
+	}
+}
+
+VOID ScaleRamp(FLOAT* Buffer, UINT Frames, UINT Channels, FLOAT Gain, FLOAT Step) {
+	Ramp<false>(Buffer, Buffer, Frames, Channels, Gain, Step);
+}
+
+VOID MixRamp(FLOAT* Out, const FLOAT* In, UINT Frames, UINT Channels, FLOAT Gain, FLOAT Step) {
+	Ramp<true>(Out, In, Frames, Channels, Gain, Step);
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <Windows.h>
+
+/* Gain ramps for mixing interleaved floating-point frames.  A ramp starts at [Gain] and changes by [Step] every
+** frame, so a constant gain is a ramp with a [Step] of 0.  Curved fades are made of short linear ramps.  The
+** kernels use SSE2 for mono, stereo and multiples of four channels, and plain loops for anything else. */
+
+/* Scales [Frames] frames of [Channels] channels in [Buffer] by a gain ramp. */
+VOID ScaleRamp(FLOAT* Buffer, UINT Frames, UINT Channels, FLOAT Gain, FLOAT Step);
+
+/* Adds [Frames] frames of [Channels] channels from [In], scaled by a gain ramp, to [Out]. */
+VOID MixRamp(FLOAT* Out, const FLOAT* In, UINT Frames, UINT Channels, FLOAT Gain, FLOAT Step);
\ No newline at end of file
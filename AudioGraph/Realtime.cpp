@@ -0,0 +1,131 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#include "Realtime.h"
+
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
+
+/* The counters the calling thread is charged to, or null if it isn't rendering. */
+static __declspec(thread) AUDIO_GRAPH_REALTIME_COUNTERS* t_Counters = nullptr;
+
+#ifdef _DEBUG
+/* Stops in the debugger at a call that broke the rules, if [pCounters] asks for it. */
+static inline VOID RealtimeTrap(const AUDIO_GRAPH_REALTIME_COUNTERS* pCounters) {
+#ifdef AUDIO_GRAPH_REALTIME_TRAP
+	if (pCounters->Trap) {
+		__debugbreak();
+	}
+#endif
+}
+
+static _CRT_ALLOC_HOOK s_PreviousAllocHook = nullptr;
+static INIT_ONCE s_AllocHookOnce = INIT_ONCE_STATIC_INIT;
+
+/* Every heap allocation and free made through the CRT is checked against the thread it happens on. */
+static int __cdecl RealtimeAllocHook(int AllocType, void* pUserData, size_t Size, int BlockType, long RequestNumber, const unsigned char* Filename, int LineNumber) {
+	//The CRT's own bookkeeping isn't anything the render path did
+	if (t_Counters != nullptr && BlockType != _CRT_BLOCK) {
+		InterlockedIncrement64(&t_Counters->Allocations);
+		RealtimeTrap(t_Counters);
+	}
+
+	if (s_PreviousAllocHook != nullptr) {
+		return s_PreviousAllocHook(AllocType, pUserData, Size, BlockType, RequestNumber, Filename, LineNumber);
+	}
+
+	return TRUE;
+}
+
+static BOOL CALLBACK InstallAllocHook(PINIT_ONCE InitOnce, PVOID Parameter, PVOID* Context) {
+	s_PreviousAllocHook = _CrtSetAllocHook(RealtimeAllocHook);
+	return TRUE;
+}
+#endif
+
+VOID RealtimeInstallHooks() {
+#ifdef _DEBUG
+	InitOnceExecuteOnce(&s_AllocHookOnce, InstallAllocHook, NULL, NULL);
+#endif
+}
+
+AUDIO_GRAPH_REALTIME_COUNTERS* RealtimeEnter(AUDIO_GRAPH_REALTIME_COUNTERS* pCounters) {
+	AUDIO_GRAPH_REALTIME_COUNTERS* Previous = t_Counters;
+	t_Counters = pCounters;
+	return Previous;
+}
+
+VOID RealtimeLeave(AUDIO_GRAPH_REALTIME_COUNTERS* pPrevious) {
+	t_Counters = pPrevious;
+}
+
+#ifdef _DEBUG
+VOID RealtimeBlockingCall() {
+	if (t_Counters != nullptr) {
+		InterlockedIncrement64(&t_Counters->BlockingCalls);
+		RealtimeTrap(t_Counters);
+	}
+}
+
+VOID RealtimeSignalCall() {
+	if (t_Counters != nullptr) {
+		InterlockedIncrement64(&t_Counters->BlockingCalls);
+	}
+}
+#endif
+
+VOID RealtimeReportFailure(IAudioGraphCallback* pCallback, LPCWSTR File, UINT Line, HRESULT hr) {
+	AUDIO_GRAPH_REALTIME_COUNTERS* Counters = t_Counters;
+
+	if (Counters == nullptr) {
+		pCallback->OnObjectFailure(File, Line, hr);
+		return;
+	}
+
+	InterlockedIncrement64(&Counters->Failures);
+
+	//Worker threads render alongside the audio thread, so the slot is claimed before it's written.
+	//[File] is always a string literal, so it outlives the failure.
+	if (InterlockedCompareExchange(&Counters->HeldFailure, AUDIO_GRAPH_HELD_FAILURE_WRITING, AUDIO_GRAPH_HELD_FAILURE_EMPTY) == AUDIO_GRAPH_HELD_FAILURE_EMPTY) {
+		Counters->HeldFile = File;
+		Counters->HeldLine = Line;
+		Counters->HeldResult = hr;
+		InterlockedExchange(&Counters->HeldFailure, AUDIO_GRAPH_HELD_FAILURE_FULL);
+	}
+}
+
+VOID RealtimeReportHeldFailure(AUDIO_GRAPH_REALTIME_COUNTERS& Counters, IAudioGraphCallback* pCallback) {
+	//Application threads can race each other here too
+	if (InterlockedCompareExchange(&Counters.HeldFailure, AUDIO_GRAPH_HELD_FAILURE_READING, AUDIO_GRAPH_HELD_FAILURE_FULL) != AUDIO_GRAPH_HELD_FAILURE_FULL) {
+		return;
+	}
+
+	LPCWSTR File = Counters.HeldFile;
+	UINT Line = Counters.HeldLine;
+	HRESULT hr = Counters.HeldResult;
+
+	InterlockedExchange(&Counters.HeldFailure, AUDIO_GRAPH_HELD_FAILURE_EMPTY);
+
+	pCallback->OnObjectFailure(File, Line, hr);
+}
\ No newline at end of file
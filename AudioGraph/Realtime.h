@@ -0,0 +1,86 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/AudioGraph
+*/
+
+#pragma once
+
+#include <Windows.h>
+
+#include "AudioGraph.h"
+
+/* Checks on the rules a thread has to keep while it renders: no heap allocations, no calls that can block or
+** enter the kernel, and no calls out to the application.  A render callback marks its thread with
+** RealtimeEnter() while it produces samples, and whatever that thread does until RealtimeLeave() is charged
+** to the counters it passed in.  Allocations and blocking calls are only counted in debug builds.  Debug builds
+** with AUDIO_GRAPH_REALTIME_TRAP defined also break into the debugger at each one charged to counters with Trap
+** set, so that the call that broke the rules is on the stack. */
+
+/* The state of the failure a render thread is holding for the application. */
+enum AUDIO_GRAPH_HELD_FAILURE {
+	AUDIO_GRAPH_HELD_FAILURE_EMPTY,
+	AUDIO_GRAPH_HELD_FAILURE_WRITING,
+	AUDIO_GRAPH_HELD_FAILURE_FULL,
+	AUDIO_GRAPH_HELD_FAILURE_READING
+};
+
+/* Counters charged by a rendering thread.  They may be read from any thread. */
+struct AUDIO_GRAPH_REALTIME_COUNTERS {
+	volatile LONG64 Allocations; //Heap allocations and frees (debug builds only)
+	volatile LONG64 BlockingCalls; //Calls that can block or enter the kernel (debug builds only)
+	volatile LONG64 Failures; //Failures reported while rendering
+	BOOL Trap; //Break at allocations and blocking calls charged here, if built with AUDIO_GRAPH_REALTIME_TRAP - offline renders read files on the render thread on purpose, so only device playback sets it
+	volatile LONG HeldFailure; //An AUDIO_GRAPH_HELD_FAILURE - the first failure since the application was last told is kept for it
+	LPCWSTR HeldFile;
+	UINT HeldLine;
+	HRESULT HeldResult;
+};
+
+/* Installs the allocation hook debug builds count with.  It's process-wide, so this only does anything the first time. */
+VOID RealtimeInstallHooks();
+
+/* Marks the calling thread as rendering, charging it to [pCounters] until RealtimeLeave().  Returns the counters
+** it was charged to before, so that a thread rendering on behalf of another can put them back. */
+AUDIO_GRAPH_REALTIME_COUNTERS* RealtimeEnter(AUDIO_GRAPH_REALTIME_COUNTERS* pCounters);
+
+/* Charges the calling thread to [pPrevious] again, as returned by RealtimeEnter(). */
+VOID RealtimeLeave(AUDIO_GRAPH_REALTIME_COUNTERS* pPrevious);
+
+#ifdef _DEBUG
+/* Counts a call that can block or enter the kernel, if the calling thread is rendering.  Placed just before the call. */
+VOID RealtimeBlockingCall();
+
+/* Counts a call that enters the kernel only to wake another thread, such as SetEvent(), if the calling thread is
+** rendering.  The render path has to wake the threads that work for it, so unlike RealtimeBlockingCall() this never
+** traps. */
+VOID RealtimeSignalCall();
+#else
+inline VOID RealtimeBlockingCall() { }
+inline VOID RealtimeSignalCall() { }
+#endif
+
+/* Reports a failure through [pCallback].  A rendering thread doesn't call the application - the failure is
+** counted and held instead, until an application thread passes it on with RealtimeReportHeldFailure().  Only one
+** failure is held at a time, so the ones after it are only counted. */
+VOID RealtimeReportFailure(IAudioGraphCallback* pCallback, LPCWSTR File, UINT Line, HRESULT hr);
+
+/* Passes the failure held in [Counters], if there is one, to [pCallback].  Called from application threads only. */
+VOID RealtimeReportHeldFailure(AUDIO_GRAPH_REALTIME_COUNTERS& Counters, IAudioGraphCallback* pCallback);
\ No newline at end of file
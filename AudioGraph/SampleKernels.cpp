@@ -0,0 +1,639 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+#include "SampleKernels.h"
+#include <intrin.h>
+#include <immintrin.h>
+#include <string.h>
+
+/* The sample formats an endpoint may use in shared mode. */
+enum SAMPLE_FORMAT {
+	SAMPLE_FORMAT_INT16, //16-bit signed int
+	SAMPLE_FORMAT_INT24, //24-bit unsigned, packed into three bytes
+	SAMPLE_FORMAT_INT32, //32-bit signed int
+	SAMPLE_FORMAT_FLOAT, //32-bit floating-point
+	SAMPLE_FORMAT_COUNT
+};
+
+/* The instruction sets there are kernels for. */
+enum SAMPLE_ISA {
+	SAMPLE_ISA_SCALAR,
+	SAMPLE_ISA_SSE2,
+	SAMPLE_ISA_AVX2,
+	SAMPLE_ISA_COUNT
+};
+
+//Scale factors between normalized floats [-1.0, 1.0] and each integer format
+static const FLOAT INT16_SCALE = 32767.0f;
+static const FLOAT INT24_SCALE = 8388607.0f;
+static const FLOAT INT32_SCALE = 2147483647.0f;
+
+//Integer conversions saturate at these values.  2147483520 is the largest float below 2^31.
+static const FLOAT INT16_MIN_FLOAT = -32768.0f;
+static const FLOAT INT16_MAX_FLOAT = 32767.0f;
+static const FLOAT INT32_MIN_FLOAT = -2147483648.0f;
+static const FLOAT INT32_MAX_FLOAT = 2147483520.0f;
+
+static inline FLOAT Clamp(FLOAT Value, FLOAT Min, FLOAT Max) {
+	return Value < Min ? Min : (Value > Max ? Max : Value);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Scalar kernels - these handle stereo applications in every format, and the frames left over by the
+// vector kernels.  [AppChannels] is always two for these, and for the SSE2 and AVX2 kernels.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static VOID ReadInt16Scalar(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const INT16* Samples = (const INT16*)(In);
+
+	for (UINT i = 0; i < Frames; i++) {
+		*Out++ = FLOAT(Samples[0]) * (1.0f / INT16_SCALE);
+		*Out++ = FLOAT(Samples[1]) * (1.0f / INT16_SCALE);
+		Samples += Channels;
+	}
+}
+
+static VOID ReadInt24Scalar(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	for (UINT i = 0; i < Frames; i++) {
+		for (UINT j = 0; j < 2; j++) {
+			UINT32 Sample = UINT32(In[0]) | (UINT32(In[1]) << 8) | (UINT32(In[2]) << 16);
+			*Out++ = FLOAT(Sample) / INT24_SCALE - 1.0f;
+			In += 3;
+		}
+
+		In += 3 * (Channels - 2);
+	}
+}
+
+static VOID ReadInt32Scalar(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const INT32* Samples = (const INT32*)(In);
+
+	for (UINT i = 0; i < Frames; i++) {
+		*Out++ = FLOAT(Samples[0]) * (1.0f / INT32_SCALE);
+		*Out++ = FLOAT(Samples[1]) * (1.0f / INT32_SCALE);
+		Samples += Channels;
+	}
+}
+
+static VOID ReadFloatScalar(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const FLOAT* Samples = (const FLOAT*)(In);
+
+	if (Channels == 2) {
+		memcpy(Out, Samples, Frames * sizeof(FLOAT) * 2);
+		return;
+	}
+
+	for (UINT i = 0; i < Frames; i++) {
+		*Out++ = Samples[0];
+		*Out++ = Samples[1];
+		Samples += Channels;
+	}
+}
+
+static VOID WriteInt16Scalar(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	INT16* Samples = (INT16*)(Out);
+
+	//Zeroing the excess channels in one go is far cheaper than zeroing them frame by frame
+	if (Channels > 2) {
+		ZeroMemory(Out, Frames * Channels * sizeof(INT16));
+	}
+
+	for (UINT i = 0; i < Frames; i++) {
+		Samples[0] = INT16(Clamp(*In++ * INT16_SCALE, INT16_MIN_FLOAT, INT16_MAX_FLOAT));
+		Samples[1] = INT16(Clamp(*In++ * INT16_SCALE, INT16_MIN_FLOAT, INT16_MAX_FLOAT));
+		Samples += Channels;
+	}
+}
+
+static VOID WriteInt24Scalar(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	if (Channels > 2) {
+		ZeroMemory(Out, Frames * Channels * 3);
+	}
+
+	for (UINT i = 0; i < Frames; i++) {
+		for (UINT j = 0; j < 2; j++) {
+			//Only three bytes are written, so the last sample never runs past the end of the buffer
+			UINT32 Sample = UINT32((Clamp(*In++, -1.0f, 1.0f) + 1.0f) * INT24_SCALE);
+			Out[0] = BYTE(Sample);
+			Out[1] = BYTE(Sample >> 8);
+			Out[2] = BYTE(Sample >> 16);
+			Out += 3;
+		}
+
+		Out += 3 * (Channels - 2);
+	}
+}
+
+static VOID WriteInt32Scalar(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	INT32* Samples = (INT32*)(Out);
+
+	if (Channels > 2) {
+		ZeroMemory(Out, Frames * Channels * sizeof(INT32));
+	}
+
+	for (UINT i = 0; i < Frames; i++) {
+		Samples[0] = INT32(Clamp(*In++ * INT32_SCALE, INT32_MIN_FLOAT, INT32_MAX_FLOAT));
+		Samples[1] = INT32(Clamp(*In++ * INT32_SCALE, INT32_MIN_FLOAT, INT32_MAX_FLOAT));
+		Samples += Channels;
+	}
+}
+
+static VOID WriteFloatScalar(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	FLOAT* Samples = (FLOAT*)(Out);
+
+	if (Channels == 2) {
+		memcpy(Samples, In, Frames * sizeof(FLOAT) * 2);
+		return;
+	}
+
+	ZeroMemory(Out, Frames * Channels * sizeof(FLOAT));
+
+	for (UINT i = 0; i < Frames; i++) {
+		Samples[0] = *In++;
+		Samples[1] = *In++;
+		Samples += Channels;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// SSE2 kernels - these also extract the first two channels of multichannel frames
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Converts eight packed 16-bit samples to floats */
+static inline VOID StoreInt16x8(__m128i Packed, FLOAT* Out) {
+	const __m128 Scale = _mm_set1_ps(1.0f / INT16_SCALE);
+
+	//Placing each sample in the top half of a 32-bit lane and shifting it back down sign-extends it
+	__m128i Low = _mm_srai_epi32(_mm_unpacklo_epi16(Packed, Packed), 16);
+	__m128i High = _mm_srai_epi32(_mm_unpackhi_epi16(Packed, Packed), 16);
+
+	_mm_storeu_ps(Out, _mm_mul_ps(_mm_cvtepi32_ps(Low), Scale));
+	_mm_storeu_ps(Out + 4, _mm_mul_ps(_mm_cvtepi32_ps(High), Scale));
+}
+
+/* Converts eight floats to saturated 16-bit samples */
+static inline __m128i PackInt16x8(const FLOAT* In) {
+	const __m128 Scale = _mm_set1_ps(INT16_SCALE);
+	const __m128 Min = _mm_set1_ps(INT16_MIN_FLOAT);
+	const __m128 Max = _mm_set1_ps(INT16_MAX_FLOAT);
+
+	__m128 Low = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(In), Scale), Min), Max);
+	__m128 High = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(In + 4), Scale), Min), Max);
+
+	return _mm_packs_epi32(_mm_cvttps_epi32(Low), _mm_cvttps_epi32(High));
+}
+
+/* Converts four floats to saturated 32-bit samples */
+static inline __m128i PackInt32x4(const FLOAT* In) {
+	const __m128 Scale = _mm_set1_ps(INT32_SCALE);
+	const __m128 Min = _mm_set1_ps(INT32_MIN_FLOAT);
+	const __m128 Max = _mm_set1_ps(INT32_MAX_FLOAT);
+
+	return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(In), Scale), Min), Max));
+}
+
+static VOID ReadInt16SSE2(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const UINT Stride = Channels * sizeof(INT16);
+	UINT i = 0;
+
+	if (Channels == 2) {
+		for (; i + 4 <= Frames; i += 4) {
+			StoreInt16x8(_mm_loadu_si128((const __m128i*)(In + i * Stride)), Out + i * 2);
+		}
+	} else {
+		//The first two channels of a frame are a single 32-bit load
+		for (; i + 4 <= Frames; i += 4) {
+			const BYTE* Frame = In + i * Stride;
+
+			__m128i Packed = _mm_setr_epi32 (
+				*(const INT32*)(Frame),
+				*(const INT32*)(Frame + Stride),
+				*(const INT32*)(Frame + Stride * 2),
+				*(const INT32*)(Frame + Stride * 3)
+			);
+
+			StoreInt16x8(Packed, Out + i * 2);
+		}
+	}
+
+	ReadInt16Scalar(In + i * Stride, Out + i * 2, Frames - i, Channels, AppChannels);
+}
+
+static VOID ReadInt32SSE2(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const __m128 Scale = _mm_set1_ps(1.0f / INT32_SCALE);
+	const UINT Stride = Channels * sizeof(INT32);
+	UINT i = 0;
+
+	if (Channels == 2) {
+		for (; i + 2 <= Frames; i += 2) {
+			__m128i Packed = _mm_loadu_si128((const __m128i*)(In + i * Stride));
+			_mm_storeu_ps(Out + i * 2, _mm_mul_ps(_mm_cvtepi32_ps(Packed), Scale));
+		}
+	} else {
+		//The first two channels of a frame are a single 64-bit load
+		for (; i + 2 <= Frames; i += 2) {
+			const BYTE* Frame = In + i * Stride;
+
+			__m128i Packed = _mm_unpacklo_epi64 (
+				_mm_loadl_epi64((const __m128i*)(Frame)),
+				_mm_loadl_epi64((const __m128i*)(Frame + Stride))
+			);
+
+			_mm_storeu_ps(Out + i * 2, _mm_mul_ps(_mm_cvtepi32_ps(Packed), Scale));
+		}
+	}
+
+	ReadInt32Scalar(In + i * Stride, Out + i * 2, Frames - i, Channels, AppChannels);
+}
+
+static VOID ReadFloatSSE2(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const UINT Stride = Channels * sizeof(FLOAT);
+	UINT i = 0;
+
+	//Stereo is a plain copy, which memcpy already vectorizes
+	if (Channels == 2) {
+		ReadFloatScalar(In, Out, Frames, Channels, AppChannels);
+		return;
+	}
+
+	for (; i + 2 <= Frames; i += 2) {
+		const BYTE* Frame = In + i * Stride;
+
+		__m128d Pair = _mm_loadh_pd (
+			_mm_load_sd((const double*)(Frame)),
+			(const double*)(Frame + Stride)
+		);
+
+		_mm_storeu_pd((double*)(Out + i * 2), Pair);
+	}
+
+	ReadFloatScalar(In + i * Stride, Out + i * 2, Frames - i, Channels, AppChannels);
+}
+
+static VOID WriteInt16SSE2(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const UINT Stride = Channels * sizeof(INT16);
+	UINT i = 0;
+
+	if (Channels == 2) {
+		for (; i + 4 <= Frames; i += 4) {
+			_mm_storeu_si128((__m128i*)(Out + i * Stride), PackInt16x8(In + i * 2));
+		}
+	} else {
+		ZeroMemory(Out, Frames * Stride);
+
+		for (; i + 4 <= Frames; i += 4) {
+			__m128i Packed = PackInt16x8(In + i * 2);
+			BYTE* Frame = Out + i * Stride;
+
+			//Each 32-bit lane holds one frame's pair of samples
+			*(INT32*)(Frame) = _mm_cvtsi128_si32(Packed);
+			*(INT32*)(Frame + Stride) = _mm_cvtsi128_si32(_mm_srli_si128(Packed, 4));
+			*(INT32*)(Frame + Stride * 2) = _mm_cvtsi128_si32(_mm_srli_si128(Packed, 8));
+			*(INT32*)(Frame + Stride * 3) = _mm_cvtsi128_si32(_mm_srli_si128(Packed, 12));
+		}
+	}
+
+	WriteInt16Scalar(In + i * 2, Out + i * Stride, Frames - i, Channels, AppChannels);
+}
+
+static VOID WriteInt32SSE2(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const UINT Stride = Channels * sizeof(INT32);
+	UINT i = 0;
+
+	if (Channels == 2) {
+		for (; i + 2 <= Frames; i += 2) {
+			_mm_storeu_si128((__m128i*)(Out + i * Stride), PackInt32x4(In + i * 2));
+		}
+	} else {
+		ZeroMemory(Out, Frames * Stride);
+
+		for (; i + 2 <= Frames; i += 2) {
+			__m128i Packed = PackInt32x4(In + i * 2);
+			BYTE* Frame = Out + i * Stride;
+
+			_mm_storel_epi64((__m128i*)(Frame), Packed);
+			_mm_storel_epi64((__m128i*)(Frame + Stride), _mm_srli_si128(Packed, 8));
+		}
+	}
+
+	WriteInt32Scalar(In + i * 2, Out + i * Stride, Frames - i, Channels, AppChannels);
+}
+
+static VOID WriteFloatSSE2(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const UINT Stride = Channels * sizeof(FLOAT);
+	UINT i = 0;
+
+	if (Channels == 2) {
+		WriteFloatScalar(In, Out, Frames, Channels, AppChannels);
+		return;
+	}
+
+	ZeroMemory(Out, Frames * Stride);
+
+	for (; i + 2 <= Frames; i += 2) {
+		__m128d Pairs = _mm_loadu_pd((const double*)(In + i * 2));
+		BYTE* Frame = Out + i * Stride;
+
+		_mm_storel_pd((double*)(Frame), Pairs);
+		_mm_storeh_pd((double*)(Frame + Stride), Pairs);
+	}
+
+	WriteFloatScalar(In + i * 2, Out + i * Stride, Frames - i, Channels, AppChannels);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels - these widen the stereo paths, and leave channel extraction to the SSE2 kernels, since
+// gathers and scatters are no faster than the 64-bit loads and stores those already use
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static VOID ReadInt16AVX2(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const __m256 Scale = _mm256_set1_ps(1.0f / INT16_SCALE);
+	UINT i = 0;
+
+	if (Channels != 2) {
+		ReadInt16SSE2(In, Out, Frames, Channels, AppChannels);
+		return;
+	}
+
+	for (; i + 8 <= Frames; i += 8) {
+		__m256i Low = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(In + i * 4)));
+		__m256i High = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(In + i * 4 + 16)));
+
+		_mm256_storeu_ps(Out + i * 2, _mm256_mul_ps(_mm256_cvtepi32_ps(Low), Scale));
+		_mm256_storeu_ps(Out + i * 2 + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(High), Scale));
+	}
+
+	ReadInt16SSE2(In + i * 4, Out + i * 2, Frames - i, Channels, AppChannels);
+}
+
+static VOID ReadInt32AVX2(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const __m256 Scale = _mm256_set1_ps(1.0f / INT32_SCALE);
+	UINT i = 0;
+
+	if (Channels != 2) {
+		ReadInt32SSE2(In, Out, Frames, Channels, AppChannels);
+		return;
+	}
+
+	for (; i + 4 <= Frames; i += 4) {
+		__m256i Packed = _mm256_loadu_si256((const __m256i*)(In + i * 8));
+		_mm256_storeu_ps(Out + i * 2, _mm256_mul_ps(_mm256_cvtepi32_ps(Packed), Scale));
+	}
+
+	ReadInt32SSE2(In + i * 8, Out + i * 2, Frames - i, Channels, AppChannels);
+}
+
+static VOID WriteInt16AVX2(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const __m256 Scale = _mm256_set1_ps(INT16_SCALE);
+	const __m256 Min = _mm256_set1_ps(INT16_MIN_FLOAT);
+	const __m256 Max = _mm256_set1_ps(INT16_MAX_FLOAT);
+	UINT i = 0;
+
+	if (Channels != 2) {
+		WriteInt16SSE2(In, Out, Frames, Channels, AppChannels);
+		return;
+	}
+
+	for (; i + 8 <= Frames; i += 8) {
+		__m256 Low = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(In + i * 2), Scale), Min), Max);
+		__m256 High = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(In + i * 2 + 8), Scale), Min), Max);
+
+		//The pack works within each 128-bit lane, so the middle quarters come out swapped
+		__m256i Packed = _mm256_packs_epi32(_mm256_cvttps_epi32(Low), _mm256_cvttps_epi32(High));
+		Packed = _mm256_permute4x64_epi64(Packed, 0xD8);
+
+		_mm256_storeu_si256((__m256i*)(Out + i * 4), Packed);
+	}
+
+	WriteInt16SSE2(In + i * 2, Out + i * 4, Frames - i, Channels, AppChannels);
+}
+
+static VOID WriteInt32AVX2(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const __m256 Scale = _mm256_set1_ps(INT32_SCALE);
+	const __m256 Min = _mm256_set1_ps(INT32_MIN_FLOAT);
+	const __m256 Max = _mm256_set1_ps(INT32_MAX_FLOAT);
+	UINT i = 0;
+
+	if (Channels != 2) {
+		WriteInt32SSE2(In, Out, Frames, Channels, AppChannels);
+		return;
+	}
+
+	for (; i + 4 <= Frames; i += 4) {
+		__m256 Samples = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(In + i * 2), Scale), Min), Max);
+		_mm256_storeu_si256((__m256i*)(Out + i * 8), _mm256_cvttps_epi32(Samples));
+	}
+
+	WriteInt32SSE2(In + i * 2, Out + i * 8, Frames - i, Channels, AppChannels);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Channel mapping kernels - these handle applications that aren't stereo, or endpoints with fewer than two
+// channels.  Shared channels are converted, application channels the endpoint lacks are silent, and
+// endpoint channels the application lacks are zeroed.
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static inline FLOAT LoadInt16(const BYTE* In) {
+	return FLOAT(*(const INT16*)(In)) * (1.0f / INT16_SCALE);
+}
+
+static inline FLOAT LoadInt24(const BYTE* In) {
+	UINT32 Sample = UINT32(In[0]) | (UINT32(In[1]) << 8) | (UINT32(In[2]) << 16);
+	return FLOAT(Sample) / INT24_SCALE - 1.0f;
+}
+
+static inline FLOAT LoadInt32(const BYTE* In) {
+	return FLOAT(*(const INT32*)(In)) * (1.0f / INT32_SCALE);
+}
+
+static inline FLOAT LoadFloat(const BYTE* In) {
+	return *(const FLOAT*)(In);
+}
+
+static inline VOID StoreInt16(FLOAT Value, BYTE* Out) {
+	*(INT16*)(Out) = INT16(Clamp(Value * INT16_SCALE, INT16_MIN_FLOAT, INT16_MAX_FLOAT));
+}
+
+static inline VOID StoreInt24(FLOAT Value, BYTE* Out) {
+	UINT32 Sample = UINT32((Clamp(Value, -1.0f, 1.0f) + 1.0f) * INT24_SCALE);
+	Out[0] = BYTE(Sample);
+	Out[1] = BYTE(Sample >> 8);
+	Out[2] = BYTE(Sample >> 16);
+}
+
+static inline VOID StoreInt32(FLOAT Value, BYTE* Out) {
+	*(INT32*)(Out) = INT32(Clamp(Value * INT32_SCALE, INT32_MIN_FLOAT, INT32_MAX_FLOAT));
+}
+
+static inline VOID StoreFloat(FLOAT Value, BYTE* Out) {
+	*(FLOAT*)(Out) = Value;
+}
+
+template <UINT Size, FLOAT (*Load)(const BYTE*)>
+static VOID ReadMapped(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const UINT Shared = Channels < AppChannels ? Channels : AppChannels;
+
+	for (UINT i = 0; i < Frames; i++) {
+		UINT j = 0;
+
+		for (; j < Shared; j++) {
+			Out[j] = Load(In + j * Size);
+		}
+
+		for (; j < AppChannels; j++) {
+			Out[j] = 0.0f;
+		}
+
+		In += Channels * Size;
+		Out += AppChannels;
+	}
+}
+
+template <UINT Size, VOID (*Store)(FLOAT, BYTE*)>
+static VOID WriteMapped(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	const UINT Shared = Channels < AppChannels ? Channels : AppChannels;
+
+	if (Channels > Shared) {
+		ZeroMemory(Out, Frames * Channels * Size);
+	}
+
+	for (UINT i = 0; i < Frames; i++) {
+		for (UINT j = 0; j < Shared; j++) {
+			Store(In[j], Out + j * Size);
+		}
+
+		In += AppChannels;
+		Out += Channels * Size;
+	}
+}
+
+/* When the layouts match, float frames are already in the application's format */
+static VOID ReadFloatMapped(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	if (Channels == AppChannels) {
+		memcpy(Out, In, Frames * sizeof(FLOAT) * Channels);
+		return;
+	}
+
+	ReadMapped<sizeof(FLOAT), LoadFloat>(In, Out, Frames, Channels, AppChannels);
+}
+
+static VOID WriteFloatMapped(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels) {
+	if (Channels == AppChannels) {
+		memcpy(Out, In, Frames * sizeof(FLOAT) * Channels);
+		return;
+	}
+
+	WriteMapped<sizeof(FLOAT), StoreFloat>(In, Out, Frames, Channels, AppChannels);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Kernel selection
+/////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+//24-bit samples straddle vector lanes, so they only have a scalar kernel
+static const SAMPLE_READ_KERNEL ReadKernels[SAMPLE_FORMAT_COUNT][SAMPLE_ISA_COUNT] = {
+	{ ReadInt16Scalar, ReadInt16SSE2, ReadInt16AVX2 },
+	{ ReadInt24Scalar, ReadInt24Scalar, ReadInt24Scalar },
+	{ ReadInt32Scalar, ReadInt32SSE2, ReadInt32AVX2 },
+	{ ReadFloatScalar, ReadFloatSSE2, ReadFloatSSE2 }
+};
+
+static const SAMPLE_WRITE_KERNEL WriteKernels[SAMPLE_FORMAT_COUNT][SAMPLE_ISA_COUNT] = {
+	{ WriteInt16Scalar, WriteInt16SSE2, WriteInt16AVX2 },
+	{ WriteInt24Scalar, WriteInt24Scalar, WriteInt24Scalar },
+	{ WriteInt32Scalar, WriteInt32SSE2, WriteInt32AVX2 },
+	{ WriteFloatScalar, WriteFloatSSE2, WriteFloatSSE2 }
+};
+
+static const SAMPLE_READ_KERNEL MappedReadKernels[SAMPLE_FORMAT_COUNT] = {
+	ReadMapped<sizeof(INT16), LoadInt16>,
+	ReadMapped<3, LoadInt24>,
+	ReadMapped<sizeof(INT32), LoadInt32>,
+	ReadFloatMapped
+};
+
+static const SAMPLE_WRITE_KERNEL MappedWriteKernels[SAMPLE_FORMAT_COUNT] = {
+	WriteMapped<sizeof(INT16), StoreInt16>,
+	WriteMapped<3, StoreInt24>,
+	WriteMapped<sizeof(INT32), StoreInt32>,
+	WriteFloatMapped
+};
+
+/* Determines the sample format the same way the endpoint format has always been interpreted. */
+static SAMPLE_FORMAT GetSampleFormat(const WAVEFORMATEXTENSIBLE* pFormat) {
+	if (pFormat->SubFormat == KSDATAFORMAT_SUBTYPE_PCM) {
+		if (pFormat->Samples.wValidBitsPerSample == 16) {
+			return SAMPLE_FORMAT_INT16;
+		} else if (pFormat->Format.wBitsPerSample == 24) {
+			return SAMPLE_FORMAT_INT24;
+		} else {
+			return SAMPLE_FORMAT_INT32;
+		}
+	}
+
+	return SAMPLE_FORMAT_FLOAT;
+}
+
+/* Determines the widest instruction set that both the CPU and the operating system support. */
+static SAMPLE_ISA GetSampleISA() {
+	int Info[4] = { 0 };
+
+	__cpuid(Info, 0);
+	const int MaxLeaf = Info[0];
+
+	__cpuid(Info, 1);
+	const bool HasSSE2 = (Info[3] & (1 << 26)) != 0;
+	const bool HasOSXSAVE = (Info[2] & (1 << 27)) != 0;
+	const bool HasAVX = (Info[2] & (1 << 28)) != 0;
+
+	//AVX registers are only usable if the operating system saves them on a context switch
+	if (MaxLeaf >= 7 && HasOSXSAVE && HasAVX && (_xgetbv(0) & 0x6) == 0x6) {
+		__cpuidex(Info, 7, 0);
+
+		if ((Info[1] & (1 << 5)) != 0) {
+			return SAMPLE_ISA_AVX2;
+		}
+	}
+
+	return HasSSE2 ? SAMPLE_ISA_SSE2 : SAMPLE_ISA_SCALAR;
+}
+
+SAMPLE_READ_KERNEL SelectReadKernel(const WAVEFORMATEXTENSIBLE* pFormat, UINT AppChannels) {
+	//The vectorized kernels only produce stereo, and expect at least two channels from the endpoint
+	if (AppChannels != 2 || pFormat->Format.nChannels < 2) {
+		return MappedReadKernels[GetSampleFormat(pFormat)];
+	}
+
+	return ReadKernels[GetSampleFormat(pFormat)][GetSampleISA()];
+}
+
+SAMPLE_WRITE_KERNEL SelectWriteKernel(const WAVEFORMATEXTENSIBLE* pFormat, UINT AppChannels) {
+	if (AppChannels != 2 || pFormat->Format.nChannels < 2) {
+		return MappedWriteKernels[GetSampleFormat(pFormat)];
+	}
+
+	return WriteKernels[GetSampleFormat(pFormat)][GetSampleISA()];
+}
+
+bool IsApplicationFormat(const WAVEFORMATEXTENSIBLE* pFormat, UINT AppChannels) {
+	return GetSampleFormat(pFormat) == SAMPLE_FORMAT_FLOAT && pFormat->Format.wBitsPerSample == 32 && pFormat->Format.nChannels == AppChannels;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+/*
+** Copyright (C) 2015 Austin Borger <aaborger@gmail.com>
+**
+** This program is free software; you can redistribute it and/or modify
+** it under the terms of the GNU General Public License as published by
+** the Free Software Foundation; either version 3 of the License, or
+** (at your option) any later version.
+**
+** This program is distributed in the hope that it will be useful,
+** but WITHOUT ANY WARRANTY; without even the implied warranty of
+** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+** GNU General Public License for more details.
+**
+** You should have received a copy of the GNU General Public License
+** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+** API documentation is available here:
+**		https://github.com/AustinBorger/DXAudio
+*/
+
+#pragma once
+
+#include <Windows.h>
+#include <mmreg.h>
+#include <Audioclient.h>
+
+/* Converts [Frames] interleaved frames of [Channels] channels, in the endpoint format, from [In] to
+** floating-point frames of [AppChannels] channels in [Out].  Endpoint channels the application doesn't
+** have are ignored, and application channels the endpoint doesn't have are silent. */
+typedef VOID (*SAMPLE_READ_KERNEL)(const BYTE* In, FLOAT* Out, UINT Frames, UINT Channels, UINT AppChannels);
+
+/* Converts [Frames] floating-point frames of [AppChannels] channels from [In] to interleaved frames of
+** [Channels] channels, in the endpoint format, in [Out].  Endpoint channels the application doesn't
+** have are zeroed. */
+typedef VOID (*SAMPLE_WRITE_KERNEL)(const FLOAT* In, BYTE* Out, UINT Frames, UINT Channels, UINT AppChannels);
+
+/* Returns the fastest kernel for reading frames in [pFormat] into [AppChannels] channels on this CPU.
+** This should be called once, when the format is known, rather than for every buffer.  When the endpoint
+** uses floating-point samples with the application's channel count, the kernel is a plain copy. */
+SAMPLE_READ_KERNEL SelectReadKernel(const WAVEFORMATEXTENSIBLE* pFormat, UINT AppChannels);
+
+/* Returns the fastest kernel for writing frames of [AppChannels] channels in [pFormat] on this CPU.
+** This should be called once, when the format is known, rather than for every buffer.  When the endpoint
+** uses floating-point samples with the application's channel count, the kernel is a plain copy. */
+SAMPLE_WRITE_KERNEL SelectWriteKernel(const WAVEFORMATEXTENSIBLE* pFormat, UINT AppChannels);
+
+/* Returns true if frames in [pFormat] are laid out exactly like floating-point frames of [AppChannels] channels,
+** so that the application can read or write the endpoint's buffer without a kernel at all. */
+bool IsApplicationFormat(const WAVEFORMATEXTENSIBLE* pFormat, UINT AppChannels);
\ No newline at end of file
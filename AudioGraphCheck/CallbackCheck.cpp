@@ -0,0 +1,223 @@
+#include "Check.h"
+#include "CDXAudioWriteCallback.h"
+#include "CAudioGraphFile.h"
+#include "CAudioGraphLoader.h"
+
+#include <cstdio>
+
+/* Plays a graph on the null backend while the application is deliberately slow, and reads the worst case
+** off the stream's own statistics.  With asynchronous transitions, nothing the application does can hold up a
+** callback.  The same run with transitions asked of the callback is the control: it has to show the stall,
+** or the check couldn't tell the two apart. */
+
+static const UINT s_SampleRate = 48000;
+static const UINT s_NodeFrames = 480; //One period of the simulated endpoint, so nearly every callback has a transition
+static const DWORD s_SlowMilliseconds = 50; //How long the application takes over anything
+
+/* Asks the application thread for every transition, and takes its time answering. */
+class CSlowCallback : public CCheckCallback {
+public:
+	CSlowCallback() :
+	m_Transitions(0)
+	{ }
+
+	LPCSTR STDMETHODCALLTYPE OnTransition(IAudioGraph* pAudioGraph, IAudioGraphNode* pNode) final {
+		InterlockedIncrement(&m_Transitions);
+		Sleep(s_SlowMilliseconds);
+		return "next";
+	}
+
+	/* Returns the number of times the callback was asked for a transition. */
+	LONG GetTransitions() {
+		return InterlockedCompareExchange(&m_Transitions, 0, 0);
+	}
+
+private:
+	volatile LONG m_Transitions;
+};
+
+/* An application thread that posts a trigger, then goes off and does something slow. */
+struct SLOW_APPLICATION {
+	IAudioGraph* Graph;
+	AUDIO_GRAPH_TRIGGER Trigger;
+	volatile LONG Running;
+};
+
+static DWORD __stdcall SlowApplicationEntry(LPVOID Data) {
+	SLOW_APPLICATION* Application = reinterpret_cast<SLOW_APPLICATION*>(Data);
+
+	while (InterlockedCompareExchange(&Application->Running, 0, 0) != 0) {
+		Application->Graph->PostTrigger(Application->Trigger);
+		Sleep(s_SlowMilliseconds);
+	}
+
+	return 0;
+}
+
+/* What a run measured, from the stream and from the write callback. */
+struct SLOW_RUN_RESULT {
+	DXAUDIO_STREAM_STATS Stream;
+	AUDIO_GRAPH_PLAYBACK_STATS Playback;
+	LONG AskedTransitions; //Transitions the callback was asked for
+};
+
+/* Plays two nodes that take turns for [Periods] periods, wired up the way CAudioGraphFactory does it, but with a
+** simulated endpoint so that the stream's statistics can be read. */
+static bool RunSlowApplication(bool AsyncTransitions, UINT64 Periods, SLOW_RUN_RESULT& Result) {
+	const std::wstring WaveFilename = CheckTempPath(L"SlowApplication.wav");
+	const std::wstring GraphFilename = CheckTempPath(L"SlowApplication.xml");
+	CSlowCallback Callback;
+	CComPtr<CAudioGraphLoader> Loader;
+	CComPtr<CAudioGraphFile> File;
+	CComPtr<IDXAudioStream> Stream;
+	CComPtr<IDXAudioStream2> Stream2;
+	std::vector<BYTE> Memory(sizeof(CDXAudioWriteCallback)); //Placement new'd, like it is by CAudioGraphFactory
+	CDXAudioWriteCallback* WriteCallback = nullptr;
+	DXAUDIO_STREAM_DESC_EX Desc = { };
+	SLOW_APPLICATION Application;
+	IAudioGraph* Graph = nullptr;
+	HANDLE Thread = NULL;
+	bool Succeeded = false;
+
+	WriteCheckWave(WaveFilename, s_SampleRate, 2, 16, s_SampleRate);
+
+	WriteCheckFile (
+		GraphFilename,
+		"<AudioGraph>\n"
+		"<Graph id = \"slow\" initial = \"a\">\n"
+		"<Node id = \"a\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"0\" duration = \"" + std::to_string(s_NodeFrames) + "\" default = \"ab\"/>\n"
+		"<Node id = \"b\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"" + std::to_string(s_NodeFrames) + "\" duration = \"" + std::to_string(s_NodeFrames) + "\" default = \"ba\"/>\n"
+		"<Edge id = \"ab\" trigger = \"next\" from = \"a\" to = \"b\"/>\n"
+		"<Edge id = \"ba\" trigger = \"next\" from = \"b\" to = \"a\"/>\n"
+		"</Graph>\n"
+		"</AudioGraph>"
+	);
+
+	Loader.Attach(new CAudioGraphLoader());
+
+	if (!EXPECT(SUCCEEDED(Loader->Initialize(&Callback)))) {
+		return false;
+	}
+
+	File.Attach(new CAudioGraphFile());
+
+	if (!EXPECT(SUCCEEDED(File->Initialize(&Callback, GraphFilename.c_str())))) {
+		Loader->Halt();
+		return false;
+	}
+
+	File->Parse();
+	File->GetGraphByID("slow", &Graph);
+
+	WriteCallback = new (Memory.data()) CDXAudioWriteCallback();
+
+	EXPECT(SUCCEEDED(WriteCallback->Initialize(&Callback, Loader, 2)));
+	WriteCallback->SetAsyncTransitions(AsyncTransitions);
+	EXPECT(SUCCEEDED(WriteCallback->SetMixer(0, 0, 0)));
+
+	Desc.Type = DXAUDIO_STREAM_TYPE_OUTPUT;
+	Desc.Backend = DXAUDIO_BACKEND_NULL;
+
+	if (EXPECT(Graph != nullptr) && EXPECT(SUCCEEDED(DXAudioCreateStreamEx(&Desc, WriteCallback, &Stream))) && EXPECT(SUCCEEDED(Stream->QueryInterface(IID_PPV_ARGS(&Stream2))))) {
+		EXPECT(SUCCEEDED(WriteCallback->SetSampleRate(UINT(Stream->GetSampleRate()))));
+
+		Application.Graph = Graph;
+		Application.Trigger = Graph->ResolveTrigger("next");
+		Application.Running = 1;
+
+		WriteCallback->QueueAudioGraph(Graph);
+		Stream->Start();
+
+		Thread = CreateThread(NULL, 0, SlowApplicationEntry, &Application, 0, NULL);
+
+		//The simulated endpoint runs as fast as the stream can go, so this only waits for as long as the callbacks take
+		for (UINT i = 0; i < 3000; i++) {
+			Stream2->GetStats(&Result.Stream);
+
+			if (Result.Stream.Periods >= Periods) {
+				break;
+			}
+
+			Sleep(10);
+		}
+
+		Stream->Stop();
+
+		InterlockedExchange(&Application.Running, 0);
+
+		if (Thread != NULL) {
+			WaitForSingleObject(Thread, INFINITE);
+			CloseHandle(Thread);
+		}
+
+		//Stopping is asynchronous, so the last period may still be running
+		Sleep(s_SlowMilliseconds * 2);
+
+		Stream2->GetStats(&Result.Stream);
+		WriteCallback->GetPlaybackStats(&Result.Playback);
+		Result.AskedTransitions = Callback.GetTransitions();
+
+		EXPECT(Result.Stream.Periods >= Periods);
+		EXPECT(Callback.GetFailures() == 0);
+
+		Succeeded = true;
+	}
+
+	//The stream holds a reference to the write callback, and has to stop posting work before the loader halts
+	Stream2.Release();
+	Stream.Release();
+	WriteCallback->Release();
+	Loader->Halt();
+
+	return Succeeded;
+}
+
+/* Returns the number of periods that took at least [Milliseconds] to process, as far as the histogram can tell. */
+static UINT64 CountSlowPeriods(const DXAUDIO_STREAM_STATS& Stats, UINT Milliseconds) {
+	UINT64 Slow = 0;
+
+	//Bucket i starts at 2^i microseconds
+	for (UINT i = 0; i < DXAUDIO_STREAM_STATS_BUCKETS; i++) {
+		if ((1ull << i) >= UINT64(Milliseconds) * 1000) {
+			Slow += Stats.ProcessHistogram[i];
+		}
+	}
+
+	return Slow;
+}
+
+static VOID PrintRun(LPCSTR Name, const SLOW_RUN_RESULT& Result) {
+	printf (
+		"\t%s: %llu periods, %llu transitions, %ld asked for, worst period %.1fms, %llu over 16ms\n",
+		Name,
+		Result.Stream.Periods,
+		Result.Playback.Transitions,
+		Result.AskedTransitions,
+		DOUBLE(Result.Stream.MaxProcessTime) / 10000.0,
+		CountSlowPeriods(Result.Stream, 16)
+	);
+}
+
+VOID CheckSlowApplication() {
+	SLOW_RUN_RESULT Async = { };
+	SLOW_RUN_RESULT Sync = { };
+
+	//Asynchronous transitions never wait on the application, however slow it is
+	if (RunSlowApplication(true, 1000, Async)) {
+		PrintRun("async", Async);
+
+		EXPECT(Async.AskedTransitions == 0);
+		EXPECT(Async.Playback.Transitions >= 500);
+		EXPECT(CountSlowPeriods(Async.Stream, 16) == 0);
+		EXPECT(Async.Stream.MaxProcessTime < LONGLONG(s_SlowMilliseconds) * 10000 / 2);
+	}
+
+	//Asking the callback stalls every transition for as long as the application takes
+	if (RunSlowApplication(false, 20, Sync)) {
+		PrintRun("sync", Sync);
+
+		EXPECT(Sync.AskedTransitions > 0);
+		EXPECT(CountSlowPeriods(Sync.Stream, 16) > 0);
+		EXPECT(Sync.Stream.MaxProcessTime >= LONGLONG(s_SlowMilliseconds) * 10000 * 4 / 5);
+	}
+}
@@ -0,0 +1,125 @@
+#include "Check.h"
+
+#include <cstdio>
+#include <cmath>
+
+static volatile LONG s_Failures = 0;
+
+bool CheckExpect(bool Condition, LPCSTR Text, LPCSTR File, UINT Line) {
+	if (!Condition) {
+		printf("\t%s(%u): expected %s\n", File, Line, Text);
+		InterlockedIncrement(&s_Failures);
+	}
+
+	return Condition;
+}
+
+UINT CheckFailures() {
+	return UINT(InterlockedCompareExchange(&s_Failures, 0, 0));
+}
+
+LONGLONG CheckTime() {
+	static LARGE_INTEGER Frequency = { };
+	LARGE_INTEGER Now;
+
+	if (Frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&Frequency);
+	}
+
+	QueryPerformanceCounter(&Now);
+
+	return LONGLONG(DOUBLE(Now.QuadPart) * 10000000.0 / DOUBLE(Frequency.QuadPart));
+}
+
+LONGLONG CheckProcessTime() {
+	FILETIME Creation, Exit, Kernel, User;
+
+	GetProcessTimes(GetCurrentProcess(), &Creation, &Exit, &Kernel, &User);
+
+	return LONGLONG((UINT64(Kernel.dwHighDateTime) << 32) | Kernel.dwLowDateTime) + LONGLONG((UINT64(User.dwHighDateTime) << 32) | User.dwLowDateTime);
+}
+
+std::wstring CheckTempPath(LPCWSTR Name) {
+	WCHAR Directory[MAX_PATH + 1];
+
+	GetTempPathW(MAX_PATH + 1, Directory);
+
+	return std::wstring(Directory) + L"AudioGraphCheck_" + Name;
+}
+
+std::string CheckUtf8(const std::wstring& Path) {
+	int size_needed = WideCharToMultiByte(CP_UTF8, 0, Path.c_str(), int(Path.size()), NULL, 0, NULL, NULL);
+	std::string Utf8(size_needed, 0);
+	WideCharToMultiByte(CP_UTF8, 0, Path.c_str(), int(Path.size()), &Utf8[0], size_needed, NULL, NULL);
+
+	return Utf8;
+}
+
+/* Appends [Bytes] bytes of [Value], little-endian. */
+static VOID AppendLE(std::vector<BYTE>& Data, UINT Value, UINT Bytes) {
+	for (UINT i = 0; i < Bytes; i++) {
+		Data.push_back(BYTE(Value >> (8 * i)));
+	}
+}
+
+VOID WriteCheckWave(const std::wstring& Filename, UINT SampleRate, UINT Channels, UINT Bits, UINT Frames) {
+	const UINT BlockAlign = Channels * Bits / 8;
+	const UINT DataBytes = Frames * BlockAlign;
+	std::vector<BYTE> Data;
+
+	Data.reserve(44 + DataBytes);
+
+	Data.insert(Data.end(), { 'R', 'I', 'F', 'F' });
+	AppendLE(Data, 36 + DataBytes, 4);
+	Data.insert(Data.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+	AppendLE(Data, 16, 4);
+	AppendLE(Data, 1, 2); //WAVE_FORMAT_PCM
+	AppendLE(Data, Channels, 2);
+	AppendLE(Data, SampleRate, 4);
+	AppendLE(Data, SampleRate * BlockAlign, 4);
+	AppendLE(Data, BlockAlign, 2);
+	AppendLE(Data, Bits, 2);
+	Data.insert(Data.end(), { 'd', 'a', 't', 'a' });
+	AppendLE(Data, DataBytes, 4);
+
+	//A sine per channel, at a frequency that doesn't divide the file, so that every frame differs from its neighbours
+	for (UINT i = 0; i < Frames; i++) {
+		for (UINT c = 0; c < Channels; c++) {
+			const DOUBLE Sample = sin(DOUBLE(i) * 0.0123 * DOUBLE(c + 1)) * 0.9;
+
+			if (Bits == 8) {
+				AppendLE(Data, UINT(INT(Sample * 127.0) + 128), 1); //8-bit PCM is unsigned
+			} else {
+				AppendLE(Data, UINT(INT(Sample * DOUBLE((1u << (Bits - 1)) - 1))), Bits / 8);
+			}
+		}
+	}
+
+	WriteCheckFile(Filename, std::string(Data.begin(), Data.end()));
+}
+
+VOID WriteCheckFile(const std::wstring& Filename, const std::string& Text) {
+	HANDLE File = CreateFileW(Filename.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	DWORD Written = 0;
+
+	if (!EXPECT(File != INVALID_HANDLE_VALUE)) {
+		return;
+	}
+
+	WriteFile(File, Text.data(), DWORD(Text.size()), &Written, NULL);
+	CloseHandle(File);
+
+	EXPECT(Written == Text.size());
+}
+
+VOID STDMETHODCALLTYPE CCheckCallback::OnObjectFailure(LPCWSTR File, UINT Line, HRESULT hr) {
+	if (hr == HRESULT_FROM_WIN32(ERROR_BUFFER_OVERFLOW)) {
+		InterlockedIncrement(&m_Overflows);
+		return;
+	}
+
+	_com_error e(hr);
+
+	wprintf(L"\tObject failure in %s @ Line %u: %s\n", File, Line, e.ErrorMessage());
+	InterlockedIncrement(&m_Failures);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "AudioGraph.h"
+#include "QueryInterface.h"
+
+#include <comdef.h>
+#include <atlbase.h>
+#include <Windows.h>
+#include <string>
+#include <vector>
+
+/* Records a failed expectation against the check that's running, which carries on regardless. */
+#define EXPECT(Condition) CheckExpect((Condition), #Condition, __FILE__, __LINE__)
+
+/* A check or benchmark, run by name from Main.cpp. */
+struct CHECK_CASE {
+	LPCSTR Name;
+	VOID (*Run)();
+	bool Benchmark; //Benchmarks only print figures, and are only run with --bench
+};
+
+/* Fails the running check if [Condition] is false.  Returns [Condition]. */
+bool CheckExpect(bool Condition, LPCSTR Text, LPCSTR File, UINT Line);
+
+/* Returns the number of expectations that have failed so far. */
+UINT CheckFailures();
+
+/* Returns the current time in 100-nanosecond units, from the performance counter. */
+LONGLONG CheckTime();
+
+/* Returns the processor time used so far by every thread of the process, in 100-nanosecond units. */
+LONGLONG CheckProcessTime();
+
+/* Returns a path in the temporary directory for a file the checks create. */
+std::wstring CheckTempPath(LPCWSTR Name);
+
+/* Converts a path to UTF-8, for the filename attribute of a node. */
+std::string CheckUtf8(const std::wstring& Path);
+
+/* Writes [Frames] frames of a deterministic, full-scale test signal to a PCM WAV file.  [Bits] is 8, 16, 24 or 32. */
+VOID WriteCheckWave(const std::wstring& Filename, UINT SampleRate, UINT Channels, UINT Bits, UINT Frames);
+
+/* Writes [Text] to a file as it is. */
+VOID WriteCheckFile(const std::wstring& Filename, const std::string& Text);
+
+/* CCheckCallback counts object failures rather than showing them, so that checks can expect them.  Failures
+** other than a full buffer are also printed, since no check expects them.  It lives on the stack of the check,
+** so it isn't reference counted. */
+class CCheckCallback : public IAudioGraphCallback {
+public:
+	CCheckCallback() :
+	m_Failures(0),
+	m_Overflows(0)
+	{ }
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(IAudioGraphCallback);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return 1;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() {
+		return 1;
+	}
+
+	VOID STDMETHODCALLTYPE OnObjectFailure(LPCWSTR File, UINT Line, HRESULT hr) final;
+
+	LPCSTR STDMETHODCALLTYPE OnTransition(IAudioGraph* pAudioGraph, IAudioGraphNode* pNode) {
+		return "";
+	}
+
+	/* Returns the number of failures other than a full buffer. */
+	LONG GetFailures() {
+		return InterlockedCompareExchange(&m_Failures, 0, 0);
+	}
+
+	/* Returns the number of failures reported with ERROR_BUFFER_OVERFLOW. */
+	LONG GetOverflows() {
+		return InterlockedCompareExchange(&m_Overflows, 0, 0);
+	}
+
+private:
+	volatile LONG m_Failures;
+	volatile LONG m_Overflows;
+};
@@ -0,0 +1,292 @@
+﻿#include "Check.h"
+#include "CDXAudioWriteCallback.h"
+#include "CAudioGraphFile.h"
+#include "CAudioGraphLoader.h"
+
+#include <random>
+
+/* Stresses the rings between the application and the render thread.  A write callback is driven directly, with
+** OnProcess() called by a fake render loop instead of a stream, so that the loop can be held back while the
+** rings are filled.  Every graph loops a single node forever, so graphs only come back to the application when
+** they're cleared, skipped, stopped or refused. */
+
+static const UINT s_QueueGraphs = 64; //Graphs [0, 64) are only ever queued
+static const UINT s_NumGraphs = s_QueueGraphs + AUDIO_GRAPH_MAX_VOICES + 64; //The rest are only ever played on the bus
+static const UINT s_SampleRate = 48000;
+static const UINT s_BufferFrames = 480;
+
+/* The write callback and everything it plays, with the render loop. */
+struct COMMAND_RING_HARNESS {
+	CCheckCallback Callback;
+	CComPtr<CAudioGraphLoader> Loader;
+	CComPtr<CAudioGraphFile> File;
+	std::vector<BYTE> Memory; //The write callback is placement new'd, like it is by CAudioGraphFactory
+	CDXAudioWriteCallback* WriteCallback;
+	std::vector<FLOAT> Buffer;
+	volatile LONG Running; //Whether the render loop should keep going
+	volatile LONG64 Callbacks; //Render loop iterations so far
+};
+
+/* Returns the graph at [Index] as the write callback sees it. */
+static CAudioGraph* GetGraph(COMMAND_RING_HARNESS& Harness, UINT Index) {
+	IAudioGraph* Graph = nullptr;
+
+	Harness.File->EnumGraph(Index, &Graph);
+
+	return static_cast<CAudioGraph*>(Graph);
+}
+
+/* Returns the file's reference count, which every graph reference held by the write callback adds to. */
+static ULONG GetReferences(COMMAND_RING_HARNESS& Harness) {
+	Harness.File->AddRef();
+
+	return Harness.File->Release();
+}
+
+/* Calls OnProcess() once, as the stream would. */
+static VOID RenderOnce(COMMAND_RING_HARNESS& Harness) {
+	Harness.WriteCallback->OnProcess(FLOAT(s_SampleRate), Harness.Buffer.data(), s_BufferFrames);
+	InterlockedIncrement64(&Harness.Callbacks);
+}
+
+static DWORD WINAPI RenderLoop(LPVOID lpParameter) {
+	COMMAND_RING_HARNESS& Harness = *(COMMAND_RING_HARNESS*)(lpParameter);
+
+	while (InterlockedCompareExchange(&Harness.Running, 0, 0) != 0) {
+		RenderOnce(Harness);
+	}
+
+	return 0;
+}
+
+/* Releases whatever the render thread has retired.  Posting any command does, and a bus gain has no other effect.
+** The render loop then takes the command, so that the ring is empty again. */
+static VOID Collect(COMMAND_RING_HARNESS& Harness) {
+	Harness.WriteCallback->SetBusGain(0, 1.0f);
+	RenderOnce(Harness);
+}
+
+static bool CreateHarness(COMMAND_RING_HARNESS& Harness) {
+	const std::wstring WaveFilename = CheckTempPath(L"CommandRings.wav");
+	const std::wstring GraphFilename = CheckTempPath(L"CommandRings.xml");
+	const UINT Failures = CheckFailures();
+	std::string Xml = "<AudioGraph>\n";
+
+	WriteCheckWave(WaveFilename, s_SampleRate, 2, 16, s_SampleRate);
+
+	for (UINT i = 0; i < s_NumGraphs; i++) {
+		Xml += "<Graph id = \"g" + std::to_string(i) + "\" initial = \"n\">";
+		Xml += "<Node id = \"n\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"0\" duration = \"48000\"/>";
+		Xml += "</Graph>\n";
+	}
+
+	Xml += "</AudioGraph>";
+
+	WriteCheckFile(GraphFilename, Xml);
+
+	Harness.Loader.Attach(new CAudioGraphLoader());
+
+	if (!EXPECT(SUCCEEDED(Harness.Loader->Initialize(&Harness.Callback)))) {
+		return false;
+	}
+
+	Harness.File.Attach(new CAudioGraphFile());
+
+	if (!EXPECT(SUCCEEDED(Harness.File->Initialize(&Harness.Callback, GraphFilename.c_str())))) {
+		return false;
+	}
+
+	Harness.File->Parse();
+
+	if (!EXPECT(Harness.File->GetNumGraphs() == s_NumGraphs)) {
+		return false;
+	}
+
+	Harness.Memory.resize(sizeof(CDXAudioWriteCallback));
+	Harness.WriteCallback = new (Harness.Memory.data()) CDXAudioWriteCallback();
+	Harness.Buffer.resize(s_BufferFrames * 2);
+	Harness.Running = 0;
+	Harness.Callbacks = 0;
+
+	EXPECT(SUCCEEDED(Harness.WriteCallback->Initialize(&Harness.Callback, Harness.Loader, 2)));
+	Harness.WriteCallback->SetAsyncTransitions(true);
+	EXPECT(SUCCEEDED(Harness.WriteCallback->SetMixer(1, 0, 0)));
+	Harness.WriteCallback->OnThreadInit();
+	EXPECT(SUCCEEDED(Harness.WriteCallback->SetSampleRate(s_SampleRate)));
+
+	return CheckFailures() == Failures && Harness.Callback.GetFailures() == 0;
+}
+
+static VOID DestroyHarness(COMMAND_RING_HARNESS& Harness) {
+	if (Harness.WriteCallback != nullptr) {
+		Harness.WriteCallback->Release();
+		Harness.WriteCallback = nullptr;
+	}
+
+	if (Harness.Loader != nullptr) {
+		Harness.Loader->Halt();
+	}
+}
+
+/* Fills the command ring and the playback queue, and checks that everything past them is refused and handed back. */
+static VOID CheckRingFull(COMMAND_RING_HARNESS& Harness) {
+	CAudioGraph* Graph = GetGraph(Harness, 0);
+	const ULONG References = GetReferences(Harness);
+	AUDIO_GRAPH_PLAYBACK_STATS Stats;
+
+	//The command ring holds exactly its capacity while the render thread is held back
+	for (UINT i = 0; i < AUDIO_GRAPH_COMMAND_CAPACITY; i++) {
+		Harness.WriteCallback->QueueAudioGraph(Graph);
+	}
+
+	EXPECT(Harness.Callback.GetOverflows() == 0);
+
+	Harness.WriteCallback->QueueAudioGraph(Graph);
+
+	EXPECT(Harness.Callback.GetOverflows() == 1);
+	EXPECT(GetReferences(Harness) == References + AUDIO_GRAPH_COMMAND_CAPACITY);
+
+	//The playback queue takes all of them, and the next one is refused by the render thread.  The render
+	//thread doesn't call the application, so the failure is only reported by the next command posted.
+	RenderOnce(Harness);
+
+	Harness.WriteCallback->QueueAudioGraph(Graph);
+	RenderOnce(Harness);
+
+	EXPECT(Harness.Callback.GetOverflows() == 1);
+
+	Collect(Harness);
+
+	Harness.WriteCallback->GetPlaybackStats(&Stats);
+
+	EXPECT(Harness.Callback.GetOverflows() == 2);
+	EXPECT(Stats.RenderFailures == 1);
+	EXPECT(GetReferences(Harness) == References + AUDIO_GRAPH_PLAYBACK_CAPACITY);
+	EXPECT(Graph->IsQueued());
+}
+
+/* Retires as many graphs as the render thread can hold at once, with nothing collected in between, and checks
+** that every one of them makes it back through m_Retired.  This is the case the static_assert on
+** AUDIO_GRAPH_RETIRED_CAPACITY is for - a graph that didn't fit would never be released. */
+static VOID CheckRetiredCapacity(COMMAND_RING_HARNESS& Harness, ULONG References) {
+	UINT Next = s_QueueGraphs;
+	AUDIO_GRAPH_BUS_STATS BusStats;
+
+	//The playback queue is still full from CheckRingFull(), so fill the bus as well, a ring at a time
+	while (Next < s_QueueGraphs + AUDIO_GRAPH_MAX_VOICES) {
+		for (UINT i = 0; i < AUDIO_GRAPH_COMMAND_CAPACITY; i++) {
+			Harness.WriteCallback->PlayAudioGraph(0, GetGraph(Harness, Next++));
+		}
+
+		RenderOnce(Harness);
+	}
+
+	Harness.WriteCallback->GetBusStats(0, &BusStats);
+
+	EXPECT(BusStats.Voices == AUDIO_GRAPH_MAX_VOICES);
+
+	//Every command left retires something: the graphs played over the cap, then the queue, then the bus
+	for (UINT i = 0; i < AUDIO_GRAPH_COMMAND_CAPACITY - 2; i++) {
+		Harness.WriteCallback->PlayAudioGraph(0, GetGraph(Harness, Next++));
+	}
+
+	Harness.WriteCallback->ClearQueue();
+	Harness.WriteCallback->StopBus(0);
+
+	EXPECT(Harness.Callback.GetOverflows() == 2);
+
+	RenderOnce(Harness);
+	Collect(Harness);
+
+	Harness.WriteCallback->GetBusStats(0, &BusStats);
+
+	EXPECT(BusStats.Voices == 0);
+	EXPECT(BusStats.DroppedVoices == AUDIO_GRAPH_COMMAND_CAPACITY - 2);
+	EXPECT(GetReferences(Harness) == References);
+
+	for (UINT i = 0; i < s_NumGraphs; i++) {
+		CAudioGraph* Graph = GetGraph(Harness, i);
+
+		if (!EXPECT(!Graph->IsQueued() && !Graph->IsVoice())) {
+			break;
+		}
+	}
+}
+
+/* Hammers the command ring from the application thread while the render loop drains it as fast as it can. */
+static VOID CheckHammer(COMMAND_RING_HARNESS& Harness, ULONG References) {
+	std::mt19937 Random(12345);
+	HANDLE Thread = NULL;
+	UINT Posted = 0;
+
+	InterlockedExchange(&Harness.Running, 1);
+
+	Thread = CreateThread(NULL, 0, RenderLoop, &Harness, 0, NULL);
+
+	if (!EXPECT(Thread != NULL)) {
+		return;
+	}
+
+	for (UINT i = 0; i < 200000; i++) {
+		const UINT Choice = Random() % 16;
+
+		if (Choice < 8) {
+			Harness.WriteCallback->QueueAudioGraph(GetGraph(Harness, Random() % s_QueueGraphs));
+		} else if (Choice < 12) {
+			CAudioGraph* Graph = GetGraph(Harness, s_QueueGraphs + Random() % (s_NumGraphs - s_QueueGraphs));
+
+			//The application knows which graphs are still voices, since only it hands them back
+			if (!Graph->IsVoice()) {
+				Harness.WriteCallback->PlayAudioGraph(0, Graph);
+			}
+		} else if (Choice == 12) {
+			Harness.WriteCallback->ClearQueue();
+		} else if (Choice == 13) {
+			Harness.WriteCallback->SkipAudioGraph();
+		} else if (Choice == 14) {
+			Harness.WriteCallback->StopBus(0);
+		} else {
+			Harness.WriteCallback->SetBusGain(0, FLOAT(Random() % 100) / 100.0f);
+		}
+
+		Posted++;
+
+		//Now and then, let the render loop catch up, so that the rings don't stay full the whole time
+		if (Random() % 1024 == 0) {
+			Sleep(1);
+		}
+	}
+
+	InterlockedExchange(&Harness.Running, 0);
+	WaitForSingleObject(Thread, INFINITE);
+	CloseHandle(Thread);
+
+	printf("\t%u commands, %lld callbacks, %d refused\n", Posted, Harness.Callbacks, Harness.Callback.GetOverflows());
+
+	EXPECT(Harness.Callbacks > 0);
+
+	//Nothing may have been lost in either direction
+	Harness.WriteCallback->ClearQueue();
+	Harness.WriteCallback->StopBus(0);
+	RenderOnce(Harness);
+	Collect(Harness);
+
+	EXPECT(GetReferences(Harness) == References);
+}
+
+VOID CheckCommandRings() {
+	COMMAND_RING_HARNESS Harness;
+	Harness.WriteCallback = nullptr;
+
+	if (CreateHarness(Harness)) {
+		const ULONG References = GetReferences(Harness);
+
+		CheckRingFull(Harness);
+		CheckRetiredCapacity(Harness, References);
+		CheckHammer(Harness, References);
+
+		EXPECT(Harness.Callback.GetFailures() == 0);
+	}
+
+	DestroyHarness(Harness);
+}
@@ -0,0 +1,82 @@
+#include "Check.h"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+/* Crossfades into a node shorter than the crossfade, then straight out of it with another crossfade.  The
+** first crossfade has to be shortened to fit the short node.  If it were cut off at the next transition
+** instead, the rest of the audio it was fading out would stop dead, which shows as a jump in the output. */
+
+static const UINT s_SampleRate = 8000;
+static const UINT s_ShortFrames = 100; //A quarter of the crossfade into it
+
+VOID CheckCrossfades() {
+	const std::wstring WaveFilename = CheckTempPath(L"Crossfades.wav");
+	const std::wstring GraphFilename = CheckTempPath(L"Crossfades.xml");
+	CCheckCallback Callback;
+	CComPtr<IAudioGraphFactory> Factory;
+	CComPtr<IAudioGraphFile> File;
+	CComPtr<IAudioGraph> Graph;
+	AUDIO_GRAPH_FACTORY_DESC Desc = { };
+	LPCSTR Script[] = { "go", "go" };
+	AUDIO_GRAPH_PLAYBACK_STATS Stats;
+	const FLOAT* Buffer = nullptr;
+	UINT64 Frames = 0;
+	FLOAT MaxStep = 0.0f;
+
+	WriteCheckWave(WaveFilename, s_SampleRate, 2, 16, s_SampleRate * 4);
+
+	//Every edge crossfades for 50ms, which is 400 frames
+	WriteCheckFile (
+		GraphFilename,
+		"<AudioGraph>\n"
+		"<Graph id = \"fades\" initial = \"a\">\n"
+		"<Node id = \"a\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"0\" duration = \"4000\"/>\n"
+		"<Node id = \"b\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"8000\" duration = \"" + std::to_string(s_ShortFrames) + "\"/>\n"
+		"<Node id = \"c\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"16000\" duration = \"4000\" terminal = \"true\"/>\n"
+		"<Edge id = \"ab\" trigger = \"go\" from = \"a\" to = \"b\" crossfade = \"50\"/>\n"
+		"<Edge id = \"bc\" trigger = \"go\" from = \"b\" to = \"c\" crossfade = \"50\"/>\n"
+		"</Graph>\n"
+		"</AudioGraph>"
+	);
+
+	Desc.SampleRate = s_SampleRate;
+	Desc.Offline = TRUE;
+	Desc.TransitionScript = Script;
+	Desc.TransitionScriptLength = 2;
+
+	if (!EXPECT(SUCCEEDED(AudioGraphCreateFactoryEx(&Desc, &Callback, &Factory)))) {
+		return;
+	}
+
+	Factory->ParseAudioGraphFile(GraphFilename.c_str(), &File);
+
+	if (!EXPECT(File != nullptr)) {
+		return;
+	}
+
+	File->GetGraphByID("fades", &Graph);
+	Factory->QueueAudioGraph(Graph);
+	Factory->Render(nullptr);
+	Factory->GetRenderBuffer(&Buffer, &Frames);
+	Factory->GetPlaybackStats(&Stats);
+
+	if (!EXPECT(Buffer != nullptr && Frames >= 4000 + s_ShortFrames + 4000)) {
+		return;
+	}
+
+	//The test signal moves by less than 0.03 from one frame to the next, and so does every crossfade between two
+	//parts of it.  Only audio that stops dead jumps by more.
+	for (UINT64 i = 0; i + 1 < 4000 + s_ShortFrames + 4000; i++) {
+		for (UINT c = 0; c < 2; c++) {
+			MaxStep = std::max(MaxStep, FLOAT(fabs(Buffer[(i + 1) * 2 + c] - Buffer[i * 2 + c])));
+		}
+	}
+
+	printf("\tlargest step between frames %.4f\n", MaxStep);
+
+	EXPECT(Stats.Crossfades == 2);
+	EXPECT(MaxStep < 0.1f);
+	EXPECT(Callback.GetFailures() == 0);
+}
@@ -0,0 +1,231 @@
+#include "Check.h"
+#include "DXAudio.h"
+
+#include <cstdio>
+#include <algorithm>
+
+/* Runs many output streams on the null backend at once, either on shared engine threads or on a thread each.
+** The null backend wakes a stream again as soon as it has processed a period, so every stream is always ready,
+** which is the case where a stream that an engine waits on first could starve the ones after it. */
+
+/* Times the wakeups of one stream, from the stream's thread.  It lives in a vector that outlives the stream,
+** so it isn't reference counted. */
+class CEngineBenchCallback : public IDXAudioWriteCallback {
+public:
+	CEngineBenchCallback() :
+	m_Periods(0),
+	m_Last(0),
+	m_GapSum(0),
+	m_MaxGap(0)
+	{ }
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(IDXAudioWriteCallback);
+		QUERY_INTERFACE_CAST(IDXAudioCallback);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return 1;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() {
+		return 1;
+	}
+
+	VOID STDMETHODCALLTYPE OnObjectFailure(LPCWSTR File, UINT Line, HRESULT hr) final {
+		m_Failures.OnObjectFailure(File, Line, hr);
+	}
+
+	VOID STDMETHODCALLTYPE OnThreadInit() final { }
+
+	VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioOut, UINT Frames) final {
+		const LONGLONG Now = CheckTime();
+
+		ZeroMemory(AudioOut, Frames * 2 * sizeof(FLOAT));
+
+		//The time from one wakeup of this stream to the next, which includes every other stream on its engine
+		if (m_Last != 0) {
+			m_GapSum += Now - m_Last;
+			m_MaxGap = std::max(m_MaxGap, Now - m_Last);
+		}
+
+		m_Last = Now;
+		InterlockedIncrement64(&m_Periods);
+	}
+
+	/* Forgets the wakeups so far.  Only called while the stream is stopped. */
+	VOID Reset() {
+		InterlockedExchange64(&m_Periods, 0);
+		m_Last = 0;
+		m_GapSum = 0;
+		m_MaxGap = 0;
+	}
+
+	LONG64 GetPeriods() {
+		return InterlockedCompareExchange64(&m_Periods, 0, 0);
+	}
+
+	LONGLONG GetMeanGap() {
+		return m_Periods > 1 ? m_GapSum / (m_Periods - 1) : 0;
+	}
+
+	LONGLONG GetMaxGap() {
+		return m_MaxGap;
+	}
+
+	LONG GetFailures() {
+		return m_Failures.GetFailures();
+	}
+
+private:
+	CCheckCallback m_Failures;
+	volatile LONG64 m_Periods;
+	LONGLONG m_Last;
+	LONGLONG m_GapSum;
+	LONGLONG m_MaxGap;
+};
+
+/* What a run of the streams measured. */
+struct ENGINE_BENCH_RESULT {
+	LONG64 MinPeriods; //Periods processed by the stream that got the fewest
+	LONG64 MaxPeriods; //Periods processed by the stream that got the most
+	DOUBLE PeriodsPerSecond; //Periods processed by all of the streams per second of wall time
+	DOUBLE Cpu; //Processor time used by the whole process per second of wall time
+	LONGLONG MeanGap; //The average time between the wakeups of a stream
+	LONGLONG MaxGap; //The longest time between the wakeups of any stream
+	LONGLONG MaxProcessTime; //The longest period any stream took to process, from its statistics
+};
+
+/* Runs [NumStreams] null-backend output streams for [Milliseconds], on shared engines if [Shared] is TRUE. */
+static bool RunStreams(UINT NumStreams, BOOL Shared, DWORD Milliseconds, ENGINE_BENCH_RESULT& Result) {
+	std::vector<CEngineBenchCallback> Callbacks(NumStreams);
+	std::vector<CComPtr<IDXAudioStream>> Streams(NumStreams);
+	DXAUDIO_STREAM_DESC_EX Desc = { };
+	LONGLONG MeanGaps = 0;
+
+	Desc.Type = DXAUDIO_STREAM_TYPE_OUTPUT;
+	Desc.Shared = Shared;
+	Desc.Backend = DXAUDIO_BACKEND_NULL;
+
+	for (UINT i = 0; i < NumStreams; i++) {
+		if (!EXPECT(SUCCEEDED(DXAudioCreateStreamEx(&Desc, &Callbacks[i], &Streams[i])))) {
+			return false;
+		}
+	}
+
+	//Every stream is started before any of them is timed, so the ones started first don't get a head start
+	for (UINT i = 0; i < NumStreams; i++) {
+		Streams[i]->Start();
+	}
+
+	Sleep(100);
+
+	for (UINT i = 0; i < NumStreams; i++) {
+		Streams[i]->Stop();
+	}
+
+	//Stopping is asynchronous, so give every thread the chance to take it in before the counts are reset
+	Sleep(100);
+
+	for (UINT i = 0; i < NumStreams; i++) {
+		Callbacks[i].Reset();
+	}
+
+	const LONGLONG Cpu = CheckProcessTime();
+	const LONGLONG Start = CheckTime();
+
+	for (UINT i = 0; i < NumStreams; i++) {
+		Streams[i]->Start();
+	}
+
+	Sleep(Milliseconds);
+
+	for (UINT i = 0; i < NumStreams; i++) {
+		Streams[i]->Stop();
+	}
+
+	const LONGLONG Wall = CheckTime() - Start;
+	const LONGLONG Used = CheckProcessTime() - Cpu;
+
+	//A stream can still be in the middle of a period when Stop() returns
+	Sleep(100);
+
+	ZeroMemory(&Result, sizeof(Result));
+	Result.MinPeriods = MAXLONGLONG;
+
+	for (UINT i = 0; i < NumStreams; i++) {
+		CComPtr<IDXAudioStream2> Stream2;
+		DXAUDIO_STREAM_STATS Stats = { };
+
+		if (EXPECT(SUCCEEDED(Streams[i]->QueryInterface(IID_PPV_ARGS(&Stream2))))) {
+			Stream2->GetStats(&Stats);
+		}
+
+		Result.MinPeriods = std::min(Result.MinPeriods, Callbacks[i].GetPeriods());
+		Result.MaxPeriods = std::max(Result.MaxPeriods, Callbacks[i].GetPeriods());
+		Result.PeriodsPerSecond += DOUBLE(Callbacks[i].GetPeriods());
+		Result.MaxGap = std::max(Result.MaxGap, Callbacks[i].GetMaxGap());
+		Result.MaxProcessTime = std::max(Result.MaxProcessTime, Stats.MaxProcessTime);
+		MeanGaps += Callbacks[i].GetMeanGap();
+
+		EXPECT(Callbacks[i].GetFailures() == 0);
+	}
+
+	Result.PeriodsPerSecond = Result.PeriodsPerSecond * 10000000.0 / DOUBLE(Wall);
+	Result.Cpu = DOUBLE(Used) / DOUBLE(Wall);
+	Result.MeanGap = MeanGaps / NumStreams;
+
+	//The streams are released before the callbacks they point at
+	Streams.clear();
+
+	return true;
+}
+
+/* Runs more streams than one engine can wait on, all of them always ready, and checks that each of them gets
+** its turn.  Waiting on the events in the same order every time would leave the streams late in the list with
+** nothing. */
+VOID CheckEngineFairness() {
+	static const UINT s_Streams = 64;
+	ENGINE_BENCH_RESULT Result;
+
+	if (!RunStreams(s_Streams, TRUE, 1000, Result)) {
+		return;
+	}
+
+	printf("\t%lld to %lld periods per stream\n", Result.MinPeriods, Result.MaxPeriods);
+
+	EXPECT(Result.MinPeriods > 0);
+	EXPECT(Result.MinPeriods * 2 >= Result.MaxPeriods);
+}
+
+/* Prints the throughput, processor time and wakeup gaps of 1, 8 and 64 streams, shared and on a thread each. */
+VOID BenchEngine() {
+	static const UINT s_Counts[] = { 1, 8, 64 };
+
+	printf("\tstreams  threads   periods/s   cpu   mean gap   max gap   max process   fewest/most periods\n");
+
+	for (UINT Count : s_Counts) {
+		for (BOOL Shared : { TRUE, FALSE }) {
+			ENGINE_BENCH_RESULT Result;
+
+			if (!RunStreams(Count, Shared, 2000, Result)) {
+				return;
+			}
+
+			printf (
+				"\t%7u  %-8s %10.0f  %4.0f%%  %7.1fus  %7.1fus  %10.1fus   %lld/%lld\n",
+				Count,
+				Shared ? "shared" : "own",
+				Result.PeriodsPerSecond,
+				Result.Cpu * 100.0,
+				DOUBLE(Result.MeanGap) / 10.0,
+				DOUBLE(Result.MaxGap) / 10.0,
+				DOUBLE(Result.MaxProcessTime) / 10.0,
+				Result.MinPeriods,
+				Result.MaxPeriods
+			);
+		}
+	}
+}
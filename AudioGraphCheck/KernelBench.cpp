@@ -0,0 +1,161 @@
+#include "Check.h"
+#include "SampleKernels.h"
+
+#include <cstdio>
+#include <algorithm>
+
+/* Measures the endpoint conversion kernels against the per-sample loops ClientReader and ClientWriter used to
+** run, for every endpoint format and a range of endpoint channel counts, converting to and from stereo. */
+
+static const UINT s_Frames = 192000; //One second of an HDMI endpoint at 192 kHz
+static const UINT s_Repeats = 20;
+static const UINT s_AppChannels = 2;
+
+/* An endpoint format the kernels convert. */
+struct KERNEL_BENCH_FORMAT {
+	LPCSTR Name;
+	UINT Bits;
+	bool Float;
+};
+
+static const KERNEL_BENCH_FORMAT s_Formats[] = {
+	{ "int16", 16, false },
+	{ "int24", 24, false },
+	{ "int32", 32, false },
+	{ "float", 32, true },
+};
+
+static const UINT s_Channels[] = { 1, 2, 6, 8 };
+
+static WAVEFORMATEXTENSIBLE MakeFormat(const KERNEL_BENCH_FORMAT& Format, UINT Channels) {
+	WAVEFORMATEXTENSIBLE Extensible;
+
+	ZeroMemory(&Extensible, sizeof(Extensible));
+	Extensible.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+	Extensible.Format.nChannels = WORD(Channels);
+	Extensible.Format.nSamplesPerSec = 192000;
+	Extensible.Format.wBitsPerSample = WORD(Format.Bits);
+	Extensible.Format.nBlockAlign = WORD(Channels * Format.Bits / 8);
+	Extensible.Format.nAvgBytesPerSec = Extensible.Format.nSamplesPerSec * Extensible.Format.nBlockAlign;
+	Extensible.Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+	Extensible.Samples.wValidBitsPerSample = WORD(Format.Bits);
+	Extensible.SubFormat = Format.Float ? KSDATAFORMAT_SUBTYPE_IEEE_FLOAT : KSDATAFORMAT_SUBTYPE_PCM;
+
+	return Extensible;
+}
+
+/* The reference read: one sample at a time, deciding the format for every sample. */
+static VOID ReadReference(const WAVEFORMATEXTENSIBLE& Format, const BYTE* In, FLOAT* Out, UINT Frames) {
+	const UINT Channels = Format.Format.nChannels;
+	const UINT Size = Format.Format.wBitsPerSample / 8;
+
+	for (UINT i = 0; i < Frames; i++) {
+		for (UINT c = 0; c < s_AppChannels; c++) {
+			const BYTE* Sample = In + (i * Channels + c) * Size;
+
+			if (c >= Channels) {
+				*Out++ = 0.0f;
+			} else if (Format.SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT) {
+				*Out++ = *(const FLOAT*)(Sample);
+			} else if (Size == 2) {
+				*Out++ = FLOAT(*(const INT16*)(Sample)) / 32767.0f;
+			} else if (Size == 3) {
+				*Out++ = FLOAT(INT32(UINT32(Sample[0]) << 8 | UINT32(Sample[1]) << 16 | UINT32(Sample[2]) << 24) >> 8) / 8388607.0f;
+			} else {
+				*Out++ = FLOAT(*(const INT32*)(Sample)) / 2147483647.0f;
+			}
+		}
+	}
+}
+
+/* The reference write: one sample at a time, with the endpoint's extra channels zeroed frame by frame. */
+static VOID WriteReference(const WAVEFORMATEXTENSIBLE& Format, const FLOAT* In, BYTE* Out, UINT Frames) {
+	const UINT Channels = Format.Format.nChannels;
+	const UINT Size = Format.Format.wBitsPerSample / 8;
+
+	for (UINT i = 0; i < Frames; i++) {
+		for (UINT c = 0; c < Channels && c < s_AppChannels; c++) {
+			const FLOAT Value = std::max(-1.0f, std::min(1.0f, In[i * s_AppChannels + c]));
+			BYTE* Sample = Out + (i * Channels + c) * Size;
+
+			if (Format.SubFormat == KSDATAFORMAT_SUBTYPE_IEEE_FLOAT) {
+				*(FLOAT*)(Sample) = Value;
+			} else if (Size == 2) {
+				*(INT16*)(Sample) = INT16(Value * 32767.0f);
+			} else if (Size == 3) {
+				const INT32 Packed = INT32(Value * 8388607.0f);
+				Sample[0] = BYTE(Packed);
+				Sample[1] = BYTE(Packed >> 8);
+				Sample[2] = BYTE(Packed >> 16);
+			} else {
+				*(INT32*)(Sample) = INT32(DOUBLE(Value) * 2147483647.0);
+			}
+		}
+
+		if (Channels > s_AppChannels) {
+			ZeroMemory(Out + (i * Channels + s_AppChannels) * Size, (Channels - s_AppChannels) * Size);
+		}
+	}
+}
+
+/* Returns the throughput of [Convert], in millions of frames per second. */
+template <typename T>
+static DOUBLE Measure(T Convert) {
+	LONGLONG Best = MAXLONGLONG;
+
+	//The fastest repeat is the one least disturbed by the rest of the system
+	for (UINT r = 0; r < s_Repeats; r++) {
+		const LONGLONG Start = CheckTime();
+
+		Convert();
+
+		Best = std::min(Best, CheckTime() - Start);
+	}
+
+	return DOUBLE(s_Frames) / (DOUBLE(std::max(Best, 1LL)) / 10.0);
+}
+
+VOID BenchKernels() {
+	std::vector<BYTE> Endpoint(s_Frames * 8 * sizeof(INT32));
+	std::vector<FLOAT> App(s_Frames * s_AppChannels);
+
+	for (size_t i = 0; i < Endpoint.size(); i++) {
+		Endpoint[i] = BYTE(i * 37 + 11);
+	}
+
+	//Float endpoints need real numbers, or the copies would be measured on NaNs and denormals
+	for (size_t i = 0; i < App.size(); i++) {
+		App[i] = FLOAT(i % 2000) / 1000.0f - 1.0f;
+	}
+
+	printf("\t%-6s %8s %14s %14s %8s %14s %14s %8s\n", "format", "channels", "read ref", "read kernel", "speedup", "write ref", "write kernel", "speedup");
+
+	for (const KERNEL_BENCH_FORMAT& Format : s_Formats) {
+		for (UINT Channels : s_Channels) {
+			const WAVEFORMATEXTENSIBLE Extensible = MakeFormat(Format, Channels);
+			const SAMPLE_READ_KERNEL Read = SelectReadKernel(&Extensible, s_AppChannels);
+			const SAMPLE_WRITE_KERNEL Write = SelectWriteKernel(&Extensible, s_AppChannels);
+
+			if (Format.Float) {
+				WriteReference(Extensible, App.data(), Endpoint.data(), s_Frames);
+			}
+
+			const DOUBLE ReadRef = Measure([&] { ReadReference(Extensible, Endpoint.data(), App.data(), s_Frames); });
+			const DOUBLE ReadKernel = Measure([&] { Read(Endpoint.data(), App.data(), s_Frames, Channels, s_AppChannels); });
+			const DOUBLE WriteRef = Measure([&] { WriteReference(Extensible, App.data(), Endpoint.data(), s_Frames); });
+			const DOUBLE WriteKernel = Measure([&] { Write(App.data(), Endpoint.data(), s_Frames, Channels, s_AppChannels); });
+
+			printf (
+				"\t%-6s %8u %9.1f Mf/s %9.1f Mf/s %7.2fx %9.1f Mf/s %9.1f Mf/s %7.2fx\n",
+				Format.Name,
+				Channels,
+				ReadRef,
+				ReadKernel,
+				ReadKernel / ReadRef,
+				WriteRef,
+				WriteKernel,
+				WriteKernel / WriteRef
+			);
+		}
+	}
+}
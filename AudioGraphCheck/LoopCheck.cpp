@@ -0,0 +1,182 @@
+#include "Check.h"
+
+#include <cstdio>
+#include <cmath>
+
+/* Loops a node 10,000 times in an offline render driven by a transition script, and checks that every pass is
+** bit-exact with the first.  The node starts more than three minutes into its file, which is where positions
+** kept in floating-point seconds used to skip and repeat frames at the loop point. */
+
+static const UINT s_SampleRate = 8000; //Low, so that a file over three minutes long stays small
+static const UINT s_FileFrames = s_SampleRate * 200;
+static const UINT s_Offset = s_SampleRate * 190 + 7; //Not a whole number of milliseconds
+static const UINT s_Duration = 1001; //Not a multiple of the offline stream's period
+static const UINT s_Loops = 10000;
+
+/* Renders the loop from a WAV file of [Bits] bits per sample, and checks the passes against each other.  The built-in
+** decoder reads 16-bit and 24-bit files, and Media Foundation reads 8-bit ones, so both paths are covered. */
+static VOID CheckLoop(UINT Bits) {
+	const std::wstring WaveFilename = CheckTempPath((L"Loop" + std::to_wstring(Bits) + L".wav").c_str());
+	const std::wstring GraphFilename = CheckTempPath(L"Loop.xml");
+	CCheckCallback Callback;
+	CComPtr<IAudioGraphFactory> Factory;
+	CComPtr<IAudioGraphFile> File;
+	CComPtr<IAudioGraph> Graph;
+	AUDIO_GRAPH_FACTORY_DESC Desc = { };
+	std::vector<LPCSTR> Script(s_Loops, "again");
+	const FLOAT* Buffer = nullptr;
+	UINT64 Frames = 0;
+	UINT Mismatched = 0;
+
+	WriteCheckWave(WaveFilename, s_SampleRate, 2, Bits, s_FileFrames);
+
+	WriteCheckFile (
+		GraphFilename,
+		"<AudioGraph>\n"
+		"<Graph id = \"loop\" initial = \"loop\">\n"
+		"<Node id = \"loop\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"" + std::to_string(s_Offset) + "\" duration = \"" + std::to_string(s_Duration) + "\"/>\n"
+		"<Node id = \"end\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"0\" duration = \"1\" terminal = \"true\"/>\n"
+		"<Edge id = \"again\" trigger = \"again\" from = \"loop\" to = \"loop\"/>\n"
+		"<Edge id = \"stop\" trigger = \"stop\" from = \"loop\" to = \"end\"/>\n"
+		"</Graph>\n"
+		"</AudioGraph>"
+	);
+
+	//The script replays the node 10,000 times, then leaves for the terminal node so that the render ends
+	Script.push_back("stop");
+
+	Desc.SampleRate = s_SampleRate;
+	Desc.Offline = TRUE;
+	Desc.TransitionScript = Script.data();
+	Desc.TransitionScriptLength = UINT(Script.size());
+
+	if (!EXPECT(SUCCEEDED(AudioGraphCreateFactoryEx(&Desc, &Callback, &Factory)))) {
+		return;
+	}
+
+	Factory->ParseAudioGraphFile(GraphFilename.c_str(), &File);
+
+	if (!EXPECT(File != nullptr)) {
+		return;
+	}
+
+	File->GetGraphByID("loop", &Graph);
+
+	//The 64-bit offset and duration are only on IAudioGraphNode2
+	CComPtr<IAudioGraphNode> Node;
+	CComPtr<IAudioGraphNode2> Node2;
+
+	Graph->GetNodeByID("loop", &Node);
+
+	if (EXPECT(Node != nullptr && SUCCEEDED(Node->QueryInterface(IID_PPV_ARGS(&Node2))))) {
+		EXPECT(Node2->GetSampleOffset64() == s_Offset && Node2->GetSampleDuration64() == s_Duration);
+		EXPECT(Node->GetSampleOffset() == s_Offset && Node->GetSampleDuration() == s_Duration);
+	}
+
+	Factory->QueueAudioGraph(Graph);
+	Factory->Render(nullptr);
+	Factory->GetRenderBuffer(&Buffer, &Frames);
+
+	if (!EXPECT(Buffer != nullptr && Frames >= UINT64(s_Loops + 1) * s_Duration)) {
+		return;
+	}
+
+	//The first pass is the reference, and it has to be the right part of the file
+	for (UINT i = 0; i < s_Duration * 2; i++) {
+		const UINT Frame = s_Offset + i / 2;
+		const DOUBLE Expected = sin(DOUBLE(Frame) * 0.0123 * DOUBLE(i % 2 + 1)) * 0.9;
+
+		if (!EXPECT(fabs(Buffer[i] - Expected) < (Bits == 8 ? 0.02 : 0.001))) {
+			break;
+		}
+	}
+
+	for (UINT Pass = 1; Pass <= s_Loops; Pass++) {
+		if (memcmp(Buffer, Buffer + UINT64(Pass) * s_Duration * 2, s_Duration * 2 * sizeof(FLOAT)) != 0) {
+			if (Mismatched++ == 0) {
+				printf("\t%u-bit: pass %u differs from the first\n", Bits, Pass);
+			}
+		}
+	}
+
+	EXPECT(Mismatched == 0);
+	EXPECT(Callback.GetFailures() == 0);
+}
+
+/* Replays a node that lies past the end of its file, so has nothing to play, until the script sends the graph on to
+** its terminal node.  The graph has to give up on the node for the rest of each callback instead of replaying it
+** forever, and a node that's empty by definition mustn't get past the compiler. */
+static VOID CheckEmptyNode() {
+	const std::wstring WaveFilename = CheckTempPath(L"Empty.wav");
+	const std::wstring GraphFilename = CheckTempPath(L"Empty.xml");
+	CCheckCallback Callback;
+	CComPtr<IAudioGraphFactory> Factory;
+	CComPtr<IAudioGraphFile> File;
+	CComPtr<IAudioGraph> Graph;
+	AUDIO_GRAPH_FACTORY_DESC Desc = { };
+	std::vector<LPCSTR> Script(1000, "again");
+	const FLOAT* Buffer = nullptr;
+	UINT64 Frames = 0;
+
+	WriteCheckWave(WaveFilename, s_SampleRate, 2, 16, s_SampleRate);
+
+	WriteCheckFile (
+		GraphFilename,
+		"<AudioGraph>\n"
+		"<Graph id = \"empty\" initial = \"empty\">\n"
+		"<Node id = \"empty\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"" + std::to_string(s_SampleRate * 2) + "\" duration = \"100\"/>\n"
+		"<Node id = \"end\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"0\" duration = \"100\" terminal = \"true\"/>\n"
+		"<Edge id = \"stop\" trigger = \"stop\" from = \"empty\" to = \"end\"/>\n"
+		"</Graph>\n"
+		"</AudioGraph>"
+	);
+
+	Script.push_back("stop");
+
+	Desc.SampleRate = s_SampleRate;
+	Desc.Offline = TRUE;
+	Desc.TransitionScript = Script.data();
+	Desc.TransitionScriptLength = UINT(Script.size());
+
+	if (!EXPECT(SUCCEEDED(AudioGraphCreateFactoryEx(&Desc, &Callback, &Factory)))) {
+		return;
+	}
+
+	Factory->ParseAudioGraphFile(GraphFilename.c_str(), &File);
+
+	if (!EXPECT(File != nullptr)) {
+		return;
+	}
+
+	File->GetGraphByID("empty", &Graph);
+	Factory->QueueAudioGraph(Graph);
+	Factory->Render(nullptr);
+	Factory->GetRenderBuffer(&Buffer, &Frames);
+
+	//Each callback the empty node stalled is silent, and the script still gets through to the terminal node
+	EXPECT(Buffer != nullptr && Frames > 100 && Buffer[0] == 0.0f);
+
+	WriteCheckFile (
+		GraphFilename,
+		"<AudioGraph>\n"
+		"<Graph id = \"empty\" initial = \"empty\">\n"
+		"<Node id = \"empty\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"0\" duration = \"0\" terminal = \"true\"/>\n"
+		"</Graph>\n"
+		"</AudioGraph>"
+	);
+
+	EXPECT(Callback.GetFailures() == 0);
+
+	//The file fails to compile, which is reported to the callback
+	File = nullptr;
+	Factory->ParseAudioGraphFile(GraphFilename.c_str(), &File);
+
+	EXPECT(Callback.GetFailures() == 1);
+}
+
+VOID CheckLoops() {
+	CheckLoop(16);
+	CheckLoop(24);
+	CheckLoop(8);
+	CheckEmptyNode();
+}
@@ -0,0 +1,83 @@
+﻿#include "Check.h"
+
+#include <cstdio>
+#include <cstring>
+
+/* Runs the checks, or the benchmarks with --bench.  Any other arguments pick checks or benchmarks by name.
+** Returns 1 if any check failed. */
+
+VOID CheckCommandRings();
+VOID CheckLoops();
+VOID CheckCrossfades();
+VOID CheckEngineFairness();
+VOID CheckSlowApplication();
+VOID CheckOfflineReadAhead();
+VOID CheckWavePrefetch();
+VOID BenchKernels();
+VOID BenchEngine();
+VOID BenchTransitions();
+VOID BenchScheduler();
+VOID BenchStreams();
+
+static const CHECK_CASE s_Cases[] = {
+	{ "CommandRings", CheckCommandRings, false },
+	{ "Loops", CheckLoops, false },
+	{ "Crossfades", CheckCrossfades, false },
+	{ "EngineFairness", CheckEngineFairness, false },
+	{ "SlowApplication", CheckSlowApplication, false },
+	{ "OfflineReadAhead", CheckOfflineReadAhead, false },
+	{ "WavePrefetch", CheckWavePrefetch, false },
+	{ "Kernels", BenchKernels, true },
+	{ "Engine", BenchEngine, true },
+	{ "Transitions", BenchTransitions, true },
+	{ "Scheduler", BenchScheduler, true },
+	{ "Streams", BenchStreams, true },
+};
+
+int main(int argc, char** argv) {
+	bool Bench = false;
+	std::vector<LPCSTR> Names;
+	UINT Failed = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bench") == 0) {
+			Bench = true;
+		} else {
+			Names.push_back(argv[i]);
+		}
+	}
+
+	CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+	for (const CHECK_CASE& Case : s_Cases) {
+		bool Selected = Names.empty() ? Case.Benchmark == Bench : false;
+
+		for (LPCSTR Name : Names) {
+			Selected = Selected || strcmp(Name, Case.Name) == 0;
+		}
+
+		if (!Selected) {
+			continue;
+		}
+
+		const UINT Before = CheckFailures();
+
+		printf("%s\n", Case.Name);
+		Case.Run();
+
+		if (Case.Benchmark) {
+			continue;
+		}
+
+		if (CheckFailures() == Before) {
+			printf("\tpassed\n");
+		} else {
+			printf("\tFAILED\n");
+			Failed++;
+		}
+	}
+
+	CoUninitialize();
+
+	return Failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+#include "Check.h"
+
+#include <cstdio>
+
+/* Renders the same graph offline with and without a read-ahead.  An offline render runs far faster than real time,
+** so a decode ring filled by the streaming thread would run dry at random and leave dropouts in the output.  Offline
+** factories read on the render thread instead, so both renders have to come out the same, sample for sample. */
+
+static const UINT s_SampleRate = 48000;
+static const UINT s_Frames = s_SampleRate * 10;
+
+/* Renders the graph in [GraphFilename] with a read-ahead of [ReadAhead] milliseconds into [Output]. */
+static bool RenderWithReadAhead(const std::wstring& GraphFilename, UINT ReadAhead, std::vector<FLOAT>& Output, AUDIO_GRAPH_PLAYBACK_STATS& Stats) {
+	CCheckCallback Callback;
+	CComPtr<IAudioGraphFactory> Factory;
+	CComPtr<IAudioGraphFile> File;
+	CComPtr<IAudioGraph> Graph;
+	AUDIO_GRAPH_FACTORY_DESC Desc = { };
+	const FLOAT* Buffer = nullptr;
+	UINT64 Frames = 0;
+
+	Desc.SampleRate = s_SampleRate;
+	Desc.Offline = TRUE;
+
+	if (!EXPECT(SUCCEEDED(AudioGraphCreateFactoryEx(&Desc, &Callback, &Factory)))) {
+		return false;
+	}
+
+	//The read-ahead is picked up when the graph is set up for playback, so it has to come before the graph is queued
+	Factory->SetReadAhead(ReadAhead);
+	Factory->ParseAudioGraphFile(GraphFilename.c_str(), &File);
+
+	if (!EXPECT(File != nullptr)) {
+		return false;
+	}
+
+	File->GetGraphByID("long", &Graph);
+	Factory->QueueAudioGraph(Graph);
+	Factory->Render(nullptr);
+	Factory->GetRenderBuffer(&Buffer, &Frames);
+	Factory->GetPlaybackStats(&Stats);
+
+	if (!EXPECT(Buffer != nullptr && Frames >= s_Frames)) {
+		return false;
+	}
+
+	Output.assign(Buffer, Buffer + Frames * 2);
+
+	EXPECT(Callback.GetFailures() == 0);
+
+	return true;
+}
+
+VOID CheckOfflineReadAhead() {
+	const std::wstring WaveFilename = CheckTempPath(L"OfflineReadAhead.wav");
+	const std::wstring GraphFilename = CheckTempPath(L"OfflineReadAhead.xml");
+	std::vector<FLOAT> Reference;
+	std::vector<FLOAT> Output;
+	AUDIO_GRAPH_PLAYBACK_STATS Stats;
+
+	WriteCheckWave(WaveFilename, s_SampleRate, 2, 16, s_Frames);
+
+	WriteCheckFile (
+		GraphFilename,
+		"<AudioGraph>\n"
+		"<Graph id = \"long\" initial = \"a\">\n"
+		"<Node id = \"a\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"0\" duration = \"" + std::to_string(s_Frames) + "\" terminal = \"true\"/>\n"
+		"</Graph>\n"
+		"</AudioGraph>"
+	);
+
+	if (!RenderWithReadAhead(GraphFilename, 0, Reference, Stats)) {
+		return;
+	}
+
+	//A ring much shorter than the render, which the streaming thread would have to refill hundreds of times
+	if (!RenderWithReadAhead(GraphFilename, 20, Output, Stats)) {
+		return;
+	}
+
+	printf("\t%llu decode underruns\n", Stats.DecodeUnderruns);
+
+	EXPECT(Stats.DecodeUnderruns == 0);
+	EXPECT(Output.size() == Reference.size());
+	EXPECT(Output.size() == Reference.size() && memcmp(Output.data(), Reference.data(), Output.size() * sizeof(FLOAT)) == 0);
+}
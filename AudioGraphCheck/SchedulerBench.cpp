@@ -0,0 +1,151 @@
+#include "Check.h"
+#include "CDXAudioWriteCallback.h"
+#include "CAudioGraphFile.h"
+#include "CAudioGraphLoader.h"
+
+#include <cstdio>
+#include <algorithm>
+
+/* Measures how rendering 256 voices on a mixer bus scales with the scheduler's threads, from the audio thread
+** alone up to every core.  The write callback is driven directly, with no stream, so that only the render is
+** timed.  The output is also compared between thread counts, since the voices are meant to be mixed in the
+** same order whichever threads rendered them. */
+
+static const UINT s_Voices = AUDIO_GRAPH_MAX_VOICES;
+static const UINT s_SampleRate = 48000;
+static const UINT s_BufferFrames = 480;
+static const UINT s_Callbacks = 1000; //Ten seconds of audio
+static const UINT s_WarmupCallbacks = 100;
+
+/* Renders the voices with [RenderThreads] workers, and returns the time the timed callbacks took.  Their
+** output is left in [Output]. */
+static LONGLONG RenderVoices(UINT RenderThreads, const std::wstring& GraphFilename, std::vector<FLOAT>& Output) {
+	CCheckCallback Callback;
+	CComPtr<CAudioGraphLoader> Loader;
+	CComPtr<CAudioGraphFile> File;
+	std::vector<BYTE> Memory(sizeof(CDXAudioWriteCallback)); //Placement new'd, like it is by CAudioGraphFactory
+	CDXAudioWriteCallback* WriteCallback = nullptr;
+	std::vector<FLOAT> Buffer(s_BufferFrames * 2);
+	AUDIO_GRAPH_BUS_STATS Stats;
+	LONGLONG Time = 0;
+
+	Loader.Attach(new CAudioGraphLoader());
+
+	if (!EXPECT(SUCCEEDED(Loader->Initialize(&Callback)))) {
+		return 0;
+	}
+
+	File.Attach(new CAudioGraphFile());
+
+	if (!EXPECT(SUCCEEDED(File->Initialize(&Callback, GraphFilename.c_str())))) {
+		Loader->Halt();
+		return 0;
+	}
+
+	File->Parse();
+
+	WriteCallback = new (Memory.data()) CDXAudioWriteCallback();
+
+	EXPECT(SUCCEEDED(WriteCallback->Initialize(&Callback, Loader, 2)));
+	WriteCallback->SetAsyncTransitions(true);
+	EXPECT(SUCCEEDED(WriteCallback->SetMixer(1, s_Voices, RenderThreads)));
+	WriteCallback->OnThreadInit();
+	EXPECT(SUCCEEDED(WriteCallback->SetSampleRate(s_SampleRate)));
+
+	//The command ring only holds so many commands, so the voices are started a ring at a time
+	for (UINT i = 0; i < s_Voices; i++) {
+		IAudioGraph* Graph = nullptr;
+
+		File->EnumGraph(i, &Graph);
+		WriteCallback->PlayAudioGraph(0, Graph);
+
+		if ((i + 1) % AUDIO_GRAPH_COMMAND_CAPACITY == 0) {
+			WriteCallback->OnProcess(FLOAT(s_SampleRate), Buffer.data(), s_BufferFrames);
+		}
+	}
+
+	for (UINT i = 0; i < s_WarmupCallbacks; i++) {
+		WriteCallback->OnProcess(FLOAT(s_SampleRate), Buffer.data(), s_BufferFrames);
+	}
+
+	Output.resize(s_Callbacks * s_BufferFrames * 2);
+
+	for (UINT i = 0; i < s_Callbacks; i++) {
+		FLOAT* Out = Output.data() + i * s_BufferFrames * 2;
+		const LONGLONG Start = CheckTime();
+
+		WriteCallback->OnProcess(FLOAT(s_SampleRate), Out, s_BufferFrames);
+
+		Time += CheckTime() - Start;
+	}
+
+	WriteCallback->GetBusStats(0, &Stats);
+
+	EXPECT(Stats.Voices == s_Voices);
+	EXPECT(Callback.GetFailures() == 0);
+
+	WriteCallback->Release();
+	Loader->Halt();
+
+	return Time;
+}
+
+VOID BenchScheduler() {
+	const std::wstring WaveFilename = CheckTempPath(L"Scheduler.wav");
+	const std::wstring GraphFilename = CheckTempPath(L"Scheduler.xml");
+	const DOUBLE Audio = DOUBLE(s_Callbacks) * DOUBLE(s_BufferFrames) / DOUBLE(s_SampleRate) * 10000000.0;
+	std::string Xml = "<AudioGraph>\n";
+	std::vector<FLOAT> Reference;
+	std::vector<FLOAT> Output;
+	std::vector<UINT> Counts;
+	SYSTEM_INFO Info;
+	LONGLONG Alone = 0;
+
+	WriteCheckWave(WaveFilename, s_SampleRate, 2, 16, s_SampleRate * 10);
+
+	//Every voice loops its own second of the file forever
+	for (UINT i = 0; i < s_Voices; i++) {
+		Xml += "<Graph id = \"g" + std::to_string(i) + "\" initial = \"n\">";
+		Xml += "<Node id = \"n\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"" + std::to_string(i % 9 * s_SampleRate) + "\" duration = \"" + std::to_string(s_SampleRate) + "\"/>";
+		Xml += "</Graph>\n";
+	}
+
+	Xml += "</AudioGraph>";
+
+	WriteCheckFile(GraphFilename, Xml);
+
+	//The audio thread renders too, so n workers use n + 1 cores
+	GetSystemInfo(&Info);
+
+	const UINT MaxThreads = std::min(UINT(Info.dwNumberOfProcessors) - 1, AUDIO_GRAPH_MAX_RENDER_THREADS);
+
+	for (UINT Threads = 0; Threads < MaxThreads; Threads = Threads * 2 + 1) {
+		Counts.push_back(Threads);
+	}
+
+	Counts.push_back(MaxThreads);
+
+	printf("\t%u voices, %u-frame callbacks, %u cores\n", s_Voices, s_BufferFrames, UINT(Info.dwNumberOfProcessors));
+	printf("\tcores   per callback   realtime   speedup   output\n");
+
+	for (UINT Threads : Counts) {
+		const LONGLONG Time = RenderVoices(Threads, GraphFilename, Threads == 0 ? Reference : Output);
+
+		if (Time == 0) {
+			return;
+		}
+
+		if (Threads == 0) {
+			Alone = Time;
+		}
+
+		printf (
+			"\t%5u   %10.1fus   %7.1fx   %6.2fx   %s\n",
+			Threads + 1,
+			DOUBLE(Time) / DOUBLE(s_Callbacks) / 10.0,
+			Audio / DOUBLE(Time),
+			DOUBLE(Alone) / DOUBLE(Time),
+			Threads == 0 ? "reference" : Output == Reference ? "identical" : "DIFFERS"
+		);
+	}
+}
@@ -0,0 +1,244 @@
+#include "Check.h"
+#include "DXAudio.h"
+
+#include <cstdio>
+
+/* Runs one stream of every type on the null backend, with nothing but the stream itself between the callback and
+** the simulated endpoints.  The endpoints run on the simulated clock, so the buffer figures are the same on every
+** machine, while the throughput and processor time show what the stream costs per period. */
+
+/* Counts what the stream hands the callback.  It lives on the stack of the benchmark, so it isn't reference counted. */
+template <class Interface>
+class CStreamBenchCallback : public Interface {
+public:
+	CStreamBenchCallback() :
+	m_Frames(0)
+	{ }
+
+	STDMETHODIMP QueryInterface(REFIID riid, void** ppvObject) final {
+		QUERY_INTERFACE_CAST(Interface);
+		QUERY_INTERFACE_CAST(IDXAudioCallback);
+		QUERY_INTERFACE_CAST(IUnknown);
+		QUERY_INTERFACE_FAIL();
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef() {
+		return 1;
+	}
+
+	ULONG STDMETHODCALLTYPE Release() {
+		return 1;
+	}
+
+	VOID STDMETHODCALLTYPE OnObjectFailure(LPCWSTR File, UINT Line, HRESULT hr) final {
+		m_Failures.OnObjectFailure(File, Line, hr);
+	}
+
+	VOID STDMETHODCALLTYPE OnThreadInit() final { }
+
+	/* Returns the number of frames the callback has been handed. */
+	LONG64 GetFrames() {
+		return InterlockedCompareExchange64(&m_Frames, 0, 0);
+	}
+
+	LONG GetFailures() {
+		return m_Failures.GetFailures();
+	}
+
+protected:
+	VOID Count(UINT Frames) {
+		InterlockedExchangeAdd64(&m_Frames, Frames);
+	}
+
+private:
+	CCheckCallback m_Failures;
+	volatile LONG64 m_Frames;
+};
+
+/* Output streams - writes silence. */
+class CStreamBenchWriteCallback : public CStreamBenchCallback<IDXAudioWriteCallback> {
+public:
+	VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioOut, UINT Frames) final {
+		ZeroMemory(AudioOut, Frames * 2 * sizeof(FLOAT));
+		Count(Frames);
+	}
+};
+
+/* Input and loopback streams - reads every sample, so the input can't be skipped. */
+class CStreamBenchReadCallback : public CStreamBenchCallback<IDXAudioReadCallback> {
+public:
+	CStreamBenchReadCallback() :
+	m_Sum(0.0f)
+	{ }
+
+	VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioIn, UINT Frames) final {
+		for (UINT i = 0; i < Frames * 2; i++) {
+			m_Sum += AudioIn[i];
+		}
+
+		Count(Frames);
+	}
+
+private:
+	volatile FLOAT m_Sum;
+};
+
+/* Duplex and echo streams - passes the input through to the output. */
+class CStreamBenchReadWriteCallback : public CStreamBenchCallback<IDXAudioReadWriteCallback> {
+public:
+	VOID STDMETHODCALLTYPE OnProcess(FLOAT SampleRate, FLOAT* AudioIn, FLOAT* AudioOut, UINT Frames) final {
+		CopyMemory(AudioOut, AudioIn, Frames * 2 * sizeof(FLOAT));
+		Count(Frames);
+	}
+};
+
+/* The simulated endpoints a stream type is run against. */
+struct STREAM_BENCH_DEVICE {
+	LPCSTR Name;
+	INT InputDrift;
+	INT OutputDrift;
+	UINT GlitchInterval;
+	LONGLONG GlitchDelay;
+};
+
+static const STREAM_BENCH_DEVICE s_Devices[] = {
+	{ "steady", 0, 0, 0, 0 },
+	{ "drift", 200, -200, 0, 0 },
+	{ "glitch", 0, 0, 100, 200000 }, //Every 100th wakeup is two periods late
+};
+
+/* What a run of one stream measured. */
+struct STREAM_BENCH_RESULT {
+	DXAUDIO_STREAM_STATS Stats;
+	DOUBLE PeriodsPerSecond; //Periods processed per second of wall time
+	DOUBLE RealTimeFactor; //Seconds of audio handed to the callback per second of wall time
+	DOUBLE Cpu; //Processor time used by the whole process per second of wall time
+};
+
+/* Runs a stream of [Type] for [Milliseconds] against [Device], with [pCallback] as its callback. */
+template <class Callback>
+static bool RunStream(DXAUDIO_STREAM_TYPE Type, const STREAM_BENCH_DEVICE& Device, DWORD Milliseconds, Callback* pCallback, STREAM_BENCH_RESULT& Result) {
+	CComPtr<IDXAudioStream> Stream;
+	CComPtr<IDXAudioStream2> Stream2;
+	DXAUDIO_STREAM_DESC_EX Desc = { };
+	DXAUDIO_NULL_DEVICE_DESC NullDevice = { };
+
+	NullDevice.InputDrift = Device.InputDrift;
+	NullDevice.OutputDrift = Device.OutputDrift;
+	NullDevice.GlitchInterval = Device.GlitchInterval;
+	NullDevice.GlitchDelay = Device.GlitchDelay;
+
+	Desc.SampleRate = 44100.0f; //The endpoints run at 48000, so every stream resamples both ways
+	Desc.Type = Type;
+	Desc.Backend = DXAUDIO_BACKEND_NULL;
+	Desc.NullDevice = &NullDevice;
+
+	if (!EXPECT(SUCCEEDED(DXAudioCreateStreamEx(&Desc, pCallback, &Stream)))) {
+		return false;
+	}
+
+	if (!EXPECT(SUCCEEDED(Stream->QueryInterface(IID_PPV_ARGS(&Stream2))))) {
+		return false;
+	}
+
+	const LONGLONG Cpu = CheckProcessTime();
+	const LONGLONG Start = CheckTime();
+
+	Stream->Start();
+	Sleep(Milliseconds);
+	Stream->Stop();
+
+	const LONGLONG Wall = CheckTime() - Start;
+	const LONGLONG Used = CheckProcessTime() - Cpu;
+
+	//A stream can still be in the middle of a period when Stop() returns
+	Sleep(100);
+
+	ZeroMemory(&Result, sizeof(Result));
+
+	Stream2->GetStats(&Result.Stats);
+
+	Result.PeriodsPerSecond = DOUBLE(Result.Stats.Periods) * 10000000.0 / DOUBLE(Wall);
+	Result.RealTimeFactor = DOUBLE(pCallback->GetFrames()) / DOUBLE(Desc.SampleRate) * 10000000.0 / DOUBLE(Wall);
+	Result.Cpu = DOUBLE(Used) / DOUBLE(Wall);
+
+	EXPECT(Result.Stats.Periods > 0);
+	EXPECT(pCallback->GetFailures() == 0);
+
+	return true;
+}
+
+/* Prints a run of one stream.  The latency columns are only filled in by duplex streams. */
+static VOID PrintStream(LPCSTR Type, LPCSTR Device, const STREAM_BENCH_RESULT& Result) {
+	const DXAUDIO_STREAM_STATS& Stats = Result.Stats;
+
+	printf (
+		"\t%-9s %-7s %10.0f  %7.1fx  %4.0f%%  %8.1fus  %8.1fus  %6llu/%-6llu  %6llu  %7.2fms  %+7.2fms  %7.2fms  %+5lldppm\n",
+		Type,
+		Device,
+		Result.PeriodsPerSecond,
+		Result.RealTimeFactor,
+		Result.Cpu * 100.0,
+		DOUBLE(Stats.MaxProcessTime) / 10.0,
+		DOUBLE(Stats.MaxJitter) / 10.0,
+		Stats.Underruns,
+		Stats.Overruns,
+		Stats.DroppedFrames,
+		DOUBLE(Stats.TargetLatency) / 10000.0,
+		DOUBLE(Stats.LatencyError) / 10000.0,
+		DOUBLE(Stats.MaxLatencyError) / 10000.0,
+		Stats.DriftCorrection
+	);
+}
+
+/* Prints the throughput, processor time, buffer faults and duplex latency of every stream type on the null backend,
+** against steady, drifting and glitching endpoints. */
+VOID BenchStreams() {
+	static const DWORD s_Milliseconds = 1000;
+
+	printf("\ttype      device   periods/s   realtime   cpu  max process  max jitter  under/over   dropped   target   latency err  max err    drift\n");
+
+	for (const STREAM_BENCH_DEVICE& Device : s_Devices) {
+		STREAM_BENCH_RESULT Result;
+
+		CStreamBenchWriteCallback Output;
+
+		if (!RunStream(DXAUDIO_STREAM_TYPE_OUTPUT, Device, s_Milliseconds, &Output, Result)) {
+			return;
+		}
+
+		PrintStream("output", Device.Name, Result);
+
+		CStreamBenchReadCallback Input;
+
+		if (!RunStream(DXAUDIO_STREAM_TYPE_INPUT, Device, s_Milliseconds, &Input, Result)) {
+			return;
+		}
+
+		PrintStream("input", Device.Name, Result);
+
+		CStreamBenchReadCallback Loopback;
+
+		if (!RunStream(DXAUDIO_STREAM_TYPE_LOOPBACK, Device, s_Milliseconds, &Loopback, Result)) {
+			return;
+		}
+
+		PrintStream("loopback", Device.Name, Result);
+
+		CStreamBenchReadWriteCallback Duplex;
+
+		if (!RunStream(DXAUDIO_STREAM_TYPE_DUPLEX, Device, s_Milliseconds, &Duplex, Result)) {
+			return;
+		}
+
+		PrintStream("duplex", Device.Name, Result);
+
+		CStreamBenchReadWriteCallback Echo;
+
+		if (!RunStream(DXAUDIO_STREAM_TYPE_ECHO, Device, s_Milliseconds, &Echo, Result)) {
+			return;
+		}
+
+		PrintStream("echo", Device.Name, Result);
+	}
+}
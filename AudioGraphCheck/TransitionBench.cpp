@@ -0,0 +1,180 @@
+#include "Check.h"
+#include "CAudioGraphFile.h"
+#include "CAudioGraph.h"
+
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <random>
+
+/* Measures how long choosing a transition takes in a graph of 10,000 nodes, by trigger handle and by trigger
+** string, against the per-node string maps that transitions used to be looked up in. */
+
+static const UINT s_Nodes = 10000;
+static const UINT s_EdgesPerNode = 8;
+static const UINT s_Triggers = 256;
+static const UINT s_Lookups = 1000000;
+static const UINT s_Repeats = 10;
+
+/* A transition to look up.  A quarter of them are for triggers the node has no edge for. */
+struct TRANSITION_BENCH_LOOKUP {
+	UINT Node;
+	UINT Trigger;
+};
+
+static std::string GetTriggerName(UINT Trigger) {
+	return "trigger_" + std::to_string(Trigger);
+}
+
+/* Returns the best time of [s_Repeats] runs of [Run], in nanoseconds per lookup. */
+template <class T>
+static DOUBLE TimeLookups(T Run) {
+	LONGLONG Best = MAXLONGLONG;
+
+	for (UINT r = 0; r < s_Repeats; r++) {
+		const LONGLONG Start = CheckTime();
+
+		Run();
+
+		Best = std::min(Best, CheckTime() - Start);
+	}
+
+	return DOUBLE(Best) * 100.0 / DOUBLE(s_Lookups);
+}
+
+VOID BenchTransitions() {
+	const std::wstring GraphFilename = CheckTempPath(L"Transitions.xml");
+	CCheckCallback Callback;
+	CComPtr<CAudioGraphFile> File;
+	IAudioGraph* Graph = nullptr;
+	std::string Xml = "<AudioGraph>\n<Graph id = \"g\" initial = \"n0\">\n";
+
+	//Every node has edges on eight of the triggers, to nodes spread over the graph.  No file is ever opened.
+	for (UINT i = 0; i < s_Nodes; i++) {
+		Xml += "<Node id = \"n" + std::to_string(i) + "\" filename = \"unused.wav\" offset = \"0\" duration = \"48000\"/>\n";
+	}
+
+	for (UINT i = 0; i < s_Nodes; i++) {
+		for (UINT k = 0; k < s_EdgesPerNode; k++) {
+			Xml += "<Edge id = \"e" + std::to_string(i) + "_" + std::to_string(k) + "\" trigger = \"" + GetTriggerName((i + k * 37) % s_Triggers) + "\"";
+			Xml += " from = \"n" + std::to_string(i) + "\" to = \"n" + std::to_string((i * 7 + k * 13 + 1) % s_Nodes) + "\"/>\n";
+		}
+	}
+
+	Xml += "</Graph>\n</AudioGraph>";
+
+	WriteCheckFile(GraphFilename, Xml);
+
+	File.Attach(new CAudioGraphFile());
+
+	if (!EXPECT(SUCCEEDED(File->Initialize(&Callback, GraphFilename.c_str())))) {
+		return;
+	}
+
+	const LONGLONG ParseStart = CheckTime();
+
+	File->Parse();
+
+	const LONGLONG ParseTime = CheckTime() - ParseStart;
+
+	File->EnumGraph(0, &Graph);
+
+	if (!EXPECT(Graph != nullptr && Graph->GetNumNodes() == s_Nodes && Graph->GetNumEdges() == s_Nodes * s_EdgesPerNode)) {
+		return;
+	}
+
+	CAudioGraph* l_Graph = static_cast<CAudioGraph*>(Graph);
+	std::vector<CAudioGraphNode*> Nodes(s_Nodes);
+	std::unordered_map<IAudioGraphNode*, UINT> NodeIndex;
+	std::vector<std::map<std::string, CAudioGraphEdge*>> Maps(s_Nodes);
+	std::vector<std::string> Names(s_Triggers + 1);
+	std::vector<AUDIO_GRAPH_TRIGGER> Handles(s_Triggers + 1);
+	std::vector<TRANSITION_BENCH_LOOKUP> Lookups(s_Lookups);
+	UINT Mismatches = 0;
+
+	for (UINT i = 0; i < s_Nodes; i++) {
+		IAudioGraphNode* Node = nullptr;
+
+		Graph->EnumNode(i, &Node);
+		Nodes[i] = static_cast<CAudioGraphNode*>(Node);
+		NodeIndex[Node] = i;
+	}
+
+	//The reference is what each node kept before triggers had handles: a map from trigger string to edge
+	for (UINT i = 0; i < Graph->GetNumEdges(); i++) {
+		IAudioGraphEdge* Edge = nullptr;
+		IAudioGraphNode* From = nullptr;
+
+		Graph->EnumEdge(i, &Edge);
+		Edge->GetFrom(&From);
+
+		Maps[NodeIndex[From]][Edge->GetTrigger()] = static_cast<CAudioGraphEdge*>(Edge);
+	}
+
+	//The last name is a trigger no edge uses at all
+	for (UINT t = 0; t <= s_Triggers; t++) {
+		Names[t] = t < s_Triggers ? GetTriggerName(t) : "missing";
+		Handles[t] = Graph->ResolveTrigger(Names[t].c_str());
+	}
+
+	EXPECT(Handles[s_Triggers] == AUDIO_GRAPH_TRIGGER_NONE);
+
+	std::mt19937 Random(1);
+
+	for (TRANSITION_BENCH_LOOKUP& Lookup : Lookups) {
+		Lookup.Node = Random() % s_Nodes;
+		Lookup.Trigger = Random() % 4 != 0 ? (Lookup.Node + (Random() % s_EdgesPerNode) * 37) % s_Triggers : Random() % (s_Triggers + 1);
+	}
+
+	//Every way of looking a transition up has to find the same edge
+	for (const TRANSITION_BENCH_LOOKUP& Lookup : Lookups) {
+		auto Found = Maps[Lookup.Node].find(Names[Lookup.Trigger]);
+		CAudioGraphEdge* Expected = Found != Maps[Lookup.Node].end() ? Found->second : nullptr;
+
+		if (l_Graph->GetTransitionEdge(Nodes[Lookup.Node], Handles[Lookup.Trigger]) != Expected ||
+			l_Graph->GetTransitionEdge(Nodes[Lookup.Node], Graph->ResolveTrigger(Names[Lookup.Trigger].c_str())) != Expected) {
+			Mismatches++;
+		}
+	}
+
+	EXPECT(Mismatches == 0);
+
+	volatile UINT_PTR Sink = 0;
+
+	const DOUBLE ByHandle = TimeLookups([&]() {
+		UINT_PTR Sum = 0;
+
+		for (const TRANSITION_BENCH_LOOKUP& Lookup : Lookups) {
+			Sum += UINT_PTR(l_Graph->GetTransitionEdge(Nodes[Lookup.Node], Handles[Lookup.Trigger]));
+		}
+
+		Sink = Sink + Sum;
+	});
+
+	const DOUBLE ByString = TimeLookups([&]() {
+		UINT_PTR Sum = 0;
+
+		for (const TRANSITION_BENCH_LOOKUP& Lookup : Lookups) {
+			Sum += UINT_PTR(l_Graph->GetTransitionEdge(Nodes[Lookup.Node], Graph->ResolveTrigger(Names[Lookup.Trigger].c_str())));
+		}
+
+		Sink = Sink + Sum;
+	});
+
+	const DOUBLE ByMap = TimeLookups([&]() {
+		UINT_PTR Sum = 0;
+
+		for (const TRANSITION_BENCH_LOOKUP& Lookup : Lookups) {
+			auto Found = Maps[Lookup.Node].find(Names[Lookup.Trigger]);
+			Sum += Found != Maps[Lookup.Node].end() ? UINT_PTR(Found->second) : 0;
+		}
+
+		Sink = Sink + Sum;
+	});
+
+	printf("\t%u nodes, %u edges, %u triggers, parsed in %.1fms\n", s_Nodes, s_Nodes * s_EdgesPerNode, s_Triggers, DOUBLE(ParseTime) / 10000.0);
+	printf("\tby handle:            %6.1fns per transition\n", ByHandle);
+	printf("\tby string:            %6.1fns per transition\n", ByString);
+	printf("\tper-node string map:  %6.1fns per transition\n", ByMap);
+}
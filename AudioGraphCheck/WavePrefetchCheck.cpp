@@ -0,0 +1,67 @@
+#include "Check.h"
+
+#include <cstdio>
+
+/* Plays WAV nodes, which are read through a mapping by the built-in decoder, from one to the next with prefetching
+** on.  The decoder never has to seek, but the start of each node still has to be read from the disk, so every
+** transition has to be prefetched by the streaming thread rather than left to fault on the render thread. */
+
+static const UINT s_SampleRate = 48000;
+
+VOID CheckWavePrefetch() {
+	const std::wstring WaveFilename = CheckTempPath(L"WavePrefetch.wav");
+	const std::wstring GraphFilename = CheckTempPath(L"WavePrefetch.xml");
+	CCheckCallback Callback;
+	CComPtr<IAudioGraphFactory> Factory;
+	CComPtr<IAudioGraphFile> File;
+	CComPtr<IAudioGraph> Graph;
+	AUDIO_GRAPH_FACTORY_DESC Desc = { };
+	LPCSTR Script[] = { "go", "go" };
+	AUDIO_GRAPH_PLAYBACK_STATS Stats;
+
+	//Written at the stream's rate and channel count, so the built-in decoder reads it rather than Media Foundation
+	WriteCheckWave(WaveFilename, s_SampleRate, 2, 16, s_SampleRate * 6);
+
+	//Each node is a second long, and starts on a part of the file no other node has played
+	WriteCheckFile (
+		GraphFilename,
+		"<AudioGraph>\n"
+		"<Graph id = \"wave\" initial = \"a\">\n"
+		"<Node id = \"a\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"0\" duration = \"48000\"/>\n"
+		"<Node id = \"b\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"96000\" duration = \"48000\"/>\n"
+		"<Node id = \"c\" filename = \"" + CheckUtf8(WaveFilename) + "\" offset = \"192000\" duration = \"48000\" terminal = \"true\"/>\n"
+		"<Edge id = \"ab\" trigger = \"go\" from = \"a\" to = \"b\"/>\n"
+		"<Edge id = \"bc\" trigger = \"go\" from = \"b\" to = \"c\"/>\n"
+		"</Graph>\n"
+		"</AudioGraph>"
+	);
+
+	Desc.SampleRate = s_SampleRate;
+	Desc.Offline = TRUE;
+	Desc.TransitionScript = Script;
+	Desc.TransitionScriptLength = 2;
+
+	if (!EXPECT(SUCCEEDED(AudioGraphCreateFactoryEx(&Desc, &Callback, &Factory)))) {
+		return;
+	}
+
+	//The prefetch time is picked up when the graph is set up for playback, so it has to come before the graph is queued
+	Factory->SetPrefetchTime(200);
+	Factory->ParseAudioGraphFile(GraphFilename.c_str(), &File);
+
+	if (!EXPECT(File != nullptr)) {
+		return;
+	}
+
+	File->GetGraphByID("wave", &Graph);
+	Factory->QueueAudioGraph(Graph);
+	Factory->Render(nullptr);
+	Factory->GetPlaybackStats(&Stats);
+
+	printf("\t%llu transitions, %llu prefetched, %llu cold\n", Stats.Transitions, Stats.Prefetches, Stats.ColdTransitions);
+
+	EXPECT(Stats.Transitions == 2);
+	EXPECT(Stats.Prefetches == 2);
+	EXPECT(Stats.ColdTransitions == 0);
+	EXPECT(Callback.GetFailures() == 0);
+}